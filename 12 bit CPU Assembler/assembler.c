@@ -18,37 +18,250 @@
  *
  * param argc - Number of command-line arguments.
  * param argv - Array of command-line arguments.
- * returns 0 on successful execution.
+ * returns 0 on successful execution (1 if a file that was checked by --check, or the source of the stream or
+ * the session mode, has errors).
  */
 int main(int argc, char *argv[]){
 
 	int i, is_valid, is_pre_valid, err_ln_size, ic, dc, *error_lines = NULL,
-		is_first_valid, is_second_valid; 
+		is_first_valid, is_second_valid, threads = 1, /* threads - number of parsing threads (-j option) */
+		is_map = 0, /* --map option */
+		is_obb = 0, /* --obb option */
+		is_optimize = 0, rewrites, image_words, /* -O option */
+		symbols_cnt, symbols_max_depth,
+		errors_limit = 0, errors_arg, /* --max-errors option */
+		is_check = 0, /* --check option */
+		is_failed = 0, /* the exit status - a file failed the check mode, the stream mode or the session mode */
+		is_deps_only = 0, is_deps_file = 0, /* -M and -MD options */
+		is_symbols_export = 0; /* --export-symbols option */
+	long symbols_depth_sum;
+	double file_start; /* trace clock time when the current file started */
+	enum stats_format stats_fmt = stats_none; /* --stats/--stats-json option */
+	enum diag_format diag_fmt = diag_text; /* --diag-json option */
+	long cache_size = DEFAULT_CACHE_SIZE; /* maximum cache size in KB (--cache-size option) */
+	char *cache_dir = NULL, cache_key[CACHE_KEY_LEN], profile[CACHE_PROFILE_LEN]; /* cache directory (--cache option) */
+	int has_cached_ent, has_cached_ext; /* the .ent/.ext files of a cache hit */
+	cache_stats cache_counters = {0, 0, 0};
 	macro_node *head_macro = NULL, *tail_macro = NULL; /* initializes macro data structure */
 	symbol_table_node *label_root = NULL; /* initializes labels table data structure */
+	extern_ref_vector ext_refs = {NULL, 0, 0}; /* initializes external references log */
+	symbol_table_node *plain_root; /* the table of the file without the snapshot (--import-symbols option) */
+	extern_ref_vector plain_refs = {NULL, 0, 0};
+	line_map_vector line_map = {NULL, 0, 0}; /* initializes the line map (--map option) */
+	map_origin_vector origins = {NULL, 0, 0}; /* initializes the .as origins of the .am lines (--map option) */
 	mem_code_word code_im[MAX_MEMORY_ASSUMPTION] = {0}; /* code image */
 	mem_data_word data_im[MAX_MEMORY_ASSUMPTION] = {0}; /* data image */
+	unsigned short obb_words[2 * MAX_MEMORY_ASSUMPTION]; /* the code and the data words of the .obb file */
 	
 	/* if no file was entered in command line */
 	if (argc < 2){
 	
-		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s file file ...)", argv[0]);
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s [-j threads] [--cache dir] [--cache-size KB] [--stats | --stats-json | --stats-summary] [--trace out.json] [--map] [--obb] [-O] [--max-errors N] [--diag-json] [--check] [-M | -MD] [--export-symbols | --import-symbols file.sym] file | - | --session file ...)", argv[0]);
 		return 0;
 	}
 	
+	/* the diagnostics of every file are printed in bulk at its end */
+	start_diags(diag_fmt, errors_limit);
+	
 	/* loop that runs over all the entered files */
 	for (i = 1; i < argc; i++){
 	
+		/* parsing threads option - applies to the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "-j") == 0 && i + 1 < argc){
+		
+			if ((threads = atoi(argv[++i])) < 1)
+				threads = 1;
+			continue;
+		}
+		
+		/* cache options - apply to the files that come after them */
+		if (strcmp(CURR_FILE_NAME, "--cache") == 0 && i + 1 < argc){
+			cache_dir = argv[++i];
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--cache-size") == 0 && i + 1 < argc){
+			cache_size = atol(argv[++i]);
+			continue;
+		}
+		
+		/* statistics options - apply to the files that come after them */
+		if (strcmp(CURR_FILE_NAME, "--stats") == 0 || strcmp(CURR_FILE_NAME, "--stats-json") == 0 ||
+			strcmp(CURR_FILE_NAME, "--stats-summary") == 0){
+			stats_fmt = strcmp(CURR_FILE_NAME, "--stats") == 0 ? stats_text :
+						strcmp(CURR_FILE_NAME, "--stats-json") == 0 ? stats_json : stats_summary;
+			continue;
+		}
+		
+		/* line map option - writes a .map file for the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "--map") == 0){
+			is_map = 1;
+			continue;
+		}
+		
+		/* binary object option - writes a .obb file for the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "--obb") == 0){
+			is_obb = 1;
+			continue;
+		}
+		
+		/* optimization option - optimizes the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "-O") == 0){
+			is_optimize = 1;
+			continue;
+		}
+		
+		/* diagnostics options - apply to the files that come after them */
+		if (strcmp(CURR_FILE_NAME, "--max-errors") == 0 && i + 1 < argc){
+			i++;
+			/* a value that is not a number in the range is rejected (the former limit stays) */
+			if (!isdigit((unsigned char)*CURR_FILE_NAME) || parse_num(CURR_FILE_NAME, strlen(CURR_FILE_NAME), 0, MAX_ERRORS_LIMIT, &errors_arg) != NUM_VALID)
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "invalid --max-errors value '%s' (expected a number between 0 and %d)", CURR_FILE_NAME, MAX_ERRORS_LIMIT);
+			else
+				errors_limit = errors_arg;
+			start_diags(diag_fmt, errors_limit);
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--diag-json") == 0){
+			diag_fmt = diag_json;
+			start_diags(diag_fmt, errors_limit);
+			continue;
+		}
+		
+		/* check option - only validates the files that come after it (see check.c) */
+		if (strcmp(CURR_FILE_NAME, "--check") == 0){
+			is_check = 1;
+			continue;
+		}
+		
+		/* dependencies options - print the make rule of the files that come after them instead of
+		   assembling them (-M), or write it to a .d file while assembling them (-MD) */
+		if (strcmp(CURR_FILE_NAME, "-M") == 0 || strcmp(CURR_FILE_NAME, "-MD") == 0){
+			is_deps_only = strcmp(CURR_FILE_NAME, "-M") == 0;
+			is_deps_file = !is_deps_only;
+			continue;
+		}
+		
+		/* symbols snapshot options - write the snapshot of the files that come after them instead of
+		   assembling them (--export-symbols), or assemble them over a snapshot (--import-symbols) */
+		if (strcmp(CURR_FILE_NAME, "--export-symbols") == 0){
+			is_symbols_export = 1;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--import-symbols") == 0 && i + 1 < argc){
+			import_symbols_snapshot(argv[++i]);
+			flush_diags();
+			continue;
+		}
+		
+		/* tracing option - traces the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "--trace") == 0 && i + 1 < argc){
+			start_trace(argv[++i]);
+			continue;
+		}
+		
+		/* stream mode - assembles the standard input into the standard output (see session.c) */
+		if (strcmp(CURR_FILE_NAME, "-") == 0){
+			set_warnings_stream(stderr); /* the standard output holds the outputs */
+			set_macro_dict_writes(0);
+			if (!assemble_stream(stdin, stdout, "stdin"))
+				is_failed = 1;
+			flush_diags();
+			set_warnings_stream(NULL);
+			set_macro_dict_writes(1);
+			continue;
+		}
+		
+		/* session mode - reassembles the standard input after every edit that it reads (see session.c) */
+		if (strcmp(CURR_FILE_NAME, "--session") == 0){
+			set_warnings_stream(stderr);
+			set_macro_dict_writes(0);
+			if (!serve_session(stdin, stdout, "stdin"))
+				is_failed = 1;
+			set_warnings_stream(NULL);
+			set_macro_dict_writes(1);
+			continue;
+		}
+		
+		/* dependencies only - scans the file without assembling it (see deps.c) */
+		if (is_deps_only){
+			print_dependencies(CURR_FILE_NAME, stdout);
+			flush_diags();
+			continue;
+		}
+		
+		/* symbols export - collects the external labels of the file without assembling it (see snapshot.c) */
+		if (is_symbols_export){
+			export_symbols_snapshot(CURR_FILE_NAME);
+			flush_diags();
+			continue;
+		}
+		
+		reset_stats();
+		file_start = trace_clock();
+		
+		/* check mode - validates the file without encoding it and without writing files */
+		if (is_check){
+		
+			if (!check_file(CURR_FILE_NAME, threads))
+				is_failed = 1;
+			
+			flush_diags();
+			if (stats_fmt != stats_none){
+				set_stats_result(0, 0);
+				print_stats(CURR_FILE_NAME, stats_fmt);
+			}
+			trace_span(CURR_FILE_NAME, "file", file_start, trace_clock(), TRACE_MAIN_TID);
+			continue;
+		}
+		
+		/* writes the .d file (the inputs do not depend on the assembly, so a cache hit writes it too) */
+		if (is_deps_file)
+			export_dependencies(CURR_FILE_NAME);
+		
+		/* if the outputs of the same source are in the cache - restores them and skips the assembly */
+		if (cache_dir != NULL){
+		
+			/* the target profile - everything else that changes the outputs */
+			sprintf(profile, "memory=%d,base=%d,map=%d,map_format=%d,obb=%d,obb_format=%d,optimize=%d",
+					MAX_MEMORY_ASSUMPTION, MEMORY_ASSUMPTION, is_map, MAP_VERSION, is_obb, OBB_VERSION, is_optimize);
+			
+			if (!get_cache_key(CURR_FILE_NAME, profile, cache_key))
+				cache_key[0] = '\0'; /* the source cannot be read - the pre assembler reports it */
+			else if (restore_from_cache(cache_dir, cache_key, CURR_FILE_NAME, &has_cached_ent, &has_cached_ext)){
+				cache_counters.hits++;
+				flush_diags();
+				if (stats_fmt != stats_none){
+					set_stats_result(1, AM_OUTPUT | OB_OUTPUT | (has_cached_ent ? ENT_OUTPUT : 0) |
+										(has_cached_ext ? EXT_OUTPUT : 0));
+					print_stats(CURR_FILE_NAME, stats_fmt);
+				}
+				trace_span(CURR_FILE_NAME, "file", file_start, trace_clock(), TRACE_MAIN_TID);
+				continue;
+			}
+			else
+				cache_counters.misses++;
+		}
+	
 		/* resets validation flags */
 		is_valid = 1;
 		err_ln_size = 0;
 		
 		/* pre assembler run */
-		if ((is_pre_valid = pre_assembler(CURR_FILE_NAME, &head_macro, &tail_macro))){ 
+		start_phase(phase_pre_assembler);
+		is_pre_valid = pre_assembler(CURR_FILE_NAME, &head_macro, &tail_macro, is_map ? &origins : NULL);
+		end_phase(phase_pre_assembler);
+		
+		if (is_pre_valid){ 
 			delete_macro_lines(&head_macro); /* now we need only the macro names */
 		}
-		else  /* if an error was found in the pre assembler */
+		else { /* if an error was found in the pre assembler */
+			free_map_origins(&origins);
+			flush_diags();
+			if (stats_fmt != stats_none)
+				print_stats(CURR_FILE_NAME, stats_fmt);
+			trace_span(CURR_FILE_NAME, "file", file_start, trace_clock(), TRACE_MAIN_TID);
 			continue;
+		}
 		
 		
 		/* resets code and data counters */
@@ -56,10 +269,31 @@ int main(int argc, char *argv[]){
 		dc = 0;
 		
 		/* first run */
+		start_phase(phase_first_run);
 		if ((is_first_valid = first_run(CURR_FILE_NAME, &label_root, &head_macro, &ic, &dc, &error_lines, 
-							 			&err_ln_size)) != 1)
+							 			&err_ln_size, threads)) != 1)
 			is_valid = 0;
 		
+		/* peephole optimization - rewrites the .am file and defines its labels again */
+		if (is_optimize && is_first_valid == 1 && (rewrites = peephole_optimize(CURR_FILE_NAME, is_map ? &origins : NULL)) > 0){
+		
+			image_words = ic + dc;
+			free_symbol_table(&label_root);
+			free(error_lines);
+			error_lines = NULL;
+			err_ln_size = 0;
+			ic = 0;
+			dc = 0;
+			
+			if ((is_first_valid = first_run(CURR_FILE_NAME, &label_root, &head_macro, &ic, &dc, &error_lines,
+											&err_ln_size, threads)) != 1)
+				is_valid = 0;
+			
+			printf("%s: -O saved %d memory words (%d rewrites), image %d -> %d words\n", CURR_FILE_NAME,
+				   image_words - (ic + dc), rewrites, image_words, ic + dc);
+		}
+		end_phase(phase_first_run);
+		
 		/* frees the macro list (we don't need it from now on) */
 		if (head_macro != NULL)	
 			free_macro_list(&head_macro);
@@ -70,9 +304,11 @@ int main(int argc, char *argv[]){
 		
 		/* second run */
 		if (is_first_valid != -1){ /* if is_first_valid does not indicate a memory error */ 
-			if (!(is_second_valid = second_run(&(code_im), &ic, &(data_im), &dc, label_root, 
-												CURR_FILE_NAME, error_lines, err_ln_size)))
+			start_phase(phase_second_run);
+			if (!(is_second_valid = second_run(&(code_im), &ic, &(data_im), &dc, label_root, &ext_refs,
+												is_map ? &line_map : NULL, CURR_FILE_NAME, error_lines, err_ln_size)))
 				is_valid = 0;
+			end_phase(phase_second_run);
 		}
 		
 		/* frees error_lines */
@@ -82,22 +318,88 @@ int main(int argc, char *argv[]){
 		/* creates and writes .ent, .ext, .ob files (if the program is valid so far) */
 		if (is_valid) {
 			
+			start_phase(phase_export);
+			
+			/* the labels are written in the order of the table without the snapshot (NULL if there is none) */
+			plain_root = build_plain_symbol_table(label_root, &ext_refs, &plain_refs);
+			
 			/* creates and writes .ent, .ext files */
-			export_entry_and_extern_labels(CURR_FILE_NAME, label_root);
+			export_entry_and_extern_labels(CURR_FILE_NAME, plain_root ? plain_root : label_root,
+										   plain_root ? &plain_refs : &ext_refs);
 			
 			/* creates and writes .ob file (while converting to BASE64) */
 			export_code_and_data_in_base64(CURR_FILE_NAME, &(code_im), ic, &(data_im), dc);
+			
+			/* creates and writes .map file */
+			if (is_map)
+				export_line_map(CURR_FILE_NAME, label_root, &line_map, &origins, ic);
+			
+			/* creates and writes .obb file */
+			if (is_obb){
+				code_and_data_to_words(&(code_im), ic, &(data_im), dc, obb_words);
+				export_obb(CURR_FILE_NAME, obb_words, ic, dc, plain_root ? plain_root : label_root,
+						   plain_root ? &plain_refs : &ext_refs);
+			}
+			
+			free_symbol_table(&plain_root);
+			free_extern_refs(&plain_refs);
+			
+			/* stores the outputs in the cache */
+			if (cache_dir != NULL && cache_key[0] != '\0')
+				store_in_cache(cache_dir, cache_key, CURR_FILE_NAME, is_there_entry(label_root), ext_refs.count > 0, is_map, is_obb);
+			
+			end_phase(phase_export);
+		}
+		
+		/* prints the errors and the warnings of the file */
+		flush_diags();
 		
+		/* reports the statistics of the file */
+		if (stats_fmt != stats_none){
+			
+			symbols_cnt = symbols_max_depth = 0;
+			symbols_depth_sum = 0;
+			get_symbol_table_shape(label_root, 1, &symbols_cnt, &symbols_max_depth, &symbols_depth_sum);
+			add_stat_counter(stat_symbols, symbols_cnt);
+			add_stat_counter(stat_symbol_max_depth, symbols_max_depth);
+			add_stat_counter(stat_symbol_depth_sum, symbols_depth_sum);
+			
+			set_stats_result(0, AM_OUTPUT | (is_valid ? OB_OUTPUT : 0) |
+							 (is_valid && is_there_entry(label_root) ? ENT_OUTPUT : 0) |
+							 (is_valid && ext_refs.count > 0 ? EXT_OUTPUT : 0));
+			print_stats(CURR_FILE_NAME, stats_fmt);
 		}
 
 		/* frees labels table */
 		if (label_root != NULL)
 			free_symbol_table(&label_root);
+		
+		/* frees external references log and line map */
+		free_extern_refs(&ext_refs);
+		free_line_map(&line_map);
+		free_map_origins(&origins);
+		
+		trace_span(CURR_FILE_NAME, "file", file_start, trace_clock(), TRACE_MAIN_TID);
 			
 	}
 	
+	/* limits the cache size and reports the cache counters */
+	if (cache_dir != NULL){
+	
+		evict_cache(cache_dir, cache_size, &cache_counters);
+		printf("cache: %d hits, %d misses, %d evictions\n", cache_counters.hits, cache_counters.misses,
+				cache_counters.evictions);
+	}
+
+	/* reports the summary of all the files */
+	if (stats_fmt != stats_none)
+		print_stats_summary(stats_fmt);
+	
+	close_macro_dicts(); /* the dictionaries of the included files are shared by all the files */
+	close_symbols_snapshot();
+	end_trace();
 
-	return 0;
+	return is_failed;
 
 
 
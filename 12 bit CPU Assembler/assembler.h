@@ -9,16 +9,30 @@
  */
 
 #include "macro_list.h"
+#include "macro_dict.h"
 #include "labels_BST.h"
+#include "obb.h"
 #include "ast.h"
 #include "encoder.h"
+#include "snapshot.h"
+#include "cache.h"
+#include "deps.h"
+#include "stats.h"
+#include "trace.h"
+#include "diag.h"
 #define CURR_FILE_NAME argv[i] /* current file name that was entered in command line */
 
 
 /* assembler main used functions prototype */
-int pre_assembler(char [], macro_node **, macro_node **);
-int first_run(char *, symbol_table_node **, macro_node **, int *, int *, int **, int *);
+int pre_assembler(char [], macro_node **, macro_node **, map_origin_vector *);
+int first_run(char *, symbol_table_node **, macro_node **, int *, int *, int **, int *, int);
+int peephole_optimize(char *, map_origin_vector *);
 int second_run(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[MAX_MEMORY_ASSUMPTION],
-				 int *, symbol_table_node *, char *, int *, int);
+				 int *, symbol_table_node *, extern_ref_vector *, line_map_vector *, char *, int *, int);
 void export_code_and_data_in_base64(char *, mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int ic,
 									 mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int dc);
+void code_and_data_to_words(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int ic,
+							mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int dc, unsigned short *);
+int assemble_stream(FILE *, FILE *, char *);
+int serve_session(FILE *, FILE *, char *);
+int check_file(char *, int);
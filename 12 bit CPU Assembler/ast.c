@@ -23,7 +23,7 @@
 #include "ast.h"
 
 /* macro definitions */
-#define DIRS_NUM 4 /* number of available directives */
+#define DIRS_NUM 5 /* number of available directives */
 #define INSS_NUM 16 /* number of available instructions */
 #define INS_LEN 3 /* length of usual instruction */
 #define STOP_LEN 4 /* length of 'stop' instruction */
@@ -43,6 +43,7 @@ void is_dir(char *, ast *);
 int check_comma(char *, ast *, char *);
 int check_end(char *, ast *, char *, int);
 int check_data(char [][MAX_LINE], int, ast *);
+int parse_data_nums(char *, ast *);
 int is_valid_label(char *, ast *, char []);
 void is_ins(char *, ast *);
 int check_ins_ops_syn(char [][MAX_LINE], int , ast *, const char *);
@@ -133,7 +134,7 @@ ast get_ast(char *line){
 char *is_there_label(char *line, ast *new_ast){
 	
 	int is_valid, length;
-	char *line_ptr, *label;
+	char *line_ptr, label[MAX_LINE]; /* the line length is already checked, so the label fits in MAX_LINE */
 	
 	
 	if ((line_ptr = strchr(line, ':')) != NULL){ /* there is a label definition */
@@ -149,13 +150,6 @@ char *is_there_label(char *line, ast *new_ast){
 			
 		}
 		
-		label = (char *)malloc((sizeof(char) * length) + 1); /* maximum potentially length and +1 for null */
-		
-		if (!label){
-			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - label definition");
-			exit(1);
-		}
-		
 		memcpy(label, line, length); /* inserts in label the label name */
 		label[length] = '\0';
 		
@@ -179,7 +173,6 @@ char *is_there_label(char *line, ast *new_ast){
 		}
 		/* if everything is ok and the label definition is valid returns line_ptr + 1
 	 	   else - if found an error returns NULL */
-		free(label);
 		return is_valid ? line_ptr + 1 : NULL;
 	}
 	
@@ -198,9 +191,9 @@ char *is_there_label(char *line, ast *new_ast){
 void is_dir(char *line, ast *new_ast){
 
 	int idx = 0, chr_cnt, length, partitions_cnt, i;
-	char *line_ptr, partitions[MAX_LINE][MAX_LINE];
-	const char *DIRS[] = {"string", "data", "entry", "extern"};
-	const int DIRS_LEN[] = {6, 4, 5, 6}; /* directives lengths in order (DIRS array order) */
+	char *line_ptr, *quote_ptr, partitions[MAX_LINE][MAX_LINE];
+	const char *DIRS[] = {"string", "data", "entry", "extern", "incbin"};
+	const int DIRS_LEN[] = {6, 4, 5, 6, 6}; /* directives lengths in order (DIRS array order) */
 	
 	
 	JUMP_TO_NEXT_NON_WHITE(line, idx)
@@ -287,14 +280,9 @@ void is_dir(char *line, ast *new_ast){
 			 
 			 	}
 			 	
-			 	strcpy(partitions[0], line_ptr);
-				if(!check_data(partitions, 1, new_ast)) /* checks if the parameter is invalid */
+			 	/* checks the parameter and inserts the number in the ast */
+				if (!parse_data_nums(line_ptr, new_ast))
 					return;
-			 		
-			 	/* if the parameter is valid */
-					
-			 	new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[0] = atoi(partitions[0]);
-			 	new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count = 1;
 			 	
 			 }
 			 
@@ -303,18 +291,9 @@ void is_dir(char *line, ast *new_ast){
 				if (!check_comma(line_ptr, new_ast, "data definition"))
 			 		return;
 			 	
-			 	/* inserts to partitions array the parameters */
-			 	divide(line_ptr, &partitions, &partitions_cnt);
-			 
-			 	if(!check_data(partitions, partitions_cnt, new_ast)) /* checks if there is an invalid parameter */
+			 	/* checks the parameters and inserts the numbers in the ast (in place, without partitions) */
+			 	if (!parse_data_nums(line_ptr, new_ast))
 					return;
-			 
-			 	/* if the parameters are valid */
-			 	for (i = 0; i < partitions_cnt; i++) /* inserts the numbers in the ast */
-			 		new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i] = atoi(partitions[i]);
-			 
-			 	/* updates the count of numbers of data in the ast */
-			 	new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count = partitions_cnt;
 			 }
 			 
 			 	
@@ -408,6 +387,90 @@ void is_dir(char *line, ast *new_ast){
 		
 		} /* end of extern case */
 		
+		else if ((IS_DIRECTIVE(4))){ /* if it is incbin directive */
+			/* the parameters are a file name in quotation marks and an optional offset and length */
+			
+			/* updates the ast directive option to incbin */
+			new_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option = ast_union_dir_incbin;
+			new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.offset = 0;
+			new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.length = INCBIN_ALL;
+			
+			skip_to_params(&line_ptr, DIRS_LEN[4]);
+			
+			if (*line_ptr != '"' || (quote_ptr = strchr(line_ptr + 1, '"')) == NULL){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				if (is_white(line_ptr))
+					strcpy(new_ast -> ast_error, "missing parameter - incbin directive");
+				else
+					strcpy(new_ast -> ast_error, "the file name must be in quotation marks - incbin directive");
+				return;
+			}
+			
+			if ((length = quote_ptr - line_ptr - 1) == 0){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				strcpy(new_ast -> ast_error, "empty file name - incbin directive");
+				return;
+			}
+			
+			/* inserts the file name in the ast (it is shorter than a line) */
+			memcpy(new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.file, line_ptr + 1, length);
+			new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.file[length] = '\0';
+			
+			line_ptr = quote_ptr + 1;
+			if (is_white(line_ptr)) /* no offset and length */
+				return;
+			
+			idx = 0;
+			JUMP_TO_NEXT_NON_WHITE(line_ptr, idx)
+			line_ptr += idx;
+			
+			if (*line_ptr != ','){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				strcpy(new_ast -> ast_error, "extraneous text after file name - incbin directive");
+				return;
+			}
+			
+			line_ptr++; /* skips the comma after the file name */
+			
+			if (is_white(line_ptr)){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				strcpy(new_ast -> ast_error, "missing parameter - incbin directive");
+				return;
+			}
+			
+			if (count_char(line_ptr, ',') > 1){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				strcpy(new_ast -> ast_error, "too many parameters - incbin directive");
+				return;
+			}
+			
+			if (count_char(line_ptr, ',') == 1 && !check_comma(line_ptr, new_ast, "incbin directive"))
+				return;
+			
+			divide(line_ptr, &partitions, &partitions_cnt);
+			
+			if (!check_data(partitions, partitions_cnt, new_ast))
+				return;
+			
+			new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.offset = atoi(partitions[0]);
+			if (partitions_cnt == 2)
+				new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.length = atoi(partitions[1]);
+			
+			if (new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.offset < 0 ||
+				(partitions_cnt == 2 && new_ast -> ast_union_ins_dir.ast_dir.dir.incbin.length < 0)){
+			
+				new_ast -> ast_union_option = ast_union_error;
+				strcpy(new_ast -> ast_error, "the offset and the length must not be negative - incbin directive");
+				return;
+			}
+		
+		} /* end of incbin case */
+		
 		else { /* if it is an undefined directive */
 		
 			idx = 0;
@@ -760,6 +823,77 @@ int check_data(char partitions[][MAX_LINE], int cnt, ast *new_ast){
 
 
 
+/*
+ *	Parses the parameters of a data directive in place. Every parameter is a view between the commas
+ *	(empty ones are skipped like in divide), its white borders are skipped and one pass of parse_num
+ *	checks and converts it, so the parameters are not copied. The range of the data words is checked
+ *	on the way, and the encoder reports the first number out of the range by its text.
+ *
+ *	param line_ptr - The parameters of the directive (the commas are already checked)
+ *	param new_ast - Pointer to the current state of the AST
+ *	returns 1 if the parameters are valid, 0 otherwise
+ */
+int parse_data_nums(char *line_ptr, ast *new_ast){
+
+	char *start, *end, *ptr;
+	int cnt = 0, len;
+	
+	new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error = NO_RANGE_ERROR;
+	
+	for (start = line_ptr; ; start = end + 1){
+		
+		for (end = start; *end != ',' && *end != '\0'; end++)
+			;
+		
+		if (end > start){ /* if the partition is not empty */
+		
+			/* removes white characters from borders */
+			for (; start < end && isspace(*start); start++)
+				;
+			for (len = end - start; len > 0 && isspace(start[len - 1]); len--)
+				;
+			
+			for (ptr = start; ptr < start + len && !isspace(*ptr); ptr++)
+				;
+			
+			if (ptr < start + len){
+				new_ast -> ast_union_option = ast_union_error;
+				sprintf(new_ast -> ast_error, "invalid data parameter - the parameter '%.*s' is seperated by white characters", len, start);
+				return 0;
+			}
+			
+			switch (parse_num(start, len, MIN_DATA_NUM, MAX_DATA_NUM,
+							  &(new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[cnt]))){
+			
+				case NUM_INVALID:
+					new_ast -> ast_union_option = ast_union_error;
+					sprintf(new_ast -> ast_error, "invalid data parameter - '%.*s' is not an integer", len, start);
+					return 0;
+				
+				case NUM_OUT_OF_RANGE:
+					if (new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error == NO_RANGE_ERROR){
+						new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error = cnt;
+						sprintf(new_ast -> range_num, "%.*s", len, start);
+					}
+				break;
+			}
+			
+			cnt++;
+		}
+		
+		if (*end == '\0')
+			break;
+	}
+	
+	/* updates the count of numbers of data in the ast */
+	new_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count = cnt;
+	
+	return 1;
+
+}
+
+
+
 /*
  *	Checks the validity of a label according to specified criteria.
  *
@@ -818,7 +952,7 @@ int is_valid_label(char *label, ast *new_ast, char error_cont[]){
  */
 int check_ins_ops_syn(char partitions[][MAX_LINE], int cnt, ast *new_ast, const char *curr_ins){
 
-	int i, j;
+	int i, j, imm, num_res;
 	char error_cont[MAX_LINE];
 	const char *REGS[] = {"r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7"};
 	
@@ -868,15 +1002,19 @@ int check_ins_ops_syn(char partitions[][MAX_LINE], int cnt, ast *new_ast, const
 		/* immediate value case (number) */
 		else if (is_num_and_punc(partitions[i])){
 			
-			if (is_num(partitions[i])){ /* it is a valid immediate value */
+			/* it is a valid immediate value (a value out of the range is reported by the encoder) */
+			if ((num_res = parse_num(partitions[i], strlen(partitions[i]), MIN_IMM_NUM, MAX_IMM_NUM, &imm)) != NUM_INVALID){
+				
+				if (num_res == NUM_OUT_OF_RANGE && new_ast -> range_num[0] == '\0')
+					strcpy(new_ast -> range_num, partitions[i]);
 			
 				if (cnt == 2){
 					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i] = ast_op_type_imm;
-					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i].imm = atoi(partitions[i]);
+					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i].imm = imm;
 				}
 				else{
 					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote = ast_op_type_imm;
-					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.imm = atoi(partitions[i]);
+					new_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.imm = imm;
 				}
 			}
 			else { /* it is not an integer number */
@@ -971,6 +1109,8 @@ void skip_to_params(char **line_ptr_add, int comm_len){
 
 /*
  *	Divides a line into partitions using a delimiter and stores them in an array.
+ *	Empty partitions are skipped (like strtok), but no static state is used, so lines can be
+ *	parsed by several threads at once.
  *
  *	param line_ptr - Pointer to the line to be divided
  *	param partitions_add - Pointer to the array to store partitions
@@ -978,13 +1118,18 @@ void skip_to_params(char **line_ptr_add, int comm_len){
  */
 void divide(char *line_ptr, char (*partitions_add)[][MAX_LINE], int *cnt_add){
 
-	char *token = strtok(line_ptr, ",");
+	char *token = line_ptr, *comma;
 	*cnt_add = 0;
 	do {
-		strcpy((*partitions_add)[*cnt_add], token);
-		token = strtok(NULL, ",");
-		(*cnt_add)++;
-	}while (token != NULL);
+		if ((comma = strchr(token, ',')) != NULL)
+			*comma = '\0'; /* ends the current partition */
+		
+		if (*token != '\0')
+			strcpy((*partitions_add)[(*cnt_add)++], token);
+			
+		if (comma != NULL)
+			token = comma + 1;
+	}while (comma != NULL);
 	
 }
 
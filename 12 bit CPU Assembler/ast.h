@@ -12,6 +12,12 @@
 #define MAX_ERROR_LEN 201
 #define MAX_STRING_LEN 81
 #define MAX_NUMBER_SIZE 81
+#define INCBIN_ALL -1 /* the length of an .incbin directive without a length (all the words after the offset) */
+#define MAX_IMM_NUM 511 /* maximum immediate value allowed (signed 10 bits) */
+#define MIN_IMM_NUM -512 /* minimum immediate value allowed */
+#define MAX_DATA_NUM 2047 /* maximum data value allowed (signed 12 bits) */
+#define MIN_DATA_NUM -2048 /* minimum data value allowed */
+#define NO_RANGE_ERROR -1 /* all the numbers of a data directive are in the data range */
 
 enum instructions { /* op code of each instruction is (<enum> - 1) */
 
@@ -54,6 +60,7 @@ typedef struct {
     char label[MAX_LABEL_SIZE]; /* the label of the label definition */
     int label_def_flag; /* flag to ensure there is a label definition in current ast */
     char ast_error[MAX_ERROR_LEN];
+    char range_num[MAX_LINE]; /* the text of the first number that is out of its range (empty if there is none) */
     enum {
         ast_union_error = 1,
         ast_union_ins, /* instruction */
@@ -68,19 +75,26 @@ typedef struct {
                 ast_union_dir_string = 1,
                 ast_union_dir_data,
                 ast_union_dir_entry,
-                ast_union_dir_extern
+                ast_union_dir_extern,
+                ast_union_dir_incbin
             }ast_union_dir_option;
             union {
                 char string[MAX_STRING_LEN]; /* if current directive is string */
                 struct { /* if current directive is data */
                      int num_array[MAX_NUMBER_SIZE];
                      int num_count;
+                     int range_error; /* the first number out of the data range (checked while parsing) */
                 }data_num_array;
                 char label[MAX_LABEL_SIZE]; /* if current directive is entry */
                 struct { /* if current directive is extern */
                 	char labels[MAX_NUMBER_SIZE][MAX_LABEL_SIZE]; 
                 	int labels_count;
                 }extern_labels_array;
+                struct { /* if current directive is incbin */
+                	char file[MAX_STRING_LEN]; /* the name of the binary file as written in the line */
+                	int offset; /* the first word of the file */
+                	int length; /* number of words (INCBIN_ALL for all the words after the offset) */
+                }incbin;
             }dir;
         }ast_dir;
         
@@ -1,7 +1,9 @@
 /*
  *	File: base64.c
  *
- *	Functions for encoding code and data into base64 representation.
+ *	Functions for encoding code and data into base64 representation (and into the words of a .obb file),
+ *	and for decoding the base64 words of a .ob file (the linker, the converter, the disassembler and the
+ *	emulator read them).
  *
  *	author: Gal Levi
  *	version: 5.8.23
@@ -15,10 +17,18 @@
 #define BASE_LINE_LEN 3 /* length of the base64 encoded line (2 characters + null terminator) */
 #define LAST_SIX_BITS_MASK 0x03F /* bitmask to extract the last 6 bits of a number */
 #define FIRST_SIX_BITS_MASK 0xFC0 /* bitmask to extract the first 6 bits of a number */
+#define WORD_MASK 0xFFF /* bitmask to extract the 12 bits of a memory word */
+#define BASE64_WORD_LEN 2 /* base64 characters of a memory word */
+
+/* functions prototype */
+void print_code_and_data_to_stream(FILE *, mem_code_word *, int, mem_data_word *, int);
+int decode_base64_word(char *);
 
 /* exclusive functions prototype */
 void code_word_to_base64(mem_code_word, char *);
+unsigned int code_word_to_num(mem_code_word);
 void num_to_base64(unsigned int, char *);
+int decode_base64_char(char);
 
 
 
@@ -34,11 +44,9 @@ void num_to_base64(unsigned int, char *);
 void export_code_and_data_in_base64(char *file_name, mem_code_word (*code_im)[MAX_BUFFER], int ic,
 									 mem_data_word (*data_im)[MAX_BUFFER], int dc){
 	FILE *ob_des;
-	char curr_base_line[BASE_LINE_LEN], ob_name[MAX_BUFFER];
-	int i;
+	char ob_name[MAX_BUFFER];
 	
 	sprintf(ob_name, "%s.ob",file_name);
-	curr_base_line[BASE_LINE_LEN - 1] = '\0'; /* inserts null terminator to string */
 	
 	if (!(ob_des = fopen(ob_name, "w"))){
 	
@@ -47,28 +55,72 @@ void export_code_and_data_in_base64(char *file_name, mem_code_word (*code_im)[MA
 		
 	}
 	
-	fprintf(ob_des , "%d %d\n", ic, dc); /* headline */
+	print_code_and_data_to_stream(ob_des, *code_im, ic, *data_im, dc);
+
+	fclose(ob_des);
+
+}
+
+
+
+/*
+ *	Prints the encoded code and data in base64 (the content of a .ob file) to a file stream.
+ *
+ *	param des - Pointer to the file stream to write to.
+ *	param code_im - The code image.
+ *	param ic - The instruction counter indicating the number of instructions.
+ *	param data_im - The data image.
+ *	param dc - The data counter indicating the number of data entries.
+ */
+void print_code_and_data_to_stream(FILE *des, mem_code_word *code_im, int ic, mem_data_word *data_im, int dc){
+
+	char curr_base_line[BASE_LINE_LEN];
+	int i;
+	
+	curr_base_line[BASE_LINE_LEN - 1] = '\0'; /* inserts null terminator to string */
+	
+	fprintf(des, "%d %d\n", ic, dc); /* headline */
 	
-	/* prints code to .ob file */
+	/* prints code */
 	for (i = 0; i < ic; i++){
-		code_word_to_base64((*code_im)[i], curr_base_line);
-        fprintf(ob_des, "%s\n", curr_base_line);
+		code_word_to_base64(code_im[i], curr_base_line);
+        fprintf(des, "%s\n", curr_base_line);
 	}
 	
-	/* prints data to .ob file */
+	/* prints data */
 	for (i = 0; i < dc; i++){
-		num_to_base64((*data_im)[i].curr_data, curr_base_line);
-        fprintf(ob_des ,"%s\n", curr_base_line);
+		num_to_base64(data_im[i].curr_data, curr_base_line);
+        fprintf(des ,"%s\n", curr_base_line);
 	}
 
-	fclose(ob_des);
-
 }
 
 
 
 
 
+/*
+ *	Converts the code and data images into the words of a .obb file (the code words and then the data words).
+ *
+ *	param code_im - Pointer to the code image memory buffer.
+ *	param ic - The instruction counter indicating the number of instructions.
+ *	param data_im - Pointer to the data image memory buffer.
+ *	param dc - The data counter indicating the number of data entries.
+ *	param words - The array to fill (ic + dc cells).
+ */
+void code_and_data_to_words(mem_code_word (*code_im)[MAX_BUFFER], int ic, mem_data_word (*data_im)[MAX_BUFFER], int dc,
+							unsigned short *words){
+	int i;
+	
+	for (i = 0; i < ic; i++)
+		words[i] = code_word_to_num((*code_im)[i]);
+	
+	for (i = 0; i < dc; i++)
+		words[ic + i] = (*data_im)[i].curr_data & WORD_MASK;
+
+}
+
+
 /*
  *	Converts a mem_code_word into a base64 encoded string.
  *
@@ -77,19 +129,32 @@ void export_code_and_data_in_base64(char *file_name, mem_code_word (*code_im)[MA
  */
 void code_word_to_base64(mem_code_word code_word, char *curr_base_line){
 	
+	num_to_base64(code_word_to_num(code_word), curr_base_line);
+
+}
+
+
+/*
+ *	Converts a mem_code_word into a number.
+ *
+ *	param code_word - The memory code word.
+ *	returns the 12 bits of the word.
+ */
+unsigned int code_word_to_num(mem_code_word code_word){
+	
 	/* *((unsigned int *)&(<memory word>)) = memory word as a number */
 	switch (code_word.word_type){
 		
 		/* if it is first word */
-		case first_word: num_to_base64(*((unsigned int *)&(code_word.union_word.first_word)), curr_base_line); 
-		break;
+		case first_word: return *((unsigned int *)&(code_word.union_word.first_word)) & WORD_MASK;
 		
 		/* if it is label or number */
-		case imm_dir_word: num_to_base64(*((unsigned int *)&(code_word.union_word.imm_direct_add_word)), curr_base_line);
-		break;
+		case imm_dir_word: return *((unsigned int *)&(code_word.union_word.imm_direct_add_word)) & WORD_MASK;
 		
-		case reg_word: num_to_base64(*((unsigned int *)&(code_word.union_word.reg_add_word)), curr_base_line);
+		case reg_word: return *((unsigned int *)&(code_word.union_word.reg_add_word)) & WORD_MASK;
 	}
+	
+	return 0;
 
 }
 
@@ -112,7 +177,47 @@ void num_to_base64(unsigned int num, char *curr_base_line) {
 }
 
 
+/*
+ *	Decodes a line of a .ob file that holds a memory word (two base64 characters and a white space).
+ *
+ *	param line - The line.
+ *	returns the 12 bits of the word, or -1 if the line is not a base64 word.
+ */
+int decode_base64_word(char *line){
+
+	int high, low;
+
+	if ((high = decode_base64_char(line[0])) < 0 || (low = decode_base64_char(line[1])) < 0 ||
+		!isspace((unsigned char)line[BASE64_WORD_LEN]))
+		return -1;
+
+	return (high << 6) | low;
+
+}
+
+
+/*
+ *	Decodes a base64 character (the index of the character in the BASE64 table of num_to_base64).
+ *	The value is computed from the ranges of the table, so no table is built and the threads of the
+ *	linker may decode at the same time.
+ *
+ *	param c - The character.
+ *	returns the 6 bit value of the character, or -1 if it is not a base64 character.
+ */
+int decode_base64_char(char c){
 
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
 
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 26;
 
+	if (c >= '0' && c <= '9')
+		return c - '0' + 52;
 
+	if (c == '+')
+		return 62;
+
+	return c == '/' ? 63 : -1;
+
+}
@@ -0,0 +1,404 @@
+/*
+ *	File: cache.c
+ *
+ *	This file implements a content addressed cache of assembly results.
+ *	The key of a source file is a 64 bit hash (two 32 bit FNV-1a hashes with different offsets) of the
+ *	.as file content, the content of its included and incbin files, the assembler version and the target
+ *	profile. A valid assembly stores its output
+ *	files in the cache directory as <key>.am, <key>.ent, <key>.ext, <key>.map and <key>.ob (written last, so an
+ *	entry exists only if its .ob file exists), and its warnings as <key>.diag. On a hit the files are copied
+ *	back, the warnings are reported again and the assembler phases are skipped. The cache size is limited by
+ *	evicting the least recently used entries.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for the directory functions in ansi mode */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include "cache.h"
+#include "deps.h"
+#include "diag.h"
+
+/* macro definitions */
+#define FNV_OFFSET_2 3735928559UL /* offset basis of the second hash (the first one is FNV_OFFSET) */
+#define COPY_BUFFER_SIZE 8192 /* size of the buffer used to copy files */
+#define OUTPUTS_NUM 7 /* number of output files of an assembly (with the warnings) */
+#define ENT_IDX 1 /* index of the .ent extension in OUTPUTS_EXT */
+#define EXT_IDX 2 /* index of the .ext extension in OUTPUTS_EXT */
+#define MAP_IDX 3 /* index of the .map extension in OUTPUTS_EXT */
+#define OBB_IDX 4 /* index of the .obb extension in OUTPUTS_EXT */
+#define DIAG_IDX 5 /* index of the warnings extension in OUTPUTS_EXT */
+#define KB 1024L /* bytes in KB */
+#define CACHE_DIR_MODE 0777 /* permissions of a created cache directory (before the umask) */
+
+/* the output files extensions (.ob is the last one, it marks a complete entry) */
+const char *OUTPUTS_EXT[] = {".am", ".ent", ".ext", ".map", ".obb", ".diag", ".ob"};
+
+typedef struct { /* cache entry (used for eviction) */
+	char key[CACHE_KEY_LEN];
+	long size; /* total size of the entry files in bytes */
+	time_t last_use; /* modification time of the .ob file */
+} cache_entry;
+
+/* exclusive functions prototype */
+void hash_bytes(const char *, long, unsigned long *, unsigned long *);
+int hash_file(char *, unsigned long *, unsigned long *);
+int copy_file(char *, char *);
+long file_size(char *);
+int compare_entries_by_use(const void *, const void *);
+
+
+
+/*
+ *	Computes the cache key of a source file.
+ *
+ *	param file_name - The name of the source file without extension.
+ *	param profile - The target profile (anything else that changes the outputs).
+ *	param key - Buffer of CACHE_KEY_LEN characters to store the key.
+ *	returns 1 if the key was computed, 0 if the source file cannot be read.
+ */
+int get_cache_key(char *file_name, const char *profile, char *key){
+
+	char src_name[MAX_BUFFER];
+	unsigned long h1 = FNV_OFFSET, h2 = FNV_OFFSET_2;
+	deps_list deps = {NULL, 0, 0};
+	int i;
+
+	sprintf(src_name, "%s.as", file_name);
+
+	if (!hash_file(src_name, &h1, &h2))
+		return 0;
+
+	/* the macros of the included files and the words of the incbin files change the outputs (the same
+	   inputs as the make rule of -M, a missing file fails the assembly anyway) */
+	if (collect_dependencies(src_name, &deps)){
+
+		for (i = 0; i < deps.count; i++){
+			hash_bytes(deps.paths[i], strlen(deps.paths[i]) + 1, &h1, &h2);
+			hash_file(deps.paths[i], &h1, &h2);
+		}
+
+		free_dependencies(&deps);
+	}
+
+	/* the version and the profile are part of the key */
+	hash_bytes(ASSEMBLER_VERSION, strlen(ASSEMBLER_VERSION) + 1, &h1, &h2);
+	hash_bytes(profile, strlen(profile) + 1, &h1, &h2);
+
+	sprintf(key, "%08lx%08lx", h1, h2);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Adds the content of a file to the hashes.
+ *
+ *	param name - The name of the file.
+ *	param h1 - Pointer to the first hash.
+ *	param h2 - Pointer to the second hash.
+ *	returns 1 if the file was read, 0 otherwise.
+ */
+int hash_file(char *name, unsigned long *h1, unsigned long *h2){
+
+	FILE *src;
+	char buffer[COPY_BUFFER_SIZE];
+	long cnt;
+
+	if (!(src = fopen(name, "rb")))
+		return 0;
+
+	while ((cnt = fread(buffer, sizeof(char), COPY_BUFFER_SIZE, src)) > 0)
+		hash_bytes(buffer, cnt, h1, h2);
+
+	fclose(src);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Restores the outputs of a source file from the cache and reports its warnings again.
+ *	The .ob file is touched, so the entry becomes the most recently used one.
+ *
+ *	param cache_dir - The cache directory.
+ *	param key - The cache key of the source file.
+ *	param file_name - The name of the source file without extension.
+ *	param has_ent_add - Pointer to store 1 if a .ent file was restored, 0 otherwise.
+ *	param has_ext_add - Pointer to store 1 if a .ext file was restored, 0 otherwise.
+ *	returns 1 on a hit (the outputs were restored), 0 on a miss.
+ */
+int restore_from_cache(char *cache_dir, char *key, char *file_name, int *has_ent_add, int *has_ext_add){
+
+	char cached_name[MAX_BUFFER], des_name[MAX_BUFFER];
+	int i;
+
+	sprintf(cached_name, "%s/%s.ob", cache_dir, key);
+
+	if (file_size(cached_name) < 0) /* if there is no entry */
+		return 0;
+
+	*has_ent_add = *has_ext_add = 0;
+
+	for (i = 0; i < OUTPUTS_NUM; i++){
+
+		sprintf(cached_name, "%s/%s%s", cache_dir, key, OUTPUTS_EXT[i]);
+		sprintf(des_name, "%s%s", file_name, OUTPUTS_EXT[i]);
+
+		/* the .ent/.ext files exist only if the source has entry/used external labels (.map and .obb only with
+		   --map and --obb), and the warnings are reported only after all the files are restored */
+		if (i == DIAG_IDX || file_size(cached_name) < 0)
+			continue;
+
+		if (!copy_file(cached_name, des_name)){
+
+			errprintf(des_name, NO_LINE_ERROR, "cannot restore file from cache");
+			return 0;
+		}
+
+		if (i == ENT_IDX)
+			*has_ent_add = 1;
+		else if (i == EXT_IDX)
+			*has_ext_add = 1;
+	}
+
+	sprintf(cached_name, "%s/%s%s", cache_dir, key, OUTPUTS_EXT[DIAG_IDX]);
+	replay_diags(cached_name, file_name);
+
+	sprintf(cached_name, "%s/%s.ob", cache_dir, key);
+	utime(cached_name, NULL); /* updates the last use time */
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Stores the outputs of a valid assembly in the cache (a missing cache directory is created), and the
+ *	diagnostics that are buffered for the file (its warnings).
+ *
+ *	param cache_dir - The cache directory.
+ *	param key - The cache key of the source file.
+ *	param file_name - The name of the source file without extension.
+ *	param has_ent - 1 if the assembly wrote a .ent file, 0 otherwise.
+ *	param has_ext - 1 if the assembly wrote a .ext file, 0 otherwise.
+ *	param has_map - 1 if the assembly wrote a .map file, 0 otherwise.
+ *	param has_obb - 1 if the assembly wrote a .obb file, 0 otherwise.
+ */
+void store_in_cache(char *cache_dir, char *key, char *file_name, int has_ent, int has_ext, int has_map, int has_obb){
+
+	char cached_name[MAX_BUFFER], src_name[MAX_BUFFER];
+	int i;
+
+	mkdir(cache_dir, CACHE_DIR_MODE); /* fails if the directory exists, otherwise the copy reports the error */
+
+	for (i = 0; i < OUTPUTS_NUM; i++){
+
+		/* skips .ent/.ext/.map/.obb files that were not written by this assembly (they may be old files) */
+		if ((i == ENT_IDX && !has_ent) || (i == EXT_IDX && !has_ext) || (i == MAP_IDX && !has_map) ||
+			(i == OBB_IDX && !has_obb))
+			continue;
+
+		sprintf(src_name, "%s%s", file_name, OUTPUTS_EXT[i]);
+		sprintf(cached_name, "%s/%s%s", cache_dir, key, OUTPUTS_EXT[i]);
+
+		/* the warnings are written from the buffer of the diagnostics (an old file of the key is removed) */
+		if (i == DIAG_IDX){
+			remove(cached_name);
+			export_diags(cached_name, file_name);
+			continue;
+		}
+
+		if (!copy_file(src_name, cached_name)){
+
+			errprintf(cached_name, NO_LINE_ERROR, "cannot write file to cache");
+			return;
+		}
+	}
+
+}
+
+
+
+/*
+ *	Evicts the least recently used entries until the cache size is within the limit.
+ *
+ *	param cache_dir - The cache directory.
+ *	param max_size - The maximum cache size in KB.
+ *	param stats - Pointer to the cache counters (the evictions are counted).
+ */
+void evict_cache(char *cache_dir, long max_size, cache_stats *stats){
+
+	DIR *dir;
+	struct dirent *curr;
+	struct stat info;
+	cache_entry *entries = NULL, *temp;
+	char path[MAX_BUFFER];
+	int entries_cnt = 0, entries_size = 0, i, j;
+	long total_size = 0, len;
+
+	if (!(dir = opendir(cache_dir)))
+		return;
+
+	/* collects the complete entries (by their .ob files) */
+	while ((curr = readdir(dir)) != NULL){
+
+		len = strlen(curr -> d_name);
+		if (len != CACHE_KEY_LEN - 1 + 3 || strcmp(curr -> d_name + CACHE_KEY_LEN - 1, ".ob") != 0)
+			continue;
+
+		sprintf(path, "%s/%s", cache_dir, curr -> d_name);
+		if (stat(path, &info) != 0)
+			continue;
+
+		if (entries_cnt == entries_size){ /* enlarges the entries array */
+
+			entries_size = entries_size ? entries_size * 2 : 64;
+			if (!(temp = (cache_entry *)counted_realloc(entries, sizeof(cache_entry) * entries_size))){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - cache");
+				exit(1);
+			}
+			entries = temp;
+		}
+
+		memcpy(entries[entries_cnt].key, curr -> d_name, CACHE_KEY_LEN - 1);
+		entries[entries_cnt].key[CACHE_KEY_LEN - 1] = '\0';
+		entries[entries_cnt].last_use = info.st_mtime;
+		entries[entries_cnt].size = 0;
+
+		for (j = 0; j < OUTPUTS_NUM; j++){
+			sprintf(path, "%s/%s%s", cache_dir, entries[entries_cnt].key, OUTPUTS_EXT[j]);
+			if ((len = file_size(path)) > 0)
+				entries[entries_cnt].size += len;
+		}
+
+		total_size += entries[entries_cnt++].size;
+	}
+
+	closedir(dir);
+
+	/* removes the oldest entries first */
+	qsort(entries, entries_cnt, sizeof(cache_entry), compare_entries_by_use);
+
+	for (i = 0; i < entries_cnt && total_size > max_size * KB; i++){
+
+		/* removes the .ob file first, so a partially removed entry is never a hit */
+		for (j = OUTPUTS_NUM - 1; j >= 0; j--){
+			sprintf(path, "%s/%s%s", cache_dir, entries[i].key, OUTPUTS_EXT[j]);
+			remove(path);
+		}
+
+		total_size -= entries[i].size;
+		stats -> evictions++;
+	}
+
+	free(entries);
+
+}
+
+
+
+/*
+ *	Updates two 32 bit FNV-1a hashes with the given bytes.
+ *
+ *	param bytes - The bytes to hash.
+ *	param cnt - The number of bytes.
+ *	param h1_add - Pointer to the first hash.
+ *	param h2_add - Pointer to the second hash.
+ */
+void hash_bytes(const char *bytes, long cnt, unsigned long *h1_add, unsigned long *h2_add){
+
+	long i;
+
+	for (i = 0; i < cnt; i++){
+
+		*h1_add = HASH_BYTE(*h1_add, bytes[i]);
+		*h2_add = HASH_BYTE(*h2_add, bytes[i]);
+	}
+
+}
+
+
+
+/*
+ *	Copies a file.
+ *
+ *	param src_name - The name of the file to copy.
+ *	param des_name - The name of the new file.
+ *	returns 1 if the file was copied, 0 otherwise.
+ */
+int copy_file(char *src_name, char *des_name){
+
+	FILE *src, *des;
+	char buffer[COPY_BUFFER_SIZE];
+	long cnt;
+	int is_valid = 1;
+
+	if (!(src = fopen(src_name, "rb")))
+		return 0;
+
+	if (!(des = fopen(des_name, "wb"))){
+		fclose(src);
+		return 0;
+	}
+
+	while ((cnt = fread(buffer, sizeof(char), COPY_BUFFER_SIZE, src)) > 0)
+		if (fwrite(buffer, sizeof(char), cnt, des) != cnt)
+			is_valid = 0;
+
+	fclose(src);
+	if (fclose(des) != 0)
+		is_valid = 0;
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Gets the size of a file.
+ *
+ *	param name - The name of the file.
+ *	returns the size of the file in bytes, or -1 if the file does not exist.
+ */
+long file_size(char *name){
+
+	struct stat info;
+
+	if (stat(name, &info) != 0)
+		return -1;
+
+	return (long)info.st_size;
+
+}
+
+
+
+/*
+ *	Compares two cache entries by their last use time (qsort comparator).
+ *
+ *	param a - Pointer to the first entry.
+ *	param b - Pointer to the second entry.
+ *	returns negative number if a was used before b, positive number if after and 0 otherwise.
+ */
+int compare_entries_by_use(const void *a, const void *b){
+
+	const cache_entry *entry_a = (const cache_entry *)a, *entry_b = (const cache_entry *)b;
+
+	if (entry_a -> last_use != entry_b -> last_use)
+		return entry_a -> last_use < entry_b -> last_use ? -1 : 1;
+
+	return strcmp(entry_a -> key, entry_b -> key);
+
+}
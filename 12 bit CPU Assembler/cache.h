@@ -0,0 +1,29 @@
+/*
+ *	File: cache.h
+ *
+ *	Defines the data structures and function prototypes of the assembly results cache.
+ *	The cache is a local directory that stores the outputs (.am, .ob, .ent, .ext, .map, .obb) of valid assemblies
+ *	and their warnings, addressed by a hash of the source file, the assembler version and the target profile.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+#define ASSEMBLER_VERSION "5.8.23" /* part of the cache key - results of other versions are not reused */
+#define CACHE_KEY_LEN 17 /* length of a cache key (16 hex digits + null) */
+#define CACHE_PROFILE_LEN 256 /* size of the target profile (7 fields take up to 150 characters, new ones must fit) */
+#define DEFAULT_CACHE_SIZE 65536 /* default maximum cache size in KB (64 MB) */
+
+typedef struct { /* cache counters */
+	int hits;
+	int misses;
+	int evictions;
+} cache_stats;
+
+/* functions prototype */
+int get_cache_key(char *, const char *, char *);
+int restore_from_cache(char *, char *, char *, int *, int *);
+void store_in_cache(char *, char *, char *, int, int, int, int);
+void evict_cache(char *, long, cache_stats *);
@@ -0,0 +1,113 @@
+/*
+ *	File: check.c
+ *
+ *	This file implements the check mode of the assembler (--check option), which validates a source
+ *	without building it. The source is expanded in memory (no .am file), the first run defines its labels
+ *	and the second run only checks the lines against the symbol table (undefined labels, entries that are
+ *	not defined, unused externals and the ranges of the numbers), so the code and data images are not
+ *	built and no file is written. The errors are the same errors of a build of the source.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for fmemopen in ansi mode */
+
+#include "macro_list.h"
+#include "labels_BST.h"
+#include "ast.h"
+#include "encoder.h"
+#include "stats.h"
+
+/* functions prototype */
+int pre_assemble_stream(FILE *, char *, macro_node **, macro_node **, char **, map_origin_vector *);
+int first_run_stream(FILE *, char *, symbol_table_node **, macro_node **, int *, int *, int **, int *, int);
+int second_run_stream(FILE *, char *, mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *,
+					  mem_data_word (*)[MAX_MEMORY_ASSUMPTION], int *, symbol_table_node *, extern_ref_vector *,
+					  line_map_vector *, int *, int);
+
+
+
+/*
+ *	Checks a source file without encoding it and without writing files.
+ *
+ *	param file_name - The name of the source file without extension.
+ *	param threads - Number of threads that parse the lines of each chunk in the first run.
+ *	returns 1 if the source is valid, 0 otherwise.
+ */
+int check_file(char *file_name, int threads){
+
+	FILE *src;
+	char src_name[MAX_BUFFER], am_name[MAX_BUFFER], *draft;
+	int is_pre_valid, is_first_valid, is_second_valid = 1, ic = 0, dc = 0, *error_lines = NULL, err_ln_size = 0;
+	macro_node *head_macro = NULL, *tail_macro = NULL;
+	symbol_table_node *label_root = NULL;
+
+	sprintf(src_name, "%s.as", file_name);
+	sprintf(am_name, "%s.am", file_name); /* the errors of the runs refer to the expanded lines like in a build */
+
+	if (!(src = fopen(src_name, "r"))){
+
+		errprintf(src_name, NO_LINE_ERROR, "cannot open file - pre assembler");
+		return 0;
+	}
+
+	/* pre assembler in memory */
+	start_phase(phase_pre_assembler);
+	is_pre_valid = pre_assemble_stream(src, src_name, &head_macro, &tail_macro, &draft, NULL);
+	end_phase(phase_pre_assembler);
+	fclose(src);
+
+	if (!is_pre_valid){ /* the macro list was freed by the pre assembler */
+		free(draft);
+		return 0;
+	}
+
+	delete_macro_lines(&head_macro); /* now we need only the macro names */
+
+	/* the expanded source is read from memory (fmemopen does not accept an empty buffer - an empty source
+	   has nothing to check) */
+	if (*draft == '\0' || !(src = fmemopen(draft, strlen(draft), "r"))){
+
+		is_pre_valid = *draft == '\0';
+
+		if (!is_pre_valid)
+			errprintf(am_name, NO_LINE_ERROR, "cannot open the expanded source - check");
+
+		free(draft);
+		if (head_macro != NULL)
+			free_macro_list(&head_macro);
+		return is_pre_valid;
+	}
+
+	/* first run */
+	start_phase(phase_first_run);
+	is_first_valid = first_run_stream(src, am_name, &label_root, &head_macro, &ic, &dc, &error_lines, &err_ln_size,
+									  threads);
+	end_phase(phase_first_run);
+
+	if (head_macro != NULL)
+		free_macro_list(&head_macro);
+
+	/* the checks of the second run (if there is no memory error) */
+	if (is_first_valid != -1){
+
+		rewind(src);
+		ic = 0;
+		dc = 0;
+
+		start_phase(phase_second_run);
+		is_second_valid = second_run_stream(src, am_name, NULL, &ic, NULL, &dc, label_root, NULL, NULL, error_lines,
+											err_ln_size);
+		end_phase(phase_second_run);
+	}
+
+	fclose(src);
+	free(draft);
+	free(error_lines);
+	if (label_root != NULL)
+		free_symbol_table(&label_root);
+
+	return is_first_valid == 1 && is_second_valid;
+
+}
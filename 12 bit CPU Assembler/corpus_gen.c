@@ -0,0 +1,428 @@
+/*
+ *	File: corpus_gen.c
+ *
+ *	This file contains a generator of synthetic assembly programs (used by the benchmark).
+ *	The corpus has a given number of source lines, split into .as files that fit in the memory of the
+ *	CPU (every file is a valid program). The files define macros, labels (sequential or random names),
+ *	external and entry labels, instructions of all the kinds and long .data/.string directives.
+ *	The generator uses its own pseudo random generator, so the same seed gives the same corpus on every
+ *	platform. The names of the generated files (without extension) are printed to stdout.
+ *
+ *	usage: corpus_gen [-n lines] [-m macros] [-k labels] [-x extern%] [-e entry%] [-d data_len]
+ *					  [-v data_max] [-D] [-r] [-s seed] [-o prefix]
+ *	-D generates only .data lines (the number parsing benchmark), and -v limits their values (small values
+ *	put more numbers in a line).
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+/* macro definitions */
+#define DEFAULT_LINES 10000 /* default number of source lines in the corpus */
+#define DEFAULT_MACROS 4 /* default number of macros in every file */
+#define DEFAULT_LABELS 64 /* default number of labels in every file */
+#define DEFAULT_EXTERN_PERCENT 10 /* default percent of label operands that are external labels */
+#define DEFAULT_ENTRY_PERCENT 10 /* default percent of the labels that are entry labels */
+#define DEFAULT_DATA_LEN 6 /* default number of values in .data (and characters in .string) */
+#define MAX_DATA_LEN 70 /* maximum length of .data/.string (the line length is limited anyway) */
+#define EXTERNS_NUM 8 /* number of external labels every file declares */
+#define MACRO_BODY_LINES 2 /* number of lines in a macro body */
+#define MAX_FILE_LABELS 1024 /* maximum number of labels in a file */
+#define RANDOM_NAME_MIN 4 /* minimum length of the random part of a random label name */
+#define RANDOM_NAME_SPAN 12 /* span of the length of the random part of a random label name */
+#define MAX_GEN_DATA_NUM 2047 /* maximum generated .data value (the default of -v) */
+#define MAX_GEN_IMM_NUM 511 /* maximum generated immediate value */
+#define DATA_ONLY_KIND 10 /* the kind of line of the -D option (a .data directive, see make_line) */
+#define GEN_LINE_LIMIT 78 /* generated lines are kept shorter than the line limit */
+#define RAND_MASK 0xFFFFFFFFUL /* keeps the random state 32 bit on any platform */
+#define REGS_NUM 8 /* number of registers */
+
+/* instructions by number of operands */
+const char *TWO_OPS_INSS[] = {"mov", "cmp", "add", "sub", "lea"};
+const char *ONE_OP_INSS[] = {"not", "clr", "inc", "dec", "jmp", "bne", "red", "prn", "jsr"};
+const char *NO_OPS_INSS[] = {"rts", "stop"};
+/* letters of the random names and strings (no 'm', so they never contain "mcro") */
+const char GEN_LETTERS[] = "abcdefghijklnopqrstuvwxyz";
+#define GEN_LETTERS_NUM 25
+#define TWO_OPS_NUM 5
+#define ONE_OP_NUM 9
+#define NO_OPS_NUM 2
+
+typedef struct { /* the generator parameters */
+	long lines; /* total number of source lines */
+	int macros; /* macros in every file */
+	int labels; /* labels in every file */
+	int extern_percent;
+	int entry_percent;
+	int data_len;
+	int data_max; /* maximum absolute .data value */
+	int is_data_only; /* 1 if every body line is a .data directive */
+	int is_random_names; /* 1 for random label names, 0 for sequential names */
+	unsigned long seed;
+	char *prefix; /* prefix of the generated files names */
+} gen_params;
+
+typedef struct { /* the state of the file that is being generated */
+	FILE *des;
+	char labels[MAX_FILE_LABELS][MAX_LABEL_SIZE]; /* the defined labels */
+	int labels_cnt;
+	int used_externs[EXTERNS_NUM]; /* flags of the external labels that were used */
+	int words; /* number of memory words used so far */
+	long lines; /* number of lines written so far */
+} gen_file;
+
+/* exclusive functions prototype */
+unsigned long next_random(unsigned long *);
+int random_below(unsigned long *, int);
+int generate_file(gen_params *, unsigned long *, int, long);
+void make_label_name(gen_params *, unsigned long *, int, char *);
+void make_operand(gen_params *, unsigned long *, gen_file *, int, char *);
+int make_line(gen_params *, unsigned long *, gen_file *, char *);
+
+
+
+/*
+ *	main function of the generator
+ *
+ *	param argc - Number of command-line arguments.
+ *	param argv - Array of command-line arguments.
+ *	returns 0 on successful execution, 1 otherwise.
+ */
+int main(int argc, char *argv[]){
+
+	gen_params params = {DEFAULT_LINES, DEFAULT_MACROS, DEFAULT_LABELS, DEFAULT_EXTERN_PERCENT,
+						 DEFAULT_ENTRY_PERCENT, DEFAULT_DATA_LEN, MAX_GEN_DATA_NUM, 0, 0, 1, "corpus"};
+	unsigned long state;
+	long written = 0, file_lines;
+	int i, file_idx = 0;
+
+	for (i = 1; i < argc; i++){
+
+		if (strcmp(argv[i], "-r") == 0)
+			params.is_random_names = 1;
+		else if (strcmp(argv[i], "-D") == 0)
+			params.is_data_only = 1;
+		else if (i + 1 < argc && strcmp(argv[i], "-n") == 0)
+			params.lines = atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-m") == 0)
+			params.macros = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-k") == 0)
+			params.labels = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-x") == 0)
+			params.extern_percent = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-e") == 0)
+			params.entry_percent = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-d") == 0)
+			params.data_len = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-v") == 0)
+			params.data_max = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+			params.seed = strtoul(argv[++i], NULL, 10);
+		else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+			params.prefix = argv[++i];
+		else {
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "unknown option '%s' (expected format: %s [-n lines] [-m macros] [-k labels] [-x extern%%] [-e entry%%] [-d data_len] [-v data_max] [-D] [-r] [-s seed] [-o prefix])", argv[i], argv[0]);
+			return 1;
+		}
+	}
+
+	/* keeps the parameters in their valid ranges */
+	if (params.labels > MAX_FILE_LABELS)
+		params.labels = MAX_FILE_LABELS;
+	if (params.data_len < 1)
+		params.data_len = 1;
+	if (params.data_len > MAX_DATA_LEN)
+		params.data_len = MAX_DATA_LEN;
+	if (params.data_max < 0 || params.data_max > MAX_GEN_DATA_NUM)
+		params.data_max = MAX_GEN_DATA_NUM;
+
+	state = params.seed ? params.seed : 1;
+
+	/* every file gets the lines that fit in the memory, until the corpus has all its lines */
+	while (written < params.lines){
+
+		if ((file_lines = generate_file(&params, &state, file_idx, params.lines - written)) <= 0)
+			return 1;
+
+		printf("%s_%04d\n", params.prefix, file_idx++);
+		written += file_lines;
+	}
+
+	return 0;
+
+}
+
+
+
+/*
+ *	Advances the pseudo random generator (32 bit xorshift).
+ *
+ *	param state_add - Pointer to the generator state.
+ *	returns the next pseudo random number.
+ */
+unsigned long next_random(unsigned long *state_add){
+
+	unsigned long x = *state_add;
+
+	x ^= (x << 13) & RAND_MASK;
+	x ^= x >> 17;
+	x ^= (x << 5) & RAND_MASK;
+
+	return *state_add = x & RAND_MASK;
+
+}
+
+
+
+/*
+ *	Gets a pseudo random number in a range.
+ *
+ *	param state_add - Pointer to the generator state.
+ *	param limit - The upper limit of the range (not included).
+ *	returns a pseudo random number in [0, limit).
+ */
+int random_below(unsigned long *state_add, int limit){
+
+	return limit > 0 ? (int)(next_random(state_add) % limit) : 0;
+
+}
+
+
+
+/*
+ *	Generates one .as file.
+ *
+ *	param params - Pointer to the generator parameters.
+ *	param state_add - Pointer to the generator state.
+ *	param file_idx - The index of the file (part of its name).
+ *	param max_lines - The maximum number of lines of the file.
+ *	returns the number of lines written, or -1 if the file cannot be created.
+ */
+int generate_file(gen_params *params, unsigned long *state_add, int file_idx, long max_lines){
+
+	static gen_file file; /* large - not on the stack */
+	char file_name[MAX_BUFFER], line[MAX_BUFFER];
+	int i, j, words, labels_cnt, reserved, used_externs[EXTERNS_NUM];
+
+	sprintf(file_name, "%s_%04d.as", params -> prefix, file_idx);
+
+	if (!(file.des = fopen(file_name, "w"))){
+		errprintf(file_name, NO_LINE_ERROR, "cannot create file - corpus generator");
+		return -1;
+	}
+
+	memset(&file.used_externs, 0, sizeof(file.used_externs));
+	file.labels_cnt = 0;
+	file.words = 0;
+	file.lines = 0;
+
+	/* the macros come first */
+	for (i = 0; i < params -> macros && file.lines + MACRO_BODY_LINES + 2 <= max_lines; i++){
+
+		fprintf(file.des, "mcro mac%d\n", i);
+		for (j = 0; j < MACRO_BODY_LINES; j++)
+			fprintf(file.des, "\t%s @r%d, @r%d\n", TWO_OPS_INSS[random_below(state_add, TWO_OPS_NUM - 1)],
+					random_below(state_add, REGS_NUM), random_below(state_add, REGS_NUM));
+		fprintf(file.des, "endmcro\n");
+		file.lines += MACRO_BODY_LINES + 2;
+	}
+
+	/* the body - until the memory or the lines run out (lines are kept for stop and the externals) */
+	reserved = 1 + (params -> extern_percent > 0 ? EXTERNS_NUM : 0);
+	while (file.lines < max_lines - reserved){
+
+		labels_cnt = file.labels_cnt;
+		memcpy(used_externs, file.used_externs, sizeof(used_externs));
+		words = make_line(params, state_add, &file, line);
+
+		if (file.words + words + 1 > MAX_MEMORY_ASSUMPTION){ /* the line is dropped with its label and uses */
+			file.labels_cnt = labels_cnt;
+			memcpy(file.used_externs, used_externs, sizeof(used_externs));
+			break;
+		}
+
+		file.words += words;
+		fputs(line, file.des);
+		file.lines++;
+	}
+
+	fprintf(file.des, "\tstop\n");
+	file.lines++;
+
+	/* declarations of the used external labels (after their uses, like in the handwritten inputs) */
+	for (i = 0; i < EXTERNS_NUM; i++){
+		if (file.used_externs[i]){
+			fprintf(file.des, ".extern X%d\n", i);
+			file.lines++;
+		}
+	}
+
+	/* entry declarations of some of the labels */
+	for (i = 0; i < file.labels_cnt && file.lines < max_lines; i++){
+		if (random_below(state_add, 100) < params -> entry_percent){
+			fprintf(file.des, ".entry %s\n", file.labels[i]);
+			file.lines++;
+		}
+	}
+
+	fclose(file.des);
+
+	return file.lines;
+
+}
+
+
+
+/*
+ *	Makes a label name.
+ *
+ *	param params - Pointer to the generator parameters.
+ *	param state_add - Pointer to the generator state.
+ *	param label_idx - The index of the label in the file (makes the name unique).
+ *	param name - Buffer to store the name.
+ */
+void make_label_name(gen_params *params, unsigned long *state_add, int label_idx, char *name){
+
+	int i, len;
+
+	if (!params -> is_random_names){
+		sprintf(name, "L%d", label_idx);
+		return;
+	}
+
+	/* a random letters prefix and the index (the prefix starts with 'Q', so it is never a reserved word) */
+	len = RANDOM_NAME_MIN + random_below(state_add, RANDOM_NAME_SPAN);
+	name[0] = 'Q';
+	for (i = 1; i < len; i++)
+		name[i] = random_below(state_add, 2) ? GEN_LETTERS[random_below(state_add, GEN_LETTERS_NUM)] :
+					toupper(GEN_LETTERS[random_below(state_add, GEN_LETTERS_NUM)]);
+	sprintf(name + len, "%d", label_idx);
+
+}
+
+
+
+/*
+ *	Makes an instruction operand.
+ *
+ *	param params - Pointer to the generator parameters.
+ *	param state_add - Pointer to the generator state.
+ *	param file - Pointer to the state of the file.
+ *	param kind - 0 for any addressing method, 1 for direct or register, 2 for direct only.
+ *	param operand - Buffer to store the operand.
+ */
+void make_operand(gen_params *params, unsigned long *state_add, gen_file *file, int kind, char *operand){
+
+	int choice = random_below(state_add, 3);
+
+	if (kind == 2)
+		choice = 1;
+	else if (kind == 1 && choice == 0)
+		choice = 2;
+
+	if (choice == 1){ /* direct - an external label or an already defined label */
+
+		if (params -> extern_percent > 0 && random_below(state_add, 100) < params -> extern_percent){
+			choice = random_below(state_add, EXTERNS_NUM);
+			file -> used_externs[choice] = 1;
+			sprintf(operand, "X%d", choice);
+			choice = 1;
+		}
+		else if (file -> labels_cnt > 0)
+			strcpy(operand, file -> labels[random_below(state_add, file -> labels_cnt)]);
+		else /* no label yet (lea is never made in this case) */
+			choice = kind == 1 ? 2 : 0;
+	}
+
+	if (choice == 0)
+		sprintf(operand, "%d", random_below(state_add, 2 * MAX_GEN_IMM_NUM + 1) - MAX_GEN_IMM_NUM);
+
+	if (choice == 2){
+		sprintf(operand, "@r%d", random_below(state_add, REGS_NUM));
+	}
+
+}
+
+
+
+/*
+ *	Makes a body line (instruction, directive, macro call or comment).
+ *
+ *	param params - Pointer to the generator parameters.
+ *	param state_add - Pointer to the generator state.
+ *	param file - Pointer to the state of the file (a label definition is added to the file labels).
+ *	param line - Buffer to store the line.
+ *	returns the number of memory words of the line.
+ */
+int make_line(gen_params *params, unsigned long *state_add, gen_file *file, char *line){
+
+	char src[MAX_LABEL_SIZE + 1], des[MAX_LABEL_SIZE + 1];
+	int kind = random_below(state_add, 100), words, i, len, ins;
+
+	line[0] = '\0';
+
+	if (params -> is_data_only)
+		kind = DATA_ONLY_KIND;
+
+	if (kind < 4) { /* comment */
+		sprintf(line, "; generated comment line %ld\n", file -> lines);
+		return 0;
+	}
+
+	if (kind < 10 && params -> macros > 0){ /* macro call */
+		sprintf(line, "\tmac%d\n", random_below(state_add, params -> macros));
+		return MACRO_BODY_LINES * 2;
+	}
+
+	/* a label definition on the line (the next label of the file) */
+	if (file -> labels_cnt < params -> labels && random_below(state_add, 4) == 0){
+		make_label_name(params, state_add, file -> labels_cnt, file -> labels[file -> labels_cnt]);
+		sprintf(line, "%s:", file -> labels[file -> labels_cnt]);
+		file -> labels_cnt++;
+	}
+
+	len = strlen(line);
+
+	if (kind < 20){ /* .data */
+
+		len += sprintf(line + len, "\t.data ");
+		for (i = 0, words = 0; i < params -> data_len && len < GEN_LINE_LIMIT - 7; i++, words++)
+			len += sprintf(line + len, "%s%d", i ? "," : "", random_below(state_add, 2 * params -> data_max + 1) - params -> data_max);
+		strcat(line, "\n");
+		return words;
+	}
+
+	if (kind < 26){ /* .string */
+
+		len += sprintf(line + len, "\t.string \"");
+		for (i = 0; i < params -> data_len && len < GEN_LINE_LIMIT - 2; i++)
+			line[len++] = GEN_LETTERS[random_below(state_add, GEN_LETTERS_NUM)];
+		strcpy(line + len, "\"\n");
+		return i + 1;
+	}
+
+	if (kind < 70){ /* two operands instruction */
+
+		ins = random_below(state_add, TWO_OPS_NUM);
+		if (ins == 4 && file -> labels_cnt == 0)
+			ins = 0; /* lea needs a defined label - mov instead */
+		make_operand(params, state_add, file, ins == 4 ? 2 : 0, src); /* lea source is direct only */
+		make_operand(params, state_add, file, ins == 1 ? 0 : 1, des); /* cmp destination is any */
+		sprintf(line + len, "\t%s %s, %s\n", TWO_OPS_INSS[ins], src, des);
+		return (src[0] == '@' && des[0] == '@') ? 2 : 3;
+	}
+
+	if (kind < 95){ /* one operand instruction */
+
+		ins = random_below(state_add, ONE_OP_NUM);
+		make_operand(params, state_add, file, ins == 7 ? 0 : 1, des); /* prn supports immediate */
+		sprintf(line + len, "\t%s %s\n", ONE_OP_INSS[ins], des);
+		return 2;
+	}
+
+	sprintf(line + len, "\t%s\n", NO_OPS_INSS[random_below(state_add, NO_OPS_NUM)]);
+	return 1;
+
+}
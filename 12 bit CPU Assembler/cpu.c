@@ -0,0 +1,656 @@
+/*
+ *	File: cpu.c
+ *
+ *	This file implements the 12 bit CPU emulator core.
+ *	The .ob image (header "ic dc" and then a word of 2 base64 characters in every line) is loaded from
+ *	address 100, and the code segment is pre-decoded. Every other address holds a lazy decoding handler,
+ *	so a jump into data or into code that was modified decodes the target when it is executed.
+ *	Memory is written only through direct operands (static addresses), so a write invalidates the decoded
+ *	instructions that may contain the written word. The registers and the memory words are 12 bits,
+ *	cmp sets the zero flag, prn prints a signed number in a line and red reads a character.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "cpu.h"
+#include "mapfile.h"
+#include "obb.h"
+
+/* macro definitions */
+#define IMM_SIGN_BIT 0x200 /* sign bit of a 10 bit immediate value */
+#define IMM_SIGN_EXTEND 0xC00 /* extends a negative 10 bit immediate value to 12 bits */
+#define WORD_SIGN_BIT 0x800 /* sign bit of a word */
+#define ARE_MASK 0x3 /* A,R,E bits of a word */
+#define MODE_MASK 0x7 /* addressing method bits */
+#define OPCODE_MASK 0xF /* op code bits */
+#define REG_MASK 0x1F /* register bits */
+#define OPERAND_SHIFT 2 /* the operand of an immediate/direct word starts at bit 2 */
+#define DES_MODE_SHIFT 2
+#define OPCODE_SHIFT 5
+#define SRC_MODE_SHIFT 9
+#define DES_REG_SHIFT 2
+#define SRC_REG_SHIFT 7 /* a register word with one register holds it here (as the assembler writes it) */
+
+/* writes a value to the destination operand (invalidates decoded code that contains the written word) */
+#define STORE_DES(cpu, ins, value) \
+	*(ins) -> des = (value) & CPU_WORD_MASK; \
+	if ((ins) -> writes_code) \
+		invalidate_code(cpu, (ins) -> des_value);
+
+/* functions prototype */
+int decode_base64_word(char *);
+
+/* exclusive functions prototype */
+int resolve_operand(cpu_state *, decoded_ins *, int, unsigned int, int, int);
+decoded_ins *cpu_fault_at(cpu_state *, int, const char *);
+decoded_ins *jump_to(cpu_state *, decoded_ins *, unsigned int);
+decoded_ins *ins_lazy(cpu_state *, decoded_ins *);
+decoded_ins *ins_invalid(cpu_state *, decoded_ins *);
+decoded_ins *ins_external(cpu_state *, decoded_ins *);
+decoded_ins *ins_end_of_memory(cpu_state *, decoded_ins *);
+decoded_ins *ins_mov(cpu_state *, decoded_ins *);
+decoded_ins *ins_cmp(cpu_state *, decoded_ins *);
+decoded_ins *ins_add(cpu_state *, decoded_ins *);
+decoded_ins *ins_sub(cpu_state *, decoded_ins *);
+decoded_ins *ins_not(cpu_state *, decoded_ins *);
+decoded_ins *ins_clr(cpu_state *, decoded_ins *);
+decoded_ins *ins_inc(cpu_state *, decoded_ins *);
+decoded_ins *ins_dec(cpu_state *, decoded_ins *);
+decoded_ins *ins_jmp(cpu_state *, decoded_ins *);
+decoded_ins *ins_bne(cpu_state *, decoded_ins *);
+decoded_ins *ins_red(cpu_state *, decoded_ins *);
+decoded_ins *ins_prn(cpu_state *, decoded_ins *);
+decoded_ins *ins_jsr(cpu_state *, decoded_ins *);
+decoded_ins *ins_rts(cpu_state *, decoded_ins *);
+decoded_ins *ins_stop(cpu_state *, decoded_ins *);
+
+/* the handler of every op code (lea is mov of the source address) */
+decoded_ins *(*const INS_HANDLERS[])(cpu_state *, decoded_ins *) = {ins_mov, ins_cmp, ins_add, ins_sub,
+	ins_mov, ins_not, ins_clr, ins_inc, ins_dec, ins_jmp, ins_bne, ins_red, ins_prn, ins_jsr, ins_rts, ins_stop};
+
+
+
+/*
+ *	Creates a new cpu with an empty memory.
+ *
+ *	param in - The input stream of red.
+ *	param out - The output stream of prn.
+ *	returns pointer to the new cpu.
+ */
+cpu_state *create_cpu(FILE *in, FILE *out){
+
+	cpu_state *cpu = (cpu_state *)counted_calloc(1, sizeof(cpu_state));
+
+	if (cpu == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - cpu");
+		exit(1);
+	}
+
+	cpu -> in = in;
+	cpu -> out = out;
+	cpu -> code_end = cpu -> data_end = CPU_LOAD_ADDRESS;
+	reset_cpu(cpu);
+
+	return cpu;
+
+}
+
+
+
+/*
+ *	Loads a .ob file (or a .obb file if is_obb is set) into the memory of the cpu and resets the cpu.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param file_name - The name of the .ob file without extension.
+ *	returns 1 if the image was loaded, 0 otherwise.
+ */
+int load_ob_image(cpu_state *cpu, char *file_name){
+
+	cpu_image image;
+
+	if (!(cpu -> is_obb ? read_obb_image(&image, file_name) : read_ob_image(&image, file_name)))
+		return 0;
+
+	load_image(cpu, &image);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Reads a .ob file into a packed memory image.
+ *
+ *	param image - Pointer to the image.
+ *	param file_name - The name of the .ob file without extension.
+ *	returns 1 if the file was read, 0 otherwise.
+ */
+int read_ob_image(cpu_image *image, char *file_name){
+
+	FILE *src;
+	char ob_name[MAX_BUFFER], line[MAX_LINE];
+	int ic, dc, i, word;
+
+	sprintf(ob_name, "%s.ob", file_name);
+
+	if (!(src = fopen(ob_name, "r"))){
+		errprintf(ob_name, NO_LINE_ERROR, "cannot open file - emulator");
+		return 0;
+	}
+
+	if (!fgets(line, MAX_LINE, src) || sscanf(line, "%d %d", &ic, &dc) != 2 || ic < 0 || dc < 0 ||
+		ic + dc > CPU_MEMORY_SIZE - CPU_LOAD_ADDRESS){
+
+		errprintf(ob_name, 1, "invalid header - expected the code and data sizes");
+		fclose(src);
+		return 0;
+	}
+
+	memset(image -> mem, 0, sizeof(image -> mem));
+
+	for (i = 0; i < ic + dc; i++){
+
+		if (!fgets(line, MAX_LINE, src) || (word = decode_base64_word(line)) < 0){
+
+			errprintf(ob_name, i + 2, "invalid base64 word");
+			fclose(src);
+			return 0;
+		}
+
+		image -> mem[CPU_LOAD_ADDRESS + i] = word;
+	}
+
+	fclose(src);
+
+	image -> code_end = CPU_LOAD_ADDRESS + ic;
+	image -> data_end = image -> code_end + dc;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Reads a .obb file into a packed memory image. The file is mapped and its words are in the format of
+ *	the image, so they are only copied (and masked to 12 bits).
+ *
+ *	param image - Pointer to the image.
+ *	param file_name - The name of the .obb file without extension.
+ *	returns 1 if the file was read, 0 otherwise.
+ */
+int read_obb_image(cpu_image *image, char *file_name){
+
+	obb_file *obb;
+	unsigned int words_num, i;
+
+	if ((obb = open_obb_file(file_name)) == NULL)
+		return 0;
+
+	words_num = obb -> header -> ic + obb -> header -> dc;
+
+	if (obb -> header -> load_address != CPU_LOAD_ADDRESS || words_num > CPU_MEMORY_SIZE - CPU_LOAD_ADDRESS){
+
+		errprintf(file_name, NO_LINE_ERROR, "the .obb image does not fit the memory - emulator");
+		close_obb_file(obb);
+		return 0;
+	}
+
+	memset(image -> mem, 0, sizeof(image -> mem));
+	for (i = 0; i < words_num; i++)
+		image -> mem[CPU_LOAD_ADDRESS + i] = obb -> words[i] & CPU_WORD_MASK;
+
+	image -> code_end = CPU_LOAD_ADDRESS + obb -> header -> ic;
+	image -> data_end = CPU_LOAD_ADDRESS + words_num;
+
+	close_obb_file(obb);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Copies a memory image into the memory of the cpu and resets the cpu.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param image - Pointer to the image.
+ */
+void load_image(cpu_state *cpu, cpu_image *image){
+
+	int i;
+
+	for (i = 0; i < CPU_MEMORY_SIZE; i++)
+		cpu -> mem[i] = image -> mem[i];
+
+	cpu -> code_end = image -> code_end;
+	cpu -> data_end = image -> data_end;
+	reset_cpu(cpu);
+
+}
+
+
+
+/*
+ *	Resets the registers, the flags and the counters of the cpu, and marks all the code as not decoded
+ *	(the memory is kept).
+ *
+ *	param cpu - Pointer to the cpu.
+ */
+void reset_cpu(cpu_state *cpu){
+
+	int i;
+
+	memset(cpu -> regs, 0, sizeof(cpu -> regs));
+	cpu -> pc = CPU_LOAD_ADDRESS;
+	cpu -> sp = CPU_MEMORY_SIZE;
+	cpu -> zero_flag = 0;
+	cpu -> executed = 0;
+	cpu -> status = cpu_running;
+	cpu -> fault[0] = '\0';
+
+	for (i = 0; i < CPU_MEMORY_SIZE; i++){
+		cpu -> code[i].handler = ins_lazy;
+		cpu -> code[i].opcode = OPCODE_NOT_DECODED;
+		cpu -> code[i].address = i;
+		cpu -> code[i].length = 1;
+	}
+
+	cpu -> code[CPU_MEMORY_SIZE].handler = ins_end_of_memory;
+	cpu -> code[CPU_MEMORY_SIZE].opcode = OPCODE_INVALID;
+	cpu -> code[CPU_MEMORY_SIZE].address = CPU_MEMORY_SIZE;
+
+	if (cpu -> write_hook != NULL)
+		cpu -> write_hook(cpu, ALL_ADDRESSES);
+
+}
+
+
+
+/*
+ *	Pre-decodes the code segment of the cpu.
+ *
+ *	param cpu - Pointer to the cpu.
+ */
+void predecode_cpu(cpu_state *cpu){
+
+	int address = CPU_LOAD_ADDRESS;
+
+	while (address < cpu -> code_end)
+		address += decode_at(cpu, address) -> length;
+
+}
+
+
+
+/*
+ *	Runs the cpu from its pc until it stops.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ *	returns the status of the cpu (cpu_halted, cpu_fault or cpu_limit).
+ */
+enum cpu_status run_cpu(cpu_state *cpu, long limit){
+
+	decoded_ins *ins = &(cpu -> code[cpu -> pc]);
+	long cnt = 0;
+
+	cpu -> status = cpu_running;
+
+	if (limit > 0){
+		for (; ins != NULL && cnt < limit; cnt++)
+			ins = ins -> handler(cpu, ins);
+	}
+	else {
+		for (; ins != NULL; cnt++)
+			ins = ins -> handler(cpu, ins);
+	}
+
+	if (ins != NULL){ /* stopped by the limit */
+		cpu -> status = cpu_limit;
+		cpu -> pc = ins -> address;
+	}
+	else if (cpu -> status == cpu_fault) /* the faulting instruction was not executed */
+		cnt--;
+
+	cpu -> executed += cnt;
+
+	return cpu -> status;
+
+}
+
+
+
+/*
+ *	Invalidates the decoded instructions that may contain a memory word (after the word was written)
+ *	and calls the write hook.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param address - The address of the written word.
+ */
+void invalidate_code(cpu_state *cpu, int address){
+
+	int i;
+
+	for (i = address; i > address - MAX_INS_LEN && i >= 0; i--){
+		cpu -> code[i].handler = ins_lazy;
+		cpu -> code[i].opcode = OPCODE_NOT_DECODED;
+	}
+
+	if (cpu -> write_hook != NULL)
+		cpu -> write_hook(cpu, address);
+
+}
+
+
+
+/*
+ *	Decodes the instruction at an address.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param address - The address of the instruction.
+ *	returns pointer to the decoded instruction (with a fault handler if the word is not an instruction).
+ */
+decoded_ins *decode_at(cpu_state *cpu, int address){
+
+	decoded_ins *ins = &(cpu -> code[address]);
+	unsigned int word = cpu -> mem[address];
+	int opcode = (word >> OPCODE_SHIFT) & OPCODE_MASK, ins_kind = opcode + 1,
+		src_mode = (word >> SRC_MODE_SHIFT) & MODE_MASK, des_mode = (word >> DES_MODE_SHIFT) & MODE_MASK,
+		is_valid = (word & ARE_MASK) == abs_code, is_external = 0, res;
+
+	ins -> address = address;
+	ins -> length = 1;
+	ins -> writes_code = 0;
+	ins -> src = ins -> des = NULL;
+
+	/* checks the addressing methods of the instruction */
+	if (ins_kind <= ast_ins_lea){
+		is_valid = is_valid && (src_mode == ast_op_type_imm || src_mode == ast_op_type_label || src_mode == ast_op_type_reg) &&
+				   (ins_kind != ast_ins_lea || src_mode == ast_op_type_label) &&
+				   (des_mode == ast_op_type_label || des_mode == ast_op_type_reg ||
+				   (des_mode == ast_op_type_imm && ins_kind == ast_ins_cmp));
+	}
+	else if (ins_kind <= ast_ins_jsr){
+		is_valid = is_valid && src_mode == 0 &&
+				   (des_mode == ast_op_type_label || des_mode == ast_op_type_reg ||
+				   (des_mode == ast_op_type_imm && ins_kind == ast_ins_prn));
+	}
+	else
+		is_valid = is_valid && src_mode == 0 && des_mode == 0;
+
+	/* resolves the operands (two registers share one word) */
+	if (is_valid && ins_kind <= ast_ins_lea && src_mode == ast_op_type_reg && des_mode == ast_op_type_reg){
+
+		if ((is_valid = address + 1 < CPU_MEMORY_SIZE && (cpu -> mem[address + 1] & ARE_MASK) == abs_code)){
+			ins -> src = &(cpu -> regs[((cpu -> mem[address + 1] >> SRC_REG_SHIFT) & REG_MASK) % CPU_REGS_NUM]);
+			ins -> des = &(cpu -> regs[((cpu -> mem[address + 1] >> DES_REG_SHIFT) & REG_MASK) % CPU_REGS_NUM]);
+			ins -> length = 2;
+		}
+	}
+	else if (is_valid && ins_kind <= ast_ins_jsr){
+
+		if (ins_kind <= ast_ins_lea){
+			res = resolve_operand(cpu, ins, 1, src_mode, ins_kind == ast_ins_lea, 0);
+			is_valid = res != 0;
+			is_external = res < 0;
+		}
+
+		if (is_valid){
+			res = resolve_operand(cpu, ins, 0, des_mode,
+								  ins_kind == ast_ins_jmp || ins_kind == ast_ins_bne || ins_kind == ast_ins_jsr,
+								  ins_kind != ast_ins_cmp && ins_kind != ast_ins_prn);
+			is_valid = res != 0;
+			is_external = is_external || res < 0;
+		}
+	}
+
+	if (!is_valid || is_external){
+		ins -> handler = is_external ? ins_external : ins_invalid;
+		ins -> opcode = OPCODE_INVALID;
+	}
+	else {
+		ins -> handler = INS_HANDLERS[opcode];
+		ins -> opcode = opcode;
+	}
+
+	return ins;
+
+}
+
+
+
+/*
+ *	Resolves the operand in the next word of an instruction (and adds the word to its length).
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param ins - Pointer to the decoded instruction.
+ *	param is_src - 1 for the source operand, 0 for the destination operand.
+ *	param mode - The addressing method of the operand.
+ *	param is_address - 1 if the instruction uses the address of a direct operand (lea, jumps).
+ *	param is_written - 1 if the instruction writes to the operand.
+ *	returns 1 if the operand is valid, -1 if it is an unresolved external label and 0 otherwise.
+ */
+int resolve_operand(cpu_state *cpu, decoded_ins *ins, int is_src, unsigned int mode, int is_address,
+					int is_written){
+
+	int address = ins -> address + ins -> length;
+	unsigned int word, value, *value_add = is_src ? &(ins -> src_value) : &(ins -> des_value), **operand_add =
+		is_src ? &(ins -> src) : &(ins -> des);
+
+	if (address >= CPU_MEMORY_SIZE)
+		return 0;
+
+	word = cpu -> mem[address];
+	value = word >> OPERAND_SHIFT;
+	ins -> length++;
+
+	if (mode == ast_op_type_reg){
+		if ((word & ARE_MASK) != abs_code)
+			return 0;
+		*operand_add = &(cpu -> regs[((word >> SRC_REG_SHIFT) & REG_MASK) % CPU_REGS_NUM]);
+	}
+	else if (mode == ast_op_type_imm){
+		if ((word & ARE_MASK) != abs_code)
+			return 0;
+		*value_add = (value & IMM_SIGN_BIT) ? (value | IMM_SIGN_EXTEND) : value;
+		*operand_add = value_add;
+	}
+	else { /* direct */
+		if ((word & ARE_MASK) == ext_code)
+			return -1;
+		*value_add = value;
+		*operand_add = is_address ? value_add : &(cpu -> mem[value]);
+		ins -> writes_code = ins -> writes_code || (!is_src && is_written);
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Stops the cpu with a fault.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param address - The address of the faulting instruction.
+ *	param reason - Description of the fault.
+ *	returns NULL (no next instruction).
+ */
+decoded_ins *cpu_fault_at(cpu_state *cpu, int address, const char *reason){
+
+	cpu -> status = cpu_fault;
+	cpu -> pc = address;
+	sprintf(cpu -> fault, "address %d: %s", address, reason);
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Jumps to an address.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param ins - Pointer to the jumping instruction.
+ *	param target - The target address.
+ *	returns the decoded instruction at the target, or NULL if the target is out of the memory.
+ */
+decoded_ins *jump_to(cpu_state *cpu, decoded_ins *ins, unsigned int target){
+
+	if (target >= CPU_MEMORY_SIZE)
+		return cpu_fault_at(cpu, ins -> address, "jump out of the memory");
+
+	return &(cpu -> code[target]);
+
+}
+
+
+
+/* the instruction handlers - every handler executes its instruction and returns the next one */
+
+decoded_ins *ins_lazy(cpu_state *cpu, decoded_ins *ins){
+
+	ins = decode_at(cpu, ins -> address);
+	return ins -> handler(cpu, ins);
+
+}
+
+decoded_ins *ins_invalid(cpu_state *cpu, decoded_ins *ins){
+
+	return cpu_fault_at(cpu, ins -> address, "invalid instruction");
+
+}
+
+decoded_ins *ins_external(cpu_state *cpu, decoded_ins *ins){
+
+	return cpu_fault_at(cpu, ins -> address, "unresolved external label (the image was not linked)");
+
+}
+
+decoded_ins *ins_end_of_memory(cpu_state *cpu, decoded_ins *ins){
+
+	return cpu_fault_at(cpu, ins -> address, "execution reached the end of the memory");
+
+}
+
+decoded_ins *ins_mov(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, *(ins -> src))
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_cmp(cpu_state *cpu, decoded_ins *ins){
+
+	cpu -> zero_flag = ((*(ins -> src) - *(ins -> des)) & CPU_WORD_MASK) == 0;
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_add(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, *(ins -> des) + *(ins -> src))
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_sub(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, *(ins -> des) - *(ins -> src))
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_not(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, ~*(ins -> des))
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_clr(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, 0)
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_inc(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, *(ins -> des) + 1)
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_dec(cpu_state *cpu, decoded_ins *ins){
+
+	STORE_DES(cpu, ins, *(ins -> des) - 1)
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_jmp(cpu_state *cpu, decoded_ins *ins){
+
+	return jump_to(cpu, ins, *(ins -> des));
+
+}
+
+decoded_ins *ins_bne(cpu_state *cpu, decoded_ins *ins){
+
+	return cpu -> zero_flag ? ins + ins -> length : jump_to(cpu, ins, *(ins -> des));
+
+}
+
+decoded_ins *ins_red(cpu_state *cpu, decoded_ins *ins){
+
+	int c = cpu -> in != NULL ? getc(cpu -> in) : EOF;
+
+	STORE_DES(cpu, ins, c == EOF ? CPU_WORD_MASK : (unsigned int)c) /* EOF is read as -1 */
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_prn(cpu_state *cpu, decoded_ins *ins){
+
+	unsigned int value = *(ins -> des);
+
+	fprintf(cpu -> out, "%d\n", (value & WORD_SIGN_BIT) ? (int)value - (CPU_WORD_MASK + 1) : (int)value);
+	return ins + ins -> length;
+
+}
+
+decoded_ins *ins_jsr(cpu_state *cpu, decoded_ins *ins){
+
+	if (cpu -> sp <= cpu -> data_end)
+		return cpu_fault_at(cpu, ins -> address, "stack overflow");
+
+	cpu -> mem[--(cpu -> sp)] = ins -> address + ins -> length; /* the return address */
+	invalidate_code(cpu, cpu -> sp);
+
+	return jump_to(cpu, ins, *(ins -> des));
+
+}
+
+decoded_ins *ins_rts(cpu_state *cpu, decoded_ins *ins){
+
+	if (cpu -> sp >= CPU_MEMORY_SIZE)
+		return cpu_fault_at(cpu, ins -> address, "stack underflow");
+
+	return jump_to(cpu, ins, cpu -> mem[(cpu -> sp)++]);
+
+}
+
+decoded_ins *ins_stop(cpu_state *cpu, decoded_ins *ins){
+
+	cpu -> status = cpu_halted;
+	cpu -> pc = ins -> address;
+
+	return NULL;
+
+}
@@ -0,0 +1,78 @@
+/*
+ *	File: cpu.h
+ *
+ *	Defines the data structures and function prototypes of the 12 bit CPU emulator core.
+ *	The memory image of a .ob file is pre-decoded into an array with a decoded instruction for every
+ *	address. A decoded instruction holds its handler and pointers to its operands (a register, a memory
+ *	cell or its own immediate value), so executing it needs no decoding and no addressing mode checks,
+ *	and the handler returns the next decoded instruction (direct threaded dispatch).
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "ast.h"
+#include "encoder.h"
+
+#define CPU_MEMORY_SIZE 1024 /* number of memory words */
+#define CPU_REGS_NUM 8 /* number of registers */
+#define CPU_WORD_MASK 0xFFF /* a word is 12 bits */
+#define CPU_LOAD_ADDRESS MEMORY_ASSUMPTION /* the image is loaded from address 100 */
+#define MAX_INS_LEN 3 /* maximum number of words of an instruction */
+#define OPCODE_NOT_DECODED -2 /* op code of an address that was not decoded yet */
+#define OPCODE_INVALID -1 /* op code of a word that is not a valid instruction */
+#define ALL_ADDRESSES -1 /* address of the write hook when all the memory changed */
+
+enum cpu_status {cpu_running, cpu_halted, cpu_fault, cpu_limit};
+
+typedef struct cpu_state cpu_state;
+
+typedef struct { /* packed memory image of a .ob file (a word in 2 bytes) */
+	unsigned short mem[CPU_MEMORY_SIZE];
+	short code_end;
+	short data_end;
+} cpu_image;
+
+typedef struct decoded_ins { /* decoded instruction */
+	struct decoded_ins *(*handler)(cpu_state *, struct decoded_ins *); /* returns the next instruction */
+	unsigned int *src; /* the source operand (register, memory cell or src_value) */
+	unsigned int *des; /* the destination operand (register, memory cell or des_value) */
+	unsigned int src_value; /* immediate value or address of a direct source operand */
+	unsigned int des_value; /* immediate value or address of a direct destination operand */
+	int opcode; /* the op code, OPCODE_INVALID or OPCODE_NOT_DECODED */
+	int address; /* the address of the instruction */
+	int length; /* number of words of the instruction */
+	int writes_code; /* 1 if the instruction writes to a memory cell (it may modify code) */
+} decoded_ins;
+
+struct cpu_state {
+	unsigned int mem[CPU_MEMORY_SIZE];
+	unsigned int regs[CPU_REGS_NUM];
+	decoded_ins code[CPU_MEMORY_SIZE + 1]; /* the decoded instruction of every address (+1 end of memory) */
+	int code_end; /* the code segment is [CPU_LOAD_ADDRESS, code_end) */
+	int data_end; /* the data segment is [code_end, data_end) */
+	int pc; /* the address of the next instruction (when the run stops) */
+	int sp; /* the stack grows down from the top of the memory */
+	int zero_flag; /* set by cmp, tested by bne */
+	long executed; /* number of executed instructions */
+	enum cpu_status status;
+	char fault[MAX_BUFFER]; /* description of the fault (if status is cpu_fault) */
+	FILE *in; /* the input of red (NULL for no input) */
+	FILE *out; /* the output of prn */
+	long limit; /* executed value to stop at (used by translated code) */
+	void (*write_hook)(cpu_state *, int); /* called when code may have changed (NULL for none) */
+	void *hook_data; /* the data of the write hook */
+	int is_obb; /* 1 if the programs are loaded from .obb files */
+};
+
+/* functions prototype */
+cpu_state *create_cpu(FILE *, FILE *);
+int load_ob_image(cpu_state *, char *);
+int read_ob_image(cpu_image *, char *);
+int read_obb_image(cpu_image *, char *);
+void load_image(cpu_state *, cpu_image *);
+void reset_cpu(cpu_state *);
+void predecode_cpu(cpu_state *);
+enum cpu_status run_cpu(cpu_state *, long);
+void invalidate_code(cpu_state *, int);
+decoded_ins *decode_at(cpu_state *, int);
@@ -6,8 +6,10 @@
  *  and memory deallocation.
  *  
  *  The file includes functionality to handle macro definitions and lines, as well as symbol table
- *  nodes for labels. It implements macros for deep matching of macro names and for conveniently
- *  accessing the current available cell in the extern_values array for a label node.
+ *  nodes for labels. It implements a macro for deep matching of macro names, a contiguous log
+ *  of the external labels references that is used to generate the .ext file and a contiguous log of
+ *  the memory words of every source line that is used to generate the binary .map file.
+ *  The same logs are used to generate the binary object file (.obb).
  *
  *  author: Gal Levi
  *  version: 5.8.23
@@ -15,23 +17,25 @@
 
 #include "macro_list.h"
 #include "labels_BST.h"
+#include "obb.h"
 
 /* macro definitions */
 
 /* checks if the current line contains the macro name with proper whitespace checks, ensuring deep matching */
 #define MACRO_NAME_DEEP_CHECK isspace(*(line_ptr + strlen(curr -> macro))) && (((*line_ptr) != (*line) && isspace(*(line_ptr - 1))) || (*line_ptr) == (*line))
 
-/*
- *  Macro for conveniently accessing the current available cell in the external values array for a label node.
- *  It also increments the values_count to indicate the addition of a new value.
- *   
- *  param label_node - Pointer to the symbol_table_node representing the external label
- *  returns - The value of the current available cell in the extern_values array, and increments values_count
- */
-#define EXTERN_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(label_node) label_node -> label_value.label_extern_value.extern_values[(label_node -> label_value.label_extern_value.values_count)++] 
+#define EXT_REFS_INIT_SIZE 16 /* initial number of cells in the external references log */
+#define EXT_LINE_LEN (MAX_LABEL_SIZE + 16) /* maximum length of a .ext file line (label, tab, address) */
+#define LINE_MAP_INIT_SIZE 64 /* initial number of cells in the line map */
+#define SYMBOLS_INIT_SIZE 16 /* initial number of cells in the symbols of a .ent or a .ext file */
+
+static int labels_seq = 0; /* the creation order of the labels */
 
-/* works same as EXTERN_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC for param array */
-#define PARAM_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(label_node) label_node -> label_value.label_param_value.param_values[(label_node -> label_value.label_param_value.values_count)++]
+/* exclusive functions prototype */
+int number_labels_post_order(symbol_table_node *, int);
+int collect_entry_labels(symbol_table_node *, map_label *, int);
+int compare_map_labels(const void *, const void *);
+int compare_extern_refs(const void *, const void *);
 
 /*---------------------------------macro doubly list-----------------------------------------------*/
 
@@ -43,7 +47,7 @@
  */
 macro_node *create_macro(char mcro[]) {
 
-    macro_node *new = (macro_node *)malloc(sizeof(macro_node));
+    macro_node *new = (macro_node *)counted_malloc(sizeof(macro_node));
     if (new == NULL) {
         errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - macro list");
         exit(1);
@@ -54,6 +58,7 @@ macro_node *create_macro(char mcro[]) {
     new -> prev = NULL;
     new -> head_line = NULL;
     new -> tail_line = NULL;
+    new -> text = NULL;
     return new;
 }
 
@@ -91,10 +96,10 @@ void insert_macro(macro_node **head, macro_node **tail, char mcro[]) {
  *	param line - The content of the line to be stored
  *	returns - Pointer to the newly created line node
  */
-line_node *create_line(macro_node **macro_n, char line[]) {
+line_node *create_line(macro_node **macro_n, char line[], int line_num) {
 	
 	
-    line_node *new_line = (line_node *)malloc(sizeof(line_node));
+    line_node *new_line = (line_node *)counted_malloc(sizeof(line_node));
     
     if (new_line == NULL) {
     
@@ -104,6 +109,7 @@ line_node *create_line(macro_node **macro_n, char line[]) {
     }
     
     strcpy(new_line -> line, line);
+    new_line -> line_num = line_num;
     new_line -> next = NULL;
     new_line -> prev = NULL;
     return new_line;
@@ -116,10 +122,11 @@ line_node *create_line(macro_node **macro_n, char line[]) {
  *   
  *	param macro - Pointer to the current macro
  *	param line - The line content to be inserted
+ *	param line_num - The line in the .as file
  */
-void insert_line(macro_node **macro, char line[]) {
+void insert_line(macro_node **macro, char line[], int line_num) {
 
-    line_node *new = create_line(macro, line);
+    line_node *new = create_line(macro, line, line_num);
     if ((*macro) -> head_line == NULL){ /* lines list is empty */
     	(*macro) -> head_line = new;
     	(*macro) -> tail_line = new;
@@ -194,6 +201,9 @@ void macro_to_string(char *des, macro_node *macro){
 
 	line_node *curr_line = macro -> head_line;
 	
+	if (macro -> text != NULL) /* an included macro */
+		strcat(des, macro -> text);
+	
 	while (curr_line != NULL){
 			
 		strcat(des, curr_line -> line);
@@ -286,7 +296,7 @@ void free_macro_list(macro_node **head) {
  */
 symbol_table_node *create_label_node(char *label, int value, enum enum_type type, enum enum_comm comm){
 
-    symbol_table_node *new_node = (symbol_table_node *)malloc(sizeof(symbol_table_node));
+    symbol_table_node *new_node = (symbol_table_node *)counted_malloc(sizeof(symbol_table_node));
     
     if (new_node == NULL){
     	errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - symbol table\n");
@@ -297,17 +307,9 @@ symbol_table_node *create_label_node(char *label, int value, enum enum_type type
     memset(new_node -> label, '\0', MAX_LABEL_SIZE); /* "clears" junk characters */
     strcpy(new_node -> label, label);
     
-    if (type == enum_extl){ /*  if the param type is external */
-    	new_node -> label_value.label_extern_value.values_count = 0;
-    	EXTERN_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(new_node) = value; /* array[count++] = value */
-    }
-    else if (type == enum_type_none){ /*  if the param type is none */
-    	new_node -> label_value.label_param_value.values_count = 0;
-    	PARAM_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(new_node) = value;
-    }
-    else
-    	new_node-> label_value.value = value;
-    	
+    new_node -> value = value;
+    new_node -> id = 0;
+    new_node -> seq = next_label_seq();
     new_node -> type = type;
     new_node -> comm = comm;
     new_node -> left = NULL;
@@ -315,6 +317,18 @@ symbol_table_node *create_label_node(char *label, int value, enum enum_type type
     return new_node;
 }
 
+/*
+ *	Gives the next number of the creation order of the labels (a new label node or a declared external
+ *	of the snapshot, see snapshot.c).
+ *   
+ *	returns - The number
+ */
+int next_label_seq(void){
+
+	return labels_seq++;
+
+}
+
 /*
  *	Inserts a label and its values into the symbol table.
  *   
@@ -352,23 +366,17 @@ symbol_table_node *insert_label(symbol_table_node *root, char *label, int value,
         		root -> comm = comm;
         
         	if (type == enum_rel || type == enum_ent)
-        		root -> label_value.value = value;
-
-        	else if (type == enum_type_none){
-        		/* inserts the value to the parameter label array and increases the array counter */
-				PARAM_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(root) = value;
-        		
-        	}
+        		root -> value = value;
         	
-        	/* else - if the param type = external the external array
-        	   will be "updated automatically" (because of the union) */
+        	/* else - if the param type = external/none the value stays the first use address,
+        	   the uses themselves are logged by the encoder */
         
         
         }
         /* if the label is already an entry - updates the command from none to the param comm */
         else if (root -> type == enum_ent){
         	if ((type == enum_rel)){ /* assumes root -> comm = enum_comm_none */
-           		root -> label_value.value = value;
+           		root -> value = value;
         		root -> comm = comm;
         	}
         	/* root -> comm not equal to enum_dir/enum_ins and param type not equal to enum_extl
@@ -379,14 +387,10 @@ symbol_table_node *insert_label(symbol_table_node *root, char *label, int value,
         
         /* if the label is already an external - updates new value */
         else if (root -> type == enum_extl){
-        	if (type == enum_type_none){ /* if the param type is enum_type_none */
-        		/* updates from no value to the param value if the label is used in an instruction */
-        		if (root -> label_value.label_extern_value.extern_values[(root -> label_value.label_extern_value.values_count) - 1] == NO_VALUE)
-        			root -> label_value.label_extern_value.extern_values[(root -> label_value.label_extern_value.values_count) - 1] = value;
-        		else
-        			/* inserts the value to the external label array and increases the array counter */
-        			EXTERN_ARRAY_CURR_AVAILABLE_CELL_PLUS_INC(root) = value;
-        	}
+        	/* updates from no value to the param value if the label is used in an instruction
+        	   (marks the external label as used) */
+        	if (type == enum_type_none && root -> value == NO_VALUE)
+        		root -> value = value;
         	
         	/* param type cannot be enum_rel/enum_ent(it is a first run error)
         	   if param type is enum_extl nothing changes (redeclaration of extern is not an error) */
@@ -461,23 +465,11 @@ void update_label_type(symbol_table_node *label_node, enum enum_type type){
  */
 void increase_labels_value_by_comm(symbol_table_node *root, int add, enum enum_comm comm){
 	
-	int i;
-	
 	if (root == NULL)
 		return;
 		
-	if (root -> comm == comm){
-		if (root -> type == enum_extl){
-			for (i = 0; root -> label_value.label_extern_value.values_count; i++){
-			
-				root -> label_value.label_extern_value.extern_values[i] += add;
-		
-			}
-	
-		}
-		else
-			root -> label_value.value += add;
-	}
+	if (root -> comm == comm)
+		root -> value += add;
 
 		
 	increase_labels_value_by_comm(root -> left, add, comm);
@@ -486,30 +478,166 @@ void increase_labels_value_by_comm(symbol_table_node *root, int add, enum enum_c
 
 
 /*
- *	Prints external labels to a file stream in post order (to get lexicographic order).
+ *	Prints the logged external references to a file stream.
+ *	The references are sorted by the post order of their labels in the table and by address, so
+ *	the output keeps the order of a post order walk on the table, and it is written in one buffered write.
  *   
  *	param des - Pointer to the file stream to write to
  *	param root - Pointer to the root of the symbol table
+ *	param ext_refs - Pointer to the external references log
  */
-void print_extern_labels_to_stream(FILE *des, symbol_table_node *root){
+void print_extern_labels_to_stream(FILE *des, symbol_table_node *root, extern_ref_vector *ext_refs){
 
-	int i;
+	int i, length = 0;
+	char *buffer;
 	
-	if (root == NULL)
+	if (ext_refs -> count == 0)
 		return;
+	
+	buffer = (char *)counted_malloc(sizeof(char) * EXT_LINE_LEN * ext_refs -> count);
+	
+	if (buffer == NULL){
+    	errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - external references");
+        exit(1);
+    }
+	
+	number_labels_post_order(root, 0); /* gives every label its post order index */
+	qsort(ext_refs -> refs, ext_refs -> count, sizeof(extern_ref), compare_extern_refs);
+	
+	for (i = 0; i < ext_refs -> count; i++)
+		length += sprintf(buffer + length, "%s\t%d\n", ext_refs -> refs[i].label -> label,
+						 ext_refs -> refs[i].address + MEMORY_ASSUMPTION);
+	
+	fwrite(buffer, sizeof(char), length, des);
+	free(buffer);
+
+}
+
+
+/*
+ *	Numbers the labels of the symbol table in post order.
+ *   
+ *	param root - Pointer to the root of the symbol table or its sub-tree
+ *	param next_id - The index to give to the first label of the sub-tree
+ *	returns - The index to give to the next label after the sub-tree
+ */
+int number_labels_post_order(symbol_table_node *root, int next_id){
+	
+	if (root == NULL)
+		return next_id;
+	
+	next_id = number_labels_post_order(root -> left, next_id);
+	next_id = number_labels_post_order(root -> right, next_id);
+	root -> id = next_id;
+	
+	return next_id + 1;
+
+}
+
+
+/*
+ *	Compares two external references by their label index and then by their address (qsort comparator).
+ *	Since every reference is unique by address, the order is total and the sort is stable.
+ *   
+ *	param a - Pointer to the first external reference
+ *	param b - Pointer to the second external reference
+ *	returns - Negative, zero or positive number according to the order of the references
+ */
+int compare_extern_refs(const void *a, const void *b){
+
+	const extern_ref *ref_a = (const extern_ref *)a, *ref_b = (const extern_ref *)b;
+	
+	if (ref_a -> label -> id != ref_b -> label -> id)
+		return ref_a -> label -> id - ref_b -> label -> id;
 		
-	print_extern_labels_to_stream(des, root -> left);
-	print_extern_labels_to_stream(des, root -> right);
+	return ref_a -> address - ref_b -> address;
+
+}
+
+
+/*
+ *	Appends an external reference to the external references log (enlarges the log if needed).
+ *   
+ *	param ext_refs - Pointer to the external references log
+ *	param label - Pointer to the used external label node
+ *	param address - The code image address of the word that uses the label
+ */
+void insert_extern_ref(extern_ref_vector *ext_refs, symbol_table_node *label, int address){
+
+	if (ext_refs -> count == ext_refs -> size){ /* if the log is full */
 	
-	/* if it is used external label */
-	if (root -> type == enum_extl &&
-	    root -> label_value.label_extern_value.extern_values[0] != NO_VALUE){
-		for (i = 0; i < root -> label_value.label_extern_value.values_count; i++){
-			
-			fprintf(des, "%s\t%d\n", root -> label, root -> label_value.label_extern_value.extern_values[i] + MEMORY_ASSUMPTION);
+		ext_refs -> size = ext_refs -> size ? ext_refs -> size * 2 : EXT_REFS_INIT_SIZE;
+		ext_refs -> refs = (extern_ref *)counted_realloc(ext_refs -> refs, sizeof(extern_ref) * ext_refs -> size);
+		
+		if (ext_refs -> refs == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - external references");
+        	exit(1);
+		}
+	}
+	
+	ext_refs -> refs[ext_refs -> count].label = label;
+	ext_refs -> refs[(ext_refs -> count)++].address = address;
+
+}
+
+
+/*
+ *	Frees the memory used by the external references log and resets it.
+ *   
+ *	param ext_refs - Pointer to the external references log
+ */
+void free_extern_refs(extern_ref_vector *ext_refs){
+
+	free(ext_refs -> refs);
+	ext_refs -> refs = NULL;
+	ext_refs -> count = 0;
+	ext_refs -> size = 0;
+
+}
+
+
+/*
+ *	Reads the symbols (a name and an address in every line) of a .ent or a .ext file, if the file exists
+ *	(used by the tools that read the outputs of the assembler - the linker, the converter and the disassembler).
+ *   
+ *	param file_name - The name of the program without extension
+ *	param ext - The extension of the file
+ *	param symbols_add - Pointer to the symbols array (enlarged if needed)
+ *	param count_add - Pointer to the number of symbols
+ *	param size_add - Pointer to the number of allocated cells
+ */
+void read_symbols_file(char *file_name, char *ext, map_label **symbols_add, int *count_add, int *size_add){
+
+	FILE *src;
+	char name[MAX_BUFFER], line[MAX_BUFFER], label[MAX_LABEL_SIZE];
+	int address;
+
+	sprintf(name, "%s%s", file_name, ext);
+	if (!(src = fopen(name, "r")))
+		return;
+
+	while (fgets(line, MAX_BUFFER, src)){
+
+		if (sscanf(line, "%31s %d", label, &address) != 2)
+			continue;
+
+		if (*count_add == *size_add){ /* if the array is full */
+
+			*size_add = *size_add ? *size_add * 2 : SYMBOLS_INIT_SIZE;
+			*symbols_add = (map_label *)counted_realloc(*symbols_add, sizeof(map_label) * *size_add);
+
+			if (*symbols_add == NULL){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - symbols file");
+				exit(1);
+			}
 		}
+
+		strcpy((*symbols_add)[*count_add].name, label);
+		(*symbols_add)[(*count_add)++].address = address;
 	}
 
+	fclose(src);
+
 }
 
 
@@ -528,7 +656,7 @@ void print_entry_labels_to_stream(FILE *des, symbol_table_node *root){
 	print_entry_labels_to_stream(des, root -> right);
 	
 	if (root -> type == enum_ent)
-		fprintf(des, "%s\t%d\n", root -> label, root -> label_value.value + MEMORY_ASSUMPTION);
+		fprintf(des, "%s\t%d\n", root -> label, root -> value + MEMORY_ASSUMPTION);
 		
 }
 
@@ -552,33 +680,227 @@ int is_there_entry(symbol_table_node *root){
 
 
 /*
- *	Checks if there are used external labels in the symbol table or its sub-trees.
+ *	Logs the memory words of a source line in the line map.
  *   
- *	param root - Pointer to the root of the symbol table or its sub-tree
- *	returns - 1 if used external labels are found, 0 otherwise
+ *	param line_map - Pointer to the line map
+ *	param line - The line in the .am file
+ *	param address - Offset of the first word in the code image or in the data image
+ *	param length - Number of words
+ *	param is_data - 1 if the words are in the data image
  */
-int is_there_used_extern(symbol_table_node *root){
+void insert_line_map(line_map_vector *line_map, int line, int address, int length, int is_data){
+
+	line_map_entry *entry;
+
+	if (line_map -> count == line_map -> size){ /* if the map is full */
 	
-	if (root == NULL)
-		return 0;
+		line_map -> size = line_map -> size ? line_map -> size * 2 : LINE_MAP_INIT_SIZE;
+		line_map -> entries = (line_map_entry *)counted_realloc(line_map -> entries, sizeof(line_map_entry) * line_map -> size);
 		
-	/* if it is external label and is used in the code by instruction */
-	if (root -> type == enum_extl && root -> label_value.label_extern_value.extern_values[0] != NO_VALUE)
-		return 1;
+		if (line_map -> entries == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - line map");
+        	exit(1);
+		}
+	}
+	
+	entry = &(line_map -> entries[(line_map -> count)++]);
+	entry -> line = line;
+	entry -> address = address;
+	entry -> length = length;
+	entry -> is_data = is_data;
+
+}
+
+
+/*
+ *	Frees the memory used by the line map and resets it.
+ *   
+ *	param line_map - Pointer to the line map
+ */
+void free_line_map(line_map_vector *line_map){
+
+	free(line_map -> entries);
+	line_map -> entries = NULL;
+	line_map -> count = 0;
+	line_map -> size = 0;
+
+}
+
+
+/*
+ *	Collects the defined labels (not the external ones) and their addresses.
+ *   
+ *	param root - Pointer to the root of the symbol table
+ *	param labels - The array to fill (NULL to count the labels only)
+ *	param cnt - Number of labels that were already collected
+ *	returns the number of collected labels.
+ */
+int collect_map_labels(symbol_table_node *root, map_label *labels, int cnt){
+
+	if (root == NULL)
+		return cnt;
+	
+	cnt = collect_map_labels(root -> left, labels, cnt);
+	
+	if (root -> comm != enum_comm_none && root -> type != enum_extl){
+		if (labels != NULL){
+			strcpy(labels[cnt].name, root -> label);
+			labels[cnt].address = root -> value + MEMORY_ASSUMPTION;
+		}
+		cnt++;
+	}
+	
+	return collect_map_labels(root -> right, labels, cnt);
+
+}
+
+
+/*
+ *	Exports the labels, the memory words of every source line and the .as origin of every .am line
+ *	to a binary .map file (see mapfile.h).
+ *   
+ *	param file_name - The base name of the output file
+ *	param root - Pointer to the root of the symbol table
+ *	param line_map - Pointer to the line map
+ *	param origins - Pointer to the origins of the .am lines
+ *	param ic - The instructions counter (the data image starts after the code image)
+ */
+void export_line_map(char *file_name, symbol_table_node *root, line_map_vector *line_map, map_origin_vector *origins, int ic){
+
+	map_file map;
+	line_map_entry *entry;
+	int i, is_data;
+
+	strcpy(map.name, file_name);
+	
+	map.labels_num = collect_map_labels(root, NULL, 0);
+	map.ranges_num = line_map -> count;
+	map.labels = (map_label *)counted_malloc(sizeof(map_label) * (map.labels_num + 1));
+	map.ranges = (map_range *)counted_malloc(sizeof(map_range) * (map.ranges_num + 1));
+	
+	if (map.labels == NULL || map.ranges == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - line map");
+        exit(1);
+	}
+	
+	collect_map_labels(root, map.labels, 0);
+	qsort(map.labels, map.labels_num, sizeof(map_label), compare_map_labels);
+	
+	/* the code lines and then the data lines, so the ranges are sorted by address */
+	for (is_data = 0, map.ranges_num = 0; is_data <= 1; is_data++){
+		for (i = 0; i < line_map -> count; i++){
+			entry = &(line_map -> entries[i]);
+			if (entry -> is_data == is_data){
+				map.ranges[map.ranges_num].address = entry -> address + MEMORY_ASSUMPTION + (is_data ? ic : 0);
+				map.ranges[map.ranges_num].length = entry -> length;
+				map.ranges[map.ranges_num++].line = entry -> line;
+			}
+		}
+	}
+	
+	map.origins = origins -> origins;
+	map.origins_num = origins -> count;
+	
+	write_map_file(file_name, &map);
+	
+	free(map.labels);
+	free(map.ranges);
+
+}
+
+
+/*
+ *	Compares labels by address (the sort order of the .map file labels).
+ */
+int compare_map_labels(const void *a, const void *b){
+
+	return ((const map_label *)a) -> address - ((const map_label *)b) -> address;
+
+}
+
+
+/*
+ *	Collects the entry labels and their addresses in post order (the order of the .ent file).
+ *   
+ *	param root - Pointer to the root of the symbol table
+ *	param labels - The array to fill (NULL to count the labels only)
+ *	param cnt - Number of labels that were already collected
+ *	returns the number of collected labels.
+ */
+int collect_entry_labels(symbol_table_node *root, map_label *labels, int cnt){
+
+	if (root == NULL)
+		return cnt;
 	
-	return is_there_used_extern(root -> left) || is_there_used_extern(root -> right);
+	cnt = collect_entry_labels(root -> left, labels, cnt);
+	cnt = collect_entry_labels(root -> right, labels, cnt);
 	
+	if (root -> type == enum_ent){
+		if (labels != NULL){
+			strcpy(labels[cnt].name, root -> label);
+			labels[cnt].address = root -> value + MEMORY_ASSUMPTION;
+		}
+		cnt++;
+	}
+	
+	return cnt;
+
 }
 
 
+/*
+ *	Exports the memory words, the entry labels and the external references to a binary .obb file
+ *	(see obb.h). The symbols are in the order of the .ent and the .ext files.
+ *   
+ *	param file_name - The base name of the output file
+ *	param words - The code words and then the data words
+ *	param ic - Number of code words
+ *	param dc - Number of data words
+ *	param root - Pointer to the root of the symbol table
+ *	param ext_refs - Pointer to the external references log
+ */
+void export_obb(char *file_name, unsigned short *words, int ic, int dc, symbol_table_node *root, extern_ref_vector *ext_refs){
+
+	map_label *entries, *externs;
+	int i, entries_num;
+	
+	entries_num = collect_entry_labels(root, NULL, 0);
+	entries = (map_label *)counted_malloc(sizeof(map_label) * (entries_num + 1));
+	externs = (map_label *)counted_malloc(sizeof(map_label) * (ext_refs -> count + 1));
+	
+	if (entries == NULL || externs == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - obb symbols");
+        exit(1);
+	}
+	
+	collect_entry_labels(root, entries, 0);
+	
+	if (ext_refs -> count > 0){ /* the order of the .ext file */
+		number_labels_post_order(root, 0);
+		qsort(ext_refs -> refs, ext_refs -> count, sizeof(extern_ref), compare_extern_refs);
+	}
+	
+	for (i = 0; i < ext_refs -> count; i++){
+		strcpy(externs[i].name, ext_refs -> refs[i].label -> label);
+		externs[i].address = ext_refs -> refs[i].address + MEMORY_ASSUMPTION;
+	}
+	
+	write_obb_file(file_name, words, ic, dc, entries, entries_num, externs, ext_refs -> count);
+	
+	free(entries);
+	free(externs);
+
+}
+
 
 /*
  *	Exports declared entry and (used) external labels to .ent and .ext files.
  *   
  *	param file_name - The base name of the output files
  *	param root - Pointer to the root of the symbol table
+ *	param ext_refs - Pointer to the external references log
  */
-void export_entry_and_extern_labels(char *file_name, symbol_table_node *root){
+void export_entry_and_extern_labels(char *file_name, symbol_table_node *root, extern_ref_vector *ext_refs){
 		
 	FILE *ent_des, *ext_des;
 	char temp_name[MAX_BUFFER];	
@@ -596,7 +918,7 @@ void export_entry_and_extern_labels(char *file_name, symbol_table_node *root){
 		fclose(ent_des);
 	}
 	
-	if (is_there_used_extern(root)){ /* if there are used external labels in the table */
+	if (ext_refs -> count > 0){ /* if there are used external labels in the table */
 	
 		sprintf(temp_name, "%s.ext", file_name);
 		if (!(ext_des = fopen(temp_name, "w"))){
@@ -605,7 +927,7 @@ void export_entry_and_extern_labels(char *file_name, symbol_table_node *root){
 			return;
 		
 		}
-		print_extern_labels_to_stream(ext_des, root); /* writes in .ext file the external lables */
+		print_extern_labels_to_stream(ext_des, root, ext_refs); /* writes in .ext file the external lables */
 		fclose(ext_des);
 	}
 
@@ -613,6 +935,33 @@ void export_entry_and_extern_labels(char *file_name, symbol_table_node *root){
 
 
 
+/*
+ *	Gets the shape of the symbol table (used by --stats).
+ *   
+ *	param root - Pointer to the root of the symbol table
+ *	param depth - The depth of root (the depth of the tree root is 1)
+ *	param cnt_add - Pointer to the labels counter
+ *	param max_depth_add - Pointer to the maximum depth
+ *	param depth_sum_add - Pointer to the sum of the labels depths
+ */
+void get_symbol_table_shape(symbol_table_node *root, int depth, int *cnt_add, int *max_depth_add,
+							long *depth_sum_add){
+
+	if (root == NULL)
+		return;
+
+	(*cnt_add)++;
+	*depth_sum_add += depth;
+	if (depth > *max_depth_add)
+		*max_depth_add = depth;
+
+	get_symbol_table_shape(root -> left, depth + 1, cnt_add, max_depth_add, depth_sum_add);
+	get_symbol_table_shape(root -> right, depth + 1, cnt_add, max_depth_add, depth_sum_add);
+
+}
+
+
+
 /*
  *	Frees the memory used by the symbol table.
  *   
@@ -0,0 +1,256 @@
+/*
+ *	File: deps.c
+ *
+ *	This file implements the dependency scanning of the assembler (-M and -MD options). The scan reads
+ *	the lines of the .as file and of its included files, and parses only the .include statements and the
+ *	lines that may be an .incbin directive, so it is much cheaper than the pre assembler and runs on
+ *	thousands of sources. The cache uses the same scan to add the content of the inputs to the key of a
+ *	source.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "deps.h"
+#include "macro_list.h"
+#include "macro_dict.h"
+#include "ast.h"
+
+/* exclusive functions prototype */
+int get_incbin_path(char *, char *, char *);
+void scan_included_file(char *, char *, deps_list *);
+void add_dependency(deps_list *, char *);
+void print_make_name(FILE *, char *);
+
+
+
+/*
+ *	Collects the inputs of a source file: the included files and the incbin files of the source lines
+ *	and of the macros of the included files (an expanded macro is a part of the source, so the name of
+ *	its incbin file is relative to the directory of the source).
+ *
+ *	param src_name - The name of the source file.
+ *	param deps - Pointer to an empty list to fill (the caller frees it by free_dependencies).
+ *	returns 1 if the source was scanned, 0 if it cannot be read.
+ */
+int collect_dependencies(char *src_name, deps_list *deps){
+
+	FILE *src;
+	char line[MAX_BUFFER], path[MAX_BUFFER];
+
+	if (!(src = fopen(src_name, "r")))
+		return 0;
+
+	while (fgets(line, MAX_BUFFER, src) != NULL){
+
+		if (get_include_path(line, src_name, path) == 1){
+			add_dependency(deps, path);
+			scan_included_file(path, src_name, deps);
+		}
+		else if (get_incbin_path(line, src_name, path))
+			add_dependency(deps, path);
+	}
+
+	fclose(src);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Frees the memory used by an inputs list and resets it.
+ *
+ *	param deps - Pointer to the list.
+ */
+void free_dependencies(deps_list *deps){
+
+	free(deps -> paths);
+	deps -> paths = NULL;
+	deps -> count = 0;
+	deps -> size = 0;
+
+}
+
+
+
+/*
+ *	Finds the file that a line refers to if it is an incbin directive.
+ *
+ *	param line - The line.
+ *	param src_name - The name of the source file (the names are relative to its directory).
+ *	param path - Buffer of MAX_BUFFER characters to store the path of the file.
+ *	returns 1 if the line is an incbin directive, 0 otherwise.
+ */
+int get_incbin_path(char *line, char *src_name, char *path){
+
+	ast line_ast;
+
+	/* only the lines that may be an incbin directive are parsed */
+	return strstr(line, ".incbin") != NULL && check_length(line) &&
+		   (line_ast = get_ast(line)).ast_union_option == ast_union_dir &&
+		   line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_incbin &&
+		   get_relative_path(src_name, line_ast.ast_union_ins_dir.ast_dir.dir.incbin.file,
+							 strlen(line_ast.ast_union_ins_dir.ast_dir.dir.incbin.file), path);
+
+}
+
+
+
+/*
+ *	Adds the incbin files of the macros of an included file to the inputs of a source (a missing
+ *	included file fails the assembly anyway, so it adds nothing).
+ *
+ *	param path - The included file.
+ *	param src_name - The name of the source file that includes it.
+ *	param deps - Pointer to the inputs of the source.
+ */
+void scan_included_file(char *path, char *src_name, deps_list *deps){
+
+	FILE *src;
+	char line[MAX_BUFFER], incbin_path[MAX_BUFFER];
+
+	if (!(src = fopen(path, "r")))
+		return;
+
+	while (fgets(line, MAX_BUFFER, src) != NULL)
+		if (get_incbin_path(line, src_name, incbin_path))
+			add_dependency(deps, incbin_path);
+
+	fclose(src);
+
+}
+
+
+
+/*
+ *	Adds an input to a list (an input that is already in the list is not added again).
+ *
+ *	param deps - Pointer to the list.
+ *	param path - The path of the input.
+ */
+void add_dependency(deps_list *deps, char *path){
+
+	int i;
+
+	for (i = 0; i < deps -> count; i++)
+		if (strcmp(deps -> paths[i], path) == 0)
+			return;
+
+	if (deps -> count == deps -> size){
+
+		deps -> size = deps -> size ? deps -> size * 2 : FIRST_DEPS_SIZE;
+
+		if (!(deps -> paths = counted_realloc(deps -> paths, deps -> size * sizeof(*(deps -> paths))))){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - dependencies");
+			exit(1);
+		}
+	}
+
+	strcpy(deps -> paths[(deps -> count)++], path);
+
+}
+
+
+
+/*
+ *	Prints the make rule of a source file (-M option).
+ *
+ *	param file_name - The name of the source file without extension.
+ *	param des - The stream of the rule.
+ *	returns 1 if the source was scanned, 0 if it cannot be read.
+ */
+int print_dependencies(char *file_name, FILE *des){
+
+	char src_name[MAX_BUFFER];
+	deps_list deps = {NULL, 0, 0};
+	int i;
+
+	sprintf(src_name, "%s.as", file_name);
+
+	if (!collect_dependencies(src_name, &deps)){
+
+		errprintf(src_name, NO_LINE_ERROR, "cannot open file - dependencies");
+		return 0;
+	}
+
+	/* the rule of the .ob file */
+	print_make_name(des, file_name);
+	fprintf(des, ".ob: ");
+	print_make_name(des, src_name);
+
+	for (i = 0; i < deps.count; i++){
+		fprintf(des, " \\\n  ");
+		print_make_name(des, deps.paths[i]);
+	}
+
+	fprintf(des, "\n");
+
+	/* the empty rules of the inputs */
+	for (i = 0; i < deps.count; i++){
+		fprintf(des, "\n");
+		print_make_name(des, deps.paths[i]);
+		fprintf(des, ":\n");
+	}
+
+	free_dependencies(&deps);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Writes the make rule of a source file to <file_name>.d (-MD option).
+ *
+ *	param file_name - The name of the source file without extension.
+ *	returns 1 if the file was written, 0 otherwise.
+ */
+int export_dependencies(char *file_name){
+
+	FILE *des;
+	char des_name[MAX_BUFFER];
+	int is_valid;
+
+	sprintf(des_name, "%s" DEPS_EXT, file_name);
+
+	if (!(des = fopen(des_name, "w"))){
+
+		errprintf(des_name, NO_LINE_ERROR, "cannot open file");
+		return 0;
+	}
+
+	is_valid = print_dependencies(file_name, des);
+
+	fclose(des);
+
+	if (!is_valid)
+		remove(des_name); /* the source cannot be read - there is no rule */
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Prints a file name in a make rule (a space, a '#' and a '$' are escaped).
+ *
+ *	param des - The stream of the rule.
+ *	param name - The file name.
+ */
+void print_make_name(FILE *des, char *name){
+
+	for (; *name; name++){
+
+		if (*name == ' ' || *name == '#')
+			putc('\\', des);
+		else if (*name == '$')
+			putc('$', des);
+
+		putc(*name, des);
+	}
+
+}
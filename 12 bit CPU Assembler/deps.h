@@ -0,0 +1,32 @@
+/*
+ *	File: deps.h
+ *
+ *	Defines the function prototypes of the dependency scanning (assembler -M and -MD options).
+ *	The inputs of a source are the .as file, the files of its .include statements and the files of its
+ *	.incbin directives (in its lines or in the macros of its included files). They are found by a line
+ *	scan of the .as file and of the included files (nothing is assembled), and the same list is the
+ *	inputs part of the cache key. It is written as a make rule of the .ob file:
+ *		<file>.ob: <file>.as <input> <input> ...
+ *		<input>:
+ *	the empty rule of every other input keeps make working after the input is deleted.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+#define DEPS_EXT ".d" /* the extension of the dependency file (-MD option) */
+#define FIRST_DEPS_SIZE 8 /* initial number of inputs of a source (doubled when full) */
+
+typedef struct { /* the inputs of a source (an input that is referred again is kept once) */
+	char (*paths)[MAX_BUFFER];
+	int count;
+	int size; /* number of allocated cells */
+} deps_list;
+
+/* functions prototype */
+int collect_dependencies(char *, deps_list *);
+void free_dependencies(deps_list *);
+int print_dependencies(char *, FILE *);
+int export_dependencies(char *);
@@ -0,0 +1,568 @@
+/*
+ *	File: diag.c
+ *
+ *	This file implements the diagnostics engine. A message is formatted once into a record, and the
+ *	record is printed through a buffer with one write instead of a write for every part of it.
+ *	Until the assembler starts the engine a record is printed at once (the linker reports from its
+ *	threads, so this path keeps its buffer on the stack). When the engine is started, the records of a
+ *	file are kept in a buffer, and a record that has the same file, severity and message as a former one
+ *	shares its text and increases the counter of the first one (generated sources repeat the same error
+ *	on thousands of lines). flush_diags prints the records in bulk - errors to stderr and warnings to the
+ *	warnings stream as text (a line for every record), or all of them to stderr as JSON lines (a line for
+ *	every message with its counter). The records of a file can be exported to a file and replayed (the
+ *	cache keeps the warnings of a valid assembly with its outputs).
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for vsnprintf in ansi mode */
+
+#include "diag.h"
+
+/* macro definitions */
+#define ANSI_COLOR_RED     "\x1b[31m" /* ANSI escape code for red text color */
+#define ANSI_COLOR_PURPLE  "\x1b[35m" /* ANSI escape code for purple text color */
+#define ANSI_BOLD          "\x1b[1m" /* ANSI escape code for bold text style */
+#define ANSI_STYLE_RESET   "\x1b[0m" /* ANSI escape code to reset text style and color */
+#define NO_RECORD -1
+#define SAME_FILE_MARK '*' /* an exported file name that starts with the name of the source file (see export_diags) */
+#define LIMIT_NOTE "too many errors (%d, --max-errors %d) - the rest of the file was not checked"
+
+static int is_buffered = 0; /* 1 after start_diags */
+static enum diag_format diag_fmt = diag_text;
+static int max_errors = 0; /* the assembly of a file stops after this number of errors (0 for no limit) */
+static int errors_cnt = 0; /* number of errors of the buffered records (with the repeats and the dropped ones) */
+static long reports_cnt = 0; /* number of reported diagnostics (errors and warnings) since the program started */
+static diag_record *records = NULL;
+static int records_cnt = 0, records_size = 0;
+static char *text = NULL; /* the file names and the messages of the records */
+static long text_len = 0, text_size = 0;
+static long last_file = NO_RECORD; /* offset of the file name of the last record */
+static int table[DIAG_TABLE_SIZE]; /* the first record of every bucket */
+static FILE *warn_des = NULL; /* the stream of the warnings (NULL for stdout) */
+static diag_out err_out, warn_out; /* the buffers of flush_diags */
+
+/* exclusive functions prototype */
+void buffer_diag(const char *, int, enum diag_severity, unsigned int, char *);
+long add_diag_text(const char *);
+void print_diag_text(diag_out *, const char *, int, enum diag_severity, const char *);
+void print_diag_json(diag_out *, const char *, int, enum diag_severity, unsigned int, const char *, int, int);
+void put_diag_out(diag_out *, const char *);
+void put_diag_json_string(diag_out *, const char *);
+void flush_diag_out(diag_out *);
+
+
+
+/*
+ *	Reports a diagnostic (called by errprintf and warnprintf).
+ *
+ *	param file_name - The name of the source file, or NO_FILE_ERROR
+ *	param line - The line number, or NO_LINE_ERROR
+ *	param severity - diag_error or diag_warning
+ *	param format - The message format string (its hash is the code of the message, and a constant message
+ *				   that is passed as "%s" is coded by its text)
+ *	param args - The arguments of the format
+ */
+void report_diag(const char *file_name, int line, enum diag_severity severity, const char *format, va_list args){
+
+	char message[DIAG_MESSAGE_SIZE];
+	unsigned int code;
+	diag_out out;
+
+	reports_cnt++;
+	vsnprintf(message, DIAG_MESSAGE_SIZE, format, args);
+	code = (unsigned int)(hash_string(FNV_OFFSET, strcmp(format, "%s") == 0 ? message : format) & DIAG_CODE_MASK);
+
+	if (is_buffered){
+		buffer_diag(file_name, line, severity, code, message);
+		return;
+	}
+
+	/* prints the record at once */
+	out.des = severity == diag_error ? stderr : (warn_des != NULL ? warn_des : stdout);
+	out.len = 0;
+	print_diag_text(&out, file_name, line, severity, message);
+	flush_diag_out(&out);
+
+}
+
+
+
+/*
+ *	Adds a record to the buffer (a repeat of a former message shares its text and is counted by the first
+ *	record of the message).
+ *
+ *	param file_name - The name of the source file, or NO_FILE_ERROR
+ *	param line - The line number, or NO_LINE_ERROR
+ *	param severity - diag_error or diag_warning
+ *	param code - The code of the message
+ *	param message - The formatted message
+ */
+void buffer_diag(const char *file_name, int line, enum diag_severity severity, unsigned int code, char *message){
+
+	unsigned long hash;
+	int i, first = NO_RECORD;
+	diag_record *record;
+
+	if (severity == diag_error && max_errors > 0 && ++errors_cnt > max_errors)
+		return; /* the file is already stopped - the error is only counted */
+
+	hash = hash_string(hash_string(FNV_OFFSET + severity, file_name), message);
+
+	for (i = table[hash & (DIAG_TABLE_SIZE - 1)]; i != NO_RECORD && first == NO_RECORD; i = records[i].next){
+
+		record = &records[i];
+
+		if (record -> hash == hash && record -> severity == severity &&
+			strcmp(text + record -> file, file_name) == 0 && strcmp(text + record -> message, message) == 0)
+			first = i;
+	}
+
+	if (records_cnt == records_size){
+
+		records_size = records_size ? records_size * 2 : DIAG_TABLE_SIZE;
+
+		if (!(records = (diag_record *)counted_realloc(records, records_size * sizeof(diag_record)))){
+			is_buffered = 0; /* prints the error at once */
+			records_cnt = 0;
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - diagnostics");
+			exit(1);
+		}
+	}
+
+	record = &records[records_cnt];
+
+	/* a repeat of a message - shares the text of the first record and is counted by it */
+	if (first != NO_RECORD){
+
+		records[first].repeats++;
+		records[first].last_line = line;
+
+		*record = records[first];
+		record -> line = record -> last_line = line;
+		record -> repeats = 0;
+		record -> first = first;
+		record -> next = NO_RECORD;
+		records_cnt++;
+		return;
+	}
+
+	/* the records of a file have the same file name - it is kept once */
+	if (last_file == NO_RECORD || strcmp(text + last_file, file_name) != 0)
+		last_file = add_diag_text(file_name);
+
+	record -> file = last_file;
+	record -> message = add_diag_text(message);
+	record -> line = record -> last_line = line;
+	record -> repeats = 0;
+	record -> code = code;
+	record -> hash = hash;
+	record -> severity = severity;
+	record -> first = records_cnt;
+	record -> next = table[hash & (DIAG_TABLE_SIZE - 1)];
+	table[hash & (DIAG_TABLE_SIZE - 1)] = records_cnt++;
+
+}
+
+
+
+/*
+ *	Adds a string to the text buffer of the records.
+ *
+ *	param str - The string
+ *	returns - The offset of the string in the text buffer
+ */
+long add_diag_text(const char *str){
+
+	long len = strlen(str) + 1, offset = text_len;
+
+	if (text_len + len > text_size){
+
+		while (text_len + len > text_size)
+			text_size = text_size ? text_size * 2 : DIAG_OUT_SIZE;
+
+		if (!(text = (char *)counted_realloc(text, text_size))){
+			is_buffered = 0; /* prints the error at once */
+			records_cnt = 0;
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - diagnostics");
+			exit(1);
+		}
+	}
+
+	memcpy(text + text_len, str, len);
+	text_len += len;
+
+	return offset;
+
+}
+
+
+
+/*
+ *	Starts buffering the diagnostics, or changes the options of the engine (the former records are
+ *	printed first). The records are printed at the exit of the program too.
+ *
+ *	param format - diag_text or diag_json (--diag-json option)
+ *	param errors - The maximum number of errors of a file (--max-errors option), 0 for no limit
+ */
+void start_diags(enum diag_format format, int errors){
+
+	int i;
+
+	if (!is_buffered){
+
+		for (i = 0; i < DIAG_TABLE_SIZE; i++)
+			table[i] = NO_RECORD;
+
+		is_buffered = 1;
+		atexit(flush_diags);
+	}
+	else
+		flush_diags();
+
+	diag_fmt = format;
+	max_errors = errors;
+
+}
+
+
+
+/*
+ *	Prints the buffered records in bulk and empties the buffer (called at the end of every file).
+ */
+void flush_diags(void){
+
+	int i;
+	char note[MAX_BUFFER];
+	diag_record *record;
+	diag_out *out;
+
+	err_out.des = stderr;
+	warn_out.des = diag_fmt == diag_json ? stderr : (warn_des != NULL ? warn_des : stdout);
+	err_out.len = warn_out.len = 0;
+
+	for (i = 0; i < records_cnt; i++){
+
+		record = &records[i];
+
+		/* the records of the same stream keep their order */
+		out = record -> severity == diag_error || warn_out.des == err_out.des ? &err_out : &warn_out;
+
+		/* a JSON line for every message (with its repeats), a text line for every record */
+		if (diag_fmt == diag_json){
+			if (record -> first == i)
+				print_diag_json(out, text + record -> file, record -> line, record -> severity, record -> code,
+								text + record -> message, record -> repeats, record -> last_line);
+		}
+		else
+			print_diag_text(out, text + record -> file, record -> line, record -> severity,
+							text + record -> message);
+	}
+
+	/* notes that the file was stopped */
+	if (is_diag_limit_reached() && records_cnt > 0){
+
+		sprintf(note, LIMIT_NOTE, errors_cnt, max_errors);
+
+		if (diag_fmt == diag_json)
+			print_diag_json(&err_out, text + last_file, NO_LINE_ERROR, diag_error,
+							(unsigned int)(hash_string(FNV_OFFSET, LIMIT_NOTE) & DIAG_CODE_MASK), note, 0, NO_LINE_ERROR);
+		else
+			print_diag_text(&err_out, text + last_file, NO_LINE_ERROR, diag_error, note);
+	}
+
+	flush_diag_out(&warn_out);
+	flush_diag_out(&err_out);
+
+	/* empties the buffer */
+	for (i = 0; i < records_cnt; i++)
+		table[records[i].hash & (DIAG_TABLE_SIZE - 1)] = NO_RECORD;
+
+	records_cnt = 0;
+	text_len = 0;
+	last_file = NO_RECORD;
+	errors_cnt = 0;
+
+}
+
+
+
+/*
+ *	Exports the buffered records of the current file, a line for every record - the severity, the line,
+ *	the code, the file name and the message (separated by tabs). A file name that starts with the name
+ *	of the source file keeps only the rest of it after SAME_FILE_MARK, so a source of the same contents
+ *	and another name replays the records with its own name.
+ *
+ *	param path - The file to write
+ *	param base_name - The name of the source file without extension
+ *	returns - 1 if the file was written, 0 if there are no records or the file cannot be written
+ */
+int export_diags(const char *path, const char *base_name){
+
+	FILE *des;
+	const char *file_name;
+	int i, len = strlen(base_name);
+
+	if (records_cnt == 0 || !(des = fopen(path, "w")))
+		return 0;
+
+	for (i = 0; i < records_cnt; i++){
+
+		file_name = text + records[i].file;
+
+		fprintf(des, "%d\t%d\t%u\t", records[i].severity, records[i].line, records[i].code);
+		if (strncmp(file_name, base_name, len) == 0)
+			fprintf(des, "%c%s\t%s\n", SAME_FILE_MARK, file_name + len, text + records[i].message);
+		else
+			fprintf(des, "%s\t%s\n", file_name, text + records[i].message);
+	}
+
+	fclose(des);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Reports the records of a file that export_diags wrote (with their codes), as if they were reported
+ *	by the phases.
+ *
+ *	param path - The exported records
+ *	param base_name - The name of the source file without extension
+ */
+void replay_diags(const char *path, const char *base_name){
+
+	FILE *src;
+	char line[DIAG_MESSAGE_SIZE + MAX_BUFFER], file_name[MAX_BUFFER], *ptr, *message;
+	int severity, line_num, len;
+	unsigned int code;
+	diag_out out;
+
+	if (!(src = fopen(path, "r")))
+		return;
+
+	while (fgets(line, sizeof(line), src) != NULL){
+
+		if (sscanf(line, "%d\t%d\t%u\t%n", &severity, &line_num, &code, &len) != 3 ||
+			(ptr = strchr(line + len, '\t')) == NULL)
+			continue;
+
+		*ptr = '\0';
+		message = ptr + 1;
+		message[strcspn(message, "\n")] = '\0';
+
+		if (line[len] == SAME_FILE_MARK)
+			sprintf(file_name, "%s%.*s", base_name, MAX_BUFFER - (int)strlen(base_name) - 1, line + len + 1);
+		else
+			sprintf(file_name, "%.*s", MAX_BUFFER - 1, line + len);
+
+		reports_cnt++;
+
+		if (is_buffered)
+			buffer_diag(file_name, line_num, (enum diag_severity)severity, code, message);
+		else {
+			out.des = severity == diag_error ? stderr : (warn_des != NULL ? warn_des : stdout);
+			out.len = 0;
+			print_diag_text(&out, file_name, line_num, (enum diag_severity)severity, message);
+			flush_diag_out(&out);
+		}
+	}
+
+	fclose(src);
+
+}
+
+
+
+/*
+ *	Checks if the current file reached the maximum number of errors (--max-errors option). The phases
+ *	stop reading lines when it did.
+ *
+ *	returns - 1 if the file reached the maximum number of errors, 0 otherwise
+ */
+int is_diag_limit_reached(void){
+
+	return max_errors > 0 && errors_cnt >= max_errors;
+
+}
+
+
+
+/*
+ *	Gets the number of diagnostics that were reported since the program started (a phase that reported
+ *	nothing leaves it unchanged).
+ *
+ *	returns - The number of reported errors and warnings
+ */
+long get_diags_count(void){
+
+	return reports_cnt;
+
+}
+
+
+
+/*
+ *	Sets the stream of the warning messages (when the standard output holds the results).
+ *
+ *	param des - The stream of the warnings (NULL for stdout).
+ */
+void set_warnings_stream(FILE *des){
+
+	if (is_buffered)
+		flush_diags();
+
+	warn_des = des;
+
+}
+
+
+
+/*
+ *	Prints a record as text.
+ *
+ *	param out - The output buffer
+ *	param file_name - The name of the source file, or NO_FILE_ERROR
+ *	param line - The line number, or NO_LINE_ERROR
+ *	param severity - diag_error or diag_warning
+ *	param message - The message
+ */
+void print_diag_text(diag_out *out, const char *file_name, int line, enum diag_severity severity,
+					 const char *message){
+
+	char num[MAX_LINE];
+
+	if (strcmp(NO_FILE_ERROR, file_name)){
+		put_diag_out(out, "File " ANSI_BOLD "'");
+		put_diag_out(out, file_name);
+		put_diag_out(out, "': " ANSI_STYLE_RESET);
+	}
+
+	if (line != NO_LINE_ERROR){
+		sprintf(num, "Line %d: ", line);
+		put_diag_out(out, num);
+	}
+
+	put_diag_out(out, severity == diag_error ? ANSI_BOLD ANSI_COLOR_RED "Error: " ANSI_STYLE_RESET :
+											   ANSI_BOLD ANSI_COLOR_PURPLE "Warning: " ANSI_STYLE_RESET);
+	put_diag_out(out, message);
+	put_diag_out(out, "\n");
+
+}
+
+
+
+/*
+ *	Prints a record as a JSON object in one line.
+ *
+ *	param out - The output buffer
+ *	param file_name - The name of the source file, or NO_FILE_ERROR
+ *	param line - The line number, or NO_LINE_ERROR
+ *	param severity - diag_error or diag_warning
+ *	param code - The code of the message
+ *	param message - The message
+ *	param repeats - Number of repeats of the message after the first one
+ *	param last_line - The last line that repeated the message
+ */
+void print_diag_json(diag_out *out, const char *file_name, int line, enum diag_severity severity,
+					 unsigned int code, const char *message, int repeats, int last_line){
+
+	char num[MAX_LINE];
+
+	put_diag_out(out, "{\"file\":");
+	if (strcmp(NO_FILE_ERROR, file_name))
+		put_diag_json_string(out, file_name);
+	else
+		put_diag_out(out, "null");
+
+	/* a diagnostic of the whole file has no line */
+	if (line != NO_LINE_ERROR)
+		sprintf(num, ",\"line\":%d", line);
+	else
+		strcpy(num, ",\"line\":null");
+	put_diag_out(out, num);
+
+	sprintf(num, ",\"severity\":\"%s\",\"code\":\"%c%04X\",\"message\":", severity == diag_error ? "error" : "warning",
+			severity == diag_error ? 'E' : 'W', code);
+	put_diag_out(out, num);
+	put_diag_json_string(out, message);
+
+	if (last_line != NO_LINE_ERROR)
+		sprintf(num, ",\"repeats\":%d,\"last_line\":%d}\n", repeats, last_line);
+	else
+		sprintf(num, ",\"repeats\":%d,\"last_line\":null}\n", repeats);
+	put_diag_out(out, num);
+
+}
+
+
+
+/*
+ *	Adds a string to an output buffer (the buffer is written when it is full).
+ *
+ *	param out - The output buffer
+ *	param str - The string
+ */
+void put_diag_out(diag_out *out, const char *str){
+
+	for (; *str; str++){
+
+		if (out -> len == DIAG_OUT_SIZE)
+			flush_diag_out(out);
+
+		out -> data[out -> len++] = *str;
+	}
+
+}
+
+
+
+/*
+ *	Adds a string to an output buffer as a JSON string.
+ *
+ *	param out - The output buffer
+ *	param str - The string
+ */
+void put_diag_json_string(diag_out *out, const char *str){
+
+	char esc[MAX_LABEL_SIZE];
+
+	put_diag_out(out, "\"");
+
+	for (; *str; str++){
+
+		if (*str == '"' || *str == '\\')
+			sprintf(esc, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			sprintf(esc, "\\u%04x", (unsigned char)*str);
+		else {
+			esc[0] = *str;
+			esc[1] = '\0';
+		}
+
+		put_diag_out(out, esc);
+	}
+
+	put_diag_out(out, "\"");
+
+}
+
+
+
+/*
+ *	Writes an output buffer to its stream.
+ *
+ *	param out - The output buffer
+ */
+void flush_diag_out(diag_out *out){
+
+	if (out -> len > 0){
+		fwrite(out -> data, sizeof(char), out -> len, out -> des);
+		fflush(out -> des);
+		out -> len = 0;
+	}
+
+}
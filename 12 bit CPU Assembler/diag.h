@@ -0,0 +1,55 @@
+/*
+ *	File: diag.h
+ *
+ *	Defines the function prototypes of the diagnostics engine. errprintf and warnprintf report a record
+ *	(file, line, severity, code and message) to the engine. The programs print every record at once with
+ *	one write, and the assembler starts the engine, so the records of a file are kept in a buffer (a
+ *	message that repeats in the file keeps its text once) and flush_diags prints them in bulk as text, a
+ *	line for every record, or as JSON lines (--diag-json option), a line for every message with the number
+ *	of its repeats. After --max-errors errors the assembly of the file stops.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include <stdarg.h>
+#include "funcs_and_macs.h"
+
+#define DIAG_TABLE_SIZE 4096 /* number of buckets of the repeated messages table (a power of 2) */
+#define DIAG_MESSAGE_SIZE (2 * MAX_BUFFER) /* maximum length of a formatted message (longer ones are cut) */
+#define DIAG_OUT_SIZE 8192 /* size of the buffer that the records are printed through */
+#define DIAG_CODE_MASK 0xFFFF /* the code of a message is the hash of its format (16 bits) */
+#define MAX_ERRORS_LIMIT 1000000 /* the largest value of the --max-errors option */
+
+enum diag_severity {diag_error, diag_warning};
+
+enum diag_format {diag_text, diag_json};
+
+typedef struct { /* a buffered record */
+	long file; /* offset of the file name in the text buffer */
+	long message; /* offset of the message in the text buffer */
+	int line; /* the line of the record */
+	int last_line; /* the last line that repeated the message (in the first record of the message) */
+	int repeats; /* number of repeats after the first record (in the first record of the message) */
+	unsigned int code;
+	unsigned long hash; /* the hash of the file, the severity and the message */
+	enum diag_severity severity;
+	int first; /* the index of the first record of the message */
+	int next; /* the next record of the bucket (-1 for none, only the first records are in the buckets) */
+} diag_record;
+
+typedef struct { /* a buffer that the records are printed through */
+	FILE *des;
+	int len;
+	char data[DIAG_OUT_SIZE];
+} diag_out;
+
+/* functions prototype */
+void report_diag(const char *, int, enum diag_severity, const char *, va_list);
+void start_diags(enum diag_format, int);
+void flush_diags(void);
+int is_diag_limit_reached(void);
+long get_diags_count(void);
+int export_diags(const char *, const char *);
+void replay_diags(const char *, const char *);
+void set_warnings_stream(FILE *);
@@ -0,0 +1,885 @@
+/*
+ *	File: disasm.c
+ *
+ *	This file contains the disassembler program. Every entered .ob file is reconstructed into an assembly
+ *	source (<file>.dis.as) that the assembler encodes into the same .ob file.
+ *	The first words are decoded by a table that is built by encoding every valid instruction and
+ *	addressing methods with encode_first_word, and the operand words are read through the memory word
+ *	structures of the encoder, so the decoding follows the encoding definitions.
+ *	The image is streamed twice without a memory cap - the first pass collects the addresses that the
+ *	relocatable operands refer to (they get labels) and the external words, and the second pass writes
+ *	the source through a large buffer. The names of the labels are taken from the .map and .ent files and
+ *	the names of the external labels from the .ext file (when they exist), other names are generated.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+
+#include "disasm.h"
+
+/* macro definitions */
+#define MAX_SOURCE_LINE (MAX_LINE - 2) /* maximum length of a source line (without new line and null) */
+#define MAX_STRING_CHARS (MAX_SOURCE_LINE - MAX_LABEL_SIZE - 12) /* a .string line fits any label */
+#define IMM_RANGE 1024 /* immediate values are 10 bits */
+#define DATA_RANGE 4096 /* data values are 12 bits */
+#define MODE_BIT(mode) (1 << (mode))
+#define ALL_MODES (MODE_BIT(ast_op_type_imm) | MODE_BIT(ast_op_type_label) | MODE_BIT(ast_op_type_reg))
+#define WRITABLE_MODES (MODE_BIT(ast_op_type_label) | MODE_BIT(ast_op_type_reg))
+/* copies a word to/from a memory word structure of the encoder (the structures are an unsigned int) */
+#define SET_WORD(field, value) memcpy(&(field), &(value), sizeof(unsigned int))
+#define GET_WORD(value, field) memcpy(&(value), &(field), sizeof(unsigned int))
+#define IS_TEXT_CHAR(word) ((word) >= ' ' && (word) <= '~' && (word) != '"')
+
+const char *INS_NAMES[] = {"mov", "cmp", "add", "sub", "lea", "not", "clr", "inc", "dec",
+							"jmp", "bne", "red", "prn", "jsr", "rts", "stop"};
+
+/* the addressing methods that the assembler accepts for every instruction (a bit for every method) */
+const int SRC_MODES[] = {ALL_MODES, ALL_MODES, ALL_MODES, ALL_MODES, MODE_BIT(ast_op_type_label),
+						 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+const int DES_MODES[] = {WRITABLE_MODES, ALL_MODES, WRITABLE_MODES, WRITABLE_MODES, WRITABLE_MODES,
+						 WRITABLE_MODES, WRITABLE_MODES, WRITABLE_MODES, WRITABLE_MODES, WRITABLE_MODES,
+						 WRITABLE_MODES, WRITABLE_MODES, ALL_MODES, WRITABLE_MODES, 0, 0};
+
+typedef struct { /* the .data and .string lines that are being built */
+	char line[MAX_BUFFER]; /* the .data line (empty if there are no numbers yet) */
+	int text[MAX_STRING_CHARS]; /* the characters that may end a .string */
+	int text_len;
+	char *label; /* the label of the next written line (NULL if it was written) */
+} data_lines;
+
+/* functions prototype */
+int decode_base64_word(char *);
+void read_symbols_file(char *, char *, map_label **, int *, int *);
+void build_decode_table(disasm_state *);
+int disassemble(disasm_state *, char *, int);
+int read_ob_word(FILE *, unsigned int *);
+void scan_code(disasm_state *, FILE *, long);
+void make_labels(disasm_state *);
+disasm_label *add_disasm_label(disasm_label **, int *, int *, char *, long, int);
+void sort_disasm_labels(disasm_label *, int);
+int find_disasm_label(disasm_label *, int, long);
+void write_declarations(disasm_state *, FILE *, char *, long, long);
+void write_code(disasm_state *, FILE *, FILE *, long, int *);
+int write_ins(disasm_state *, FILE *, unsigned int *, int, long, char *);
+char *format_operand(disasm_state *, int, unsigned int, long, char *);
+void write_data(disasm_state *, FILE *, FILE *, long, long, int *);
+void add_data_word(data_lines *, FILE *, int);
+void add_data_number(data_lines *, FILE *, int);
+void flush_data_line(data_lines *, FILE *);
+void flush_text(data_lines *, FILE *, int);
+char *next_label(disasm_state *, FILE *, int *, long);
+void free_disasm_file(disasm_state *);
+int compare_disasm_labels(const void *, const void *);
+int compare_label_names(const void *, const void *);
+
+
+
+/*
+ *	main function of the program
+ *
+ *	param argc - Number of command-line arguments.
+ *	param argv - Array of command-line arguments.
+ *	returns 0 if all the files were disassembled completely, 1 otherwise.
+ */
+int main(int argc, char *argv[]){
+
+	int i, is_stats = 0, res = 0;
+	disasm_state *state;
+
+	/* if no file was entered in command line */
+	if (argc < 2){
+
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s [--stats] file file ...)", argv[0]);
+		return 1;
+	}
+
+	if ((state = (disasm_state *)counted_calloc(1, sizeof(disasm_state))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - disassembler");
+		exit(1);
+	}
+
+	build_decode_table(state);
+
+	/* loop that runs over all the entered files */
+	for (i = 1; i < argc; i++){
+
+		/* statistics option - applies to the files that come after it */
+		if (strcmp(CURR_FILE_NAME, "--stats") == 0){
+			is_stats = 1;
+			continue;
+		}
+
+		res = !disassemble(state, CURR_FILE_NAME, is_stats) || res;
+	}
+
+	free(state -> labels);
+	free(state -> externs);
+	free(state);
+
+	return res;
+
+}
+
+
+
+/*
+ *	Builds the decode table of the first words by encoding every instruction with every valid
+ *	combination of addressing methods.
+ *
+ *	param state - Pointer to the disassembler.
+ */
+void build_decode_table(disasm_state *state){
+
+	ast line;
+	mem_code_word word;
+	decode_entry *entry;
+	unsigned int value;
+	int ins, src, des;
+
+	for (ins = ast_ins_mov; ins <= ast_ins_stop; ins++){
+		for (src = 0; src <= ast_op_type_reg; src++){
+			for (des = 0; des <= ast_op_type_reg; des++){
+
+				/* a mode is 0 if and only if the instruction has no such operand */
+				if ((src ? !(SRC_MODES[ins - 1] & MODE_BIT(src)) : SRC_MODES[ins - 1] != 0) ||
+					(des ? !(DES_MODES[ins - 1] & MODE_BIT(des)) : DES_MODES[ins - 1] != 0))
+					continue;
+
+				memset(&line, 0, sizeof(ast));
+				line.ast_union_option = ast_union_ins;
+				line.ast_union_ins_dir.ast_ins.ins = ins;
+				line.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[0] = src;
+				line.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[1] = des;
+				if (src == 0)
+					line.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote = des;
+
+				word = encode_first_word(&line);
+
+				/* the memory word as a number (as base64.c writes it) */
+				GET_WORD(value, word.union_word.first_word);
+				entry = &(state -> decode[value & WORD_MASK]);
+				entry -> ins = ins;
+				entry -> src_mode = src;
+				entry -> des_mode = des;
+				entry -> length = 1 + (src != 0) + (des != 0) - (src == ast_op_type_reg && des == ast_op_type_reg);
+			}
+		}
+	}
+
+}
+
+
+
+/*
+ *	Disassembles a .ob file into <file>.dis.as.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param file_name - The name of the .ob file without extension.
+ *	param is_stats - 1 to print the throughput to stderr.
+ *	returns 1 if the source expresses the whole image, 0 otherwise.
+ */
+int disassemble(disasm_state *state, char *file_name, int is_stats){
+
+	FILE *src, *des;
+	char name[MAX_BUFFER], line[MAX_LINE];
+	long ic, dc, code_start;
+	map_label *names = NULL; /* the symbols of the .ent and the .ext files */
+	int label_idx = 0, names_num = 0, names_size = 0, i;
+	double start = trace_clock(), elapsed;
+
+	sprintf(name, "%s.ob", file_name);
+	if (!(src = fopen(name, "r"))){
+		errprintf(name, NO_LINE_ERROR, "cannot open file - disassembler");
+		return 0;
+	}
+	setvbuf(src, NULL, _IOFBF, DISASM_BUFFER_SIZE);
+
+	if (!fgets(line, MAX_LINE, src) || sscanf(line, "%ld %ld", &ic, &dc) != 2 || ic < 0 || dc < 0){
+		errprintf(name, 1, "invalid header - expected the code and data sizes");
+		fclose(src);
+		return 0;
+	}
+	code_start = ftell(src);
+
+	state -> labels_num = state -> externs_num = state -> errors = 0;
+	memset(state -> is_target, 0, sizeof(state -> is_target));
+
+	/* the optional files of the names */
+	sprintf(name, "%s.map", file_name);
+	if ((des = fopen(name, "rb")) != NULL){
+		fclose(des);
+		state -> map = read_map_file(file_name);
+	}
+
+	/* the names of the .ent file are labels, and the names of the .ext file are external words */
+	read_symbols_file(file_name, ".ent", &names, &names_num, &names_size);
+	for (i = 0; i < names_num; i++)
+		add_disasm_label(&(state -> labels), &(state -> labels_num), &(state -> labels_size), names[i].name,
+						 names[i].address, 1) -> is_entry = 1;
+
+	names_num = 0;
+	read_symbols_file(file_name, ".ext", &names, &names_num, &names_size);
+	for (i = 0; i < names_num; i++)
+		add_disasm_label(&(state -> externs), &(state -> externs_num), &(state -> externs_size), names[i].name,
+						 names[i].address, 0);
+	free(names);
+
+	/* first pass - the referred addresses and the external words */
+	scan_code(state, src, ic);
+	make_labels(state);
+
+	sprintf(name, "%s.dis.as", file_name);
+	if (!(des = fopen(name, "w"))){
+		errprintf(name, NO_LINE_ERROR, "cannot write file");
+		fclose(src);
+		free_disasm_file(state);
+		return 0;
+	}
+	setvbuf(des, NULL, _IOFBF, DISASM_BUFFER_SIZE);
+
+	/* second pass - the source */
+	write_declarations(state, des, file_name, ic, dc);
+	fseek(src, code_start, SEEK_SET);
+	write_code(state, src, des, ic, &label_idx);
+	write_data(state, src, des, MEMORY_ASSUMPTION + ic, dc, &label_idx);
+
+	/* the labels after the image */
+	for (; label_idx < state -> labels_num; label_idx++){
+		fprintf(des, "; the label %s (address %ld) is out of the image\n", state -> labels[label_idx].name,
+				state -> labels[label_idx].address);
+		state -> errors++;
+	}
+
+	fclose(des);
+	fclose(src);
+	free_disasm_file(state);
+
+	if (state -> errors > 0)
+		errprintf(name, NO_LINE_ERROR, "%d words or labels cannot be expressed in assembly (see the comments)", state -> errors);
+
+	if (is_stats){
+		elapsed = (trace_clock() - start) / US_IN_SEC;
+		fprintf(stderr, "%s: %ld words in %.6f seconds (%.0f words per second)\n", file_name, ic + dc, elapsed,
+				elapsed > 0 ? (ic + dc) / elapsed : 0);
+	}
+
+	return state -> errors == 0;
+
+}
+
+
+
+/*
+ *	Reads the next word of a .ob file.
+ *
+ *	param src - The .ob file.
+ *	param word - Pointer to store the word.
+ *	returns 1 if a word was read, 0 at the end of the file or at an invalid line (a zero word is stored).
+ */
+int read_ob_word(FILE *src, unsigned int *word){
+
+	char line[MAX_LINE];
+	int value;
+
+	*word = 0;
+
+	if (!fgets(line, MAX_LINE, src) || (value = decode_base64_word(line)) < 0)
+		return 0;
+
+	*word = value;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Scans the code words - marks the addresses that the relocatable operands refer to and generates a
+ *	name for every external word that has no name in the .ext file.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param src - The .ob file (after the header).
+ *	param ic - Number of code words.
+ */
+void scan_code(disasm_state *state, FILE *src, long ic){
+
+	mem_code_word word;
+	unsigned int value;
+	char name[MAX_LABEL_SIZE];
+	long i;
+	int named_num;
+
+	sort_disasm_labels(state -> externs, state -> externs_num);
+	named_num = state -> externs_num;
+
+	for (i = 0; i < ic && read_ob_word(src, &value); i++){
+
+		SET_WORD(word.union_word.imm_direct_add_word, value);
+
+		if (word.union_word.imm_direct_add_word.are == rel_code)
+			state -> is_target[word.union_word.imm_direct_add_word.operand] = 1;
+
+		else if (word.union_word.imm_direct_add_word.are == ext_code &&
+				 find_disasm_label(state -> externs, named_num, MEMORY_ASSUMPTION + i) < 0){
+			sprintf(name, "EXT%ld", MEMORY_ASSUMPTION + i);
+			add_disasm_label(&(state -> externs), &(state -> externs_num), &(state -> externs_size), name, MEMORY_ASSUMPTION + i, 2);
+		}
+	}
+
+	sort_disasm_labels(state -> externs, state -> externs_num);
+
+}
+
+
+
+/*
+ *	Makes the labels - the labels of the .map and .ent files and a generated label for every referred
+ *	address that has no name, sorted by address with one label in an address.
+ *
+ *	param state - Pointer to the disassembler.
+ */
+void make_labels(disasm_state *state){
+
+	char name[MAX_LABEL_SIZE];
+	int i, j, named_num;
+
+	if (state -> map != NULL)
+		for (i = 0; i < state -> map -> labels_num; i++)
+			add_disasm_label(&(state -> labels), &(state -> labels_num), &(state -> labels_size),
+							 state -> map -> labels[i].name, state -> map -> labels[i].address, 0);
+
+	sort_disasm_labels(state -> labels, state -> labels_num);
+	named_num = state -> labels_num;
+
+	for (i = 0; i < MAX_ADDRESS_NUM; i++){
+		if (state -> is_target[i] && find_disasm_label(state -> labels, named_num, i) < 0){
+			sprintf(name, "L%d", i);
+			add_disasm_label(&(state -> labels), &(state -> labels_num), &(state -> labels_size), name, i, 2);
+		}
+	}
+
+	sort_disasm_labels(state -> labels, state -> labels_num);
+
+	/* keeps the first name of every address (an entry of the .ent file is the same label as in the .map) */
+	for (i = j = 0; i < state -> labels_num; i++){
+		if (j > 0 && state -> labels[j - 1].address == state -> labels[i].address)
+			state -> labels[j - 1].is_entry = state -> labels[j - 1].is_entry || state -> labels[i].is_entry;
+		else
+			state -> labels[j++] = state -> labels[i];
+	}
+	state -> labels_num = j;
+
+}
+
+
+
+/*
+ *	Adds a label to a labels array (the size is doubled when the array is full).
+ *
+ *	param labels - Pointer to the array.
+ *	param count - Pointer to the number of labels.
+ *	param size - Pointer to the number of allocated cells.
+ *	param name - The name of the label.
+ *	param address - The address of the label.
+ *	param order - The order of the source of the name (a lower order is preferred).
+ *	returns pointer to the new label.
+ */
+disasm_label *add_disasm_label(disasm_label **labels, int *count, int *size, char *name, long address, int order){
+
+	disasm_label *label;
+
+	if (*count == *size){
+
+		*size = *size ? *size * 2 : FIRST_DISASM_SIZE;
+
+		if ((*labels = (disasm_label *)counted_realloc(*labels, *size * sizeof(disasm_label))) == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - disassembler");
+			exit(1);
+		}
+	}
+
+	label = &((*labels)[(*count)++]);
+	strcpy(label -> name, name);
+	label -> address = address;
+	label -> order = order;
+	label -> is_entry = 0;
+
+	return label;
+
+}
+
+
+
+/*
+ *	Sorts a labels array by address (and by the order of the source of the names).
+ *
+ *	param labels - The array (NULL if it was not allocated yet).
+ *	param count - Number of labels.
+ */
+void sort_disasm_labels(disasm_label *labels, int count){
+
+	if (count > 1)
+		qsort(labels, count, sizeof(disasm_label), compare_disasm_labels);
+
+}
+
+
+
+/*
+ *	Finds the label of an address in a sorted labels array (binary search).
+ *
+ *	param labels - The array.
+ *	param count - Number of labels.
+ *	param address - The address.
+ *	returns the index of the first label of the address, -1 if there is no label in the address.
+ */
+int find_disasm_label(disasm_label *labels, int count, long address){
+
+	int low = 0, high = count - 1, mid, res = -1;
+
+	while (low <= high){
+
+		mid = (low + high) / 2;
+
+		if (labels[mid].address < address)
+			low = mid + 1;
+		else {
+			if (labels[mid].address == address)
+				res = mid;
+			high = mid - 1;
+		}
+	}
+
+	return res;
+
+}
+
+
+
+/*
+ *	Writes the header comment, the .entry and the .extern lines.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param des - The source file.
+ *	param file_name - The name of the program without extension.
+ *	param ic - Number of code words.
+ *	param dc - Number of data words.
+ */
+void write_declarations(disasm_state *state, FILE *des, char *file_name, long ic, long dc){
+
+	disasm_label *names;
+	int i;
+
+	fprintf(des, "; disassembled from %s.ob - %ld code words and %ld data words\n", file_name, ic, dc);
+
+	for (i = 0; i < state -> labels_num; i++)
+		if (state -> labels[i].is_entry)
+			fprintf(des, ".entry %s\n", state -> labels[i].name);
+
+	if (state -> externs_num == 0)
+		return;
+
+	/* every external label is declared once */
+	if ((names = (disasm_label *)counted_malloc(state -> externs_num * sizeof(disasm_label))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - disassembler");
+		exit(1);
+	}
+
+	memcpy(names, state -> externs, state -> externs_num * sizeof(disasm_label));
+	qsort(names, state -> externs_num, sizeof(disasm_label), compare_label_names);
+
+	for (i = 0; i < state -> externs_num; i++)
+		if (i == 0 || strcmp(names[i].name, names[i - 1].name) != 0)
+			fprintf(des, ".extern %s\n", names[i].name);
+
+	free(names);
+
+}
+
+
+
+/*
+ *	Writes the instruction lines. The words are decoded from a window of the next words of the image.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param src - The .ob file (after the header).
+ *	param des - The source file.
+ *	param ic - Number of code words.
+ *	param label_idx - Pointer to the index of the next label.
+ */
+void write_code(disasm_state *state, FILE *src, FILE *des, long ic, int *label_idx){
+
+	unsigned int window[MAX_INS_WORDS];
+	long address = MEMORY_ASSUMPTION, end = MEMORY_ASSUMPTION + ic;
+	int window_len = 0, used, i;
+
+	while (address < end){
+
+		/* fills the window with the next words */
+		for (; window_len < MAX_INS_WORDS && address + window_len < end; window_len++)
+			if (!read_ob_word(src, &window[window_len]))
+				state -> errors++; /* written as an invalid word */
+
+		used = write_ins(state, des, window, window_len, address, next_label(state, des, label_idx, address));
+
+		for (i = used; i < window_len; i++)
+			window[i - used] = window[i];
+		window_len -= used;
+		address += used;
+	}
+
+}
+
+
+
+/*
+ *	Writes the instruction line of the first word of a window.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param des - The source file.
+ *	param window - The next words.
+ *	param window_len - Number of words in the window.
+ *	param address - The address of the first word.
+ *	param label - The label of the address (NULL if none).
+ *	returns the number of words of the instruction (1 if the word is written as an invalid word).
+ */
+int write_ins(disasm_state *state, FILE *des, unsigned int *window, int window_len, long address, char *label){
+
+	decode_entry *entry = &(state -> decode[window[0] & WORD_MASK]);
+	mem_code_word word;
+	char src[MAX_LINE], des_op[MAX_LINE];
+	int is_valid = entry -> ins != 0 && entry -> length <= window_len;
+
+	if (is_valid && entry -> src_mode == ast_op_type_reg && entry -> des_mode == ast_op_type_reg){
+
+		/* two registers share one word */
+		SET_WORD(word.union_word.reg_add_word, window[1]);
+		is_valid = word.union_word.reg_add_word.are == abs_code && word.union_word.reg_add_word.src_reg < 8 &&
+				   word.union_word.reg_add_word.des_reg < 8;
+		sprintf(src, "@r%d", word.union_word.reg_add_word.src_reg);
+		sprintf(des_op, "@r%d", word.union_word.reg_add_word.des_reg);
+	}
+	else if (is_valid){
+		is_valid = (entry -> src_mode == 0 || format_operand(state, entry -> src_mode, window[1], address + 1, src)) &&
+				   (entry -> des_mode == 0 || format_operand(state, entry -> des_mode, window[entry -> length - 1],
+															  address + entry -> length - 1, des_op));
+	}
+
+	if (label != NULL)
+		fprintf(des, "%s:", label);
+
+	if (!is_valid){
+		fprintf(des, "\t; invalid instruction word %u at address %ld\n", window[0], address);
+		state -> errors++;
+		return 1;
+	}
+
+	if (entry -> src_mode)
+		fprintf(des, "\t%s %s, %s\n", INS_NAMES[entry -> ins - 1], src, des_op);
+	else if (entry -> des_mode)
+		fprintf(des, "\t%s %s\n", INS_NAMES[entry -> ins - 1], des_op);
+	else
+		fprintf(des, "\t%s\n", INS_NAMES[entry -> ins - 1]);
+
+	return entry -> length;
+
+}
+
+
+
+/*
+ *	Formats an operand word.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param mode - The addressing method of the operand.
+ *	param value - The word.
+ *	param address - The address of the word.
+ *	param operand - Buffer of the operand text.
+ *	returns the operand text, NULL if the word is not a valid operand of the addressing method.
+ */
+char *format_operand(disasm_state *state, int mode, unsigned int value, long address, char *operand){
+
+	mem_code_word word;
+	int idx, number;
+
+	SET_WORD(word.union_word.imm_direct_add_word, value);
+
+	if (mode == ast_op_type_reg){
+
+		SET_WORD(word.union_word.reg_add_word, value);
+
+		/* a register word with one register holds it as a source register (as the assembler writes it) */
+		if (word.union_word.reg_add_word.are != abs_code || word.union_word.reg_add_word.src_reg >= 8)
+			return NULL;
+
+		sprintf(operand, "@r%d", word.union_word.reg_add_word.src_reg);
+	}
+
+	else if (mode == ast_op_type_imm){
+
+		if (word.union_word.imm_direct_add_word.are != abs_code)
+			return NULL;
+
+		number = word.union_word.imm_direct_add_word.operand;
+		sprintf(operand, "%d", number >= IMM_RANGE / 2 ? number - IMM_RANGE : number);
+	}
+
+	else if (word.union_word.imm_direct_add_word.are == rel_code){
+
+		if ((idx = find_disasm_label(state -> labels, state -> labels_num, word.union_word.imm_direct_add_word.operand)) < 0)
+			return NULL;
+
+		strcpy(operand, state -> labels[idx].name);
+	}
+
+	else if (word.union_word.imm_direct_add_word.are == ext_code){
+
+		if ((idx = find_disasm_label(state -> externs, state -> externs_num, address)) < 0)
+			return NULL;
+
+		strcpy(operand, state -> externs[idx].name);
+	}
+
+	else
+		return NULL;
+
+	return operand;
+
+}
+
+
+
+/*
+ *	Writes the .data and .string lines. A line ends at a label and at the end of a source line of the
+ *	.map file, and a run of characters that ends with a zero is written as a .string.
+ *
+ *	param state - Pointer to the disassembler.
+ *	param src - The .ob file (after the code words).
+ *	param des - The source file.
+ *	param address - The address of the first data word.
+ *	param dc - Number of data words.
+ *	param label_idx - Pointer to the index of the next label.
+ */
+void write_data(disasm_state *state, FILE *src, FILE *des, long address, long dc, int *label_idx){
+
+	data_lines lines;
+	unsigned int value;
+	long end = address + dc;
+	int range_idx = 0;
+	char *label;
+
+	lines.line[0] = '\0';
+	lines.text_len = 0;
+	lines.label = NULL;
+
+	for (; address < end; address++){
+
+		if (!read_ob_word(src, &value))
+			state -> errors++;
+
+		/* skips the ranges that end before the address */
+		while (state -> map != NULL && range_idx < state -> map -> ranges_num &&
+			   state -> map -> ranges[range_idx].address < address)
+			range_idx++;
+
+		label = next_label(state, des, label_idx, address);
+
+		if (label != NULL || (state -> map != NULL && range_idx < state -> map -> ranges_num &&
+			state -> map -> ranges[range_idx].address == address)){
+			flush_text(&lines, des, 0);
+			flush_data_line(&lines, des);
+			lines.label = label;
+		}
+
+		add_data_word(&lines, des, value >= DATA_RANGE / 2 ? (int)value - DATA_RANGE : (int)value);
+	}
+
+	flush_text(&lines, des, 0);
+	flush_data_line(&lines, des);
+
+}
+
+
+
+/*
+ *	Adds a data word to the data lines.
+ *
+ *	param lines - Pointer to the data lines.
+ *	param des - The source file.
+ *	param number - The signed value of the word.
+ */
+void add_data_word(data_lines *lines, FILE *des, int number){
+
+	/* a character that may be a part of a .string */
+	if (IS_TEXT_CHAR(number) && lines -> text_len < MAX_STRING_CHARS){
+		lines -> text[(lines -> text_len)++] = number;
+		return;
+	}
+
+	/* the end of a string */
+	if (number == 0 && lines -> text_len > 0){
+		flush_text(lines, des, 1);
+		return;
+	}
+
+	flush_text(lines, des, 0);
+	add_data_number(lines, des, number);
+
+}
+
+
+
+/*
+ *	Adds a number to the .data line (a new line is started when the line is full).
+ *
+ *	param lines - Pointer to the data lines.
+ *	param des - The source file.
+ *	param number - The signed value of the word.
+ */
+void add_data_number(data_lines *lines, FILE *des, int number){
+
+	char text[MAX_LINE];
+	int len;
+
+	sprintf(text, "%d", number);
+	len = strlen(lines -> line);
+
+	if (len > 0 && len + strlen(text) + 2 > MAX_SOURCE_LINE){
+		flush_data_line(lines, des);
+		len = 0;
+	}
+
+	if (len == 0){
+		if (lines -> label != NULL)
+			sprintf(lines -> line, "%s:\t.data %s", lines -> label, text);
+		else
+			sprintf(lines -> line, "\t.data %s", text);
+		lines -> label = NULL;
+	}
+	else
+		sprintf(lines -> line + len, ", %s", text);
+
+}
+
+
+
+/*
+ *	Writes the .data line that is being built.
+ *
+ *	param lines - Pointer to the data lines.
+ *	param des - The source file.
+ */
+void flush_data_line(data_lines *lines, FILE *des){
+
+	if (lines -> line[0] != '\0')
+		fprintf(des, "%s\n", lines -> line);
+
+	lines -> line[0] = '\0';
+
+}
+
+
+
+/*
+ *	Writes the characters that may end a .string - as a .string if they ended with a zero, otherwise
+ *	as numbers of the .data line.
+ *
+ *	param lines - Pointer to the data lines.
+ *	param des - The source file.
+ *	param is_string - 1 if the characters ended with a zero.
+ */
+void flush_text(data_lines *lines, FILE *des, int is_string){
+
+	int i, len = lines -> text_len;
+
+	lines -> text_len = 0;
+
+	if (!is_string){
+		for (i = 0; i < len; i++)
+			add_data_number(lines, des, lines -> text[i]);
+		return;
+	}
+
+	flush_data_line(lines, des);
+
+	if (lines -> label != NULL)
+		fprintf(des, "%s:", lines -> label);
+	lines -> label = NULL;
+
+	fprintf(des, "\t.string \"");
+	for (i = 0; i < len; i++)
+		putc(lines -> text[i], des);
+	fprintf(des, "\"\n");
+
+}
+
+
+
+/*
+ *	Gets the label of an address and reports the labels that were passed (they are not at the start of
+ *	a source line, so they cannot be defined).
+ *
+ *	param state - Pointer to the disassembler.
+ *	param des - The source file.
+ *	param label_idx - Pointer to the index of the next label.
+ *	param address - The address of the next source line (the end of the image after the last line).
+ *	returns the name of the label of the address, NULL if there is no label in the address.
+ */
+char *next_label(disasm_state *state, FILE *des, int *label_idx, long address){
+
+	disasm_label *label;
+
+	for (; *label_idx < state -> labels_num && state -> labels[*label_idx].address <= address; (*label_idx)++){
+
+		label = &(state -> labels[*label_idx]);
+
+		if (label -> address == address && address >= MEMORY_ASSUMPTION){
+			(*label_idx)++;
+			return label -> name;
+		}
+
+		fprintf(des, "; the label %s (address %ld) is not at the start of a line\n", label -> name, label -> address);
+		state -> errors++;
+	}
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Frees the names of the current file.
+ *
+ *	param state - Pointer to the disassembler.
+ */
+void free_disasm_file(disasm_state *state){
+
+	if (state -> map != NULL)
+		free_map_file(state -> map);
+	state -> map = NULL;
+
+}
+
+
+
+/* the sort orders of the labels */
+
+int compare_disasm_labels(const void *a, const void *b){
+
+	const disasm_label *label_a = (const disasm_label *)a, *label_b = (const disasm_label *)b;
+
+	if (label_a -> address != label_b -> address)
+		return label_a -> address < label_b -> address ? -1 : 1;
+
+	return label_a -> order - label_b -> order;
+
+}
+
+int compare_label_names(const void *a, const void *b){
+
+	return strcmp(((const disasm_label *)a) -> name, ((const disasm_label *)b) -> name);
+
+}
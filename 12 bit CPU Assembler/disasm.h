@@ -0,0 +1,52 @@
+/*
+ *	File: disasm.h
+ *
+ *	This header file serves as an interface for the disassembler program, which reconstructs an
+ *	assembly source (.dis.as) from a .ob file and from its .ent, .ext and .map files when they exist.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "ast.h"
+#include "encoder.h"
+#include "mapfile.h"
+#include "trace.h"
+
+#define CURR_FILE_NAME argv[i] /* current file name that was entered in command line */
+#define WORDS_NUM 4096 /* number of 12 bit words (entries of the decode table) */
+#define WORD_MASK 0xFFF
+#define MAX_INS_WORDS 3 /* maximum number of words of an instruction */
+#define MAX_ADDRESS_NUM 1024 /* a direct operand is 10 bits, so it refers to the first 1024 addresses */
+#define DISASM_BUFFER_SIZE 65536 /* size of the input and the output buffers */
+#define FIRST_DISASM_SIZE 64 /* initial size of the labels and the external references arrays */
+
+typedef struct { /* an entry of the decode table of the first words */
+	int ins; /* the instruction (enum instructions), 0 if the word is not a valid first word */
+	int src_mode; /* addressing methods (enum op_type_e, 0 for none) */
+	int des_mode;
+	int length; /* number of words of the instruction */
+} decode_entry;
+
+typedef struct {
+	char name[MAX_LABEL_SIZE];
+	long address;
+	int order; /* the names of the .map come first, then the .ent and then the generated names */
+	int is_entry; /* 1 if the label is in the .ent file */
+} disasm_label;
+
+typedef struct {
+	decode_entry decode[WORDS_NUM];
+	disasm_label *labels; /* sorted by address (one label in an address) */
+	int labels_num;
+	int labels_size;
+	disasm_label *externs; /* the uses of external labels sorted by address */
+	int externs_num;
+	int externs_size;
+	map_file *map; /* NULL if there is no .map file */
+	char is_target[MAX_ADDRESS_NUM]; /* 1 if a relocatable operand refers to the address */
+	int errors; /* number of words and labels that cannot be expressed in assembly */
+} disasm_state;
+
+/* functions prototype */
+mem_code_word encode_first_word(ast *);
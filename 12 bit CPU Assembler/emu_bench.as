@@ -0,0 +1,19 @@
+; emu_bench.as - nested counting loops (the emulator benchmark)
+; runs about 20 million instructions and prints the final sum
+MAIN:	clr @r3
+	mov ROUNDS, @r4
+OUTER:	mov 500, @r1
+MIDDLE:	mov 250, @r2
+INNER:	add 3, @r3
+	dec @r2
+	cmp 0, @r2
+	bne INNER
+	dec @r1
+	cmp 0, @r1
+	bne MIDDLE
+	dec @r4
+	cmp 0, @r4
+	bne OUTER
+	prn @r3
+	stop
+ROUNDS:	.data 40
@@ -0,0 +1,278 @@
+/*
+ *	File: emulator.c
+ *
+ *	This file contains the main logic of the emulator program. Every entered .ob file is loaded,
+ *	pre-decoded and run until it stops (stop, a fault or the instructions limit). The program reads
+ *	from stdin (red) and writes to stdout (prn), the faults and the statistics are written to stderr.
+ *	With --jit the hot blocks are translated into native code, and with --compare every file is run by
+ *	the interpreter and then by the translator, the outputs are compared and the speedup is reported.
+ *	--obb loads the programs from their binary .obb files instead of the .ob files.
+ *	--profile writes a profile of every file by labels, calls and source lines to a .prof file.
+ *	--farm runs the jobs of a manifest (a .ob file, an input file and an expected output file in every
+ *	line) on -j worker threads.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+
+#include "emulator.h"
+
+
+
+/*
+ *	main function of the program
+ *
+ *	param argc - Number of command-line arguments.
+ *	param argv - Array of command-line arguments.
+ *	returns 0 if all the programs stopped normally, 1 otherwise.
+ */
+int main(int argc, char *argv[]){
+
+	int i, is_stats = 0, is_jit = 0, is_compare = 0, is_profile = 0, is_obb = 0, res = 0, threads = 1; /* threads - farm workers (-j option) */
+	long limit = 0; /* maximum number of instructions of a program (-n option, 0 for no limit) */
+	double elapsed;
+	cpu_state *cpu;
+	jit_state *jit = NULL;
+	FILE *input = NULL; /* copy of stdin for the runs of --compare */
+
+	/* if no file was entered in command line */
+	if (argc < 2){
+
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s [-n limit] [-j threads] [--stats] [--jit] [--compare] [--profile] [--obb] [--farm manifest] file file ...)", argv[0]);
+		return 1;
+	}
+
+	cpu = create_cpu(stdin, stdout);
+
+	/* loop that runs over all the entered files */
+	for (i = 1; i < argc; i++){
+
+		/* options - apply to the files that come after them */
+		if (strcmp(CURR_FILE_NAME, "-n") == 0 && i + 1 < argc){
+			limit = atol(argv[++i]);
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "-j") == 0 && i + 1 < argc){
+			if ((threads = atoi(argv[++i])) < 1)
+				threads = 1;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--farm") == 0 && i + 1 < argc){
+			res = run_farm(argv[++i], threads, limit, is_jit, is_obb) || res;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--profile") == 0){
+			is_profile = 1;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--obb") == 0){ /* loads the programs from .obb files */
+			is_obb = cpu -> is_obb = 1;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--stats") == 0){
+			is_stats = 1;
+			continue;
+		}
+		if (strcmp(CURR_FILE_NAME, "--jit") == 0 || strcmp(CURR_FILE_NAME, "--compare") == 0){
+			if (jit == NULL && (jit = create_jit(cpu)) == NULL)
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "native translation is not supported on this system, %s is ignored", CURR_FILE_NAME);
+			else if (strcmp(CURR_FILE_NAME, "--jit") == 0)
+				is_jit = 1;
+			else
+				is_compare = 1;
+			continue;
+		}
+
+		if (is_profile){
+			elapsed = trace_clock();
+			if (!profile_program(cpu, CURR_FILE_NAME, limit)){
+				res = 1;
+				continue;
+			}
+			fflush(stdout);
+			res = report_run(cpu, NULL, CURR_FILE_NAME, limit, (trace_clock() - elapsed) / US_IN_SEC, is_stats) || res;
+			continue;
+		}
+
+		if (is_compare){
+			if (input == NULL && (input = tmpfile()) != NULL)
+				copy_stream(stdin, input);
+			res = compare_runs(cpu, jit, CURR_FILE_NAME, limit, input, is_stats) || res;
+			continue;
+		}
+
+		if ((elapsed = run_program(cpu, is_jit ? jit : NULL, CURR_FILE_NAME, limit)) < 0){
+			res = 1;
+			continue;
+		}
+
+		res = report_run(cpu, is_jit ? jit : NULL, CURR_FILE_NAME, limit, elapsed, is_stats) || res;
+	}
+
+	if (input != NULL)
+		fclose(input);
+	if (jit != NULL)
+		free_jit(jit);
+	free(cpu);
+
+	return res;
+
+}
+
+
+
+/*
+ *	Loads a .ob file and runs it until it stops.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param jit - Pointer to the translator of the cpu (NULL to interpret).
+ *	param file_name - The name of the .ob file without extension.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ *	returns the run time in seconds, -1 if the file was not loaded.
+ */
+double run_program(cpu_state *cpu, jit_state *jit, char *file_name, long limit){
+
+	double start;
+
+	if (!load_ob_image(cpu, file_name))
+		return -1;
+
+	start = trace_clock();
+	predecode_cpu(cpu);
+	if (jit != NULL)
+		run_cpu_jit(cpu, jit, limit);
+	else
+		run_cpu(cpu, limit);
+	fflush(cpu -> out);
+
+	return (trace_clock() - start) / US_IN_SEC;
+
+}
+
+
+
+/*
+ *	Reports how a run stopped and its statistics.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param jit - Pointer to the translator of the run (NULL if it was interpreted).
+ *	param file_name - The name of the .ob file without extension.
+ *	param limit - The instructions limit of the run.
+ *	param elapsed - The run time in seconds.
+ *	param is_stats - 1 if the statistics are reported.
+ *	returns 0 if the program stopped normally, 1 otherwise.
+ */
+int report_run(cpu_state *cpu, jit_state *jit, char *file_name, long limit, double elapsed, int is_stats){
+
+	int res = 0;
+
+	if (cpu -> status == cpu_fault){
+		errprintf(file_name, NO_LINE_ERROR, "cpu fault at %s", cpu -> fault);
+		res = 1;
+	}
+	else if (cpu -> status == cpu_limit){
+		errprintf(file_name, NO_LINE_ERROR, "the limit of %ld instructions was reached at address %d", limit, cpu -> pc);
+		res = 1;
+	}
+
+	if (is_stats){
+		fprintf(stderr, "%s: %ld instructions in %.3f sec (%.0f instructions/sec)\n", file_name,
+				cpu -> executed, elapsed, elapsed > 0 ? cpu -> executed / elapsed : 0);
+		if (jit != NULL)
+			fprintf(stderr, "%s: %ld blocks translated, %ld invalidated, %ld flushes\n", file_name,
+					jit -> translated, jit -> invalidated, jit -> flushes);
+	}
+
+	return res;
+
+}
+
+
+
+/*
+ *	Runs a .ob file by the interpreter and by the translator, compares the outputs, the number of
+ *	instructions and the final status, and reports the speedup. The output of the translated run is
+ *	written to stdout.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param jit - Pointer to the translator of the cpu.
+ *	param file_name - The name of the .ob file without extension.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ *	param input - The input of both runs (NULL if it could not be created).
+ *	param is_stats - 1 if the statistics are reported.
+ *	returns 0 if the runs are the same and the program stopped normally, 1 otherwise.
+ */
+int compare_runs(cpu_state *cpu, jit_state *jit, char *file_name, long limit, FILE *input, int is_stats){
+
+	FILE *interp_out = tmpfile(), *jit_out = tmpfile();
+	double interp_time, jit_time;
+	long interp_executed;
+	enum cpu_status interp_status;
+	int res = 1, c, e;
+
+	if (input == NULL || interp_out == NULL || jit_out == NULL)
+		errprintf(file_name, NO_LINE_ERROR, "can't create a temporary file");
+	else {
+		rewind(input);
+		cpu -> in = input;
+		cpu -> out = interp_out;
+		interp_time = run_program(cpu, NULL, file_name, limit);
+		interp_executed = cpu -> executed;
+		interp_status = cpu -> status;
+
+		rewind(input);
+		cpu -> out = jit_out;
+		if (interp_time >= 0 && (jit_time = run_program(cpu, jit, file_name, limit)) >= 0){
+			res = report_run(cpu, jit, file_name, limit, jit_time, is_stats);
+
+			/* compares the outputs */
+			rewind(interp_out);
+			rewind(jit_out);
+			do {
+				c = getc(interp_out);
+				e = getc(jit_out);
+			} while (c == e && c != EOF);
+
+			if (c != e || interp_executed != cpu -> executed || interp_status != cpu -> status){
+				errprintf(file_name, NO_LINE_ERROR, "the translated run differs from the interpreter");
+				res = 1;
+			}
+
+			rewind(jit_out);
+			copy_stream(jit_out, stdout);
+			fprintf(stderr, "%s: interpreter %.0f instructions/sec, jit %.0f instructions/sec (speedup %.2fx)\n", file_name,
+					interp_time > 0 ? interp_executed / interp_time : 0, jit_time > 0 ? cpu -> executed / jit_time : 0,
+					jit_time > 0 ? interp_time / jit_time : 0);
+		}
+	}
+
+	if (interp_out != NULL)
+		fclose(interp_out);
+	if (jit_out != NULL)
+		fclose(jit_out);
+	cpu -> in = stdin;
+	cpu -> out = stdout;
+
+	return res;
+
+}
+
+
+
+/*
+ *	Copies a stream to another stream.
+ *
+ *	param src - The source stream.
+ *	param des - The destination stream.
+ */
+void copy_stream(FILE *src, FILE *des){
+
+	char buffer[COPY_BUFFER_SIZE];
+	size_t len;
+
+	while ((len = fread(buffer, 1, sizeof(buffer), src)) > 0)
+		fwrite(buffer, 1, len, des);
+	fflush(des);
+
+}
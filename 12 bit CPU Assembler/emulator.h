@@ -0,0 +1,24 @@
+/*
+ *	File: emulator.h
+ *
+ *	This header file serves as an interface for the emulator program, which runs .ob files on the
+ *	12 bit CPU emulator core.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "jit.h"
+#include "farm.h"
+#include "mapfile.h"
+#include "profile.h"
+#include "trace.h"
+
+#define CURR_FILE_NAME argv[i] /* current file name that was entered in command line */
+#define COPY_BUFFER_SIZE 4096
+
+/* functions prototype */
+double run_program(cpu_state *, jit_state *, char *, long);
+int report_run(cpu_state *, jit_state *, char *, long, double, int);
+int compare_runs(cpu_state *, jit_state *, char *, long, FILE *, int);
+void copy_stream(FILE *, FILE *);
@@ -3,7 +3,7 @@
  *
  *	This program encodes assembly instructions and directives into machine code.
  *	It defines functions to encode instructions and directives based on the provided
- *	Abstract Syntax Tree (AST) structure.
+ *	Abstract Syntax Tree (AST) structure, and a function that only checks them (--check option).
  *
  *	author: Gal Levi
  *	version: 5.8.23
@@ -13,24 +13,27 @@
 #include "funcs_and_macs.h"
 #include "ast.h"
 #include "encoder.h"
+#include "incbin.h"
 #include "labels_BST.h"
 
 /* macro definitions */
 
 /* instruction op code = ast enum of instruction - 1 */
 #define INS_OPCODE curr_line_ast -> ast_union_ins_dir.ast_ins.ins - 1 
-#define MAX_IMM_NUM 511 /* maximum immediate value allowed (signed 10 bits) */
-#define MIN_IMM_NUM -512 /* minimum immediate value allowed */
-#define MAX_DATA_NUM 2047 /* maximum data value allowed (signed 12 bits) */
-#define MIN_DATA_NUM -2048 /* minimum data value allowed */
+/* the errors of the encoder (the check mode reports the same errors) */
+#define UNDEFINED_LABEL_ERROR "the label '%s' has not been defined anywhere"
+#define IMM_RANGE_ERROR "the number %s is out of range (immediate value range is -512,...,511)"
+#define DATA_RANGE_ERROR "the number %s is out of range (data value range is -2048,...,2047)"
 
 
 /* exclusive functions prototype */
 mem_code_word encode_first_word(ast *);
-int insert_word_ins_with_operands(enum op_type_e, op_type_u, mem_code_word (*)[MAX_MEMORY_ASSUMPTION], 
-									symbol_table_node *, int *, char *, int);
+int insert_word_ins_with_operands(enum op_type_e, op_type_u, char *, mem_code_word (*)[MAX_MEMORY_ASSUMPTION], 
+									symbol_table_node *, extern_ref_vector *, int *, char *, int);
 int encode_dir(mem_data_word (*)[MAX_MEMORY_ASSUMPTION], ast *, symbol_table_node *, int *, char *, int);
-int encode_ins(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], ast *, symbol_table_node *, int *, char *, int);
+int encode_ins(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], ast *, symbol_table_node *, extern_ref_vector *, int *,
+				char *, int);
+int check_operand(enum op_type_e, op_type_u, char *, symbol_table_node *, char *, int);
 
 
 
@@ -44,18 +47,20 @@ int encode_ins(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], ast *, symbol_table_nod
  *	param dc_add - Pointer to the data counter, used to keep track of the current address in the data image.
  *	param curr_line_ast - The AST node representing the current line of code.
  *	param symbol_table - Pointer to the symbol table.
+ *	param ext_refs - Pointer to the external references log.
  *	param file_name - Name of the source file being processed.
  *	param line_num - Current line number in the source file.
  *	returns 1 if encoding is successful, 0 otherwise.
  */
 int encoder(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
 			 mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int *dc_add, 
- 			ast *curr_line_ast, symbol_table_node *symbol_table, char *file_name, int line_num){
+ 			ast *curr_line_ast, symbol_table_node *symbol_table, extern_ref_vector *ext_refs,
+ 			 char *file_name, int line_num){
 
 	/* if the line is instruction */
 	if (curr_line_ast -> ast_union_option == ast_union_ins){
 
-		return encode_ins(code_im, curr_line_ast, symbol_table, ic_add, file_name, line_num);
+		return encode_ins(code_im, curr_line_ast, symbol_table, ext_refs, ic_add, file_name, line_num);
 
 	}
 
@@ -81,12 +86,14 @@ int encoder(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
  *	param dc_add - Pointer to the data counter, used to keep track of the current address in the data image.
  *	param curr_line_ast - The AST node representing the current line of code.
  *	param symbol_table - Pointer to the symbol table.
+ *	param ext_refs - Pointer to the external references log.
  *	param file_name - Name of the source file being processed.
  *	param line_num - Current line number in the source file.
  *	returns 1 if encoding is successful, 0 otherwise.
  */
 int encode_ins(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_ast,
- 				symbol_table_node *symbol_table, int *ic_add, char *file_name, int line_num){
+ 				symbol_table_node *symbol_table, extern_ref_vector *ext_refs, int *ic_add,
+ 				 char *file_name, int line_num){
 		
 	int i;
 		
@@ -116,7 +123,7 @@ int encode_ins(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_a
 				/* inserts the encoded operands into the image code array */
 				if (!insert_word_ins_with_operands(curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i],
 												 curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i],
-												  code_im,  symbol_table,  ic_add,  file_name, line_num))
+												 curr_line_ast -> range_num, code_im,  symbol_table, ext_refs, ic_add,  file_name, line_num))
 					return 0;
 			}
 		}
@@ -129,7 +136,7 @@ int encode_ins(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_a
 		
 		if (!insert_word_ins_with_operands(curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote,
 											curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu,
-											code_im,  symbol_table,  ic_add,  file_name, line_num))
+											curr_line_ast -> range_num, code_im,  symbol_table, ext_refs, ic_add,  file_name, line_num))
 			return 0;
 			
 	}
@@ -157,7 +164,7 @@ int encode_ins(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_a
 int encode_dir(mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_ast,
  				symbol_table_node *symbol_table, int *dc_add, char *file_name, int line_num){
 	
-	int i;
+	int i, words;
 	
 	/* if it is string directive */
 	if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string){
@@ -175,22 +182,40 @@ int encode_dir(mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_a
 	} /* end of string case */
 	
 	
+	else if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_incbin){
+	
+		if (!get_incbin_words(curr_line_ast, file_name, line_num, &words))
+			return 0;
+		
+		/* the file may have grown since the first run */
+		if (*dc_add + words > MAX_MEMORY_ASSUMPTION){
+		
+			errprintf(file_name, line_num, "the file '%s' was changed during the assembly - incbin directive", curr_line_ast -> ast_union_ins_dir.ast_dir.dir.incbin.file);
+			return 0;
+		}
+		
+		/* inserts in the data image array the words of the file */
+		if (!copy_incbin_words(curr_line_ast, file_name, line_num, &((*data_im)[*dc_add]), words))
+			return 0;
+		
+		*dc_add += words;
+	
+	} /* end of incbin case */
+	
+	
 	else { /* if it is data directive */
 		
-		/* inserts in the data image array the encoded numbers */
-		for (i = 0; i < curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count; i++){
-			
-			if (curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i] > MAX_DATA_NUM ||
-				curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i] < MIN_DATA_NUM){
-			
-				errprintf(file_name, line_num, "the number %d is out of range (data value range is -2048,...,2047)", curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i]);
-				return 0;
-			
-			}
-			(*data_im)[(*dc_add)++].curr_data = curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i];
+		/* the range of the numbers was checked while parsing */
+		if (curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error != NO_RANGE_ERROR){
 		
+			errprintf(file_name, line_num, DATA_RANGE_ERROR, curr_line_ast -> range_num);
+			return 0;
 		}
 		
+		/* inserts in the data image array the encoded numbers */
+		for (i = 0; i < curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count; i++)
+			(*data_im)[(*dc_add)++].curr_data = curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_array[i];
+		
 	
 	} /* end of data case */
 	
@@ -205,17 +230,19 @@ int encode_dir(mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], ast *curr_line_a
  *
  *	param ote - Operand type enumeration for the current operand.
  *	param otu - Operand type union for the current operand.
+ *	param range_num - The text of the first number of the line that is out of its range.
  *	param code_im - Pointer to the code image memory buffer.
  *	param symbol_table - Pointer to the symbol table.
+ *	param ext_refs - Pointer to the external references log (external uses are appended to it).
  *	param ic_add - Pointer to the instruction counter, used to keep track of the current address in the code image.
  *	param file_name - Name of the source file being processed.
  *	param line_num - Current line number in the source file.
  *	returns 1 if the operand insertion is successful, 0 otherwise.
  */
-int insert_word_ins_with_operands(enum op_type_e ote, op_type_u otu, 
+int insert_word_ins_with_operands(enum op_type_e ote, op_type_u otu, char *range_num,
 								mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION],
-								 symbol_table_node *symbol_table, int *ic_add, char *file_name,
-								  int line_num){
+								 symbol_table_node *symbol_table, extern_ref_vector *ext_refs, int *ic_add,
+								  char *file_name, int line_num){
 
 	symbol_table_node *curr_search_res;
 		
@@ -242,18 +269,19 @@ int insert_word_ins_with_operands(enum op_type_e ote, op_type_u otu,
 			if (curr_search_res -> type == enum_rel || 
 			   (curr_search_res -> type == enum_ent && curr_search_res -> comm != enum_comm_none)){
 				(*code_im)[(*ic_add)].union_word.imm_direct_add_word.are = rel_code;
-				(*code_im)[(*ic_add)].union_word.imm_direct_add_word.operand = curr_search_res -> label_value.value + MEMORY_ASSUMPTION;
+				(*code_im)[(*ic_add)].union_word.imm_direct_add_word.operand = curr_search_res -> value + MEMORY_ASSUMPTION;
 			}
 			
 			/* if the type is external */
 			else if (curr_search_res -> type == enum_extl){  
 				(*code_im)[(*ic_add)].union_word.imm_direct_add_word.are = ext_code;
 				(*code_im)[(*ic_add)].union_word.imm_direct_add_word.operand = 0;
+				insert_extern_ref(ext_refs, curr_search_res, *ic_add); /* logs the external use */
 			}
 			
 			else { /* if the type is none/undefined entry the label has not been defined at all */
 				
-				errprintf(file_name, line_num, "the label '%s' has not been defined anywhere", otu.label);
+				errprintf(file_name, line_num, UNDEFINED_LABEL_ERROR, otu.label);
 				return 0;
 			}
 					
@@ -272,7 +300,7 @@ int insert_word_ins_with_operands(enum op_type_e ote, op_type_u otu,
 		/* if the immediate value exceeds the limit of 10 bits */
 		if (otu.imm > MAX_IMM_NUM || otu.imm < MIN_IMM_NUM){
 				
-			errprintf(file_name, line_num, "the number %d is out of range (immediate value range is -512,...,511)", otu.imm);
+			errprintf(file_name, line_num, IMM_RANGE_ERROR, range_num);
 			return 0;
 				
 		}
@@ -289,6 +317,99 @@ int insert_word_ins_with_operands(enum op_type_e ote, op_type_u otu,
 }
 
 
+/*
+ *	Checks an instruction or a directive like the encoder, without encoding it (--check option).
+ *	The words of an .incbin directive are not read (the first run already checked its file).
+ *
+ *	param curr_line_ast - The AST node representing the current line of code.
+ *	param symbol_table - Pointer to the symbol table.
+ *	param file_name - Name of the source file being processed.
+ *	param line_num - Current line number in the source file.
+ *	returns 1 if the encoder would encode the line, 0 otherwise.
+ */
+int check_encoding(ast *curr_line_ast, symbol_table_node *symbol_table, char *file_name, int line_num){
+
+	int i;
+	
+	/* 2 operands instructions case (a register operand has nothing to check) */
+	if (curr_line_ast -> ast_union_option == ast_union_ins &&
+		curr_line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_mov &&
+		curr_line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
+		
+		for (i = 0; i < 2; i++){
+			if (!check_operand(curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i],
+							   curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i],
+							   curr_line_ast -> range_num, symbol_table, file_name, line_num))
+				return 0;
+		}
+	}
+	
+	/* one operand instructions case */
+	else if (curr_line_ast -> ast_union_option == ast_union_ins &&
+			 curr_line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_not &&
+			 curr_line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr)
+		return check_operand(curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote,
+							 curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu,
+							 curr_line_ast -> range_num, symbol_table, file_name, line_num);
+	
+	/* data directive case */
+	else if (curr_line_ast -> ast_union_option == ast_union_dir &&
+			 curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_data){
+		
+		/* the range of the numbers was checked while parsing */
+		if (curr_line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error != NO_RANGE_ERROR){
+		
+			errprintf(file_name, line_num, DATA_RANGE_ERROR, curr_line_ast -> range_num);
+			return 0;
+		}
+	}
+	
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks an operand like insert_word_ins_with_operands, without encoding it.
+ *
+ *	param ote - Operand type enumeration for the current operand.
+ *	param otu - Operand type union for the current operand.
+ *	param range_num - The text of the first number of the line that is out of its range.
+ *	param symbol_table - Pointer to the symbol table.
+ *	param file_name - Name of the source file being processed.
+ *	param line_num - Current line number in the source file.
+ *	returns 1 if the operand is valid, 0 otherwise.
+ */
+int check_operand(enum op_type_e ote, op_type_u otu, char *range_num, symbol_table_node *symbol_table, char *file_name, int line_num){
+
+	symbol_table_node *curr_search_res;
+	
+	/* a label operand must be relocatable, a defined entry or external */
+	if (ote == ast_op_type_label){
+		
+		if ((curr_search_res = search_label(symbol_table, otu.label)) &&
+			curr_search_res -> type != enum_rel && curr_search_res -> type != enum_extl &&
+			!(curr_search_res -> type == enum_ent && curr_search_res -> comm != enum_comm_none)){
+		
+			errprintf(file_name, line_num, UNDEFINED_LABEL_ERROR, otu.label);
+			return 0;
+		}
+	}
+	
+	/* an immediate operand must fit 10 bits */
+	else if (ote != ast_op_type_reg && (otu.imm > MAX_IMM_NUM || otu.imm < MIN_IMM_NUM)){
+	
+		errprintf(file_name, line_num, IMM_RANGE_ERROR, range_num);
+		return 0;
+	}
+	
+	return 1;
+
+}
+
+
+
 /*
  *	Encodes the first word of an instruction.
  *
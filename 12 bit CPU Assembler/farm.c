@@ -0,0 +1,440 @@
+/*
+ *	File: farm.c
+ *
+ *	This file implements the batch emulator (--farm option).
+ *	Every .ob file of the manifest is read once into a packed image (2 bytes a word), and its jobs share
+ *	it read only, so the images of thousands of jobs stay small. A worker thread owns one cpu and runs a
+ *	job on it by loading the image into it, so every job runs on an isolated machine state.
+ *	The jobs are split into a deque for every worker. A worker takes the jobs from the tail of its own
+ *	deque, and when it is empty it steals from the head of the deques of the other workers (work
+ *	stealing), so a worker that got long jobs does not hold the others.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for pthreads in ansi mode */
+
+#include <pthread.h>
+#include "jit.h"
+#include "farm.h"
+#include "trace.h"
+
+/* macro definitions */
+#define NO_JOB -1
+
+typedef struct farm_state farm_state;
+
+typedef struct { /* a .ob file that was read */
+	char *name;
+	cpu_image *image;
+} farm_image;
+
+typedef struct {
+	pthread_mutex_t lock;
+	int head; /* the deque is the jobs order[head, tail) of the farm */
+	int tail;
+	int id;
+	long steals; /* number of jobs that the worker stole */
+	cpu_state *cpu; /* the cpu of the worker (created by the calling thread) */
+	jit_state *jit; /* the translator of the cpu (NULL to interpret) */
+	farm_state *farm;
+} farm_worker;
+
+struct farm_state {
+	farm_job *jobs;
+	int jobs_num;
+	int *order; /* the job indexes of the deques */
+	farm_worker workers[MAX_FARM_THREADS];
+	int threads;
+	farm_image *images; /* the .ob files of the jobs */
+	int images_num;
+	int images_size;
+	long limit;
+	int is_obb; /* 1 if the images are read from .obb files */
+};
+
+/* exclusive functions prototype */
+int read_manifest(char *, farm_state *);
+cpu_image *find_image(farm_state *, char *);
+void *farm_worker_main(void *);
+int take_job(farm_worker *);
+int steal_job(farm_worker *);
+void run_job(cpu_state *, jit_state *, farm_job *, long);
+int compare_output(FILE *, FILE *);
+
+
+
+/*
+ *	Runs the jobs of a manifest on a pool of worker threads and reports every job and the throughput.
+ *
+ *	param manifest - The name of the manifest file.
+ *	param threads - Number of worker threads.
+ *	param limit - The maximum number of instructions of a job (0 for no limit).
+ *	param is_jit - 1 if the workers translate hot blocks into native code.
+ *	param is_obb - 1 if the programs are read from .obb files.
+ *	returns 0 if all the jobs passed, 1 otherwise.
+ */
+int run_farm(char *manifest, int threads, long limit, int is_jit, int is_obb){
+
+	farm_state farm;
+	farm_worker *worker;
+	pthread_t tids[MAX_FARM_THREADS];
+	int i, is_created[MAX_FARM_THREADS], failed = 0;
+	long executed = 0, steals = 0;
+	double start, elapsed;
+	farm_job *job;
+
+	memset(&farm, 0, sizeof(farm));
+	farm.threads = threads < 1 ? 1 : threads > MAX_FARM_THREADS ? MAX_FARM_THREADS : threads;
+	farm.limit = limit;
+	farm.is_obb = is_obb;
+
+	if (!read_manifest(manifest, &farm))
+		return 1;
+
+	if (farm.threads > farm.jobs_num && farm.jobs_num > 0)
+		farm.threads = farm.jobs_num;
+
+	/* splits the jobs into equal deques */
+	for (i = 0; i < farm.jobs_num; i++)
+		farm.order[i] = i;
+
+	for (i = 0; i < farm.threads; i++){
+		worker = &farm.workers[i];
+		pthread_mutex_init(&(worker -> lock), NULL);
+		worker -> head = (int)((long)farm.jobs_num * i / farm.threads);
+		worker -> tail = (int)((long)farm.jobs_num * (i + 1) / farm.threads);
+		worker -> id = i + 1;
+		worker -> cpu = create_cpu(NULL, NULL);
+		worker -> jit = is_jit ? create_jit(worker -> cpu) : NULL;
+		worker -> farm = &farm;
+	}
+
+	start = trace_clock();
+
+	set_alloc_counting(0); /* the counters are not shared by the threads */
+	for (i = 0; i < farm.threads; i++)
+		is_created[i] = pthread_create(&tids[i], NULL, farm_worker_main, &farm.workers[i]) == 0;
+
+	for (i = 0; i < farm.threads; i++){
+		if (is_created[i])
+			pthread_join(tids[i], NULL);
+		else /* the thread was not created - runs its jobs (and steals) in the calling thread */
+			farm_worker_main(&farm.workers[i]);
+	}
+	set_alloc_counting(1);
+
+	elapsed = (trace_clock() - start) / US_IN_SEC;
+
+	/* reports the jobs by their order in the manifest */
+	for (i = 0; i < farm.jobs_num; i++){
+		job = &farm.jobs[i];
+		printf("%s:%d: %s < %s: %s, %ld cycles (worker %d)\n", manifest, job -> line, job -> ob_name, job -> input,
+			   job -> is_passed ? "passed" : job -> reason, job -> executed, job -> worker);
+		executed += job -> executed;
+		failed += !job -> is_passed;
+	}
+
+	for (i = 0; i < farm.threads; i++){
+		worker = &farm.workers[i];
+		steals += worker -> steals;
+		pthread_mutex_destroy(&(worker -> lock));
+		if (worker -> jit != NULL)
+			free_jit(worker -> jit);
+		free(worker -> cpu);
+	}
+
+	printf("%s: %d jobs, %d passed, %d failed, %ld cycles in %.3f sec (%.0f cycles/sec, %.0f jobs/sec), %d threads, %ld steals\n",
+		   manifest, farm.jobs_num, farm.jobs_num - failed, failed, executed, elapsed, elapsed > 0 ? executed / elapsed : 0,
+		   elapsed > 0 ? farm.jobs_num / elapsed : 0, farm.threads, steals);
+	fflush(stdout);
+
+	for (i = 0; i < farm.jobs_num; i++)
+		free(farm.jobs[i].ob_name);
+	for (i = 0; i < farm.images_num; i++){
+		free(farm.images[i].name);
+		free(farm.images[i].image);
+	}
+	free(farm.jobs);
+	free(farm.order);
+	free(farm.images);
+
+	return failed > 0;
+
+}
+
+
+
+/*
+ *	Reads the jobs of a manifest and the images of their .ob files.
+ *
+ *	param manifest - The name of the manifest file.
+ *	param farm - Pointer to the farm.
+ *	returns 1 if the manifest was read, 0 otherwise.
+ */
+int read_manifest(char *manifest, farm_state *farm){
+
+	FILE *src;
+	char line[MAX_BUFFER], ob_name[MAX_BUFFER], input[MAX_BUFFER], expected[MAX_BUFFER];
+	int line_num = 0, size = FIRST_JOBS_SIZE, tokens;
+	farm_job *job;
+
+	if (!(src = fopen(manifest, "r"))){
+		errprintf(manifest, NO_LINE_ERROR, "cannot open file - farm manifest");
+		return 0;
+	}
+
+	if ((farm -> jobs = (farm_job *)counted_malloc(size * sizeof(farm_job))) == NULL){
+		errprintf(manifest, NO_LINE_ERROR, "memory allocation failed - farm jobs");
+		exit(1);
+	}
+
+	while (fgets(line, MAX_BUFFER, src)){
+
+		line_num++;
+
+		/* skips empty lines and comments */
+		if ((tokens = sscanf(line, "%s %s %s", ob_name, input, expected)) < 1 || ob_name[0] == '#')
+			continue;
+
+		if (tokens < 2)
+			strcpy(input, FARM_NO_FILE);
+		if (tokens < 3)
+			strcpy(expected, FARM_NO_FILE);
+
+		if (farm -> jobs_num == size){
+			size *= 2;
+			if ((farm -> jobs = (farm_job *)counted_realloc(farm -> jobs, size * sizeof(farm_job))) == NULL){
+				errprintf(manifest, line_num, "memory allocation failed - farm jobs");
+				exit(1);
+			}
+		}
+
+		job = &(farm -> jobs[farm -> jobs_num++]);
+		memset(job, 0, sizeof(farm_job));
+		job -> line = line_num;
+
+		if ((job -> ob_name = (char *)counted_malloc(strlen(ob_name) + strlen(input) + strlen(expected) + 3)) == NULL){
+			errprintf(manifest, line_num, "memory allocation failed - farm job");
+			exit(1);
+		}
+
+		job -> input = job -> ob_name + strlen(ob_name) + 1;
+		job -> expected = job -> input + strlen(input) + 1;
+		strcpy(job -> ob_name, ob_name);
+		strcpy(job -> input, input);
+		strcpy(job -> expected, expected);
+
+		job -> image = find_image(farm, ob_name);
+	}
+
+	fclose(src);
+
+	if ((farm -> order = (int *)counted_malloc((farm -> jobs_num + 1) * sizeof(int))) == NULL){
+		errprintf(manifest, NO_LINE_ERROR, "memory allocation failed - farm jobs");
+		exit(1);
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Finds the image of a .ob file, and reads it if it was not read yet.
+ *
+ *	param farm - Pointer to the farm.
+ *	param ob_name - The name of the .ob file without extension.
+ *	returns pointer to the image, NULL if the file can't be read.
+ */
+cpu_image *find_image(farm_state *farm, char *ob_name){
+
+	farm_image *image;
+	int i;
+
+	for (i = 0; i < farm -> images_num; i++)
+		if (strcmp(farm -> images[i].name, ob_name) == 0)
+			return farm -> images[i].image;
+
+	if (farm -> images_num == farm -> images_size){
+		farm -> images_size = farm -> images_size == 0 ? FIRST_JOBS_SIZE : farm -> images_size * 2;
+		if ((farm -> images = (farm_image *)counted_realloc(farm -> images, farm -> images_size * sizeof(farm_image))) == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - farm images");
+			exit(1);
+		}
+	}
+
+	image = &(farm -> images[(farm -> images_num)++]);
+
+	if ((image -> name = (char *)counted_malloc(strlen(ob_name) + 1)) == NULL ||
+		(image -> image = (cpu_image *)counted_malloc(sizeof(cpu_image))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - farm image");
+		exit(1);
+	}
+
+	strcpy(image -> name, ob_name);
+
+	if (!(farm -> is_obb ? read_obb_image(image -> image, ob_name) : read_ob_image(image -> image, ob_name))){ /* the name is kept so the file is read once */
+		free(image -> image);
+		image -> image = NULL;
+	}
+
+	return image -> image;
+
+}
+
+
+
+/*
+ *	The function of a worker thread - runs jobs until all the deques are empty.
+ *
+ *	param arg - Pointer to the worker.
+ *	returns NULL.
+ */
+void *farm_worker_main(void *arg){
+
+	farm_worker *worker = (farm_worker *)arg;
+	farm_state *farm = worker -> farm;
+	farm_job *job;
+	int i;
+
+	while ((i = take_job(worker)) != NO_JOB || (i = steal_job(worker)) != NO_JOB){
+		job = &(farm -> jobs[i]);
+		job -> worker = worker -> id;
+		run_job(worker -> cpu, worker -> jit, job, farm -> limit);
+	}
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Takes a job from the tail of the deque of a worker.
+ *
+ *	param worker - Pointer to the worker.
+ *	returns the index of the job, NO_JOB if the deque is empty.
+ */
+int take_job(farm_worker *worker){
+
+	int job = NO_JOB;
+
+	pthread_mutex_lock(&(worker -> lock));
+	if (worker -> head < worker -> tail)
+		job = worker -> farm -> order[--(worker -> tail)];
+	pthread_mutex_unlock(&(worker -> lock));
+
+	return job;
+
+}
+
+
+
+/*
+ *	Steals a job from the head of the deque of another worker.
+ *
+ *	param thief - Pointer to the worker that steals.
+ *	returns the index of the job, NO_JOB if all the deques are empty.
+ */
+int steal_job(farm_worker *thief){
+
+	farm_state *farm = thief -> farm;
+	farm_worker *victim;
+	int i, job = NO_JOB;
+
+	for (i = 1; i < farm -> threads && job == NO_JOB; i++){
+
+		victim = &(farm -> workers[(thief -> id - 1 + i) % farm -> threads]);
+
+		pthread_mutex_lock(&(victim -> lock));
+		if (victim -> head < victim -> tail)
+			job = farm -> order[(victim -> head)++];
+		pthread_mutex_unlock(&(victim -> lock));
+	}
+
+	if (job != NO_JOB)
+		thief -> steals++;
+
+	return job;
+
+}
+
+
+
+/*
+ *	Runs a job on a cpu and checks its output.
+ *
+ *	param cpu - Pointer to the cpu of the worker.
+ *	param jit - Pointer to the translator of the cpu (NULL to interpret).
+ *	param job - Pointer to the job.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ */
+void run_job(cpu_state *cpu, jit_state *jit, farm_job *job, long limit){
+
+	FILE *in = NULL, *out = NULL, *expected = NULL;
+
+	if (job -> image == NULL)
+		strcpy(job -> reason, "the .ob file can't be read");
+	else if (strcmp(job -> input, FARM_NO_FILE) != 0 && !(in = fopen(job -> input, "r")))
+		strcpy(job -> reason, "cannot open the input file");
+	else if (strcmp(job -> expected, FARM_NO_FILE) != 0 && !(expected = fopen(job -> expected, "r")))
+		strcpy(job -> reason, "cannot open the expected output file");
+	else if (!(out = tmpfile()))
+		strcpy(job -> reason, "can't create a temporary file");
+	else {
+		cpu -> in = in;
+		cpu -> out = out;
+		load_image(cpu, job -> image);
+
+		if (jit != NULL)
+			run_cpu_jit(cpu, jit, limit);
+		else
+			run_cpu(cpu, limit);
+
+		job -> executed = cpu -> executed;
+
+		if (cpu -> status == cpu_fault)
+			sprintf(job -> reason, "cpu fault at %.*s", FARM_REASON_LEN - 14, cpu -> fault);
+		else if (cpu -> status == cpu_limit)
+			sprintf(job -> reason, "the instructions limit was reached at address %d", cpu -> pc);
+		else if (expected != NULL && !compare_output(out, expected))
+			strcpy(job -> reason, "the output differs from the expected output");
+		else
+			job -> is_passed = 1;
+	}
+
+	if (in != NULL)
+		fclose(in);
+	if (out != NULL)
+		fclose(out);
+	if (expected != NULL)
+		fclose(expected);
+
+}
+
+
+
+/*
+ *	Compares the output of a job with the expected output.
+ *
+ *	param out - The output of the job.
+ *	param expected - The expected output.
+ *	returns 1 if they are the same, 0 otherwise.
+ */
+int compare_output(FILE *out, FILE *expected){
+
+	int c, e;
+
+	rewind(out);
+
+	do {
+		c = getc(out);
+		e = getc(expected);
+	} while (c == e && c != EOF);
+
+	return c == e;
+
+}
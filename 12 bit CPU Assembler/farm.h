@@ -0,0 +1,30 @@
+/*
+ *	File: farm.h
+ *
+ *	Defines the data structures and function prototypes of the batch emulator (--farm option).
+ *	A manifest has a job in every line - a .ob file, an input file and an expected output file
+ *	("-" for no input or for no output check). The jobs run on a pool of worker threads.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define MAX_FARM_THREADS 64
+#define FARM_NO_FILE "-" /* no input file or no expected output file */
+#define FARM_REASON_LEN 100 /* maximum length of the failure reason of a job */
+#define FIRST_JOBS_SIZE 64 /* initial size of the jobs array (doubled when full) */
+
+typedef struct {
+	cpu_image *image; /* the image of the .ob file (shared by the jobs of the file, NULL if not read) */
+	char *ob_name; /* the names are in one allocation that starts at ob_name */
+	char *input;
+	char *expected;
+	int line; /* the line of the job in the manifest */
+	int worker; /* the worker that ran the job */
+	long executed; /* number of cycles (an instruction is a cycle) */
+	int is_passed;
+	char reason[FARM_REASON_LEN]; /* why the job failed */
+} farm_job;
+
+/* functions prototype */
+int run_farm(char *, int, long, int, int);
@@ -4,20 +4,58 @@
  *  This source file contains the implementation of the first_run function,
  *	which is responsible for processing the input assembly file during the first run of the assembler.
  *	It handles label definitions, instruction and directive processing, and performs various error checks.
+ *	The lines are read in chunks, each chunk is parsed (optionally by several threads, since every line
+ *	is parsed independently) and then passed sequentially to define the labels and assign the addresses.
+ *	The first chunk is small and every full chunk doubles the next one, so a short file allocates buffers
+ *	for a few lines only.
  *  
  *  author: Gal Levi
  *  version: 5.8.23
  */
 
 
+#define _POSIX_C_SOURCE 200112L /* for pthreads in ansi mode */
+
+#include <pthread.h>
 #include "macro_list.h"
 #include "labels_BST.h"
 #include "ast.h"
+#include "encoder.h"
+#include "snapshot.h"
+#include "incbin.h"
+#include "stats.h"
+#include "trace.h"
+#include "diag.h"
 
 /* macro definitions */
 #define L_INS_TWO_REGS 2 /* number of memory words for instructions with two registers */
+#define L_INS_TWO_PARAMS 3 /* number of memory words for instructions with two parameters */
+#define L_INS_ONE_PARAM 2 /* number of memory words for instructions with one parameter */
 #define L_INS_NO_PARAMS 1 /* number of memory words for instructions with no parameters */
 #define ENLARGE_SIZE *err_ln_size_add += sizeof(int) /* size increase for error line number array */
+#define PARSE_CHUNK_LINES 4096 /* maximum number of lines that are parsed together before the sequential pass */
+#define FIRST_CHUNK_LINES 64 /* number of lines of the first chunk of a file */
+#define MAX_PARSE_THREADS 64 /* maximum number of parsing threads */
+
+typedef struct { /* a range of lines in the current chunk that is parsed by one thread */
+	char (*lines)[MAX_BUFFER];
+	ast *asts;
+	int *ic_words; /* number of code words of each line */
+	int *dc_words; /* number of data words of each line */
+	int first, last; /* the range is [first, last) */
+	int worker; /* the trace thread id of the thread that parses the range */
+} parse_job;
+
+/* functions prototype */
+int first_run_stream(FILE *, char *, symbol_table_node **, macro_node **, int *, int *, int **, int *, int);
+int define_line_labels(ast *, int, int, symbol_table_node **, macro_node *, int *, int *, char *, int);
+void count_line_words(ast *, int *, int *);
+
+/* exclusive functions prototype */
+int read_lines_chunk(FILE *, char (*)[MAX_BUFFER], int);
+void alloc_chunk_buffers(int, char (**)[MAX_BUFFER], ast **, int **, int **);
+void parse_lines_chunk(char (*)[MAX_BUFFER], ast *, int *, int *, int, int);
+void *parse_lines_range(void *);
 
 
 
@@ -36,23 +74,15 @@
  *  param dc_add - Pointer to the data counter.
  *  param err_ln_add - Pointer to an array storing error line numbers.
  *  param err_ln_size_add - Pointer to the size of the errors line array.
+ *  param threads - Number of threads that parse the lines of each chunk (1 parses in the calling thread).
  *  returns 1 if the first run processing is successful, -1 if there is a memory overflow and 0 otherwise.
  */
 int first_run(char *file_name, symbol_table_node **label_root_add, macro_node **head_add,
-			 int *ic_add, int *dc_add, int **err_ln_add, int *err_ln_size_add){
+			 int *ic_add, int *dc_add, int **err_ln_add, int *err_ln_size_add, int threads){
 
-	int line_num = 0, is_valid = 1, is_line_valid = 1, i;
+	int is_valid;
 	FILE *src;
-	char src_name[MAX_BUFFER], curr_line[MAX_BUFFER]; /* MAX_BUFFER = 1024 */
-	ast curr_line_ast;
-	symbol_table_node *curr_search_res;
-	
-	(*err_ln_add) = (int *)calloc(*err_ln_size_add, 0);
-	
-	if (!(*err_ln_add)){
-		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - first run");
-        exit(1);
-	}
+	char src_name[MAX_BUFFER]; /* MAX_BUFFER = 1024 */
 	
 	sprintf(src_name, "%s.am", file_name);
 	
@@ -63,245 +93,522 @@ int first_run(char *file_name, symbol_table_node **label_root_add, macro_node **
 		
 	}
 	
-	memset(curr_line, '\0', MAX_BUFFER); /* "clears" curr_line junk characters */
+	is_valid = first_run_stream(src, src_name, label_root_add, head_add, ic_add, dc_add, err_ln_add,
+								err_ln_size_add, threads);
 	
-	/* runs on the file */
-	while (fgets(curr_line, MAX_BUFFER, src) != NULL){
-		
-		line_num++; /* test.am file line counter */
+	fclose(src);
+	return is_valid;
+}
+
+
+
+/*
+ *  Processes the first run on an expanded source stream (the core of the first run).
+ *  It is used for .am files and for the in memory sources of the check mode (--check option).
+ *
+ *  param src - The expanded source stream.
+ *  param src_name - The name of the source (for error messages).
+ *  param label_root_add - Pointer to the root of the symbol table.
+ *  param head_add - Pointer to the head of the macro linked list.
+ *  param ic_add - Pointer to the instruction counter.
+ *  param dc_add - Pointer to the data counter.
+ *  param err_ln_add - Pointer to an array storing error line numbers.
+ *  param err_ln_size_add - Pointer to the size of the errors line array.
+ *  param threads - Number of threads that parse the lines of each chunk (1 parses in the calling thread).
+ *  returns 1 if the first run processing is successful, -1 if there is a memory overflow and 0 otherwise.
+ */
+int first_run_stream(FILE *src, char *src_name, symbol_table_node **label_root_add, macro_node **head_add,
+					 int *ic_add, int *dc_add, int **err_ln_add, int *err_ln_size_add, int threads){
+
+	int line_num = 0, is_valid = 1, is_line_valid = 1, j, lines_cnt, chunk_size = FIRST_CHUNK_LINES;
+	int *ic_words = NULL, *dc_words = NULL;
+	double read_start = trace_clock();
+	char (*lines)[MAX_BUFFER] = NULL; /* MAX_BUFFER = 1024 */
+	ast *asts = NULL, *curr_line_ast;
+	
+	(*err_ln_add) = (int *)counted_calloc(*err_ln_size_add, 0);
+	
+	if (!(*err_ln_add)){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - first run");
+        exit(1);
+	}
+	
+	reset_snapshot_externs(); /* the externals of the snapshot that the previous file declared */
+	
+	/* allocates the buffers of the first chunk (lines, their asts and their sizes in memory words) */
+	alloc_chunk_buffers(chunk_size, &lines, &asts, &ic_words, &dc_words);
+	
+	/* runs on the file chunk by chunk (until the file has too many errors) */
+	while (!is_diag_limit_reached() && (lines_cnt = read_lines_chunk(src, lines, chunk_size)) > 0){
+	
+		trace_span("read chunk", "io", read_start, trace_clock(), TRACE_MAIN_TID);
+	
+		/* parses the lines of the chunk and computes their sizes */
+		parse_lines_chunk(lines, asts, ic_words, dc_words, lines_cnt, threads);
+		add_stat_counter(stat_lines, lines_cnt);
+	
+		/* sequential pass - defines the labels and assigns the addresses (running sum of the sizes) */
+		for (j = 0; j < lines_cnt && !is_diag_limit_reached(); j++){
 		
-		is_line_valid = 1;
+			line_num++; /* test.am file line counter */
 		
-		curr_line_ast = get_ast(curr_line);
+			curr_line_ast = &asts[j];
 		
+			/* checks the line, defines its labels and adds its size to the counters */
+			is_line_valid = define_line_labels(curr_line_ast, ic_words[j], dc_words[j], label_root_add,
+												*head_add, ic_add, dc_add, src_name, line_num);
 		
-		/* if the line is empty or a comment, skips it */
-		if (curr_line_ast.ast_union_option == ast_union_empty_line ||
-			curr_line_ast.ast_union_option == ast_union_comment_line)
-			continue;
+			if (!is_line_valid){
+			
+				(*err_ln_add) = counted_realloc(*err_ln_add, ENLARGE_SIZE); /* ENLARGE_SIZE = err_ln_size += sizeof(int) */
 			
-		/* errors check */
+				(*err_ln_add)[((*err_ln_size_add)/sizeof(int)) - 1] = line_num;
+			
+				if (is_valid)
+					is_valid = 0;
+		
+			}
+		
+		} /* end of sequential pass */
 		
-		/* if there is a label definition in current line */
-		if (curr_line_ast.label_def_flag){
+		/* a full chunk - the next one is twice as large (up to PARSE_CHUNK_LINES) */
+		if (lines_cnt == chunk_size && chunk_size < PARSE_CHUNK_LINES){
+			chunk_size *= 2;
+			alloc_chunk_buffers(chunk_size, &lines, &asts, &ic_words, &dc_words);
+		}
 		
-			/* if the current line label is a macro */
-			if (is_macro_exist(*head_add, curr_line_ast.label)){
+		read_start = trace_clock();
+	}
+	
+	free(lines);
+	free(asts);
+	free(ic_words);
+	free(dc_words);
+	
+	
+	if ((*ic_add + *dc_add) > MAX_MEMORY_ASSUMPTION){
+	
+		errprintf(src_name, NO_LINE_ERROR, "memory overflow - the maximum memory you can use is %d memory words but you exceeded it and reached %d.", MAX_MEMORY_ASSUMPTION, (*ic_add + *dc_add));
+		is_valid = -1; /* flag indicating there is a memory error */
+	
+	}
+	
+	
+	/* the used externals of the snapshot become external labels of the table */
+	resolve_snapshot_externs(*label_root_add);
+	
+	/* adding ic for all directive labels */
+	if (is_valid == 1)
+		increase_labels_value_by_comm(*label_root_add, *ic_add, enum_dir);
+	
+	
+	return is_valid;
+}
+
+
+
+/*
+ *  Handles one parsed line in the sequential pass of the first run.
+ *  It checks the label definition of the line against the symbol table, inserts the defined and used labels
+ *  into the table and adds the size of the line to the instructions (IC) and data (DC) counters.
+ *
+ *  param curr_line_ast - The ast of the line.
+ *  param ic_words - The number of code words of the line.
+ *  param dc_words - The number of data words of the line (an incbin directive gets it from its file).
+ *  param label_root_add - Pointer to the root of the symbol table.
+ *  param head - The head of the macro linked list.
+ *  param ic_add - Pointer to the instruction counter.
+ *  param dc_add - Pointer to the data counter.
+ *  param src_name - The name of the source (for error messages).
+ *  param line_num - The number of the line.
+ *  returns 1 if the line is valid, 0 otherwise.
+ */
+int define_line_labels(ast *curr_line_ast, int ic_words, int dc_words, symbol_table_node **label_root_add,
+						macro_node *head, int *ic_add, int *dc_add, char *src_name, int line_num){
+
+	int is_line_valid = 1, i;
+	symbol_table_node *curr_search_res;
+	
+	/* if the line is empty or a comment, skips it */
+	if (curr_line_ast -> ast_union_option == ast_union_empty_line ||
+		curr_line_ast -> ast_union_option == ast_union_comment_line)
+		return 1;
+	
+	/* errors check */
+
+	/* if there is a label definition in current line */
+	if (curr_line_ast -> label_def_flag){
+
+		/* if the current line label is a macro */
+		if (is_macro_exist(head, curr_line_ast -> label)){
+	
+			errprintf(src_name, line_num, "the label '%s' is already a defined macro - label definition", curr_line_ast -> label);
+			is_line_valid = 0;
+		}
+		/* if the current line label is already in the table */
+		else if ((curr_search_res = search_label(*label_root_add, curr_line_ast -> label))){
+	
+			if (curr_search_res -> comm == enum_comm_none){ /* if the label command is none (external or entry label) */
+				if (curr_search_res -> type == enum_extl || /* if the label is external (or a used external of the snapshot) */
+					(curr_search_res -> type == enum_type_none && is_snapshot_extern(curr_line_ast -> label))){
+				
+					errprintf(src_name, line_num, "the label '%s' is already declared as external and could not be defined as local", curr_line_ast -> label);
+					is_line_valid = 0;
 			
-				errprintf(src_name, line_num, "the label '%s' is already a defined macro - label definition", curr_line_ast.label);
+				}
+			}
+			else { /* if the label command is instruction or directive */
+				errprintf(src_name, line_num, "the label '%s' is already defined", curr_line_ast -> label);
 				is_line_valid = 0;
 			}
-			/* if the current line label is already in the table */
-			else if ((curr_search_res = search_label(*label_root_add, curr_line_ast.label))){
-			
-				if (curr_search_res -> comm == enum_comm_none){ /* if the label command is none (external or entry label) */
-					if (curr_search_res -> type == enum_extl){ /* if the label is external */
-						
-						errprintf(src_name, line_num, "the label '%s' is already declared as external and could not be defined as local", curr_line_ast.label);
-						is_line_valid = 0;
-					
-					}
-				}
-				else { /* if the label command is instruction or directive */
-					errprintf(src_name, line_num, "the label '%s' is already defined", curr_line_ast.label);
-					is_line_valid = 0;
-				}
-			}	
-			
 		}
+		/* if the label is an external of the snapshot that was declared and not used yet */
+		else if (is_snapshot_extern(curr_line_ast -> label)){
 		
-		/* if there is already an error in ast checks */
-		if (is_line_valid && curr_line_ast.ast_union_option == ast_union_error){ 
-			
-			errprintf(src_name, line_num, curr_line_ast.ast_error);
+			errprintf(src_name, line_num, "the label '%s' is already declared as external and could not be defined as local", curr_line_ast -> label);
 			is_line_valid = 0;
 		}
+	
+	}
+
+	/* if there is already an error in ast checks */
+	if (is_line_valid && curr_line_ast -> ast_union_option == ast_union_error){ 
+	
+		errprintf(src_name, line_num, "%s", curr_line_ast -> ast_error);
+		is_line_valid = 0;
+	}
+
+	/* that's all the errors for now */
+	
+	/* instructions case */
+	if (is_line_valid && curr_line_ast -> ast_union_option == ast_union_ins){
+	
+		if (curr_line_ast -> label_def_flag)
+			/* iserts the label in the table */
+			*label_root_add = insert_label(*label_root_add, curr_line_ast -> label, *ic_add, enum_rel, enum_ins);
+	
+		
+		/* 2 parameters instructions case (mov, cmp, add, sub, lea) */
+		if (curr_line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_mov &&
+			curr_line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
+		
+			/* the operand words come right after the first word(the instruction command) */
+			for (i = 0; i < 2; i++){
+				/* if the parameters are labels */
+				if (curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i] == ast_op_type_label)
+					*label_root_add = insert_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i].label, *ic_add + 1 + i, enum_type_none, enum_comm_none);
+			}
+		
+		}
 		
-		/* that's all the errors for now */
-			
-		/* instructions case */
-		if (is_line_valid && curr_line_ast.ast_union_option == ast_union_ins){
+		/* one parameter instructions case */
+		else if (curr_line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_not &&
+			curr_line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr){
+		
+			if (curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote == ast_op_type_label)
+				*label_root_add = insert_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.label, *ic_add + 1, enum_type_none, enum_comm_none);
+		
+		}
+	
+		*ic_add += ic_words; /* adds the size of the instruction (computed while parsing) */
+		
+	} /* end of instructions case */
+
+
+	/* directives case */
+	else if (is_line_valid && curr_line_ast -> ast_union_option == ast_union_dir){
+	
+		/* if it is string, data or incbin directives */
+		if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string ||
+			curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_data ||
+			curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_incbin){
+		
+			/* the size of an incbin directive is the size of its file (only the file status is read) */
+			if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_incbin &&
+				!get_incbin_words(curr_line_ast, src_name, line_num, &dc_words))
+				return 0;
+		
+			if (curr_line_ast -> label_def_flag)
+				*label_root_add = insert_label(*label_root_add, curr_line_ast -> label, *dc_add, enum_rel, enum_dir);
+		
+			*dc_add += dc_words; /* adds the size of the string/data (computed while parsing) */
+
+		}
+	
+		/* if it is an entry declaration */
+		else if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry){
+	
+			if (curr_line_ast -> label_def_flag) /* if there is a label defiition in entry definition line */
+				warnprintf(src_name, line_num, "the label '%s' has no meaning - label definition on entry declaration", curr_line_ast -> label);
+		
+			/* if the entry label is already exist in the table */
+			if ((curr_search_res = search_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.label))){
 			
-			if (curr_line_ast.label_def_flag)
-				/* iserts the label in the table */
-				*label_root_add = insert_label(*label_root_add, curr_line_ast.label, *ic_add, enum_rel, enum_ins);
+				/* if the exist label type is external (or a used external of the snapshot) */
+				if (curr_search_res -> type == enum_extl ||
+					(curr_search_res -> type == enum_type_none && is_snapshot_extern(curr_search_res -> label))){
 			
-				
-			/* 2 parameters instructions case (mov, cmp, add, sub, lea) */
-			if (curr_line_ast.ast_union_ins_dir.ast_ins.ins >= ast_ins_mov &&
-				curr_line_ast.ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
-				
-				/* if the 2 parameters are registers */
-				if (curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[0] == ast_op_type_reg &&
-					curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[1] == ast_op_type_reg)
-					*ic_add += L_INS_TWO_REGS; /* two registers are sharing one memory word */
-				
-				else { 
-					(*ic_add)++; /* adds to count the first word(the instruction command) */
-					
-					for (i = 0; i < 2; i++){
-						/* if the parameters are labels */
-						if (curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i] == ast_op_type_label)
-							*label_root_add = insert_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i].label, *ic_add, enum_type_none, enum_comm_none);
-						
-						(*ic_add)++;
-					}
+					errprintf(src_name, line_num, "the label '%s' is already declared as extern and could not be redeclared as entry", curr_search_res -> label);
+					is_line_valid = 0;
 				}
+			
+				else if (curr_search_res -> type == enum_rel) /* if the type is relocatable - updates the type to entry*/
 				
+					update_label_type(curr_search_res, enum_ent);
+		
+		
 			}
-				
-			/* one parameter instructions case */
-			else if (curr_line_ast.ast_union_ins_dir.ast_ins.ins >= ast_ins_not &&
-				curr_line_ast.ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr){
-				(*ic_add)++; /* adds to count the first word(the instruction command */
-				
-				if (curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote == ast_op_type_label)
-					*label_root_add = insert_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.label, *ic_add, enum_type_none, enum_comm_none);
-						
-				(*ic_add)++;
-				
+			/* if the label is an external of the snapshot that was declared and not used yet */
+			else if (is_snapshot_extern(curr_line_ast -> ast_union_ins_dir.ast_dir.dir.label)){
+			
+				errprintf(src_name, line_num, "the label '%s' is already declared as extern and could not be redeclared as entry", curr_line_ast -> ast_union_ins_dir.ast_dir.dir.label);
+				is_line_valid = 0;
 			}
-				
-			else /* not parameters instructions case */
-				
-				*ic_add += L_INS_NO_PARAMS;
-				
-				
-		} /* end of instructions case */
-		
 		
-		/* directives case */
-		else if (is_line_valid && curr_line_ast.ast_union_option == ast_union_dir){
+			/* else - the label is not in the table or not defined yet or already declared as entry */
+			if (is_line_valid)
+				*label_root_add = insert_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.label, NO_VALUE, enum_ent, enum_comm_none);
 			
-			/* if it is string or data directives */
-			if (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string ||
-				curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_data){
-				
-				if (curr_line_ast.label_def_flag)
-					*label_root_add = insert_label(*label_root_add, curr_line_ast.label, *dc_add, enum_rel, enum_dir);
-				
-				
-				/* if it is string directive */
-				if (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string){
-					
-					/* +1 for '\0' */
-					*dc_add += (strlen(curr_line_ast.ast_union_ins_dir.ast_dir.dir.string) + 1);
-				}
-				
-				/* if it is data directive */
-				else
-					*dc_add += curr_line_ast.ast_union_ins_dir.ast_dir.dir.data_num_array.num_count;
+			
+		}
+		else { /* if it is extern declaration */
+	
+			if (curr_line_ast -> label_def_flag) /* if there is a label defiition in entry definition line */
+				warnprintf(src_name, line_num, "the label '%s' has no meaning - label definition on extern declaration", curr_line_ast -> label);
+	
+			/* runs on extern label array */
+			for (i = 0; is_line_valid && i < curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels_count; i++){
 		
-			}
+				/* if the extern label is already exist in the table */
+				if ((curr_search_res = search_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]))){
 			
-			/* if it is an entry declaration */
-			else if (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry){
+					/* if the exist label type is entry */
+					if (curr_search_res -> type == enum_ent){
 			
-				if (curr_line_ast.label_def_flag) /* if there is a label defiition in entry definition line */
-					warnprintf(src_name, line_num, "the label '%s' has no meaning - label definition on entry declaration", curr_line_ast.label);
-				
-				/* if the entry label is already exist in the table */
-				if ((curr_search_res = search_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_dir.dir.label))){
-					
-					/* if the exist label type is external */
-					if (curr_search_res -> type == enum_extl){
-					
-						errprintf(src_name, line_num, "the label '%s' is already declared as extern and could not be redeclared as entry", curr_search_res -> label);
+						errprintf(src_name, line_num, "the label '%s' is already declared as entry and could not be redeclared as external", curr_search_res -> label);
 						is_line_valid = 0;
-					}
-					
-					else if (curr_search_res -> type == enum_rel) /* if the type is relocatable - updates the type to entry*/
-						
-						update_label_type(curr_search_res, enum_ent);
-				
-				
-				}
-				
-				/* else - the label is not in the table or not defined yet or already declared as entry */
-				if (is_line_valid)
-					*label_root_add = insert_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_dir.dir.label, NO_VALUE, enum_ent, enum_comm_none);
-					
-					
-			}
-			else { /* if it is extern declaration */
 			
-				if (curr_line_ast.label_def_flag) /* if there is a label defiition in entry definition line */
-					warnprintf(src_name, line_num, "the label '%s' has no meaning - label definition on extern declaration", curr_line_ast.label);
+					}
 			
-				/* runs on extern label array */
-				for (i = 0; is_line_valid && i < curr_line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels_count; i++){
-				
-					/* if the extern label is already exist in the table */
-					if ((curr_search_res = search_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]))){
-					
-						/* if the exist label type is entry */
-						if (curr_search_res -> type == enum_ent){
-					
-							errprintf(src_name, line_num, "the label '%s' is already declared as entry and could not be redeclared as external", curr_search_res -> label);
-							is_line_valid = 0;
-					
-						}
-					
-						else if (curr_search_res -> type == enum_rel) { /* if the type is rellocation */
-						
-							errprintf(src_name, line_num, "the label '%s' is already defined as local and could not be declared as external", curr_search_res -> label);
-							is_line_valid = 0;
-						}
-				
+					else if (curr_search_res -> type == enum_rel) { /* if the type is rellocation */
 				
+						errprintf(src_name, line_num, "the label '%s' is already defined as local and could not be declared as external", curr_search_res -> label);
+						is_line_valid = 0;
 					}
-					
-					/* else - the label is not in the table or not defined yet or already declared as external */
-					if (is_line_valid)
-						*label_root_add = insert_label(*label_root_add, curr_line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i], NO_VALUE, enum_extl, enum_comm_none);
-				
-				
-				
-				
-				} /* end of for */
-				
-			
-			}
 		
 		
+				}
+			
+				/* else - the label is not in the table or not defined yet or already declared as external
+				   (a label of the snapshot that is not in the table is only marked as declared) */
+				if (is_line_valid && (curr_search_res ||
+					!declare_snapshot_extern(curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i])))
+					*label_root_add = insert_label(*label_root_add, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i], NO_VALUE, enum_extl, enum_comm_none);
 		
 		
 		
-		} /* end of directives case */
 		
-		if (!is_line_valid){
-			
-			(*err_ln_add) = realloc(*err_ln_add, ENLARGE_SIZE); /* ENLARGE_SIZE = err_ln_size += sizeof(int) */
-			
-			(*err_ln_add)[((*err_ln_size_add)/sizeof(int)) - 1] = line_num;
-			
-			if (is_valid)
-				is_valid = 0;
+			} /* end of for */
 		
+	
 		}
-		
-		
-		memset(curr_line, '\0', MAX_BUFFER);
+
+
+
+
+
+	} /* end of directives case */
+	
+	return is_line_valid;
+
+}
+
+
+
+/*
+ *  Reads the next chunk of lines from the file.
+ *
+ *  param src - The file to read from.
+ *  param lines - Array of buffers to store the lines.
+ *  param size - The number of buffers.
+ *  returns the number of lines that were read (0 at the end of the file).
+ */
+int read_lines_chunk(FILE *src, char (*lines)[MAX_BUFFER], int size){
+
+	int cnt = 0;
+	
+	while (cnt < size && fgets(lines[cnt], MAX_BUFFER, src) != NULL)
+		cnt++;
+	
+	return cnt;
+
+}
+
+
+
+/*
+ *  Allocates (or enlarges) the buffers of a chunk - the lines, their asts and their sizes in memory words.
+ *  The contents are not kept (the previous chunk is already passed).
+ *
+ *  param size - The number of lines of the chunk.
+ *  param lines_add - Pointer to the lines buffers (NULL before the first chunk).
+ *  param asts_add - Pointer to the asts.
+ *  param ic_words_add - Pointer to the numbers of code words.
+ *  param dc_words_add - Pointer to the numbers of data words.
+ */
+void alloc_chunk_buffers(int size, char (**lines_add)[MAX_BUFFER], ast **asts_add, int **ic_words_add,
+						 int **dc_words_add){
+
+	free(*lines_add);
+	free(*asts_add);
+	free(*ic_words_add);
+	free(*dc_words_add);
+	
+	*lines_add = (char (*)[MAX_BUFFER])counted_malloc(sizeof(**lines_add) * size);
+	*asts_add = (ast *)counted_malloc(sizeof(ast) * size);
+	*ic_words_add = (int *)counted_malloc(sizeof(int) * size);
+	*dc_words_add = (int *)counted_malloc(sizeof(int) * size);
+	
+	if (!*lines_add || !*asts_add || !*ic_words_add || !*dc_words_add){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - first run");
+        exit(1);
 	}
+
+}
+
+
+
+/*
+ *  Parses the lines of a chunk into asts and computes the number of memory words of each line.
+ *  The lines are independent, so the chunk is divided into contiguous ranges that are parsed by
+ *  separate threads. If a thread cannot be created, its range is parsed by the calling thread.
+ *
+ *  param lines - The lines of the chunk.
+ *  param asts - Array to store the ast of each line.
+ *  param ic_words - Array to store the number of code words of each line.
+ *  param dc_words - Array to store the number of data words of each line.
+ *  param cnt - The number of lines in the chunk.
+ *  param threads - The number of threads to use.
+ */
+void parse_lines_chunk(char (*lines)[MAX_BUFFER], ast *asts, int *ic_words, int *dc_words, int cnt,
+						int threads){
 	
+	pthread_t tids[MAX_PARSE_THREADS];
+	parse_job jobs[MAX_PARSE_THREADS];
+	int is_created[MAX_PARSE_THREADS], i;
 	
-	if ((*ic_add + *dc_add) > MAX_MEMORY_ASSUMPTION){
+	if (threads > MAX_PARSE_THREADS)
+		threads = MAX_PARSE_THREADS;
 	
-		errprintf(src_name, NO_LINE_ERROR, "memory overflow - the maximum memory you can use is %d memory words but you exceeded it and reached %d.", MAX_MEMORY_ASSUMPTION, (*ic_add + *dc_add));
-		is_valid = -1; /* flag indicating there is a memory error */
+	if (threads > cnt)
+		threads = cnt;
+	
+	for (i = 0; i < threads || i == 0; i++){
 	
+		jobs[i].lines = lines;
+		jobs[i].asts = asts;
+		jobs[i].ic_words = ic_words;
+		jobs[i].dc_words = dc_words;
+		jobs[i].first = threads > 1 ? (int)((long)cnt * i / threads) : 0;
+		jobs[i].last = threads > 1 ? (int)((long)cnt * (i + 1) / threads) : cnt;
+		jobs[i].worker = threads > 1 ? i + 1 : TRACE_MAIN_TID;
 	}
 	
+	if (threads <= 1){ /* parses the whole chunk in the calling thread */
+		parse_lines_range(&jobs[0]);
+		return;
+	}
 	
-	/* adding ic for all directive labels */
-	if (is_valid == 1)
-		increase_labels_value_by_comm(*label_root_add, *ic_add, enum_dir);
+	set_alloc_counting(0); /* the counters are not shared by the threads */
+	for (i = 0; i < threads; i++)
+		is_created[i] = pthread_create(&tids[i], NULL, parse_lines_range, &jobs[i]) == 0;
+		
+	for (i = 0; i < threads; i++){
+		if (is_created[i])
+			pthread_join(tids[i], NULL);
+		else { /* the thread was not created - parses its range in the calling thread */
+			jobs[i].worker = TRACE_MAIN_TID;
+			parse_lines_range(&jobs[i]);
+		}
+	}
+	set_alloc_counting(1);
+
+}
+
+
+
+/*
+ *  Parses a range of lines (thread routine).
+ *
+ *  param job_add - Pointer to the parse_job that describes the range.
+ *  returns NULL.
+ */
+void *parse_lines_range(void *job_add){
+
+	parse_job *job = (parse_job *)job_add;
+	int i;
+	double start = trace_clock();
+	
+	for (i = job -> first; i < job -> last; i++){
+	
+		job -> asts[i] = get_ast(job -> lines[i]);
+		count_line_words(&(job -> asts[i]), &(job -> ic_words[i]), &(job -> dc_words[i]));
+	}
 	
+	trace_span("parse lines", "worker", start, trace_clock(), job -> worker);
 	
+	return NULL;
 
-	fclose(src);
-	return is_valid;
 }
 
 
 
+/*
+ *  Computes the number of memory words of a line from its ast alone.
+ *
+ *  param line_ast - The ast of the line.
+ *  param ic_words_add - Pointer to store the number of code words.
+ *  param dc_words_add - Pointer to store the number of data words.
+ */
+void count_line_words(ast *line_ast, int *ic_words_add, int *dc_words_add){
+
+	*ic_words_add = 0;
+	*dc_words_add = 0;
+	
+	/* instructions case */
+	if (line_ast -> ast_union_option == ast_union_ins){
+	
+		/* 2 parameters instructions case (mov, cmp, add, sub, lea) */
+		if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_mov &&
+			line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
+			
+			/* if the 2 parameters are registers */
+			if (line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[0] == ast_op_type_reg &&
+				line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[1] == ast_op_type_reg)
+				*ic_words_add = L_INS_TWO_REGS; /* two registers are sharing one memory word */
+			else
+				*ic_words_add = L_INS_TWO_PARAMS;
+		}
+		
+		/* one parameter instructions case */
+		else if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_not &&
+				line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr)
+			*ic_words_add = L_INS_ONE_PARAM;
+		
+		else /* not parameters instructions case */
+			*ic_words_add = L_INS_NO_PARAMS;
+	}
+	
+	/* directives case */
+	else if (line_ast -> ast_union_option == ast_union_dir){
+	
+		/* if it is string directive (+1 for '\0') */
+		if (line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string)
+			*dc_words_add = strlen(line_ast -> ast_union_ins_dir.ast_dir.dir.string) + 1;
+			
+		/* if it is data directive */
+		else if (line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_data)
+			*dc_words_add = line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.num_count;
+	}
+
+}
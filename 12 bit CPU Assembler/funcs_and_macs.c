@@ -2,8 +2,8 @@
  *	File: funcs_and_macs.c
  *
  *  This file contains various utility functions used throughout the assembler program.
- *	These include string manipulation, whitespace handling, error and warning printing functions,
- *	and ANSI escape codes for text formatting and color.
+ *	These include string manipulation, whitespace handling and the error and warning printing functions
+ *	(which report to the diagnostics engine in diag.c).
  *	The functions defined here are used to perform common tasks and improve the readability of the code.
  *
  *  author: Gal Levi
@@ -11,15 +11,22 @@
  */
 
 
-#include "funcs_and_macs.h"
-#include <stdarg.h>
+#include <limits.h>
+#include "diag.h"
 
 /* macro definitions */
 #define RES_WORDS_NUM 28 /* number of reserved words in the assembly language */
-#define ANSI_COLOR_RED     "\x1b[31m" /* ANSI escape code for red text color */
-#define ANSI_COLOR_PURPLE  "\x1b[35m" /* ANSI escape code for purple text color */
-#define ANSI_BOLD          "\x1b[1m" /* ANSI escape code for bold text style */
-#define ANSI_STYLE_RESET   "\x1b[0m" /* ANSI escape code to reset text style and color */
+#define SWAR_HIGH_NIBBLES 0xF0F0F0F0UL /* the high nibbles of 4 packed characters */
+#define SWAR_DIGITS_HIGH 0x30303030UL /* the high nibbles of 4 digits ('0' in every byte) */
+#define SWAR_ADD_SIX 0x06060606UL /* a digit stays below 0x40 after adding 6, the characters after '9' do not */
+#define SWAR_LOW_BYTE 0xFFUL
+
+/* allocation counters of the counted allocation functions (reported by --stats). They are not atomic, so
+   they count only in a single thread - the code that starts worker threads turns the counting off until
+   it joins them (set_alloc_counting) */
+static long alloc_cnt = 0;
+static long alloc_bytes = 0;
+static int is_alloc_counted = 1;
 
 
 
@@ -172,6 +179,72 @@ int is_num(char *str){
 
 }
 
+/*
+ *  Parses a signed decimal integer from a token (pointer and length, the token is not copied) in one pass,
+ *  and checks its range on the way. Runs of 4 digits are converted together - the 4 characters are packed
+ *  into a 32 bit word, checked to be digits at once and combined by two multiplications (SWAR).
+ *  Like is_num and atoi, a sign without digits is 0.
+ *
+ *  param str - A pointer to the first character of the token.
+ *  param len - The length of the token.
+ *  param min - The minimum value of the range.
+ *  param max - The maximum value of the range.
+ *  param value_add - Pointer to store the value (a value that does not fit an int is saturated).
+ *  returns NUM_INVALID if the token is not an integer, NUM_OUT_OF_RANGE if it is out of the range and
+ *  NUM_VALID otherwise.
+ */
+int parse_num(const char *str, int len, int min, int max, int *value_add){
+	
+	const char *end = str + len;
+	unsigned long word, value = 0, limit;
+	long signed_value;
+	int is_negative = 0;
+	
+	if (str < end && (*str == '-' || *str == '+')){
+		is_negative = *str == '-';
+		str++;
+	}
+	
+	limit = (unsigned long)INT_MAX + is_negative; /* the saturated magnitude */
+	
+	/* 4 digits at a time (the first character in the low byte) */
+	for (; end - str >= 4; str += 4){
+		
+		word = (unsigned long)(unsigned char)str[0] | (unsigned long)(unsigned char)str[1] << 8 |
+			   (unsigned long)(unsigned char)str[2] << 16 | (unsigned long)(unsigned char)str[3] << 24;
+		
+		if ((word & SWAR_HIGH_NIBBLES) != SWAR_DIGITS_HIGH || ((word + SWAR_ADD_SIX) & SWAR_HIGH_NIBBLES) != SWAR_DIGITS_HIGH)
+			return NUM_INVALID;
+		
+		word -= SWAR_DIGITS_HIGH; /* the digits values */
+		word = word * 10 + (word >> 8); /* byte 0 holds the first 2 digits and byte 2 the last 2 digits */
+		value = value > limit / 10000 ? limit :
+				value * 10000 + (word & SWAR_LOW_BYTE) * 100 + ((word >> 16) & SWAR_LOW_BYTE);
+		
+		if (value > limit)
+			value = limit;
+	}
+	
+	/* the rest of the digits */
+	for (; str < end; str++){
+		
+		if (!isdigit((unsigned char)*str))
+			return NUM_INVALID;
+		
+		value = value > limit / 10 ? limit : value * 10 + (*str - '0');
+		
+		if (value > limit)
+			value = limit;
+	}
+	
+	/* (value - 1) keeps the negation in the range of a 32 bit long */
+	signed_value = is_negative ? (value ? -(long)(value - 1) - 1 : 0) : (long)value;
+	*value_add = (int)signed_value;
+	
+	return signed_value < min || signed_value > max ? NUM_OUT_OF_RANGE : NUM_VALID;
+
+}
+
 /*
  *  Checks if a string is a reserved word.
  *
@@ -328,7 +401,8 @@ int is_comment(char *curr_line){
 /*
  *  Prints formatted error messages to stderr.
  *
- *  This function prints formatted error messages to the standard error stream (stderr).
+ *  This function reports formatted error messages to the diagnostics engine, which prints them to the
+ *  standard error stream (stderr).
  *
  *  param file_name - The name of the source file related to the error.
  *  param line - The line number related to the error, or NO_LINE_ERROR if not applicable.
@@ -339,15 +413,7 @@ void errprintf(const char file_name[], const int line, const char *error, ...) {
     va_list args;
     va_start(args, error);
 
-    if (strcmp(NO_FILE_ERROR, file_name))
-    	fprintf(stderr, "File " ANSI_BOLD "'%s': " ANSI_STYLE_RESET, file_name);
-    if (line != NO_LINE_ERROR)
-    	fprintf(stderr, "Line %d: ", line);
-    fprintf(stderr, ANSI_BOLD ANSI_COLOR_RED "Error: " ANSI_STYLE_RESET);
-
-    vfprintf(stderr, error, args);
-    
-    fprintf(stderr, "\n");
+    report_diag(file_name, line, diag_error, error, args);
 
     va_end(args);
 }
@@ -356,7 +422,8 @@ void errprintf(const char file_name[], const int line, const char *error, ...) {
 /*
  *  Prints formatted warning messages to stdout.
  *
- *  This function prints formatted warning messages to the standard output stream (stdout).
+ *  This function reports formatted warning messages to the diagnostics engine, which prints them to the
+ *  standard output stream (stdout), or to the stream that was set by set_warnings_stream.
  *
  *  param file_name - The name of the source file related to the warning.
  *  param line - The line number related to the warning.
@@ -367,12 +434,7 @@ void warnprintf(const char file_name[], const int line, const char *warning, ...
     va_list args;
     va_start(args, warning);
 
-    fprintf(stdout, "File " ANSI_BOLD "'%s': " ANSI_STYLE_RESET "Line %d: "
-            ANSI_BOLD ANSI_COLOR_PURPLE "Warning: " ANSI_STYLE_RESET, file_name, line);
-
-    vfprintf(stdout, warning, args);
-    
-    fprintf(stdout, "\n");
+    report_diag(file_name, line, diag_warning, warning, args);
 
     va_end(args);
 }
@@ -393,13 +455,158 @@ int check_length(char *line){
 
 
 
+/*
+ * Finds a file that a source refers to (an included file). A relative name is relative to the
+ * directory of the source.
+ *
+ * param src_name - The name of the source file.
+ * param name - The name of the file as written in the source.
+ * param len - The length of the name.
+ * param path - Buffer of MAX_BUFFER characters to store the path of the file.
+ * Returns 1 if the path fits in the buffer, otherwise returns 0.
+ */
+int get_relative_path(char *src_name, char *name, int len, char *path){
 
+	char *dir_end;
+	int dir_len = 0;
+	
+	if (*name != '/' && (dir_end = strrchr(src_name, '/')) != NULL)
+		dir_len = dir_end - src_name + 1;
+	
+	if (dir_len + len >= MAX_BUFFER)
+		return 0;
+	
+	sprintf(path, "%.*s%.*s", dir_len, src_name, len, name);
+	
+	return 1;
+	
+}
 
 
 
+/*
+ * Allocates memory like malloc and counts the allocation.
+ *
+ * param size - The number of bytes to allocate.
+ * Returns pointer to the allocated memory, or NULL if the allocation failed.
+ */
+void *counted_malloc(size_t size){
+
+	if (is_alloc_counted){
+		alloc_cnt++;
+		alloc_bytes += size;
+	}
+	return malloc(size);
+
+}
 
 
 
+/*
+ * Allocates zeroed memory like calloc and counts the allocation.
+ *
+ * param cnt - The number of elements.
+ * param size - The size of an element.
+ * Returns pointer to the allocated memory, or NULL if the allocation failed.
+ */
+void *counted_calloc(size_t cnt, size_t size){
 
+	if (is_alloc_counted){
+		alloc_cnt++;
+		alloc_bytes += cnt * size;
+	}
+	return calloc(cnt, size);
+
+}
 
 
+
+/*
+ * Reallocates memory like realloc and counts the allocation.
+ *
+ * param ptr - Pointer to the memory to reallocate (NULL allocates new memory).
+ * param size - The new size in bytes.
+ * Returns pointer to the reallocated memory, or NULL if the allocation failed.
+ */
+void *counted_realloc(void *ptr, size_t size){
+
+	if (is_alloc_counted){
+		alloc_cnt++;
+		alloc_bytes += size;
+	}
+	return realloc(ptr, size);
+
+}
+
+
+
+/*
+ * Gets the allocation counters of the counted allocation functions.
+ *
+ * param cnt_add - Pointer to store the number of allocations.
+ * param bytes_add - Pointer to store the number of requested bytes.
+ */
+void get_alloc_counters(long *cnt_add, long *bytes_add){
+
+	*cnt_add = alloc_cnt;
+	*bytes_add = alloc_bytes;
+
+}
+
+
+
+/*
+ * Turns the allocation counters on or off. The counting is turned off while worker threads run (the
+ * allocations of the workers are not counted), and it is changed only when no worker thread runs.
+ *
+ * param is_counted - 1 to count the allocations, 0 to stop counting them.
+ */
+void set_alloc_counting(int is_counted){
+
+	is_alloc_counted = is_counted;
+
+}
+
+
+
+/*
+ * Prints a string as a JSON string (with quotes and escapes) to a file stream.
+ *
+ * param des - Pointer to the file stream to write to.
+ * param str - The string.
+ */
+void print_json_string(FILE *des, const char *str){
+
+	putc('"', des);
+
+	for (; *str; str++){
+
+		if (*str == '"' || *str == '\\')
+			fprintf(des, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			fprintf(des, "\\u%04x", (unsigned char)*str);
+		else
+			putc(*str, des);
+	}
+
+	putc('"', des);
+
+}
+
+
+
+/*
+ * Continues a 32 bit FNV-1a hash over a string (a new hash starts with FNV_OFFSET).
+ *
+ * param hash - The hash so far.
+ * param str - The string.
+ * returns the hash.
+ */
+unsigned long hash_string(unsigned long hash, const char *str){
+
+	for (; *str; str++)
+		hash = HASH_BYTE(hash, *str);
+
+	return hash;
+
+}
@@ -42,6 +42,20 @@
 #define NO_LINE_ERROR -1 /* indicator for no line number */
 #define NO_FILE_ERROR "NO FILE" /* indicator for no file name */
 #define MEMORY_ASSUMPTION 100 /* assignment memory stack assumption (starts from 100) */
+#define US_IN_SEC 1000000.0 /* microseconds in a second */
+
+/* 32 bit FNV-1a hash parameters (the hashes of the caches, the tables and the diagnostic codes) */
+#define FNV_PRIME 16777619UL /* 32 bit FNV prime */
+#define FNV_OFFSET 2166136261UL /* 32 bit FNV offset basis */
+#define HASH_MASK 0xFFFFFFFFUL /* keeps the hash 32 bit on any platform */
+
+/* continues a FNV-1a hash with a byte */
+#define HASH_BYTE(hash, byte) ((((hash) ^ (unsigned char)(byte)) * FNV_PRIME) & HASH_MASK)
+
+/* the results of parse_num */
+#define NUM_INVALID 0 /* the token is not an integer */
+#define NUM_VALID 1 /* the token is an integer in the range */
+#define NUM_OUT_OF_RANGE 2 /* the token is an integer out of the range */
 
 
 void remove_white(char *);
@@ -50,6 +64,7 @@ int count_char(char *, char);
 int is_white_n(char *, int);
 int is_sep_by_white(char *);
 int is_num(char *);
+int parse_num(const char *, int, int, int, int *);
 int is_reserved_word(char *);
 int is_num_and_punc(char *);
 void remove_white_from_borders(char *);
@@ -58,5 +73,13 @@ int is_comment(char *);
 void errprintf(const char [], const int , const char *, ...);
 void warnprintf(const char [], const int, const char *, ...);
 int check_length(char *);
+int get_relative_path(char *, char *, int, char *);
+void *counted_malloc(size_t);
+void *counted_calloc(size_t, size_t);
+void *counted_realloc(void *, size_t);
+void get_alloc_counters(long *, long *);
+void set_alloc_counting(int);
+void print_json_string(FILE *, const char *);
+unsigned long hash_string(unsigned long, const char *);
 
 
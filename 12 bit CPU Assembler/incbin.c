@@ -0,0 +1,114 @@
+/*
+ *	File: incbin.c
+ *
+ *	This file contains the functions of the .incbin directive (see incbin.h) - the first run gets the number
+ *	of words of a directive from the size of its file, and the second run copies its words into the data
+ *	image.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for mmap in ansi mode */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ast.h"
+#include "encoder.h"
+#include "incbin.h"
+
+/* macro definitions */
+#define INCBIN_DIR curr_line_ast -> ast_union_ins_dir.ast_dir.dir.incbin /* the parameters of the directive */
+
+
+
+/*
+ *	Gets the number of words of an .incbin directive from the size of its file.
+ *
+ *	param curr_line_ast - The ast of the directive.
+ *	param src_name - The name of the source file (the file name is relative to its directory).
+ *	param line_num - The line of the directive.
+ *	param words_add - Pointer to store the number of words.
+ *	returns 1 if the file and the range are valid, 0 otherwise.
+ */
+int get_incbin_words(ast *curr_line_ast, char *src_name, int line_num, int *words_add){
+
+	struct stat st;
+	char path[MAX_BUFFER];
+	long file_words;
+
+	if (!get_relative_path(src_name, INCBIN_DIR.file, strlen(INCBIN_DIR.file), path) || stat(path, &st) != 0){
+		errprintf(src_name, line_num, "cannot open file '%s' - incbin directive", INCBIN_DIR.file);
+		return 0;
+	}
+
+	if (st.st_size % INCBIN_WORD_SIZE != 0){
+		errprintf(src_name, line_num, "the size of '%s' is not a whole number of %d byte words - incbin directive",
+				  INCBIN_DIR.file, INCBIN_WORD_SIZE);
+		return 0;
+	}
+
+	file_words = st.st_size / INCBIN_WORD_SIZE;
+
+	if (INCBIN_DIR.offset > file_words ||
+		(INCBIN_DIR.length != INCBIN_ALL && INCBIN_DIR.length > file_words - INCBIN_DIR.offset)){
+		errprintf(src_name, line_num, "the range is out of the file '%s' (%ld words) - incbin directive",
+				  INCBIN_DIR.file, file_words);
+		return 0;
+	}
+
+	/* a too large file is reported by the memory overflow check of the first run */
+	*words_add = INCBIN_DIR.length != INCBIN_ALL ? INCBIN_DIR.length : (int)(file_words - INCBIN_DIR.offset);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Copies the words of an .incbin directive from its mapped file.
+ *
+ *	param curr_line_ast - The ast of the directive.
+ *	param src_name - The name of the source file (the file name is relative to its directory).
+ *	param line_num - The line of the directive.
+ *	param des - The first data word to fill.
+ *	param words - The number of words that the first run counted.
+ *	returns 1 if the words were copied, 0 if the file cannot be mapped or it became shorter.
+ */
+int copy_incbin_words(ast *curr_line_ast, char *src_name, int line_num, mem_data_word *des, int words){
+
+	struct stat st;
+	char path[MAX_BUFFER];
+	unsigned char *base, *word;
+	int fd, i;
+
+	if (words == 0)
+		return 1;
+
+	if (!get_relative_path(src_name, INCBIN_DIR.file, strlen(INCBIN_DIR.file), path) ||
+		(fd = open(path, O_RDONLY)) < 0){
+		errprintf(src_name, line_num, "cannot open file '%s' - incbin directive", INCBIN_DIR.file);
+		return 0;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size / INCBIN_WORD_SIZE < (long)INCBIN_DIR.offset + words ||
+		(base = (unsigned char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+		errprintf(src_name, line_num, "the file '%s' was changed during the assembly - incbin directive", INCBIN_DIR.file);
+		close(fd);
+		return 0;
+	}
+
+	close(fd); /* the mapping stays valid */
+
+	for (i = 0, word = base + (long)INCBIN_DIR.offset * INCBIN_WORD_SIZE; i < words; i++, word += INCBIN_WORD_SIZE)
+		des[i].curr_data = (word[0] | (word[1] << 8)) & INCBIN_WORD_MASK;
+
+	munmap(base, st.st_size);
+
+	return 1;
+
+}
@@ -0,0 +1,20 @@
+/*
+ *	File: incbin.h
+ *
+ *	Defines the format of the binary files of the .incbin directive and the function prototypes that size
+ *	and copy them. A binary file is a sequence of 16 bit little endian words, and the low 12 bits of every
+ *	word are a data word (a file of 2n bytes has n words). The first run takes the number of words from the
+ *	size of the file, and the second run copies the words from the mapped file into the data image, so the
+ *	words are never parsed.
+ *	ast.h and encoder.h must be included before.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define INCBIN_WORD_SIZE 2 /* bytes of a word in a binary file */
+#define INCBIN_WORD_MASK 0xFFF /* the bits of a word that are copied */
+
+/* functions prototype */
+int get_incbin_words(ast *, char *, int, int *);
+int copy_incbin_words(ast *, char *, int, mem_data_word *, int);
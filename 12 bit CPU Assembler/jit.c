@@ -0,0 +1,561 @@
+/*
+ *	File: jit.c
+ *
+ *	This file implements the basic block translator of the emulator (x86-64, System V calling convention).
+ *	A translated block is a native function that gets the cpu (rdi) and the code map (rsi) and returns the
+ *	address of the next instruction. The registers, the memory and the flag stay in the cpu structure,
+ *	the immediate values and the direct addresses are constants in the native code.
+ *	A write to a memory word of executed code is checked in the code map, and if it is set the block
+ *	returns at once with the written address, so the dispatcher invalidates the decoded instructions and
+ *	the translated blocks that contain the word. A bne/jmp to the start of its own block is a native loop
+ *	that returns to the dispatcher only when the next iteration would cross the instructions limit.
+ *	The arena is never writable and executable at once - it is read/write only while a block is emitted
+ *	into it and read/execute otherwise.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _DEFAULT_SOURCE /* for MAP_ANONYMOUS in ansi mode */
+
+#include <stddef.h>
+#include <limits.h>
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+/* macro definitions */
+#define SMC_EXIT 0x80000000u /* the block returned after a write to a word of executed code */
+#define EXIT_ADDRESS_SHIFT 16 /* the written address of a SMC_EXIT is in bits 16-25 */
+#define EXIT_PC_MASK 0xFFFF
+#define EAX 0 /* x86-64 register numbers */
+#define ECX 1
+#define EDX 2
+#define MODRM_RDI_DISP32 0x87 /* [rdi + disp32], the register is added in bits 3-5 */
+#define MODRM_RSI_DISP32 0x86
+#define OFFSET_OF_EXECUTED offsetof(cpu_state, executed)
+#define OFFSET_OF_LIMIT offsetof(cpu_state, limit)
+#define OFFSET_OF_ZERO_FLAG offsetof(cpu_state, zero_flag)
+#define EXIT_CODE_SIZE 17 /* size of the code of emit_exit */
+#define BACK_EDGE_JUMP_SIZE 5 /* size of jmp rel32 */
+
+typedef unsigned int (*native_block)(cpu_state *, unsigned char *);
+
+/* exclusive functions prototype */
+void jit_write_hook(cpu_state *, int);
+void flush_blocks(jit_state *);
+void mark_code(jit_state *, int, int);
+int translate_block(cpu_state *, jit_state *, int);
+void translate_ins(unsigned char **, cpu_state *, decoded_ins *, int);
+void translate_branch(unsigned char **, unsigned char *, int, decoded_ins *, int);
+long operand_offset(cpu_state *, unsigned int *);
+void emit_byte(unsigned char **, int);
+void emit_u32(unsigned char **, unsigned long);
+void emit_load(unsigned char **, int, cpu_state *, unsigned int *);
+void emit_store(unsigned char **, int, long);
+void emit_exit(unsigned char **, int, unsigned long);
+int protect_arena(jit_state *, int);
+
+
+
+/*
+ *	Creates a translator for a cpu and sets its write hook.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	returns pointer to the new translator, NULL if translation is not supported.
+ */
+jit_state *create_jit(cpu_state *cpu){
+
+#ifdef JIT_SUPPORTED
+	jit_state *jit = (jit_state *)counted_calloc(1, sizeof(jit_state));
+	void *arena;
+
+	if (jit == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - jit");
+		exit(1);
+	}
+
+	arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (arena == MAP_FAILED){
+		free(jit);
+		return NULL;
+	}
+
+	jit -> arena = (unsigned char *)arena;
+	cpu -> write_hook = jit_write_hook;
+	cpu -> hook_data = jit;
+	jit_write_hook(cpu, ALL_ADDRESSES);
+
+	return jit;
+#else
+	return NULL;
+#endif
+
+}
+
+
+
+/*
+ *	Frees a translator and its native code arena.
+ *
+ *	param jit - Pointer to the translator.
+ */
+void free_jit(jit_state *jit){
+
+#ifdef JIT_SUPPORTED
+	munmap(jit -> arena, JIT_ARENA_SIZE);
+#endif
+	free(jit);
+
+}
+
+
+
+/*
+ *	Runs the cpu from its pc until it stops. A translated block is called, a block that was entered
+ *	JIT_THRESHOLD times is translated and any other block is interpreted.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param jit - Pointer to the translator of the cpu.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ *	returns the status of the cpu (cpu_halted, cpu_fault or cpu_limit).
+ */
+enum cpu_status run_cpu_jit(cpu_state *cpu, jit_state *jit, long limit){
+
+	decoded_ins *ins, *next;
+	jit_block *block;
+	native_block native;
+	unsigned int res;
+	int pc = cpu -> pc, is_end;
+
+	cpu -> limit = limit > 0 ? cpu -> executed + limit : LONG_MAX;
+	cpu -> status = cpu_running;
+
+	while (cpu -> status == cpu_running){
+
+		if (cpu -> executed >= cpu -> limit){
+			cpu -> status = cpu_limit;
+			cpu -> pc = pc;
+			break;
+		}
+
+		block = &(jit -> blocks[pc]);
+
+		if (block -> native == NULL && block -> hits != NOT_TRANSLATABLE && ++(block -> hits) >= JIT_THRESHOLD)
+			translate_block(cpu, jit, pc);
+
+		/* calls the translated block if it can't cross the limit */
+		if (block -> native != NULL && cpu -> executed + block -> ins_cnt <= cpu -> limit){
+			memcpy(&native, &(block -> native), sizeof(native));
+			res = native(cpu, jit -> code_map);
+			pc = res & EXIT_PC_MASK;
+			if (res & SMC_EXIT)
+				invalidate_code(cpu, (res >> EXIT_ADDRESS_SHIFT) & (CPU_MEMORY_SIZE - 1));
+			continue;
+		}
+
+		/* interprets the instructions until the end of the block */
+		ins = &(cpu -> code[pc]);
+		do {
+			if ((next = ins -> handler(cpu, ins)) == NULL){
+				if (cpu -> status != cpu_fault) /* the faulting instruction was not executed */
+					cpu -> executed++;
+				break;
+			}
+			cpu -> executed++;
+			mark_code(jit, ins -> address, ins -> length);
+			is_end = next != ins + ins -> length || ins -> opcode < ast_ins_mov - 1 || ins -> opcode > ast_ins_dec - 1;
+			ins = next;
+		} while (!is_end && cpu -> executed < cpu -> limit);
+
+		pc = ins -> address;
+	}
+
+	return cpu -> status;
+
+}
+
+
+
+/*
+ *	The write hook of the cpu - invalidates the translated blocks that contain a written word.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param address - The address of the written word (ALL_ADDRESSES after the memory was loaded).
+ */
+void jit_write_hook(cpu_state *cpu, int address){
+
+	jit_state *jit = (jit_state *)cpu -> hook_data;
+	jit_block *block;
+	int i;
+
+	if (address == ALL_ADDRESSES){
+		flush_blocks(jit);
+		memset(jit -> code_map, 0, sizeof(jit -> code_map));
+		mark_code(jit, CPU_LOAD_ADDRESS, cpu -> code_end - CPU_LOAD_ADDRESS);
+		return;
+	}
+
+	for (i = address; i > address - MAX_BLOCK_WORDS && i >= 0; i--){
+		block = &(jit -> blocks[i]);
+		if (block -> native != NULL && block -> end > address){
+			block -> native = NULL;
+			block -> hits = 0;
+			jit -> invalidated++;
+		}
+		else if (block -> hits == NOT_TRANSLATABLE && i > address - MAX_INS_LEN)
+			block -> hits = 0;
+	}
+
+}
+
+
+
+/*
+ *	Removes all the translated blocks and empties the arena.
+ *
+ *	param jit - Pointer to the translator.
+ */
+void flush_blocks(jit_state *jit){
+
+	memset(jit -> blocks, 0, sizeof(jit -> blocks));
+	jit -> arena_used = 0;
+
+}
+
+
+
+/*
+ *	Marks memory words as a part of executed code (a translated block checks them when it writes).
+ *
+ *	param jit - Pointer to the translator.
+ *	param address - The first word.
+ *	param len - Number of words.
+ */
+void mark_code(jit_state *jit, int address, int len){
+
+	for (; len > 0 && address < CPU_MEMORY_SIZE; len--, address++)
+		jit -> code_map[address] = 1;
+
+}
+
+
+
+/*
+ *	Translates the block that starts at an address and adds it to the block cache.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param jit - Pointer to the translator.
+ *	param start - The start address of the block.
+ *	returns 1 if the block was translated, 0 otherwise.
+ */
+int translate_block(cpu_state *cpu, jit_state *jit, int start){
+
+	jit_block *block = &(jit -> blocks[start]);
+	unsigned char *native, *p;
+	decoded_ins *ins;
+	int address = start, cnt = 0, is_end = 0;
+
+	if (start >= CPU_MEMORY_SIZE){
+		block -> hits = NOT_TRANSLATABLE;
+		return 0;
+	}
+
+	if (jit -> arena_used + MAX_BLOCK_CODE > JIT_ARENA_SIZE){
+		flush_blocks(jit);
+		jit -> flushes++;
+	}
+
+	if (protect_arena(jit, 1) != 0){
+		block -> hits = NOT_TRANSLATABLE;
+		return 0;
+	}
+
+	native = p = jit -> arena + jit -> arena_used;
+
+	while (!is_end && cnt < MAX_BLOCK_INS && address < CPU_MEMORY_SIZE){
+
+		ins = decode_at(cpu, address);
+
+		if (ins -> opcode >= ast_ins_mov - 1 && ins -> opcode <= ast_ins_dec - 1)
+			translate_ins(&p, cpu, ins, ++cnt);
+		else if ((ins -> opcode == ast_ins_jmp - 1 || ins -> opcode == ast_ins_bne - 1) && operand_offset(cpu, ins -> des) < 0){
+			translate_branch(&p, native, start, ins, ++cnt);
+			is_end = 1;
+		}
+		else
+			break;
+
+		address += ins -> length;
+	}
+
+	if (!is_end && cnt > 0)
+		emit_exit(&p, cnt, address);
+
+	/* a block that can't be executed is not added */
+	if (protect_arena(jit, 0) != 0 || cnt == 0){
+		block -> hits = NOT_TRANSLATABLE;
+		return 0;
+	}
+
+	block -> native = native;
+	block -> ins_cnt = cnt;
+	block -> end = address;
+	mark_code(jit, start, address - start);
+	jit -> arena_used += p - native;
+	jit -> translated++;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Changes the protection of the arena - read/write to emit a block, read/execute to run the blocks.
+ *
+ *	param jit - Pointer to the translator.
+ *	param writable - 1 for read/write, 0 for read/execute.
+ *	returns 0 on success, -1 otherwise.
+ */
+int protect_arena(jit_state *jit, int writable){
+
+#ifdef JIT_SUPPORTED
+	return mprotect(jit -> arena, JIT_ARENA_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+#else
+	return -1;
+#endif
+
+}
+
+
+
+/*
+ *	Translates an arithmetic, logic or move instruction.
+ *
+ *	param p - Pointer to the position in the native code.
+ *	param cpu - Pointer to the cpu.
+ *	param ins - The decoded instruction.
+ *	param cnt - Number of instructions of the block up to and including this one.
+ */
+void translate_ins(unsigned char **p, cpu_state *cpu, decoded_ins *ins, int cnt){
+
+	int next = ins -> address + ins -> length;
+
+	switch (ins -> opcode + 1){
+
+		case ast_ins_mov:
+		case ast_ins_lea: /* the source of lea is its address */
+			emit_load(p, EAX, cpu, ins -> src);
+			break;
+
+		case ast_ins_cmp: /* xor edx, edx / eax = src - des / sete dl / zero_flag = edx */
+			emit_byte(p, 0x31);
+			emit_byte(p, 0xD2);
+			emit_load(p, EAX, cpu, ins -> src);
+			emit_load(p, ECX, cpu, ins -> des);
+			emit_byte(p, 0x29);
+			emit_byte(p, 0xC8);
+			emit_byte(p, 0x25);
+			emit_u32(p, CPU_WORD_MASK);
+			emit_byte(p, 0x0F);
+			emit_byte(p, 0x94);
+			emit_byte(p, 0xC2);
+			emit_store(p, EDX, OFFSET_OF_ZERO_FLAG);
+			return;
+
+		case ast_ins_add: /* add eax, ecx */
+		case ast_ins_sub: /* sub eax, ecx */
+			emit_load(p, EAX, cpu, ins -> des);
+			emit_load(p, ECX, cpu, ins -> src);
+			emit_byte(p, ins -> opcode + 1 == ast_ins_add ? 0x01 : 0x29);
+			emit_byte(p, 0xC8);
+			break;
+
+		case ast_ins_not: /* not eax */
+			emit_load(p, EAX, cpu, ins -> des);
+			emit_byte(p, 0xF7);
+			emit_byte(p, 0xD0);
+			break;
+
+		case ast_ins_clr: /* xor eax, eax */
+			emit_byte(p, 0x31);
+			emit_byte(p, 0xC0);
+			break;
+
+		case ast_ins_inc: /* add eax, 1 */
+		case ast_ins_dec: /* sub eax, 1 */
+			emit_load(p, EAX, cpu, ins -> des);
+			emit_byte(p, 0x83);
+			emit_byte(p, ins -> opcode + 1 == ast_ins_inc ? 0xC0 : 0xE8);
+			emit_byte(p, 1);
+			break;
+	}
+
+	/* and eax, CPU_WORD_MASK / des = eax */
+	emit_byte(p, 0x25);
+	emit_u32(p, CPU_WORD_MASK);
+	emit_store(p, EAX, operand_offset(cpu, ins -> des));
+
+	/* cmp byte [rsi + address], 0 / je over the exit / returns with the written address */
+	if (ins -> writes_code){
+		emit_byte(p, 0x80);
+		emit_byte(p, MODRM_RSI_DISP32 | (7 << 3));
+		emit_u32(p, ins -> des_value);
+		emit_byte(p, 0);
+		emit_byte(p, 0x74);
+		emit_byte(p, EXIT_CODE_SIZE);
+		emit_exit(p, cnt, next | SMC_EXIT | ((unsigned long)ins -> des_value << EXIT_ADDRESS_SHIFT));
+	}
+
+}
+
+
+
+/*
+ *	Translates a direct jmp or bne that ends a block.
+ *
+ *	param p - Pointer to the position in the native code.
+ *	param native - The start of the native code of the block.
+ *	param start - The start address of the block.
+ *	param ins - The decoded instruction.
+ *	param cnt - Number of instructions of the block.
+ */
+void translate_branch(unsigned char **p, unsigned char *native, int start, decoded_ins *ins, int cnt){
+
+	unsigned char *skip = NULL;
+	unsigned int target = *(ins -> des);
+
+	/* add qword [rdi + executed], cnt */
+	emit_byte(p, 0x48);
+	emit_byte(p, 0x81);
+	emit_byte(p, MODRM_RDI_DISP32);
+	emit_u32(p, OFFSET_OF_EXECUTED);
+	emit_u32(p, cnt);
+
+	/* cmp dword [rdi + zero_flag], 0 / jne over the taken branch */
+	if (ins -> opcode + 1 == ast_ins_bne){
+		emit_byte(p, 0x83);
+		emit_byte(p, MODRM_RDI_DISP32 | (7 << 3));
+		emit_u32(p, OFFSET_OF_ZERO_FLAG);
+		emit_byte(p, 0);
+		emit_byte(p, 0x75);
+		skip = (*p)++;
+	}
+
+	/* a loop - mov rax, [rdi + executed] / add rax, cnt / cmp rax, [rdi + limit] / jg over / jmp start */
+	if (target == start){
+		emit_byte(p, 0x48);
+		emit_byte(p, 0x8B);
+		emit_byte(p, MODRM_RDI_DISP32);
+		emit_u32(p, OFFSET_OF_EXECUTED);
+		emit_byte(p, 0x48);
+		emit_byte(p, 0x05);
+		emit_u32(p, cnt);
+		emit_byte(p, 0x48);
+		emit_byte(p, 0x3B);
+		emit_byte(p, MODRM_RDI_DISP32);
+		emit_u32(p, OFFSET_OF_LIMIT);
+		emit_byte(p, 0x7F);
+		emit_byte(p, BACK_EDGE_JUMP_SIZE);
+		emit_byte(p, 0xE9);
+		emit_u32(p, (unsigned long)(native - (*p + 4)));
+	}
+
+	/* mov eax, target / ret */
+	emit_byte(p, 0xB8);
+	emit_u32(p, target);
+	emit_byte(p, 0xC3);
+
+	if (skip != NULL){
+		*skip = (unsigned char)(*p - (skip + 1));
+		emit_byte(p, 0xB8);
+		emit_u32(p, ins -> address + ins -> length);
+		emit_byte(p, 0xC3);
+	}
+
+}
+
+
+
+/*
+ *	Finds the offset of a register or a memory word in the cpu structure.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param operand - The operand of a decoded instruction.
+ *	returns the offset, -1 if the operand is an immediate value (or a direct address) of the instruction.
+ */
+long operand_offset(cpu_state *cpu, unsigned int *operand){
+
+	if (operand >= cpu -> regs && operand < cpu -> regs + CPU_REGS_NUM)
+		return offsetof(cpu_state, regs) + (operand - cpu -> regs) * sizeof(unsigned int);
+
+	if (operand >= cpu -> mem && operand < cpu -> mem + CPU_MEMORY_SIZE)
+		return offsetof(cpu_state, mem) + (operand - cpu -> mem) * sizeof(unsigned int);
+
+	return -1;
+
+}
+
+
+
+/* the native code emitters */
+
+void emit_byte(unsigned char **p, int byte){
+
+	*(*p)++ = (unsigned char)byte;
+
+}
+
+void emit_u32(unsigned char **p, unsigned long value){
+
+	int i;
+
+	for (i = 0; i < 4; i++, value >>= 8)
+		emit_byte(p, value & 0xFF);
+
+}
+
+/* mov reg, imm32 or mov reg, [rdi + offset] */
+void emit_load(unsigned char **p, int reg, cpu_state *cpu, unsigned int *operand){
+
+	long offset = operand_offset(cpu, operand);
+
+	if (offset < 0){
+		emit_byte(p, 0xB8 + reg);
+		emit_u32(p, *operand);
+	}
+	else {
+		emit_byte(p, 0x8B);
+		emit_byte(p, MODRM_RDI_DISP32 | (reg << 3));
+		emit_u32(p, offset);
+	}
+
+}
+
+/* mov [rdi + offset], reg */
+void emit_store(unsigned char **p, int reg, long offset){
+
+	emit_byte(p, 0x89);
+	emit_byte(p, MODRM_RDI_DISP32 | (reg << 3));
+	emit_u32(p, offset);
+
+}
+
+/* add qword [rdi + executed], cnt / mov eax, res / ret (EXIT_CODE_SIZE bytes) */
+void emit_exit(unsigned char **p, int cnt, unsigned long res){
+
+	emit_byte(p, 0x48);
+	emit_byte(p, 0x81);
+	emit_byte(p, MODRM_RDI_DISP32);
+	emit_u32(p, OFFSET_OF_EXECUTED);
+	emit_u32(p, cnt);
+	emit_byte(p, 0xB8);
+	emit_u32(p, res);
+	emit_byte(p, 0xC3);
+
+}
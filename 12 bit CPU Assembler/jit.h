@@ -0,0 +1,44 @@
+/*
+ *	File: jit.h
+ *
+ *	Defines the data structures and function prototypes of the basic block translator of the emulator.
+ *	A basic block that was entered JIT_THRESHOLD times is translated into native x86-64 code and kept in
+ *	a block cache by its start address. The arithmetic, logic and move instructions and the direct
+ *	jmp/bne that end a block are translated, every other instruction (red, prn, jsr, rts, stop and
+ *	the faults) ends the block and is executed by the interpreter.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "cpu.h"
+
+#define JIT_THRESHOLD 8 /* number of entries to a block before it is translated */
+#define MAX_BLOCK_INS 64 /* maximum number of instructions of a translated block */
+#define MAX_BLOCK_WORDS (MAX_BLOCK_INS * MAX_INS_LEN) /* maximum number of memory words of a block */
+#define MAX_INS_CODE 64 /* maximum size of the native code of an instruction (bytes) */
+#define MAX_BLOCK_CODE ((MAX_BLOCK_INS + 2) * MAX_INS_CODE) /* maximum size of the native code of a block */
+#define JIT_ARENA_SIZE (1024 * 1024) /* size of the native code arena (flushed when full) */
+#define NOT_TRANSLATABLE -1 /* hits of a block that starts with an instruction that is not translated */
+
+typedef struct {
+	unsigned char *native; /* the translated code (NULL if the block is not translated) */
+	int hits; /* number of entries to the block (or NOT_TRANSLATABLE) */
+	int ins_cnt; /* number of instructions of the block */
+	int end; /* the block is [start address, end) */
+} jit_block;
+
+typedef struct {
+	jit_block blocks[CPU_MEMORY_SIZE + 1]; /* the block cache by start address (+1 end of memory) */
+	unsigned char code_map[CPU_MEMORY_SIZE]; /* 1 if the word may be a part of an executed instruction */
+	unsigned char *arena; /* the native code (read/write while a block is emitted, read/execute otherwise) */
+	long arena_used;
+	long translated; /* number of translated blocks */
+	long invalidated; /* number of blocks that were invalidated by writes */
+	long flushes; /* number of times the arena was full */
+} jit_state;
+
+/* functions prototype */
+jit_state *create_jit(cpu_state *);
+void free_jit(jit_state *);
+enum cpu_status run_cpu_jit(cpu_state *, jit_state *, long);
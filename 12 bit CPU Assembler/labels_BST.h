@@ -11,6 +11,7 @@
 
 
 #include "funcs_and_macs.h"
+#include "mapfile.h"
 #define NO_VALUE -1 /* for external and entry lables that have not yet been defined */
 
 enum enum_type{
@@ -29,35 +30,62 @@ enum enum_comm{
 /* define the symbol table node structure */
 typedef struct symbol_table_node {
     char label[MAX_LABEL_SIZE];
-    union {
-    	int value;
-    	struct {
-    		int extern_values[MAX_MEMORY_ASSUMPTION];
-    		int values_count;
-    	}label_extern_value; /* if the label is external */
-    	struct {
-    		int param_values[MAX_MEMORY_ASSUMPTION];
-    		int values_count;
-    	}label_param_value; /* if the label is parameter */
-    }label_value;
+    int value; /* address of the label (for external label - first use address or NO_VALUE if unused) */
+    int id; /* post order index of the label (used to order the external references) */
+    int seq; /* creation order of the label (rebuilds the table of a file without the snapshot, see snapshot.c) */
     enum enum_type type;
     enum enum_comm comm;
     struct symbol_table_node *left;
     struct symbol_table_node *right;
 } symbol_table_node;
 
+/* define the external references log structure */
+typedef struct {
+    symbol_table_node *label; /* the used external label */
+    int address; /* the code image address of the word that uses the label */
+} extern_ref;
+
+typedef struct {
+    extern_ref *refs; /* contiguous array of the external references (in encoding order) */
+    int count; /* number of references in the array */
+    int size; /* number of allocated cells */
+} extern_ref_vector;
+
+/* define the line map structure (the memory words of every source line, --map option) */
+typedef struct {
+    int line; /* the line in the .am file */
+    int address; /* offset of the first word in the code image or in the data image */
+    int length; /* number of words */
+    int is_data; /* 1 if the words are in the data image */
+} line_map_entry;
+
+typedef struct {
+    line_map_entry *entries; /* contiguous array of the lines (in encoding order) */
+    int count; /* number of lines in the array */
+    int size; /* number of allocated cells */
+} line_map_vector;
+
 /* functions prototype */
 void free_symbol_table(symbol_table_node **);
 symbol_table_node *search_label(symbol_table_node *, char *);
 symbol_table_node *insert_label(symbol_table_node *, char *, int, enum enum_type, enum enum_comm);
 symbol_table_node *create_label_node(char *, int, enum enum_type, enum enum_comm);
+int next_label_seq(void);
 void update_label_type(symbol_table_node *, enum enum_type);
 void increase_labels_value_by_comm(symbol_table_node *, int, enum enum_comm);
-void print_extern_labels_to_stream(FILE *, symbol_table_node *);
+void print_extern_labels_to_stream(FILE *, symbol_table_node *, extern_ref_vector *);
 void print_entry_labels_to_stream(FILE *, symbol_table_node *);
-void export_entry_and_extern_labels(char *, symbol_table_node *);
-int is_there_used_extern(symbol_table_node *);
+void export_entry_and_extern_labels(char *, symbol_table_node *, extern_ref_vector *);
+void insert_extern_ref(extern_ref_vector *, symbol_table_node *, int);
+void free_extern_refs(extern_ref_vector *);
+void read_symbols_file(char *, char *, map_label **, int *, int *);
+void insert_line_map(line_map_vector *, int, int, int, int);
+void free_line_map(line_map_vector *);
+int collect_map_labels(symbol_table_node *, map_label *, int);
+void export_line_map(char *, symbol_table_node *, line_map_vector *, map_origin_vector *, int);
+void export_obb(char *, unsigned short *, int, int, symbol_table_node *, extern_ref_vector *);
 int is_there_entry(symbol_table_node *);
+void get_symbol_table_shape(symbol_table_node *, int, int *, int *, long *);
 
 
 
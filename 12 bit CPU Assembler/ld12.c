@@ -0,0 +1,533 @@
+/*
+ *	File: ld12.c
+ *
+ *	This file contains the linker program. The modules are read by worker threads (every thread reads a
+ *	contiguous range of the modules), then the code and the data of every module get their bases in the
+ *	image and the entries of all the modules are inserted into one hash table (FNV-1a, open addressing),
+ *	and then the threads relocate their modules into the image - a relocatable word is moved by the base
+ *	of its segment and an external word (ARE = external) is replaced by the address of the entry with its
+ *	name. Every step is linear in the size of the modules, so thousands of modules are linked quickly.
+ *	The linked image is written to a .ob file and its entries to a .ent file.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for pthreads in ansi mode */
+
+#include <pthread.h>
+#include "ld12.h"
+
+/* functions prototype */
+void num_to_base64(unsigned int, char *);
+int decode_base64_word(char *);
+void read_symbols_file(char *, char *, map_label **, int *, int *);
+
+/* exclusive functions prototype */
+void run_jobs(ld_module *, int, int, ld_table *, unsigned short *, void *(*)(void *));
+void *read_modules_range(void *);
+int read_module(ld_module *);
+int layout_modules(ld_module *, int);
+int build_symbol_table(ld_table *, ld_module *, int);
+ld_symbol *find_symbol(ld_table *, char *);
+void *link_modules_range(void *);
+void link_module(ld_module *, ld_table *, unsigned short *);
+int relocate_address(ld_module *, int);
+int write_image(char *, ld_module *, int, unsigned short *, int, int);
+
+
+
+/*
+ *	main function of the program
+ *
+ *	param argc - Number of command-line arguments.
+ *	param argv - Array of command-line arguments.
+ *	returns 0 if the modules were linked, 1 otherwise.
+ */
+int main(int argc, char *argv[]){
+
+	int i, modules_num = 0, threads = 1, is_stats = 0, ic = 0, dc = 0, res = 0;
+	char *output = DEFAULT_OUTPUT;
+	double start, read_end, resolve_end, link_end;
+	ld_module *modules;
+	ld_table table = {NULL, 0};
+	unsigned short *image;
+
+	if ((modules = (ld_module *)counted_calloc(argc, sizeof(ld_module))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - modules");
+		exit(1);
+	}
+
+	/* the options apply to the whole link, the other arguments are the modules */
+	for (i = 1; i < argc; i++){
+
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+			if ((threads = atoi(argv[++i])) < 1)
+				threads = 1;
+		}
+		else if (strcmp(argv[i], "--stats") == 0)
+			is_stats = 1;
+		else
+			modules[modules_num++].name = argv[i];
+	}
+
+	/* if no module was entered in command line */
+	if (modules_num == 0){
+
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s [-o output] [-j threads] [--stats] file file ...)", argv[0]);
+		free(modules);
+		return 1;
+	}
+
+	start = trace_clock();
+	run_jobs(modules, modules_num, threads, NULL, NULL, read_modules_range);
+	read_end = trace_clock();
+
+	for (i = 0; i < modules_num; i++)
+		res = res || modules[i].errors > 0;
+
+	/* the bases of the modules and the global symbols */
+	if (!res && (!layout_modules(modules, modules_num) || !build_symbol_table(&table, modules, modules_num)))
+		res = 1;
+	resolve_end = trace_clock();
+
+	if (!res){
+
+		ic = modules[modules_num - 1].code_base - MEMORY_ASSUMPTION + modules[modules_num - 1].ic;
+		dc = modules[modules_num - 1].data_base - MEMORY_ASSUMPTION - ic + modules[modules_num - 1].dc;
+
+		if ((image = (unsigned short *)counted_malloc((ic + dc + 1) * sizeof(unsigned short))) == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - image");
+			exit(1);
+		}
+
+		run_jobs(modules, modules_num, threads, &table, image, link_modules_range);
+
+		for (i = 0; i < modules_num; i++)
+			res = res || modules[i].errors > 0;
+
+		if (!res && !write_image(output, modules, modules_num, image, ic, dc))
+			res = 1;
+
+		free(image);
+	}
+	link_end = trace_clock();
+
+	if (is_stats)
+		fprintf(stderr, "%s: %d modules, %d code and %d data words - read %.3f sec, resolve %.3f sec, link %.3f sec (%d threads)\n",
+				output, modules_num, ic, dc, (read_end - start) / US_IN_SEC,
+				(resolve_end - read_end) / US_IN_SEC, (link_end - resolve_end) / US_IN_SEC, threads);
+
+	for (i = 0; i < modules_num; i++){
+		free(modules[i].words);
+		free(modules[i].entries);
+		free(modules[i].externs);
+	}
+	free(modules);
+	free(table.cells);
+
+	return res;
+
+}
+
+
+
+/*
+ *	Runs a routine on the modules - the modules are divided into contiguous ranges that are handled by
+ *	separate threads. If a thread cannot be created, its range is handled by the calling thread.
+ *
+ *	param modules - The modules.
+ *	param modules_num - Number of modules.
+ *	param threads - The number of threads to use.
+ *	param table - The global symbols (NULL in the read phase).
+ *	param image - The linked words (NULL in the read phase).
+ *	param routine - The thread routine (gets an ld_job).
+ */
+void run_jobs(ld_module *modules, int modules_num, int threads, ld_table *table, unsigned short *image,
+			  void *(*routine)(void *)){
+
+	pthread_t tids[MAX_LINK_THREADS];
+	ld_job jobs[MAX_LINK_THREADS];
+	int is_created[MAX_LINK_THREADS], i;
+
+	if (threads > MAX_LINK_THREADS)
+		threads = MAX_LINK_THREADS;
+
+	if (threads > modules_num)
+		threads = modules_num;
+
+	for (i = 0; i < threads; i++){
+		jobs[i].modules = modules;
+		jobs[i].first = (int)((long)modules_num * i / threads);
+		jobs[i].last = (int)((long)modules_num * (i + 1) / threads);
+		jobs[i].table = table;
+		jobs[i].image = image;
+	}
+
+	if (threads <= 1){ /* handles all the modules in the calling thread */
+		routine(&jobs[0]);
+		return;
+	}
+
+	set_alloc_counting(0); /* the counters are not shared by the threads */
+	for (i = 0; i < threads; i++)
+		is_created[i] = pthread_create(&tids[i], NULL, routine, &jobs[i]) == 0;
+
+	for (i = 0; i < threads; i++){
+		if (is_created[i])
+			pthread_join(tids[i], NULL);
+		else /* the thread was not created - handles its range in the calling thread */
+			routine(&jobs[i]);
+	}
+	set_alloc_counting(1);
+
+}
+
+
+
+/*
+ *	Reads a range of modules (thread routine).
+ *
+ *	param job_add - Pointer to the ld_job that describes the range.
+ *	returns NULL.
+ */
+void *read_modules_range(void *job_add){
+
+	ld_job *job = (ld_job *)job_add;
+	int i;
+
+	for (i = job -> first; i < job -> last; i++)
+		if (!read_module(&(job -> modules[i])))
+			job -> modules[i].errors++;
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Reads the .ob file of a module and its .ent and .ext files (if they exist).
+ *
+ *	param module - Pointer to the module.
+ *	returns 1 if the module was read, 0 otherwise.
+ */
+int read_module(ld_module *module){
+
+	FILE *src;
+	char ob_name[MAX_BUFFER], line[MAX_LINE];
+	int i, word;
+
+	sprintf(ob_name, "%s.ob", module -> name);
+
+	if (!(src = fopen(ob_name, "r"))){
+		errprintf(ob_name, NO_LINE_ERROR, "cannot open file");
+		return 0;
+	}
+
+	/* an assembled module fits the memory, so a larger header is not valid */
+	if (!fgets(line, MAX_LINE, src) || sscanf(line, "%d %d", &(module -> ic), &(module -> dc)) != 2 ||
+		module -> ic < 0 || module -> dc < 0 || module -> ic + module -> dc > MAX_MEMORY_ASSUMPTION){
+
+		errprintf(ob_name, 1, "invalid header - expected the code and data sizes");
+		fclose(src);
+		return 0;
+	}
+
+	if ((module -> words = (unsigned short *)counted_malloc((module -> ic + module -> dc + 1) * sizeof(unsigned short))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - module words");
+		exit(1);
+	}
+
+	for (i = 0; i < module -> ic + module -> dc; i++){
+
+		if (!fgets(line, MAX_LINE, src) || (word = decode_base64_word(line)) < 0){
+
+			errprintf(ob_name, i + 2, "invalid base64 word");
+			fclose(src);
+			return 0;
+		}
+
+		module -> words[i] = word;
+	}
+
+	fclose(src);
+
+	read_symbols_file(module -> name, ".ent", &(module -> entries), &(module -> entries_num), &(module -> entries_size));
+	read_symbols_file(module -> name, ".ext", &(module -> externs), &(module -> externs_num), &(module -> externs_size));
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Gives every module the bases of its code and its data in the image - the code of all the modules
+ *	comes first (in the order of the command line) and then their data, as in a .ob file.
+ *
+ *	param modules - The modules.
+ *	param modules_num - Number of modules.
+ *	returns 1 if the image fits the memory, 0 otherwise.
+ */
+int layout_modules(ld_module *modules, int modules_num){
+
+	int i, ic = 0, dc = 0;
+
+	for (i = 0; i < modules_num; i++){
+		modules[i].code_base = MEMORY_ASSUMPTION + ic;
+		ic += modules[i].ic;
+	}
+
+	for (i = 0; i < modules_num; i++){
+		modules[i].data_base = MEMORY_ASSUMPTION + ic + dc;
+		dc += modules[i].dc;
+	}
+
+	if (ic + dc > MAX_MEMORY_ASSUMPTION){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "the linked image has %d words, it does not fit the memory (%d words)",
+				  ic + dc, MAX_MEMORY_ASSUMPTION);
+		return 0;
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Builds the global symbols table from the entries of the modules (the addresses are relocated).
+ *
+ *	param table - Pointer to the table.
+ *	param modules - The modules.
+ *	param modules_num - Number of modules.
+ *	returns 1 if every entry is defined once, 0 otherwise.
+ */
+int build_symbol_table(ld_table *table, ld_module *modules, int modules_num){
+
+	ld_symbol *cell;
+	int i, j, res = 1;
+	unsigned long count = 0;
+
+	for (i = 0; i < modules_num; i++)
+		count += modules[i].entries_num;
+
+	/* at most half of the cells are used, so a search ends after a few cells */
+	for (table -> size = FIRST_SYMBOLS_SIZE; table -> size < 2 * count; table -> size *= 2)
+		;
+
+	if ((table -> cells = (ld_symbol *)counted_calloc(table -> size, sizeof(ld_symbol))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols table");
+		exit(1);
+	}
+
+	for (i = 0; i < modules_num; i++){
+		for (j = 0; j < modules[i].entries_num; j++){
+
+			cell = find_symbol(table, modules[i].entries[j].name);
+
+			if (cell -> name != NULL){
+				errprintf(modules[i].name, NO_LINE_ERROR, "entry %s is already defined in %s", cell -> name, cell -> module -> name);
+				modules[i].errors++;
+				res = 0;
+				continue;
+			}
+
+			cell -> name = modules[i].entries[j].name;
+			cell -> module = &modules[i];
+			if ((cell -> address = relocate_address(&modules[i], modules[i].entries[j].address)) < 0){
+				errprintf(modules[i].name, NO_LINE_ERROR, "entry %s is out of the module", cell -> name);
+				res = 0;
+			}
+		}
+	}
+
+	return res;
+
+}
+
+
+
+/*
+ *	Finds the cell of a symbol in the table (linear probing).
+ *
+ *	param table - Pointer to the table.
+ *	param name - The name of the symbol.
+ *	returns pointer to the cell of the symbol, or to the empty cell where it should be inserted.
+ */
+ld_symbol *find_symbol(ld_table *table, char *name){
+
+	unsigned long i = hash_string(FNV_OFFSET, name) & (table -> size - 1);
+
+	while (table -> cells[i].name != NULL && strcmp(table -> cells[i].name, name) != 0)
+		i = (i + 1) & (table -> size - 1);
+
+	return &(table -> cells[i]);
+
+}
+
+
+
+/*
+ *	Relocates and resolves a range of modules into the image (thread routine).
+ *
+ *	param job_add - Pointer to the ld_job that describes the range.
+ *	returns NULL.
+ */
+void *link_modules_range(void *job_add){
+
+	ld_job *job = (ld_job *)job_add;
+	int i;
+
+	for (i = job -> first; i < job -> last; i++)
+		link_module(&(job -> modules[i]), job -> table, job -> image);
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Copies the words of a module into the image - moves the relocatable words by the bases of the module
+ *	and replaces the external words by the addresses of their entries (as relocatable words).
+ *
+ *	param module - Pointer to the module.
+ *	param table - Pointer to the global symbols.
+ *	param image - The linked words.
+ */
+void link_module(ld_module *module, ld_table *table, unsigned short *image){
+
+	unsigned short *code = image + module -> code_base - MEMORY_ASSUMPTION;
+	ld_symbol *symbol;
+	int i, address;
+
+	for (i = 0; i < module -> ic; i++){
+
+		code[i] = module -> words[i];
+
+		if ((code[i] & ARE_MASK) == rel_code){
+
+			if ((address = relocate_address(module, code[i] >> ADDRESS_SHIFT)) < 0){
+				errprintf(module -> name, NO_LINE_ERROR, "the word at address %d refers out of the module", i + MEMORY_ASSUMPTION);
+				module -> errors++;
+			}
+			else
+				code[i] = (address << ADDRESS_SHIFT) | (code[i] & ARE_MASK);
+		}
+	}
+
+	memcpy(image + module -> data_base - MEMORY_ASSUMPTION, module -> words + module -> ic, module -> dc * sizeof(unsigned short));
+
+	for (i = 0; i < module -> externs_num; i++){
+
+		address = module -> externs[i].address - MEMORY_ASSUMPTION;
+
+		if (address < 0 || address >= module -> ic || (code[address] & ARE_MASK) != ext_code){
+			errprintf(module -> name, NO_LINE_ERROR, "the .ext file does not match the .ob file (address %d)", module -> externs[i].address);
+			module -> errors++;
+		}
+		else if ((symbol = find_symbol(table, module -> externs[i].name)) -> name == NULL){
+			errprintf(module -> name, NO_LINE_ERROR, "undefined reference to %s (no module declares it as an entry)", module -> externs[i].name);
+			code[address] &= ~ARE_MASK; /* it is reported once */
+			module -> errors++;
+		}
+		else
+			code[address] = (symbol -> address << ADDRESS_SHIFT) | rel_code;
+	}
+
+	/* an external word that is not in the .ext file has no name to resolve */
+	for (i = 0; i < module -> ic; i++){
+		if ((code[i] & ARE_MASK) == ext_code){
+			errprintf(module -> name, NO_LINE_ERROR, "the external word at address %d is not in the .ext file", i + MEMORY_ASSUMPTION);
+			module -> errors++;
+		}
+	}
+
+}
+
+
+
+/*
+ *	Relocates an address of a module to its address in the image.
+ *
+ *	param module - Pointer to the module.
+ *	param address - The address in the module (the module is loaded from address 100).
+ *	returns the address in the image, -1 if the address is out of the module.
+ */
+int relocate_address(ld_module *module, int address){
+
+	address -= MEMORY_ASSUMPTION;
+
+	if (address >= 0 && address < module -> ic) /* a code address */
+		return module -> code_base + address;
+
+	if (address >= module -> ic && address < module -> ic + module -> dc) /* a data address */
+		return module -> data_base + address - module -> ic;
+
+	return -1;
+
+}
+
+
+
+/*
+ *	Writes the linked image to a .ob file and the entries of the modules (in their image addresses) to a
+ *	.ent file. All the externals were resolved, so there is no .ext file.
+ *
+ *	param output - The name of the image without extension.
+ *	param modules - The modules.
+ *	param modules_num - Number of modules.
+ *	param image - The linked words.
+ *	param ic - Number of code words.
+ *	param dc - Number of data words.
+ *	returns 1 if the files were written, 0 otherwise.
+ */
+int write_image(char *output, ld_module *modules, int modules_num, unsigned short *image, int ic, int dc){
+
+	FILE *des;
+	char name[MAX_BUFFER], curr_base_line[OB_LINE_LEN];
+	int i, j, is_entry = 0;
+
+	sprintf(name, "%s.ob", output);
+	if (!(des = fopen(name, "w"))){
+		errprintf(name, NO_LINE_ERROR, "cannot write file");
+		return 0;
+	}
+
+	curr_base_line[OB_LINE_LEN - 1] = '\0';
+	fprintf(des, "%d %d\n", ic, dc);
+
+	for (i = 0; i < ic + dc; i++){
+		num_to_base64(image[i], curr_base_line);
+		fprintf(des, "%s\n", curr_base_line);
+	}
+
+	fclose(des);
+
+	sprintf(name, "%s.ent", output);
+	remove(name); /* an old .ent file of the image */
+
+	for (i = 0; i < modules_num; i++)
+		is_entry = is_entry || modules[i].entries_num > 0;
+
+	if (!is_entry)
+		return 1;
+
+	if (!(des = fopen(name, "w"))){
+		errprintf(name, NO_LINE_ERROR, "cannot write file");
+		return 0;
+	}
+
+	for (i = 0; i < modules_num; i++)
+		for (j = 0; j < modules[i].entries_num; j++)
+			fprintf(des, "%s\t%d\n", modules[i].entries[j].name, relocate_address(&modules[i], modules[i].entries[j].address));
+
+	fclose(des);
+
+	return 1;
+
+}
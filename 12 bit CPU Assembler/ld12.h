@@ -0,0 +1,58 @@
+/*
+ *	File: ld12.h
+ *
+ *	This header file serves as an interface for the linker program, which links the assembled modules
+ *	(.ob, .ent and .ext files) into one image. The code of the modules is placed one after the other and
+ *	then their data, the relocatable words and the entry labels are moved by the base of their module,
+ *	and the external words are resolved against the entries of all the modules by a hash table.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+#include "encoder.h"
+#include "mapfile.h"
+#include "trace.h"
+
+#define DEFAULT_OUTPUT "link" /* the name of the linked image without extension (-o option) */
+#define MAX_LINK_THREADS 64
+#define OB_LINE_LEN 3 /* length of a base64 word (2 characters + null terminator) */
+#define FIRST_SYMBOLS_SIZE 16 /* minimum size of the hash table of the entries */
+#define ARE_MASK 0x3 /* A,R,E bits of a code word */
+#define ADDRESS_SHIFT 2 /* the operand of a relocatable or an external word starts at bit 2 */
+
+typedef struct { /* an assembled module */
+	char *name; /* the name of the module without extension */
+	unsigned short *words; /* the code words and then the data words */
+	int ic; /* number of code words */
+	int dc; /* number of data words */
+	map_label *entries; /* the .ent file */
+	int entries_num;
+	int entries_size;
+	map_label *externs; /* the .ext file */
+	int externs_num;
+	int externs_size;
+	int code_base; /* the address of the first code word of the module in the image */
+	int data_base; /* the address of the first data word of the module in the image */
+	int errors;
+} ld_module;
+
+typedef struct { /* a cell of the global symbols hash table */
+	char *name; /* NULL for an empty cell */
+	int address; /* the address in the image */
+	ld_module *module; /* the module that defines the symbol */
+} ld_symbol;
+
+typedef struct {
+	ld_symbol *cells;
+	unsigned long size; /* a power of 2 */
+} ld_table;
+
+typedef struct { /* a range of modules for a thread */
+	ld_module *modules;
+	int first;
+	int last;
+	ld_table *table; /* the symbols (NULL in the read phase) */
+	unsigned short *image; /* the linked words (NULL in the read phase) */
+} ld_job;
@@ -0,0 +1,647 @@
+/*
+ *	File: macro_dict.c
+ *
+ *	This file implements the .include directive and its precompiled macro dictionaries (see macro_dict.h).
+ *	An included file is compiled (its macro definitions are checked and stored) only when it has no valid
+ *	.mcd file, and a loaded dictionary stays mapped until the end of the invocation, so a file that is
+ *	included by many sources is parsed once. Including a dictionary adds its macros to the macro list of
+ *	the source, and the body of such a macro is the text in the dictionary (it is not copied).
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for mmap and getpid in ansi mode */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "macro_list.h"
+#include "macro_dict.h"
+
+/* macro definitions */
+#define FIRST_MACROS_SIZE 16 /* initial size of the macros array of a compiled file */
+#define FIRST_STRINGS_SIZE 1024 /* initial size of the string table of a compiled file */
+#define MIN_TABLE_SIZE 8
+#define MCRO_LEN 4 /* length of the mcro statement */
+#define ENDMCRO_LEN 7 /* length of the endmcro statement */
+#define MCD_NAME_SIZE (MAX_BUFFER + MAX_LABEL_SIZE) /* the path with the extension and a process id */
+#define SOURCE_CHUNK_SIZE 8192 /* the included file is hashed in chunks of this size */
+
+typedef struct { /* a growing string table */
+	char *text;
+	unsigned long size;
+	unsigned long capacity;
+} mcd_strings;
+
+typedef struct { /* the identity of an included file (an edit that keeps the size changes the hash) */
+	unsigned int size;
+	unsigned int hash; /* FNV-1a hash of the contents */
+} mcd_source;
+
+static macro_dict *loaded_dicts = NULL; /* the dictionaries of the invocation */
+static int is_dict_written = 1; /* 0 if a compiled dictionary is kept only in memory */
+
+/* exclusive functions prototype */
+int read_source_identity(char *, mcd_source *);
+int map_macro_dict(macro_dict *, mcd_source *);
+int compile_macro_dict(macro_dict *, mcd_source *);
+int read_macro_defs(FILE *, char *, mcd_strings *, mcd_slot **, unsigned int *);
+int build_macro_image(macro_dict *, mcd_source *, mcd_strings *, mcd_slot *, unsigned int);
+void write_macro_dict(macro_dict *);
+int is_mcd_valid(char *, long, mcd_source *);
+void add_mcd_text(mcd_strings *, const char *, unsigned long);
+unsigned int hash_macro_name(const char *);
+
+
+
+/*
+ *	Checks if a line is an .include statement and finds the included file. A relative name is relative
+ *	to the directory of the source that includes it.
+ *
+ *	param line - The source line.
+ *	param src_name - The name of the source file.
+ *	param path - Buffer of MAX_BUFFER characters to store the path of the included file.
+ *	returns 1 if the line is a valid .include statement, -1 if it is an invalid one, 0 otherwise.
+ */
+int get_include_path(char *line, char *src_name, char *path){
+
+	char *ptr = line, *end;
+
+	while (isspace((unsigned char)*ptr))
+		ptr++;
+
+	if (strncmp(ptr, INCLUDE_DIRECTIVE, strlen(INCLUDE_DIRECTIVE)) != 0)
+		return 0;
+
+	ptr += strlen(INCLUDE_DIRECTIVE);
+	if (!isspace((unsigned char)*ptr) && *ptr != '"')
+		return 0; /* another word that starts with .include */
+
+	while (isspace((unsigned char)*ptr))
+		ptr++;
+
+	if (*ptr != '"' || (end = strchr(ptr + 1, '"')) == NULL || end == ptr + 1 || !is_white(end + 1) ||
+		!get_relative_path(src_name, ptr + 1, end - ptr - 1, path))
+		return -1;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Adds the macros of an included file to the macro list of a source.
+ *
+ *	param path - The included file.
+ *	param src_name - The name of the source file (for error messages).
+ *	param line_num - The line of the .include statement.
+ *	param head_add - Pointer to the head of the macro list.
+ *	param tail_add - Pointer to the tail of the macro list.
+ *	returns 1 if the macros were added, 0 otherwise.
+ */
+int include_macros(char *path, char *src_name, int line_num, macro_node **head_add, macro_node **tail_add){
+
+	macro_dict *dict;
+	macro_node *curr;
+	unsigned int i;
+	int is_valid = 1;
+
+	if ((dict = load_macro_dict(path)) == NULL){
+		errprintf(src_name, line_num, "cannot include '%s'", path);
+		return 0;
+	}
+
+	/* the macros that are already defined are looked up in the dictionary */
+	for (curr = *head_add; curr != NULL; curr = curr -> next)
+		if (find_dict_macro(dict, curr -> macro) != NULL){
+			errprintf(src_name, line_num, "the macro '%s' of '%s' is already defined", curr -> macro, path);
+			is_valid = 0;
+		}
+
+	if (!is_valid)
+		return 0;
+
+	for (i = 0; i < dict -> header -> table_size; i++)
+		if (dict -> table[i].name != 0){
+			insert_macro(head_add, tail_add, dict -> strings + dict -> table[i].name);
+			(*tail_add) -> text = dict -> strings + dict -> table[i].body;
+		}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Loads the dictionary of an included file - an already loaded one, its .mcd file if it is up to date,
+ *	or a newly compiled one (which is written to the .mcd file).
+ *
+ *	param path - The included file.
+ *	returns pointer to the dictionary, NULL if the file cannot be read or it is not valid.
+ */
+macro_dict *load_macro_dict(char *path){
+
+	macro_dict *dict;
+	mcd_source source;
+
+	for (dict = loaded_dicts; dict != NULL; dict = dict -> next)
+		if (strcmp(dict -> path, path) == 0)
+			return dict;
+
+	if (!read_source_identity(path, &source)){
+		errprintf(path, NO_LINE_ERROR, "cannot open file - include");
+		return NULL;
+	}
+
+	if ((dict = (macro_dict *)counted_calloc(1, sizeof(macro_dict))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - macro dictionary");
+		exit(1);
+	}
+
+	strcpy(dict -> path, path);
+
+	if (!map_macro_dict(dict, &source) && !compile_macro_dict(dict, &source)){
+		free(dict);
+		return NULL;
+	}
+
+	dict -> header = (mcd_header *)dict -> base;
+	dict -> table = (mcd_slot *)(dict -> base + dict -> header -> table_offset);
+	dict -> strings = dict -> base + dict -> header -> strings_offset;
+	dict -> next = loaded_dicts;
+	loaded_dicts = dict;
+
+	return dict;
+
+}
+
+
+
+/*
+ *	Finds a macro in a dictionary.
+ *
+ *	param dict - Pointer to the dictionary.
+ *	param name - The name of the macro.
+ *	returns pointer to the slot of the macro, NULL if it is not in the dictionary.
+ */
+mcd_slot *find_dict_macro(macro_dict *dict, char *name){
+
+	unsigned int hash = hash_macro_name(name), mask = dict -> header -> table_size - 1, i, cnt;
+	mcd_slot *slot;
+
+	for (i = hash & mask, cnt = 0; cnt <= mask; i = (i + 1) & mask, cnt++){
+
+		slot = &(dict -> table[i]);
+
+		if (slot -> name == 0)
+			return NULL;
+
+		if (slot -> hash == hash && strcmp(dict -> strings + slot -> name, name) == 0)
+			return slot;
+	}
+
+	return NULL;
+
+}
+
+
+
+/*
+ *	Sets if the compiled dictionaries are written to .mcd files (the stream mode writes no files).
+ *
+ *	param is_written - 1 to write the compiled dictionaries, 0 to keep them only in memory.
+ */
+void set_macro_dict_writes(int is_written){
+
+	is_dict_written = is_written;
+
+}
+
+
+
+/*
+ *	Unmaps (or frees) all the loaded dictionaries.
+ */
+void close_macro_dicts(void){
+
+	macro_dict *next;
+
+	while (loaded_dicts != NULL){
+
+		next = loaded_dicts -> next;
+
+		if (loaded_dicts -> is_mapped)
+			munmap(loaded_dicts -> base, loaded_dicts -> size);
+		else
+			free(loaded_dicts -> base);
+
+		free(loaded_dicts);
+		loaded_dicts = next;
+	}
+
+}
+
+
+
+/*
+ *	Reads an included file to get its size and the hash of its contents.
+ *
+ *	param path - The included file.
+ *	param source - Pointer to store the identity of the file.
+ *	returns 1 if the file was read, 0 if it cannot be opened.
+ */
+int read_source_identity(char *path, mcd_source *source){
+
+	FILE *src;
+	unsigned char chunk[SOURCE_CHUNK_SIZE];
+	unsigned long hash = FNV_OFFSET, size = 0;
+	size_t cnt, i;
+
+	if (!(src = fopen(path, "rb")))
+		return 0;
+
+	while ((cnt = fread(chunk, 1, SOURCE_CHUNK_SIZE, src)) > 0){
+		for (i = 0; i < cnt; i++)
+			hash = HASH_BYTE(hash, chunk[i]);
+		size += cnt;
+	}
+
+	fclose(src);
+
+	source -> size = (unsigned int)size;
+	source -> hash = (unsigned int)hash;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Maps the .mcd file of an included file, if it exists and it was compiled from the current file.
+ *
+ *	param dict - Pointer to the dictionary (its path is set).
+ *	param source - The identity of the included file.
+ *	returns 1 if the file was mapped, 0 otherwise.
+ */
+int map_macro_dict(macro_dict *dict, mcd_source *source){
+
+	struct stat mcd_st;
+	char mcd_name[MCD_NAME_SIZE];
+	void *base;
+	int fd;
+
+	sprintf(mcd_name, "%s%s", dict -> path, MCD_EXT);
+
+	if ((fd = open(mcd_name, O_RDONLY)) < 0)
+		return 0;
+
+	if (fstat(fd, &mcd_st) != 0 || mcd_st.st_size < (long)sizeof(mcd_header) ||
+		(base = mmap(NULL, mcd_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+		close(fd);
+		return 0;
+	}
+
+	close(fd); /* the mapping stays valid */
+
+	if (!is_mcd_valid((char *)base, mcd_st.st_size, source)){ /* an old or a foreign file is compiled again */
+		munmap(base, mcd_st.st_size);
+		return 0;
+	}
+
+	dict -> base = (char *)base;
+	dict -> size = mcd_st.st_size;
+	dict -> is_mapped = 1;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Compiles an included file into a dictionary image and writes it to the .mcd file.
+ *
+ *	param dict - Pointer to the dictionary (its path is set).
+ *	param source - The identity of the included file.
+ *	returns 1 if the file was compiled, 0 if it cannot be read or it is not valid.
+ */
+int compile_macro_dict(macro_dict *dict, mcd_source *source){
+
+	FILE *src;
+	mcd_strings strings = {NULL, 0, 0};
+	mcd_slot *macros = NULL;
+	unsigned int macros_num = 0;
+	int is_valid;
+
+	if (!(src = fopen(dict -> path, "r"))){
+		errprintf(dict -> path, NO_LINE_ERROR, "cannot open file - include");
+		return 0;
+	}
+
+	add_mcd_text(&strings, "", 1); /* offset 0 is the name of the empty slots */
+
+	is_valid = read_macro_defs(src, dict -> path, &strings, &macros, &macros_num) &&
+			   build_macro_image(dict, source, &strings, macros, macros_num);
+
+	fclose(src);
+	free(strings.text);
+	free(macros);
+
+	if (is_valid && is_dict_written)
+		write_macro_dict(dict);
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Reads the macro definitions of an included file (the file may hold only macro definitions, empty
+ *	lines and comments).
+ *
+ *	param src - The included file.
+ *	param src_name - The name of the included file (for error messages).
+ *	param strings - The string table to store the names and the bodies.
+ *	param macros_add - Pointer to the macros array (its slots are not in the hash table yet).
+ *	param macros_num - Pointer to the number of macros.
+ *	returns 1 if the definitions are valid, 0 otherwise.
+ */
+int read_macro_defs(FILE *src, char *src_name, mcd_strings *strings, mcd_slot **macros_add, unsigned int *macros_num){
+
+	char curr_line[MAX_BUFFER], temp[MAX_BUFFER], *line_ptr;
+	unsigned int macros_size = 0;
+	int line_num = 0, mcro_flag = 0, is_valid = 1;
+
+	while (fgets(curr_line, MAX_BUFFER, src) != NULL){
+
+		line_num++;
+
+		if (!check_length(curr_line)){
+			errprintf(src_name, line_num, "line overflow - length of line is up to 80 characters");
+			is_valid = 0;
+		}
+
+		else if (!mcro_flag && (is_white(curr_line) || is_comment(curr_line) == 1))
+			continue; /* empty lines and comments between the definitions */
+
+		else if ((line_ptr = strstr(curr_line, "endmcro")) != NULL){
+
+			memset(temp, '\0', MAX_BUFFER);
+			strncpy(temp, curr_line, line_ptr - curr_line);
+
+			if (!mcro_flag){
+				errprintf(src_name, line_num, "endmcro statement without a mcro statement");
+				is_valid = 0;
+			}
+			else if (!is_white(temp) || !is_white(line_ptr + ENDMCRO_LEN)){
+				errprintf(src_name, line_num, "additional characters are not allowed in endmcro statement");
+				is_valid = 0;
+			}
+			else {
+				add_mcd_text(strings, "", 1); /* ends the body */
+				mcro_flag = 0;
+			}
+		}
+
+		else if (mcro_flag) /* a line of the body */
+			add_mcd_text(strings, curr_line, strlen(curr_line));
+
+		else if ((line_ptr = strstr(curr_line, "mcro")) != NULL){
+
+			memset(temp, '\0', MAX_BUFFER);
+			strncpy(temp, curr_line, line_ptr - curr_line);
+			line_ptr += MCRO_LEN;
+
+			if (!is_white(temp)){
+				errprintf(src_name, line_num, "additional characters are not allowed in mcro statement");
+				is_valid = 0;
+				continue;
+			}
+
+			if (is_valid_lm(line_ptr, 0) != 1){
+				errprintf(src_name, line_num, "the macro '%s' is not a valid macro name", line_ptr);
+				is_valid = 0;
+				continue;
+			}
+
+			if (*macros_num == macros_size){ /* if the array is full */
+
+				macros_size = macros_size ? macros_size * 2 : FIRST_MACROS_SIZE;
+				*macros_add = (mcd_slot *)counted_realloc(*macros_add, sizeof(mcd_slot) * macros_size);
+
+				if (*macros_add == NULL){
+					errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - macro dictionary");
+					exit(1);
+				}
+			}
+
+			(*macros_add)[*macros_num].hash = hash_macro_name(line_ptr);
+			(*macros_add)[*macros_num].name = strings -> size;
+			add_mcd_text(strings, line_ptr, strlen(line_ptr) + 1);
+			(*macros_add)[*macros_num].body = strings -> size;
+			(*macros_add)[(*macros_num)++].line = line_num;
+			mcro_flag = 1;
+		}
+
+		else {
+			errprintf(src_name, line_num, "only macro definitions are allowed in an included file");
+			is_valid = 0;
+		}
+	}
+
+	if (mcro_flag){
+		errprintf(src_name, line_num, "missing endmcro statement");
+		is_valid = 0;
+	}
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Builds the image of a dictionary (the header, the hash table and the string table) from the
+ *	compiled macros.
+ *
+ *	param dict - Pointer to the dictionary.
+ *	param source - The identity of the included file.
+ *	param strings - The string table.
+ *	param macros - The macros.
+ *	param macros_num - Number of macros.
+ *	returns 1 if the image was built, 0 if a macro is defined twice.
+ */
+int build_macro_image(macro_dict *dict, mcd_source *source, mcd_strings *strings, mcd_slot *macros, unsigned int macros_num){
+
+	mcd_header *header;
+	mcd_slot *table;
+	unsigned int table_size = MIN_TABLE_SIZE, i, j, mask;
+	int is_valid = 1;
+
+	while (table_size < macros_num * 2) /* at most half of the slots are used */
+		table_size *= 2;
+
+	dict -> size = sizeof(mcd_header) + table_size * sizeof(mcd_slot) + strings -> size;
+
+	if ((dict -> base = (char *)counted_calloc(dict -> size, 1)) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - macro dictionary");
+		exit(1);
+	}
+
+	header = (mcd_header *)dict -> base;
+	memcpy(header -> magic, MCD_MAGIC, sizeof(MCD_MAGIC));
+	header -> byte_order = MCD_BYTE_ORDER;
+	header -> version = MCD_VERSION;
+	header -> source_size = source -> size;
+	header -> source_hash = source -> hash;
+	header -> macros_num = macros_num;
+	header -> table_size = table_size;
+	header -> table_offset = sizeof(mcd_header);
+	header -> strings_offset = sizeof(mcd_header) + table_size * sizeof(mcd_slot);
+	header -> strings_size = strings -> size;
+
+	table = (mcd_slot *)(dict -> base + header -> table_offset);
+	memcpy(dict -> base + header -> strings_offset, strings -> text, strings -> size);
+
+	for (i = 0, mask = table_size - 1; i < macros_num; i++){
+
+		for (j = macros[i].hash & mask; table[j].name != 0; j = (j + 1) & mask)
+			if (table[j].hash == macros[i].hash && strcmp(strings -> text + table[j].name, strings -> text + macros[i].name) == 0)
+				break;
+
+		if (table[j].name != 0){
+			errprintf(dict -> path, macros[i].line, "the macro '%s' is already defined", strings -> text + macros[i].name);
+			is_valid = 0;
+		}
+		else
+			table[j] = macros[i];
+	}
+
+	if (!is_valid){
+		free(dict -> base);
+		dict -> base = NULL;
+	}
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Writes the image of a compiled dictionary to its .mcd file. The image is written to a temporary file
+ *	which is then renamed, so another invocation never maps a partly written file. If the file cannot be
+ *	written the dictionary is used from memory.
+ *
+ *	param dict - Pointer to the compiled dictionary.
+ */
+void write_macro_dict(macro_dict *dict){
+
+	FILE *des;
+	char mcd_name[MCD_NAME_SIZE], temp_name[MCD_NAME_SIZE + MAX_LABEL_SIZE];
+	int is_written;
+
+	sprintf(mcd_name, "%s%s", dict -> path, MCD_EXT);
+	sprintf(temp_name, "%s.%ld", mcd_name, (long)getpid());
+
+	if (!(des = fopen(temp_name, "wb"))){
+		warnprintf(mcd_name, NO_LINE_ERROR, "cannot write the macro dictionary - the included file is compiled again by every invocation");
+		return;
+	}
+
+	is_written = fwrite(dict -> base, 1, dict -> size, des) == (size_t)dict -> size;
+	is_written = fclose(des) == 0 && is_written;
+
+	if (!is_written || rename(temp_name, mcd_name) != 0){
+		warnprintf(mcd_name, NO_LINE_ERROR, "cannot write the macro dictionary - the included file is compiled again by every invocation");
+		remove(temp_name);
+	}
+
+}
+
+
+
+/*
+ *	Checks that a .mcd file was compiled from the current included file and that its sections are in
+ *	the file.
+ *
+ *	param base - The mapped file.
+ *	param size - The size of the file.
+ *	param source - The identity of the included file.
+ *	returns 1 if the file is valid, 0 otherwise.
+ */
+int is_mcd_valid(char *base, long size, mcd_source *source){
+
+	mcd_header *header = (mcd_header *)base;
+	mcd_slot *table;
+	unsigned int i;
+
+	if (memcmp(header -> magic, MCD_MAGIC, sizeof(MCD_MAGIC)) != 0 || header -> byte_order != MCD_BYTE_ORDER ||
+		header -> version != MCD_VERSION || header -> source_size != source -> size ||
+		header -> source_hash != source -> hash ||
+		header -> table_size == 0 || (header -> table_size & (header -> table_size - 1)) != 0 ||
+		header -> macros_num >= header -> table_size || header -> table_offset != sizeof(mcd_header) ||
+		header -> table_size > (unsigned long)(size - header -> table_offset) / sizeof(mcd_slot) ||
+		header -> strings_offset != header -> table_offset + header -> table_size * sizeof(mcd_slot) ||
+		header -> strings_size == 0 || header -> strings_size > (unsigned long)(size - header -> strings_offset) ||
+		base[header -> strings_offset + header -> strings_size - 1] != '\0')
+		return 0;
+
+	/* every name and body starts in the string table, which ends with a null */
+	table = (mcd_slot *)(base + header -> table_offset);
+	for (i = 0; i < header -> table_size; i++)
+		if (table[i].name >= header -> strings_size || table[i].body >= header -> strings_size ||
+			strlen(base + header -> strings_offset + table[i].name) >= MAX_LINE)
+			return 0;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Appends text to a string table.
+ *
+ *	param strings - Pointer to the string table.
+ *	param text - The text.
+ *	param len - Number of characters to append.
+ */
+void add_mcd_text(mcd_strings *strings, const char *text, unsigned long len){
+
+	if (strings -> size + len > strings -> capacity){
+
+		while (strings -> size + len > strings -> capacity)
+			strings -> capacity = strings -> capacity ? strings -> capacity * 2 : FIRST_STRINGS_SIZE;
+
+		if ((strings -> text = (char *)counted_realloc(strings -> text, strings -> capacity)) == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - macro dictionary");
+			exit(1);
+		}
+	}
+
+	memcpy(strings -> text + strings -> size, text, len);
+	strings -> size += len;
+
+}
+
+
+
+/*
+ *	Computes the 32 bit FNV-1a hash of a macro name.
+ *
+ *	param name - The name.
+ *	returns the hash.
+ */
+unsigned int hash_macro_name(const char *name){
+
+	return (unsigned int)hash_string(FNV_OFFSET, name);
+
+}
@@ -0,0 +1,62 @@
+/*
+ *	File: macro_dict.h
+ *
+ *	Defines the precompiled macro dictionary format (.mcd) and the function prototypes of the .include
+ *	directive. A file that is included by '.include "file"' holds only macro definitions, and it is
+ *	compiled once into <file>.mcd:
+ *		header (mcd_header)
+ *		hash table - an mcd_slot for every cell (FNV-1a hash of the name, linear probing)
+ *		string table - the null terminated names and bodies of the macros (a body is the text of its lines)
+ *	The dictionary is mapped into memory and shared by all the files of an invocation, and later
+ *	invocations map the same .mcd file while the size and the contents hash of the included file are
+ *	the same (otherwise it is compiled again).
+ *	The macros are added to a macro list, so macro_list.h must be included before.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define MCD_MAGIC "MCD" /* the first bytes of a .mcd file (with a null) */
+#define MCD_VERSION 2
+#define MCD_BYTE_ORDER 0x01020304 /* reads differently on a machine of another byte order */
+#define MCD_EXT ".mcd"
+#define INCLUDE_DIRECTIVE ".include"
+
+typedef struct {
+	char magic[4];
+	unsigned int byte_order;
+	unsigned int version;
+	unsigned int source_size; /* the size of the included file when it was compiled */
+	unsigned int source_hash; /* the FNV-1a hash of the contents of the included file when it was compiled */
+	unsigned int macros_num;
+	unsigned int table_size; /* number of slots (a power of 2) */
+	unsigned int table_offset; /* the offsets are in bytes from the start of the file */
+	unsigned int strings_offset;
+	unsigned int strings_size;
+} mcd_header;
+
+typedef struct {
+	unsigned int hash; /* the hash of the name */
+	unsigned int name; /* offset of the name in the string table, 0 for an empty slot */
+	unsigned int body; /* offset of the body in the string table */
+	unsigned int line; /* the line of the mcro statement in the included file */
+} mcd_slot;
+
+typedef struct macro_dict { /* a loaded dictionary */
+	char path[MAX_BUFFER]; /* the included file */
+	char *base; /* the mapped file (or the compiled image if it could not be written) */
+	long size;
+	int is_mapped;
+	mcd_header *header;
+	mcd_slot *table;
+	char *strings;
+	struct macro_dict *next;
+} macro_dict;
+
+/* functions prototype */
+int get_include_path(char *, char *, char *);
+int include_macros(char *, char *, int, macro_node **, macro_node **);
+macro_dict *load_macro_dict(char *);
+mcd_slot *find_dict_macro(macro_dict *, char *);
+void set_macro_dict_writes(int);
+void close_macro_dicts(void);
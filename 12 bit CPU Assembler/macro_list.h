@@ -17,6 +17,7 @@
 typedef struct l_node {
 
     char line[MAX_LINE];
+    int line_num; /* the line in the .as file */
     struct l_node *next;
     struct l_node *prev;
     
@@ -29,6 +30,7 @@ typedef struct m_node {
     struct m_node *prev;
     line_node *head_line;
     line_node *tail_line;
+    const char *text; /* the body of an included macro (in its dictionary), NULL for a macro of the source */
     
 }macro_node;
 
@@ -36,8 +38,8 @@ typedef struct m_node {
 /* functions prototype */
 macro_node *create_macro(char[]);
 void insert_macro(macro_node **, macro_node **, char[]);
-line_node *create_line(macro_node **, char[]);
-void insert_line(macro_node **, char[]);
+line_node *create_line(macro_node **, char[], int);
+void insert_line(macro_node **, char[], int);
 macro_node *is_macro(macro_node **, char []);
 void free_macro_list(macro_node **);
 void delete_macro_lines(macro_node **);
@@ -0,0 +1,427 @@
+/*
+ *	File: mapfile.c
+ *
+ *	This file writes and reads the binary .map file (the format is described in mapfile.h).
+ *	The addresses and the lines are delta encoded into LEB128 varints, so most of the numbers take a byte.
+ *	A read .map file is kept in sorted arrays, hence an address is resolved by a binary search.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "mapfile.h"
+
+/* macro definitions */
+#define VARINT_MAX_SHIFT 35 /* a varint of more than 5 bytes does not fit an int */
+
+typedef struct { /* a cursor on the bytes of a read .map file */
+	unsigned char *pos;
+	unsigned char *end;
+	int is_valid; /* 0 after reading past the end or a too long varint */
+} map_reader;
+
+/* exclusive functions prototype */
+void put_varint(FILE *, unsigned long);
+void put_signed_varint(FILE *, long);
+unsigned long get_varint(map_reader *);
+long get_signed_varint(map_reader *);
+int get_count(map_reader *);
+void *map_alloc(int, size_t);
+
+
+
+/*
+ *	Logs the origin of the next line of the .am file.
+ *
+ *	param origins - Pointer to the origins vector
+ *	param line - The line in the .as file (of the macro call for an expanded line)
+ *	param macro_line - The line of the macro definition in the .as file (0 if not expanded from a macro)
+ */
+void insert_map_origin(map_origin_vector *origins, int line, int macro_line){
+
+	if (origins -> count == origins -> size){ /* if the vector is full */
+
+		origins -> size = origins -> size ? origins -> size * 2 : FIRST_ORIGINS_SIZE;
+		origins -> origins = (map_origin *)counted_realloc(origins -> origins, sizeof(map_origin) * origins -> size);
+
+		if (origins -> origins == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - line origins");
+        	exit(1);
+		}
+	}
+
+	origins -> origins[origins -> count].line = line;
+	origins -> origins[(origins -> count)++].macro_line = macro_line;
+
+}
+
+
+/*
+ *	Frees the memory used by the origins vector and resets it.
+ *
+ *	param origins - Pointer to the origins vector
+ */
+void free_map_origins(map_origin_vector *origins){
+
+	free(origins -> origins);
+	origins -> origins = NULL;
+	origins -> count = 0;
+	origins -> size = 0;
+
+}
+
+
+/*
+ *	Writes a .map file.
+ *
+ *	param file_name - The name of the program without extension
+ *	param map - Pointer to the map (the labels and the ranges must be sorted by address)
+ *	returns 1 if the file was written, 0 otherwise.
+ */
+int write_map_file(char *file_name, map_file *map){
+
+	FILE *des;
+	char map_name[MAX_BUFFER];
+	int i, prev = 0, len;
+
+	sprintf(map_name, "%s.map", file_name);
+	if (!(des = fopen(map_name, "wb"))){
+
+		errprintf(map_name, NO_LINE_ERROR, "cannot write file");
+		return 0;
+
+	}
+
+	fwrite(MAP_MAGIC, 1, MAP_HEADER_LEN - 1, des);
+	putc(MAP_VERSION, des);
+
+	put_varint(des, len = strlen(map -> name));
+	fwrite(map -> name, 1, len, des);
+
+	/* labels */
+	put_varint(des, map -> labels_num);
+	for (i = 0; i < map -> labels_num; i++){
+		put_varint(des, map -> labels[i].address - prev);
+		prev = map -> labels[i].address;
+		put_varint(des, len = strlen(map -> labels[i].name));
+		fwrite(map -> labels[i].name, 1, len, des);
+	}
+
+	/* ranges - prev is the end of the previous range and len is its line */
+	put_varint(des, map -> ranges_num);
+	for (i = prev = len = 0; i < map -> ranges_num; i++){
+		put_varint(des, map -> ranges[i].address - prev);
+		put_varint(des, map -> ranges[i].length);
+		put_signed_varint(des, map -> ranges[i].line - len);
+		prev = map -> ranges[i].address + map -> ranges[i].length;
+		len = map -> ranges[i].line;
+	}
+
+	/* origins */
+	put_varint(des, map -> origins_num);
+	for (i = prev = 0; i < map -> origins_num; i++){
+		put_signed_varint(des, map -> origins[i].line - prev);
+		put_varint(des, map -> origins[i].macro_line);
+		prev = map -> origins[i].line;
+	}
+
+	fclose(des);
+
+	return 1;
+
+}
+
+
+/*
+ *	Reads a .map file.
+ *
+ *	param file_name - The name of the program without extension
+ *	returns pointer to the map (free it by free_map_file), NULL if the file could not be read.
+ */
+map_file *read_map_file(char *file_name){
+
+	FILE *src;
+	char map_name[MAX_BUFFER];
+	unsigned char *bytes;
+	map_reader reader;
+	map_file *map;
+	long size;
+	int i, prev, len;
+
+	sprintf(map_name, "%s.map", file_name);
+	if (!(src = fopen(map_name, "rb"))){
+		errprintf(map_name, NO_LINE_ERROR, "cannot open file (assemble the program with --map)");
+		return NULL;
+	}
+
+	fseek(src, 0, SEEK_END);
+	size = ftell(src);
+	rewind(src);
+
+	bytes = (unsigned char *)map_alloc(size + 1, 1);
+	size = fread(bytes, 1, size, src);
+	fclose(src);
+
+	if (size < MAP_HEADER_LEN || memcmp(bytes, MAP_MAGIC, MAP_HEADER_LEN - 1) != 0 || bytes[MAP_HEADER_LEN - 1] != MAP_VERSION){
+		errprintf(map_name, NO_LINE_ERROR, "not a .map file of this version (assemble the program again with --map)");
+		free(bytes);
+		return NULL;
+	}
+
+	reader.pos = bytes + MAP_HEADER_LEN;
+	reader.end = bytes + size;
+	reader.is_valid = 1;
+	map = (map_file *)map_alloc(1, sizeof(map_file));
+
+	len = get_count(&reader);
+	if (len < MAX_BUFFER){
+		memcpy(map -> name, reader.pos, len);
+		reader.pos += len;
+	}
+	else
+		reader.is_valid = 0;
+
+	/* labels */
+	map -> labels_num = get_count(&reader);
+	map -> labels = (map_label *)map_alloc(map -> labels_num, sizeof(map_label));
+	for (i = prev = 0; reader.is_valid && i < map -> labels_num; i++){
+		map -> labels[i].address = prev += get_varint(&reader);
+		if ((len = get_count(&reader)) < MAX_LABEL_SIZE){
+			memcpy(map -> labels[i].name, reader.pos, len);
+			reader.pos += len;
+		}
+		else
+			reader.is_valid = 0;
+	}
+
+	/* ranges - prev is the end of the previous range and len is its line */
+	map -> ranges_num = get_count(&reader);
+	map -> ranges = (map_range *)map_alloc(map -> ranges_num, sizeof(map_range));
+	for (i = prev = len = 0; reader.is_valid && i < map -> ranges_num; i++){
+		map -> ranges[i].address = prev + get_varint(&reader);
+		map -> ranges[i].length = get_varint(&reader);
+		map -> ranges[i].line = len += get_signed_varint(&reader);
+		prev = map -> ranges[i].address + map -> ranges[i].length;
+	}
+
+	/* origins */
+	map -> origins_num = get_count(&reader);
+	map -> origins = (map_origin *)map_alloc(map -> origins_num, sizeof(map_origin));
+	for (i = prev = 0; reader.is_valid && i < map -> origins_num; i++){
+		map -> origins[i].line = prev += get_signed_varint(&reader);
+		map -> origins[i].macro_line = get_varint(&reader);
+	}
+
+	free(bytes);
+
+	if (!reader.is_valid){
+		errprintf(map_name, NO_LINE_ERROR, "the .map file is truncated or corrupted");
+		free_map_file(map);
+		return NULL;
+	}
+
+	return map;
+
+}
+
+
+/*
+ *	Frees a read .map file.
+ *
+ *	param map - Pointer to the map
+ */
+void free_map_file(map_file *map){
+
+	free(map -> labels);
+	free(map -> ranges);
+	free(map -> origins);
+	free(map);
+
+}
+
+
+/*
+ *	Finds the range of memory words that contains an address (binary search).
+ *
+ *	param map - Pointer to the map
+ *	param address - The address
+ *	returns the index of the range, -1 if no source line has a word in the address.
+ */
+int find_map_range(map_file *map, int address){
+
+	int low = 0, high = map -> ranges_num - 1, mid;
+
+	while (low <= high){
+
+		mid = (low + high) / 2;
+
+		if (address < map -> ranges[mid].address)
+			high = mid - 1;
+		else if (address >= map -> ranges[mid].address + map -> ranges[mid].length)
+			low = mid + 1;
+		else
+			return mid;
+	}
+
+	return -1;
+
+}
+
+
+/*
+ *	Finds the label that owns an address - the last label whose address is not greater (binary search).
+ *
+ *	param map - Pointer to the map
+ *	param address - The address
+ *	returns the index of the label, -1 if the address is before the first label.
+ */
+int find_map_label(map_file *map, int address){
+
+	int low = 0, high = map -> labels_num - 1, mid, res = -1;
+
+	while (low <= high){
+
+		mid = (low + high) / 2;
+
+		if (map -> labels[mid].address <= address){
+			res = mid;
+			low = mid + 1;
+		}
+		else
+			high = mid - 1;
+	}
+
+	return res;
+
+}
+
+
+/*
+ *	Gets the origin of a line of the .am file.
+ *
+ *	param map - Pointer to the map
+ *	param line - The line in the .am file
+ *	returns pointer to the origin, NULL if the line is out of the file.
+ */
+map_origin *get_map_origin(map_file *map, int line){
+
+	return line >= 1 && line <= map -> origins_num ? &(map -> origins[line - 1]) : NULL;
+
+}
+
+
+/*
+ *	Writes a LEB128 varint (7 bits in every byte, the high bit is set if more bytes follow).
+ *
+ *	param des - Pointer to the file stream to write to
+ *	param value - The value
+ */
+void put_varint(FILE *des, unsigned long value){
+
+	while (value >= 0x80){
+		putc((int)(value & 0x7F) | 0x80, des);
+		value >>= 7;
+	}
+
+	putc((int)value, des);
+
+}
+
+
+/*
+ *	Writes a signed varint - zigzag encoded (0, -1, 1, -2, ... are 0, 1, 2, 3, ...) so a small negative
+ *	delta takes a byte too.
+ *
+ *	param des - Pointer to the file stream to write to
+ *	param value - The value
+ */
+void put_signed_varint(FILE *des, long value){
+
+	put_varint(des, value < 0 ? ((unsigned long)(-(value + 1)) << 1) | 1 : (unsigned long)value << 1);
+
+}
+
+
+/*
+ *	Reads a LEB128 varint.
+ *
+ *	param reader - Pointer to the reader
+ *	returns the value (0 if the reader became invalid).
+ */
+unsigned long get_varint(map_reader *reader){
+
+	unsigned long value = 0;
+	int shift = 0, byte;
+
+	do {
+		if (reader -> pos >= reader -> end || shift >= VARINT_MAX_SHIFT){
+			reader -> is_valid = 0;
+			return 0;
+		}
+
+		byte = *(reader -> pos)++;
+		value |= (unsigned long)(byte & 0x7F) << shift;
+		shift += 7;
+
+	} while (byte & 0x80);
+
+	return value;
+
+}
+
+
+/*
+ *	Reads a zigzag encoded signed varint.
+ *
+ *	param reader - Pointer to the reader
+ *	returns the value (0 if the reader became invalid).
+ */
+long get_signed_varint(map_reader *reader){
+
+	unsigned long value = get_varint(reader);
+
+	return value & 1 ? -(long)(value >> 1) - 1 : (long)(value >> 1);
+
+}
+
+
+/*
+ *	Reads a count or a length. Every counted item takes at least a byte, so a count that is greater
+ *	than the number of bytes left is invalid (it protects the allocations from a corrupted file).
+ *
+ *	param reader - Pointer to the reader
+ *	returns the count (0 if it is invalid).
+ */
+int get_count(map_reader *reader){
+
+	unsigned long count = get_varint(reader);
+
+	if (count > (unsigned long)(reader -> end - reader -> pos)){
+		reader -> is_valid = 0;
+		return 0;
+	}
+
+	return (int)count;
+
+}
+
+
+/*
+ *	Allocates a zeroed array of the map.
+ *
+ *	param count - Number of cells
+ *	param cell - Size of a cell
+ *	returns the array.
+ */
+void *map_alloc(int count, size_t cell){
+
+	void *array = counted_calloc(count > 0 ? count : 1, cell);
+
+	if (array == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - map file");
+		exit(1);
+	}
+
+	return array;
+
+}
@@ -0,0 +1,67 @@
+/*
+ *	File: mapfile.h
+ *
+ *	Defines the data structures and function prototypes of the binary .map file (assembler --map option).
+ *	The file maps the memory words of a program back to its labels, to the lines of its .am file and
+ *	through the macro expansions to the lines of its .as file.
+ *
+ *	Format (every number is a LEB128 varint, a signed delta is zigzag encoded):
+ *		magic "M12" and a version byte
+ *		length and bytes of the name of the program (without extension)
+ *		labels: count, then by address - address delta, name length and name bytes
+ *		ranges: count, then by address - gap from the end of the previous range, length and signed .am line delta
+ *		origins: count, then for every .am line - signed .as line delta and the .as line of the macro
+ *				 definition line it was expanded from (0 if it was not expanded from a macro)
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+#define MAP_MAGIC "M12" /* the first bytes of a .map file */
+#define MAP_VERSION 1
+#define MAP_HEADER_LEN 4 /* magic and version */
+#define FIRST_ORIGINS_SIZE 256 /* initial size of the origins vector (doubled when full) */
+
+typedef struct {
+	char name[MAX_LABEL_SIZE];
+	int address;
+} map_label;
+
+typedef struct {
+	int address; /* the first memory word */
+	int length; /* number of words */
+	int line; /* the line in the .am file */
+} map_range;
+
+typedef struct {
+	int line; /* the line in the .as file (of the macro call for an expanded line) */
+	int macro_line; /* the line of the macro definition in the .as file, 0 if not expanded from a macro */
+} map_origin;
+
+typedef struct {
+	map_origin *origins; /* origins[i] is the origin of the line i + 1 of the .am file */
+	int count;
+	int size;
+} map_origin_vector;
+
+typedef struct {
+	char name[MAX_BUFFER]; /* the name of the program without extension */
+	map_label *labels; /* sorted by address */
+	int labels_num;
+	map_range *ranges; /* sorted by address (the code lines and then the data lines) */
+	int ranges_num;
+	map_origin *origins;
+	int origins_num;
+} map_file;
+
+/* functions prototype */
+void insert_map_origin(map_origin_vector *, int, int);
+void free_map_origins(map_origin_vector *);
+int write_map_file(char *, map_file *);
+map_file *read_map_file(char *);
+void free_map_file(map_file *);
+int find_map_range(map_file *, int);
+int find_map_label(map_file *, int);
+map_origin *get_map_origin(map_file *, int);
@@ -0,0 +1,262 @@
+/*
+ *	File: obb.c
+ *
+ *	This file writes and loads the binary object format (.obb, described in obb.h).
+ *	The loader maps the file into memory and only checks that the header and the sections are valid,
+ *	so the words and the symbols are used in place without any decoding.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for mmap in ansi mode */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mapfile.h"
+#include "obb.h"
+
+/* macro definitions */
+#define ALIGN_UP(offset) (((offset) + OBB_ALIGN - 1) / OBB_ALIGN * OBB_ALIGN)
+/* the name of a symbol is the name of the previous symbol (the externs of a label are adjacent) */
+#define IS_SAME_NAME(symbols, i) ((i) > 0 && strcmp((symbols)[i].name, (symbols)[(i) - 1].name) == 0)
+
+/* exclusive functions prototype */
+unsigned int write_obb_symbols(FILE *, map_label *, int, unsigned int);
+void write_obb_names(FILE *, map_label *, int);
+int is_obb_section_valid(long, unsigned long, unsigned long, unsigned long);
+int are_obb_names_valid(obb_symbol *, unsigned int, unsigned int);
+
+
+
+/*
+ *	Writes a .obb file.
+ *
+ *	param file_name - The name of the program without extension
+ *	param words - The code words and then the data words
+ *	param ic - Number of code words
+ *	param dc - Number of data words
+ *	param entries - The entry labels and their addresses
+ *	param entries_num - Number of entry labels
+ *	param externs - The external labels and the addresses of the words that refer to them
+ *	param externs_num - Number of external references
+ *	returns 1 if the file was written, 0 otherwise.
+ */
+int write_obb_file(char *file_name, unsigned short *words, int ic, int dc, map_label *entries, int entries_num,
+				   map_label *externs, int externs_num){
+
+	FILE *des;
+	char obb_name[MAX_BUFFER], pad[OBB_ALIGN] = {0};
+	obb_header header;
+	unsigned int strings_size;
+
+	sprintf(obb_name, "%s.obb", file_name);
+	if (!(des = fopen(obb_name, "wb"))){
+
+		errprintf(obb_name, NO_LINE_ERROR, "cannot write file");
+		return 0;
+
+	}
+
+	memset(&header, 0, sizeof(obb_header));
+	strcpy(header.magic, OBB_MAGIC);
+	header.byte_order = OBB_BYTE_ORDER;
+	header.version = OBB_VERSION;
+	header.load_address = MEMORY_ASSUMPTION;
+	header.ic = ic;
+	header.dc = dc;
+	header.words_offset = sizeof(obb_header);
+	header.entries_offset = ALIGN_UP(header.words_offset + (ic + dc) * sizeof(unsigned short));
+	header.entries_num = entries_num;
+	header.externs_offset = header.entries_offset + entries_num * sizeof(obb_symbol);
+	header.externs_num = externs_num;
+	header.strings_offset = header.externs_offset + externs_num * sizeof(obb_symbol);
+
+	/* the symbols are written after the header, so the size of the string table is computed first */
+	strings_size = write_obb_symbols(NULL, entries, entries_num, 0);
+	header.strings_size = write_obb_symbols(NULL, externs, externs_num, strings_size);
+
+	fwrite(&header, sizeof(obb_header), 1, des);
+	fwrite(words, sizeof(unsigned short), ic + dc, des);
+	fwrite(pad, 1, header.entries_offset - header.words_offset - (ic + dc) * sizeof(unsigned short), des);
+
+	write_obb_symbols(des, entries, entries_num, 0);
+	write_obb_symbols(des, externs, externs_num, strings_size);
+	write_obb_names(des, entries, entries_num);
+	write_obb_names(des, externs, externs_num);
+
+	fclose(des);
+
+	return 1;
+
+}
+
+
+/*
+ *	Writes the symbols of a table (or only computes the size of their names).
+ *
+ *	param des - The .obb file (NULL to compute the size only)
+ *	param symbols - The symbols
+ *	param count - Number of symbols
+ *	param name - The offset of the first name in the string table
+ *	returns the offset of the string table after the names of the symbols.
+ */
+unsigned int write_obb_symbols(FILE *des, map_label *symbols, int count, unsigned int name){
+
+	obb_symbol symbol;
+	int i;
+
+	for (i = 0; i < count; i++){
+
+		if (!IS_SAME_NAME(symbols, i)){
+			symbol.name = name;
+			name += strlen(symbols[i].name) + 1;
+		}
+
+		symbol.address = symbols[i].address;
+
+		if (des != NULL)
+			fwrite(&symbol, sizeof(obb_symbol), 1, des);
+	}
+
+	return name;
+
+}
+
+
+/*
+ *	Writes the names of the symbols of a table to the string table.
+ *
+ *	param des - The .obb file
+ *	param symbols - The symbols
+ *	param count - Number of symbols
+ */
+void write_obb_names(FILE *des, map_label *symbols, int count){
+
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (!IS_SAME_NAME(symbols, i))
+			fwrite(symbols[i].name, 1, strlen(symbols[i].name) + 1, des);
+
+}
+
+
+/*
+ *	Loads a .obb file by mapping it into memory.
+ *
+ *	param file_name - The name of the program without extension
+ *	returns pointer to the loaded file (close it by close_obb_file), NULL if the file is not valid.
+ */
+obb_file *open_obb_file(char *file_name){
+
+	obb_file *obb;
+	obb_header *header;
+	struct stat st;
+	char obb_name[MAX_BUFFER];
+	void *base;
+	int fd, is_valid;
+
+	sprintf(obb_name, "%s.obb", file_name);
+
+	if ((fd = open(obb_name, O_RDONLY)) < 0){
+		errprintf(obb_name, NO_LINE_ERROR, "cannot open file");
+		return NULL;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < (long)sizeof(obb_header) ||
+		(base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+		errprintf(obb_name, NO_LINE_ERROR, "not a .obb file");
+		close(fd);
+		return NULL;
+	}
+
+	close(fd); /* the mapping stays valid */
+
+	header = (obb_header *)base;
+	is_valid = memcmp(header -> magic, OBB_MAGIC, sizeof(OBB_MAGIC)) == 0 && header -> byte_order == OBB_BYTE_ORDER &&
+			   header -> version == OBB_VERSION &&
+			   is_obb_section_valid(st.st_size, header -> words_offset, (unsigned long)header -> ic + header -> dc, sizeof(unsigned short)) &&
+			   is_obb_section_valid(st.st_size, header -> entries_offset, header -> entries_num, sizeof(obb_symbol)) &&
+			   is_obb_section_valid(st.st_size, header -> externs_offset, header -> externs_num, sizeof(obb_symbol)) &&
+			   is_obb_section_valid(st.st_size, header -> strings_offset, header -> strings_size, 1) &&
+			   (header -> strings_size == 0 || ((char *)base)[header -> strings_offset + header -> strings_size - 1] == '\0') &&
+			   are_obb_names_valid((obb_symbol *)((char *)base + header -> entries_offset), header -> entries_num, header -> strings_size) &&
+			   are_obb_names_valid((obb_symbol *)((char *)base + header -> externs_offset), header -> externs_num, header -> strings_size);
+
+	if (!is_valid){
+		errprintf(obb_name, NO_LINE_ERROR, "not a .obb file of this version and byte order");
+		munmap(base, st.st_size);
+		return NULL;
+	}
+
+	if ((obb = (obb_file *)counted_malloc(sizeof(obb_file))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - obb file");
+		exit(1);
+	}
+
+	obb -> base = (char *)base;
+	obb -> size = st.st_size;
+	obb -> header = header;
+	obb -> words = (unsigned short *)(obb -> base + header -> words_offset);
+	obb -> entries = (obb_symbol *)(obb -> base + header -> entries_offset);
+	obb -> externs = (obb_symbol *)(obb -> base + header -> externs_offset);
+	obb -> strings = obb -> base + header -> strings_offset;
+
+	return obb;
+
+}
+
+
+/*
+ *	Checks that a section is in the file and aligned.
+ *
+ *	param size - The size of the file
+ *	param offset - The offset of the section
+ *	param count - Number of items in the section
+ *	param item - The size of an item
+ *	returns 1 if the section is valid, 0 otherwise.
+ */
+int is_obb_section_valid(long size, unsigned long offset, unsigned long count, unsigned long item){
+
+	return offset >= sizeof(obb_header) && offset % (item < OBB_ALIGN ? item : OBB_ALIGN) == 0 &&
+		   offset <= (unsigned long)size && count <= ((unsigned long)size - offset) / item;
+
+}
+
+
+/*
+ *	Checks that the names of the symbols start in the string table (it ends with a null).
+ *
+ *	param symbols - The symbols
+ *	param count - Number of symbols
+ *	param strings_size - The size of the string table
+ *	returns 1 if the names are valid, 0 otherwise.
+ */
+int are_obb_names_valid(obb_symbol *symbols, unsigned int count, unsigned int strings_size){
+
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (symbols[i].name >= strings_size)
+			return 0;
+
+	return 1;
+
+}
+
+
+/*
+ *	Unmaps a loaded .obb file.
+ *
+ *	param obb - Pointer to the loaded file
+ */
+void close_obb_file(obb_file *obb){
+
+	munmap(obb -> base, obb -> size);
+	free(obb);
+
+}
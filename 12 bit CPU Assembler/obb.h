@@ -0,0 +1,58 @@
+/*
+ *	File: obb.h
+ *
+ *	Defines the binary object format (.obb) and the function prototypes of its writer and loader.
+ *	A .obb file holds the same program as the .ob, .ent and .ext files:
+ *		header (obb_header)
+ *		code and data words - a word in 16 bits
+ *		entries - an obb_symbol for every entry label (as in the .ent file)
+ *		externs - an obb_symbol for every code word that refers to an external label (as in the .ext file)
+ *		string table - the null terminated names of the symbols
+ *	The numbers are in the byte order of the writer (the loader checks byte_order), and the sections are
+ *	aligned to 4 bytes, so a mapped file is used in place without parsing.
+ *	The symbols are passed to the writer as map_label arrays, so mapfile.h must be included before.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define OBB_MAGIC "OBB" /* the first bytes of a .obb file (with a null) */
+#define OBB_VERSION 1
+#define OBB_BYTE_ORDER 0x01020304 /* reads differently on a machine of another byte order */
+#define OBB_ALIGN 4 /* alignment of the sections */
+
+typedef struct {
+	char magic[4];
+	unsigned int byte_order;
+	unsigned int version;
+	unsigned int load_address; /* the address of the first code word */
+	unsigned int ic; /* number of code words */
+	unsigned int dc; /* number of data words (they follow the code words) */
+	unsigned int words_offset; /* the offsets are in bytes from the start of the file */
+	unsigned int entries_offset;
+	unsigned int entries_num;
+	unsigned int externs_offset;
+	unsigned int externs_num;
+	unsigned int strings_offset;
+	unsigned int strings_size;
+} obb_header;
+
+typedef struct {
+	unsigned int name; /* offset of the name in the string table */
+	unsigned int address;
+} obb_symbol;
+
+typedef struct { /* a loaded .obb file */
+	char *base; /* the mapped file */
+	long size;
+	obb_header *header;
+	unsigned short *words; /* the code words and then the data words */
+	obb_symbol *entries;
+	obb_symbol *externs;
+	char *strings;
+} obb_file;
+
+/* functions prototype */
+int write_obb_file(char *, unsigned short *, int, int, map_label *, int, map_label *, int);
+obb_file *open_obb_file(char *);
+void close_obb_file(obb_file *);
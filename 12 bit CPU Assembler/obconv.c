@@ -0,0 +1,213 @@
+/*
+ *	File: obconv.c
+ *
+ *	This file contains the object converter program. Every entered program is converted from its .ob,
+ *	.ent and .ext files into a .obb file, or with --to-ob from its .obb file back into the .ob, .ent and
+ *	.ext files (a converted file is the same as the file that the assembler writes).
+ *	The number of words is not limited by the memory of the CPU, so any .ob file can be converted.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+
+#include "obconv.h"
+
+/* functions prototype */
+void num_to_base64(unsigned int, char *);
+int decode_base64_word(char *);
+void read_symbols_file(char *, char *, map_label **, int *, int *);
+
+/* exclusive functions prototype */
+int ob_to_obb(char *);
+int obb_to_ob(char *);
+int write_symbols(char *, char *, obb_file *, obb_symbol *, unsigned int);
+
+
+
+/*
+ *	main function of the program
+ *
+ *	param argc - Number of command-line arguments.
+ *	param argv - Array of command-line arguments.
+ *	returns 0 if all the programs were converted, 1 otherwise.
+ */
+int main(int argc, char *argv[]){
+
+	int i, is_to_ob = 0, res = 0;
+
+	/* if no file was entered in command line */
+	if (argc < 2){
+
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "no file was entered (expected format: %s [--to-ob | --to-obb] file file ...)", argv[0]);
+		return 1;
+	}
+
+	/* loop that runs over all the entered files */
+	for (i = 1; i < argc; i++){
+
+		/* direction options - apply to the files that come after them */
+		if (strcmp(CURR_FILE_NAME, "--to-ob") == 0 || strcmp(CURR_FILE_NAME, "--to-obb") == 0){
+			is_to_ob = strcmp(CURR_FILE_NAME, "--to-ob") == 0;
+			continue;
+		}
+
+		res = !(is_to_ob ? obb_to_ob(CURR_FILE_NAME) : ob_to_obb(CURR_FILE_NAME)) || res;
+	}
+
+	return res;
+
+}
+
+
+
+/*
+ *	Converts the .ob, .ent and .ext files of a program into a .obb file.
+ *
+ *	param file_name - The name of the program without extension.
+ *	returns 1 if the program was converted, 0 otherwise.
+ */
+int ob_to_obb(char *file_name){
+
+	FILE *src;
+	char ob_name[MAX_BUFFER], line[MAX_LINE];
+	unsigned short *words;
+	obconv_symbols entries = {NULL, 0, 0}, externs = {NULL, 0, 0};
+	long ic, dc, size, i;
+	int word, res;
+
+	sprintf(ob_name, "%s.ob", file_name);
+
+	if (!(src = fopen(ob_name, "r"))){
+		errprintf(ob_name, NO_LINE_ERROR, "cannot open file");
+		return 0;
+	}
+
+	fseek(src, 0, SEEK_END);
+	size = ftell(src);
+	rewind(src);
+
+	/* every word takes a line of at least 3 characters, so the header can't make a too large allocation */
+	if (!fgets(line, MAX_LINE, src) || sscanf(line, "%ld %ld", &ic, &dc) != 2 || ic < 0 || dc < 0 ||
+		ic + dc > size / OB_LINE_LEN){
+
+		errprintf(ob_name, 1, "invalid header - expected the code and data sizes");
+		fclose(src);
+		return 0;
+	}
+
+	if ((words = (unsigned short *)counted_malloc((ic + dc + 1) * sizeof(unsigned short))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - obb words");
+		exit(1);
+	}
+
+	for (i = 0; i < ic + dc; i++){
+
+		if (!fgets(line, MAX_LINE, src) || (word = decode_base64_word(line)) < 0){
+
+			errprintf(ob_name, i + 2, "invalid base64 word");
+			fclose(src);
+			free(words);
+			return 0;
+		}
+
+		words[i] = word;
+	}
+
+	fclose(src);
+
+	read_symbols_file(file_name, ".ent", &(entries.symbols), &(entries.count), &(entries.size));
+	read_symbols_file(file_name, ".ext", &(externs.symbols), &(externs.count), &(externs.size));
+
+	res = write_obb_file(file_name, words, ic, dc, entries.symbols, entries.count, externs.symbols, externs.count);
+
+	free(words);
+	free(entries.symbols);
+	free(externs.symbols);
+
+	return res;
+
+}
+
+
+
+/*
+ *	Converts the .obb file of a program into its .ob, .ent and .ext files (the .ent and .ext files are
+ *	written only if the program has entry labels and external references, as by the assembler).
+ *
+ *	param file_name - The name of the program without extension.
+ *	returns 1 if the program was converted, 0 otherwise.
+ */
+int obb_to_ob(char *file_name){
+
+	FILE *des;
+	char ob_name[MAX_BUFFER], curr_base_line[OB_LINE_LEN];
+	obb_file *obb;
+	unsigned int i;
+	int res;
+
+	if ((obb = open_obb_file(file_name)) == NULL)
+		return 0;
+
+	sprintf(ob_name, "%s.ob", file_name);
+
+	if (!(des = fopen(ob_name, "w"))){
+		errprintf(ob_name, NO_LINE_ERROR, "cannot write file");
+		close_obb_file(obb);
+		return 0;
+	}
+
+	curr_base_line[OB_LINE_LEN - 1] = '\0';
+	fprintf(des, "%u %u\n", obb -> header -> ic, obb -> header -> dc);
+
+	for (i = 0; i < obb -> header -> ic + obb -> header -> dc; i++){
+		num_to_base64(obb -> words[i], curr_base_line);
+		fprintf(des, "%s\n", curr_base_line);
+	}
+
+	fclose(des);
+
+	res = write_symbols(file_name, ".ent", obb, obb -> entries, obb -> header -> entries_num) &&
+		  write_symbols(file_name, ".ext", obb, obb -> externs, obb -> header -> externs_num);
+
+	close_obb_file(obb);
+
+	return res;
+
+}
+
+
+
+/*
+ *	Writes the symbols of a loaded .obb file to a .ent or a .ext file (if there are symbols).
+ *
+ *	param file_name - The name of the program without extension.
+ *	param ext - The extension of the file.
+ *	param obb - Pointer to the loaded file.
+ *	param symbols - The symbols.
+ *	param count - Number of symbols.
+ *	returns 1 if the file was written (or not needed), 0 otherwise.
+ */
+int write_symbols(char *file_name, char *ext, obb_file *obb, obb_symbol *symbols, unsigned int count){
+
+	FILE *des;
+	char name[MAX_BUFFER];
+	unsigned int i;
+
+	if (count == 0)
+		return 1;
+
+	sprintf(name, "%s%s", file_name, ext);
+	if (!(des = fopen(name, "w"))){
+		errprintf(name, NO_LINE_ERROR, "cannot write file");
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+		fprintf(des, "%s\t%u\n", obb -> strings + symbols[i].name, symbols[i].address);
+
+	fclose(des);
+
+	return 1;
+
+}
@@ -0,0 +1,22 @@
+/*
+ *	File: obconv.h
+ *
+ *	This header file serves as an interface for the object converter program, which converts the base64
+ *	object files of a program (.ob and its .ent and .ext files) into a binary object file (.obb) and back.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+#include "mapfile.h"
+#include "obb.h"
+
+#define CURR_FILE_NAME argv[i] /* current file name that was entered in command line */
+#define OB_LINE_LEN 3 /* length of a base64 word (2 characters + null terminator) */
+
+typedef struct { /* the symbols of a .ent or a .ext file */
+	map_label *symbols;
+	int count;
+	int size;
+} obconv_symbols;
@@ -0,0 +1,23 @@
+; opt_blocks.as - moved blocks (an optimizer check fixture)
+; -O moves BLOCK to the place of the jump to it, so STEP inside it gets
+; a new address that the branches from inside and from outside must use
+MAIN:	mov 3, @r1
+	clr @r2
+	clr @r5
+	jmp BLOCK
+TAIL:	prn @r2
+	inc @r5
+	mov 2, @r1
+	cmp 2, @r5
+	bne STEP
+	jsr SUB
+	prn @r2
+	stop
+BLOCK:	add 10, @r2
+STEP:	inc @r2
+	dec @r1
+	cmp 0, @r1
+	bne STEP
+	jmp TAIL
+SUB:	add 100, @r2
+	rts
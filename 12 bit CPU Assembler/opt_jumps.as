@@ -0,0 +1,40 @@
+; opt_jumps.as - jump chains and inc/dec runs (an optimizer check fixture)
+; -O shortens the chains, removes the jumps to the next instruction,
+; replaces the jumps to a rts or a stop and collapses the runs
+MAIN:	mov 5, @r1
+	clr @r2
+	jmp HOP1
+HOP1:	jmp HOP2
+HOP2:	jmp LOOP
+LOOP:	inc @r2
+	inc @r2
+	inc @r2
+	dec @r1
+	cmp 0, @r1
+	bne AGAIN
+	jmp DONE
+AGAIN:	jmp LOOP
+DONE:	prn @r2
+	inc COUNT
+	dec COUNT
+	inc COUNT
+	inc COUNT
+	prn COUNT
+	dec @r3
+	dec @r3
+	dec @r3
+	dec @r3
+	inc @r3
+	prn @r3
+	inc @r4
+	dec @r4
+	prn @r4
+	jsr SUB
+	prn @r5
+	jmp END
+SUB:	inc @r5
+	inc @r5
+	jmp BACK
+BACK:	rts
+END:	stop
+COUNT:	.data 7
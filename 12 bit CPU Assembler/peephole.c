@@ -0,0 +1,490 @@
+/*
+ *	File: peephole.c
+ *
+ *  This file contains the peephole optimizer of the assembler (-O option). It runs after a valid first run
+ *  and rewrites the instructions of the .am file to take fewer memory words and cycles:
+ *		- a jmp or a bne to the next instruction is removed
+ *		- a jmp or a bne to a jmp goes directly to the final target
+ *		- a jmp to a rts or to a stop is replaced by the rts or the stop
+ *		- a run of inc/dec of the same operand is replaced by one inc, dec, add or sub (or removed)
+ *  and it lays out the code blocks - a block that is entered only by its label (the instruction before it
+ *  does not fall through) and ends with a jmp, a rts or a stop is moved to the place of a jmp to it, so
+ *  the jmp is removed. The rewrites and the moves run to a fixed point, and then the first run assigns
+ *  the addresses of the new layout (the instructions sizes do not depend on the addresses, so one
+ *  assignment is final).
+ *  The removed lines stay in the .am file as comments, and the .map origins of the moved lines are moved
+ *  with them. A line with a label is never removed and no instruction is rewritten after a label, so
+ *  every label keeps its meaning (the optimizer assumes that the program does not read its own code words).
+ *
+ *  author: Gal Levi
+ *  version: 5.8.23
+ */
+
+
+#include "labels_BST.h"
+#include "ast.h"
+
+/* macro definitions */
+#define FIRST_PEEP_SIZE 256 /* initial number of cells of the lines array */
+#define MAX_IMM 511 /* the largest value of a 10 bit immediate operand */
+#define L_ONE_OP 2 /* number of memory words of inc/dec (the operand takes a word) */
+#define L_ADD_IMM 3 /* number of memory words of add/sub of an immediate value */
+#define NO_LINE -1
+
+typedef struct {
+	char *text; /* the line as in the .am file */
+	char label[MAX_LABEL_SIZE]; /* the label definition of the line ("" for none) */
+	int ins; /* the instruction (enum instructions), 0 if the line is not an instruction */
+	int op_type; /* the addressing method of the operand of a one operand instruction (0 for others) */
+	char op[MAX_LABEL_SIZE]; /* the label or the register of the operand */
+	int imm; /* the immediate source operand of a rewritten add/sub */
+	int is_dir; /* 1 if the line is a directive */
+	int next; /* the lines are a linked list in the order of the file (NO_LINE at the ends) */
+	int prev;
+	enum {peep_kept, peep_changed, peep_removed} state;
+} peep_line;
+
+typedef struct {
+	peep_line *lines;
+	int count;
+	int size;
+	symbol_table_node *labels; /* the value of a label is the index of its line */
+} peep_program; /* the first line of the file is always lines[0] (a moved block has an instruction before it) */
+
+/* functions prototype */
+int peephole_optimize(char *, map_origin_vector *);
+
+/* exclusive functions prototype */
+int read_peep_lines(FILE *, peep_program *);
+void write_peep_lines(FILE *, peep_program *, map_origin_vector *);
+int next_code_line(peep_program *, int);
+int prev_code_line(peep_program *, int);
+int find_label_line(peep_program *, char *);
+int optimize_jump(peep_program *, int);
+int optimize_inc_dec(peep_program *, int);
+int move_jump_target(peep_program *, int);
+int is_unconditional(peep_line *);
+
+
+
+/*
+ *  Optimizes the .am file of a program (the program must be valid).
+ *
+ *  param file_name - The name of the program without extension.
+ *  param origins - The .as origins of the .am lines (NULL if they are not kept).
+ *  returns the number of rewrites and moves (0 if the file was not changed).
+ */
+int peephole_optimize(char *file_name, map_origin_vector *origins){
+
+	FILE *file;
+	char am_name[MAX_BUFFER];
+	peep_program program = {NULL, 0, 0, NULL};
+	int i, changed, rewrites = 0;
+
+	sprintf(am_name, "%s.am", file_name);
+
+	if (!(file = fopen(am_name, "r"))){
+		errprintf(am_name, NO_LINE_ERROR, "cannot open file - optimizer");
+		return 0;
+	}
+
+	read_peep_lines(file, &program);
+	fclose(file);
+
+	/* a rewrite may enable another one (a jump to a jump that became a rts, or a moved block that ends
+	   with a jump to the next instruction), so it runs to a fixed point */
+	do {
+		changed = 0;
+		for (i = 0; i < program.count; i++)
+			if (program.lines[i].ins != 0 && program.lines[i].state != peep_removed)
+				changed += optimize_jump(&program, i) + optimize_inc_dec(&program, i);
+
+		for (i = 0; i < program.count; i++)
+			if (program.lines[i].ins == ast_ins_jmp && program.lines[i].state != peep_removed)
+				changed += move_jump_target(&program, i);
+
+		rewrites += changed;
+
+	} while (changed);
+
+	if (rewrites > 0){
+
+		if (!(file = fopen(am_name, "w"))){
+			errprintf(am_name, NO_LINE_ERROR, "cannot write file - optimizer");
+			rewrites = 0;
+		}
+		else {
+			write_peep_lines(file, &program, origins);
+			fclose(file);
+		}
+	}
+
+	for (i = 0; i < program.count; i++)
+		free(program.lines[i].text);
+	free(program.lines);
+	free_symbol_table(&(program.labels));
+
+	return rewrites;
+
+}
+
+
+
+/*
+ *  Reads the lines of the .am file, and keeps the instruction and the operand of every one operand or
+ *  no operand instruction and the line of every label.
+ *
+ *  param src - The .am file.
+ *  param program - Pointer to the program.
+ *  returns the number of lines.
+ */
+int read_peep_lines(FILE *src, peep_program *program){
+
+	char line[MAX_BUFFER];
+	peep_line *curr;
+	ast line_ast;
+
+	while (fgets(line, MAX_BUFFER, src) != NULL){
+
+		if (program -> count == program -> size){ /* if the array is full */
+
+			program -> size = program -> size ? program -> size * 2 : FIRST_PEEP_SIZE;
+			program -> lines = (peep_line *)counted_realloc(program -> lines, sizeof(peep_line) * program -> size);
+
+			if (program -> lines == NULL){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - optimizer");
+				exit(1);
+			}
+		}
+
+		curr = &(program -> lines[program -> count]);
+		memset(curr, 0, sizeof(peep_line));
+		curr -> prev = program -> count - 1; /* NO_LINE for the first line */
+		curr -> next = NO_LINE;
+		if (program -> count > 0)
+			program -> lines[program -> count - 1].next = program -> count;
+
+		if (!(curr -> text = (char *)counted_malloc(strlen(line) + 1))){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - optimizer");
+			exit(1);
+		}
+		strcpy(curr -> text, line);
+
+		line_ast = get_ast(line);
+
+		if (line_ast.label_def_flag){
+			strcpy(curr -> label, line_ast.label);
+			program -> labels = insert_label(program -> labels, curr -> label, program -> count, enum_rel, enum_ins);
+		}
+
+		curr -> is_dir = line_ast.ast_union_option == ast_union_dir;
+
+		if (line_ast.ast_union_option == ast_union_ins){
+
+			curr -> ins = line_ast.ast_union_ins_dir.ast_ins.ins;
+
+			if (curr -> ins >= ast_ins_not && curr -> ins <= ast_ins_jsr){
+
+				curr -> op_type = line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote;
+
+				if (curr -> op_type == ast_op_type_label)
+					strcpy(curr -> op, line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.label);
+				else if (curr -> op_type == ast_op_type_reg)
+					sprintf(curr -> op, "@r%d", line_ast.ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu.reg);
+			}
+		}
+
+		program -> count++;
+	}
+
+	return program -> count;
+
+}
+
+
+
+/*
+ *  Writes the lines of the program in their new order - the changed lines are written from their
+ *  instruction and operands, and the removed lines are written as comments.
+ *
+ *  param des - The .am file.
+ *  param program - Pointer to the program.
+ *  param origins - The .as origins of the .am lines, reordered as the lines (NULL if they are not kept).
+ */
+void write_peep_lines(FILE *des, peep_program *program, map_origin_vector *origins){
+
+	const char *INS_NAMES[] = {"mov", "cmp", "add", "sub", "lea", "not", "clr", "inc", "dec",
+								"jmp", "bne", "red", "prn", "jsr", "rts", "stop"};
+	peep_line *curr;
+	map_origin *old_origins = NULL;
+	int i, line;
+
+	/* the origins are copied, since a line takes the origin of the line that was in another place */
+	if (origins != NULL && origins -> count == program -> count){
+
+		if (!(old_origins = (map_origin *)counted_malloc(sizeof(map_origin) * (origins -> count + 1)))){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - optimizer");
+			exit(1);
+		}
+		memcpy(old_origins, origins -> origins, sizeof(map_origin) * origins -> count);
+	}
+
+	for (i = 0, line = 0; i != NO_LINE; i = program -> lines[i].next, line++){
+
+		curr = &(program -> lines[i]);
+
+		if (old_origins != NULL)
+			origins -> origins[line] = old_origins[i];
+
+		if (curr -> state == peep_kept)
+			fputs(curr -> text, des);
+
+		else if (curr -> state == peep_removed)
+			fprintf(des, ";%s", curr -> text); /* the text keeps its new line */
+
+		else {
+			if (curr -> label[0] != '\0')
+				fprintf(des, "%s:", curr -> label);
+
+			if (curr -> ins == ast_ins_add || curr -> ins == ast_ins_sub)
+				fprintf(des, "\t%s %d, %s\n", INS_NAMES[curr -> ins - 1], curr -> imm, curr -> op);
+			else if (curr -> op_type != 0)
+				fprintf(des, "\t%s %s\n", INS_NAMES[curr -> ins - 1], curr -> op);
+			else
+				fprintf(des, "\t%s\n", INS_NAMES[curr -> ins - 1]);
+		}
+	}
+
+	free(old_origins);
+
+}
+
+
+
+/*
+ *  Finds the next instruction line (the instruction of the next code address).
+ *
+ *  param program - Pointer to the program.
+ *  param i - The index of the current line.
+ *  returns the index of the next instruction line, NO_LINE if there is none.
+ */
+int next_code_line(peep_program *program, int i){
+
+	for (i = program -> lines[i].next; i != NO_LINE; i = program -> lines[i].next)
+		if (program -> lines[i].ins != 0 && program -> lines[i].state != peep_removed)
+			return i;
+
+	return NO_LINE;
+
+}
+
+
+
+/*
+ *  Finds the previous instruction line.
+ *
+ *  param program - Pointer to the program.
+ *  param i - The index of the current line.
+ *  returns the index of the previous instruction line, NO_LINE if there is none.
+ */
+int prev_code_line(peep_program *program, int i){
+
+	for (i = program -> lines[i].prev; i != NO_LINE; i = program -> lines[i].prev)
+		if (program -> lines[i].ins != 0 && program -> lines[i].state != peep_removed)
+			return i;
+
+	return NO_LINE;
+
+}
+
+
+
+/*
+ *  Finds the instruction line of a label.
+ *
+ *  param program - Pointer to the program.
+ *  param label - The label.
+ *  returns the index of the line, NO_LINE if the label is not defined on an instruction.
+ */
+int find_label_line(peep_program *program, char *label){
+
+	symbol_table_node *node = search_label(program -> labels, label);
+
+	if (node == NULL || program -> lines[node -> value].ins == 0)
+		return NO_LINE;
+
+	return node -> value;
+
+}
+
+
+
+/*
+ *  Optimizes a jmp or a bne to a label.
+ *
+ *  param program - Pointer to the program.
+ *  param i - The index of the line.
+ *  returns 1 if the line was rewritten, 0 otherwise.
+ */
+int optimize_jump(peep_program *program, int i){
+
+	peep_line *curr = &(program -> lines[i]);
+	int target, steps;
+	char *final;
+
+	if ((curr -> ins != ast_ins_jmp && curr -> ins != ast_ins_bne) || curr -> op_type != ast_op_type_label ||
+		(target = find_label_line(program, curr -> op)) == NO_LINE)
+		return 0;
+
+	/* follows a chain of jumps to its final target (a loop of jumps is kept) */
+	for (final = curr -> op, steps = 0; program -> lines[target].ins == ast_ins_jmp &&
+		 program -> lines[target].op_type == ast_op_type_label && steps < program -> count; steps++){
+
+		final = program -> lines[target].op;
+		if ((target = find_label_line(program, final)) == NO_LINE)
+			return 0;
+	}
+
+	if (steps == program -> count)
+		return 0;
+
+	if (final != curr -> op){ /* the chain was followed */
+		strcpy(curr -> op, final);
+		curr -> state = peep_changed;
+		return 1;
+	}
+
+	/* a jump to the next instruction (a line with a label is kept) */
+	if (target == next_code_line(program, i) && curr -> label[0] == '\0'){
+		curr -> state = peep_removed;
+		return 1;
+	}
+
+	/* a jmp to a rts or a stop takes one word instead of two */
+	if (curr -> ins == ast_ins_jmp && (program -> lines[target].ins == ast_ins_rts || program -> lines[target].ins == ast_ins_stop)){
+		curr -> ins = program -> lines[target].ins;
+		curr -> op_type = 0;
+		curr -> state = peep_changed;
+		return 1;
+	}
+
+	return 0;
+
+}
+
+
+
+/*
+ *  Optimizes a run of inc/dec instructions of the same operand (the lines after the first one have no
+ *  labels) - the run of 2 words instructions is replaced by one instruction of the sum.
+ *
+ *  param program - Pointer to the program.
+ *  param i - The index of the first line.
+ *  returns 1 if the run was rewritten, 0 otherwise.
+ */
+int optimize_inc_dec(peep_program *program, int i){
+
+	peep_line *curr = &(program -> lines[i]), *next;
+	int j, k, len = 1, sum, words;
+
+	if (curr -> ins != ast_ins_inc && curr -> ins != ast_ins_dec)
+		return 0;
+
+	sum = curr -> ins == ast_ins_inc ? 1 : -1;
+
+	for (j = next_code_line(program, i); j != NO_LINE && len < MAX_IMM; j = next_code_line(program, j)){
+
+		next = &(program -> lines[j]);
+		if (next -> label[0] != '\0' || (next -> ins != ast_ins_inc && next -> ins != ast_ins_dec) ||
+			next -> op_type != curr -> op_type || strcmp(next -> op, curr -> op) != 0)
+			break;
+
+		sum += next -> ins == ast_ins_inc ? 1 : -1;
+		len++;
+	}
+
+	words = sum == 0 ? 0 : sum == 1 || sum == -1 ? L_ONE_OP : L_ADD_IMM;
+
+	/* the first line keeps its label, so it is removed only if it has no label */
+	if (len < 2 || words >= len * L_ONE_OP || (sum == 0 && curr -> label[0] != '\0'))
+		return 0;
+
+	for (j = next_code_line(program, i), k = 1; k < len; j = next_code_line(program, j), k++)
+		program -> lines[j].state = peep_removed;
+
+	if (sum == 0)
+		curr -> state = peep_removed;
+	else {
+		curr -> ins = sum == 1 ? ast_ins_inc : sum == -1 ? ast_ins_dec : sum > 0 ? ast_ins_add : ast_ins_sub;
+		curr -> imm = sum > 0 ? sum : -sum;
+		curr -> state = peep_changed;
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *  Moves the block of the target of a jmp to the place of the jmp and removes the jmp. The block starts
+ *  at the target, it is entered only by jumps (the instruction before it is a jmp, a rts or a stop) and
+ *  it ends with a jmp, a rts or a stop, so neither its old place nor its new place is reached by falling
+ *  through. A block with a directive is not moved (the data keeps its order).
+ *
+ *  param program - Pointer to the program.
+ *  param i - The index of the jmp line.
+ *  returns 1 if the block was moved, 0 otherwise.
+ */
+int move_jump_target(peep_program *program, int i){
+
+	peep_line *lines = program -> lines;
+	int first, last, before, after;
+
+	if (lines[i].op_type != ast_op_type_label || lines[i].label[0] != '\0' ||
+		(first = find_label_line(program, lines[i].op)) == NO_LINE || lines[first].state == peep_removed ||
+		(before = prev_code_line(program, first)) == NO_LINE || !is_unconditional(&lines[before]))
+		return 0;
+
+	/* finds the end of the block (the jmp must not be in the block) */
+	for (last = first; last != NO_LINE && last != i && !lines[last].is_dir &&
+		 (lines[last].ins == 0 || lines[last].state == peep_removed || !is_unconditional(&lines[last])); last = lines[last].next)
+		;
+
+	if (last == NO_LINE || last == i || lines[last].is_dir)
+		return 0;
+
+	/* unlinks the block */
+	before = lines[first].prev;
+	after = lines[last].next;
+	lines[before].next = after;
+	if (after != NO_LINE)
+		lines[after].prev = before;
+
+	/* links it after the jmp */
+	after = lines[i].next;
+	lines[i].next = first;
+	lines[first].prev = i;
+	lines[last].next = after;
+	if (after != NO_LINE)
+		lines[after].prev = last;
+
+	lines[i].state = peep_removed;
+
+	return 1;
+
+}
+
+
+
+/*
+ *  Checks if an instruction never falls through to the next instruction.
+ *
+ *  param line - The instruction line.
+ *  returns 1 for a jmp, a rts or a stop, 0 otherwise.
+ */
+int is_unconditional(peep_line *line){
+
+	return line -> ins == ast_ins_jmp || line -> ins == ast_ins_rts || line -> ins == ast_ins_stop;
+
+}
@@ -3,6 +3,7 @@
  *
  * This file handles the pre-assembler phase, macro processing, and preparation for the first run.
  * It also includes utility functions for handling lines, macros, and checking line lengths.
+ * An .include statement adds the macros of a precompiled dictionary (see macro_dict.h).
  * This program processes source files, identifies macros,
  * checks syntax validity, and generates intermediate files for further processing.
  *
@@ -12,6 +13,10 @@
 
 
 #include "macro_list.h"
+#include "macro_dict.h"
+#include "mapfile.h"
+#include "stats.h"
+#include "diag.h"
 
 /* macro definitions */
 #define BEFORE_ENDMCRO_AND_MCRO line_ptr - curr_line /* the text before endmcro/mcro statement */
@@ -25,6 +30,9 @@
 /* the length of the text before the name of macro which found in current line */
 #define BEFORE_MACRO_TEXT_LEN strstr(curr_line, curr_macro -> macro) - curr_line
 
+/* functions prototype */
+int pre_assemble_stream(FILE *, char *, macro_node **, macro_node **, char **, map_origin_vector *);
+
 
 
 
@@ -34,23 +42,15 @@
  * param file_name - The name of the source file without extension.
  * param head_add - Pointer to the head of the macro list.
  * param tail_add - Pointer to the tail of the macro list.
+ * param origins - Pointer to log the .as origin of every .am line (NULL if not needed).
  * Returns 1 if the pre-assembler phase completes successfully, otherwise returns 0.
  */
-int pre_assembler(char file_name[], macro_node **head_add, macro_node **tail_add){
+int pre_assembler(char file_name[], macro_node **head_add, macro_node **tail_add, map_origin_vector *origins){
 	
-	macro_node *curr_macro;
 	FILE *src, *des;
 	/* MAX_BUFFER = 1024 */
-	char src_name[MAX_BUFFER], des_name[MAX_BUFFER], curr_line[MAX_BUFFER] , temp[MAX_BUFFER], *line_ptr;
-	int mcro_flag = 0, line_num = 0, draft_size = 0, is_valid = 1, is_macro_valid;
-	char *draft = (char *)calloc(draft_size, sizeof(char)); /* stores the result */
-	
-	if (!draft){ /* if allocation was failed */
-	
-		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - pre assembler");
-		exit(1);
-	
-	}
+	char src_name[MAX_BUFFER], des_name[MAX_BUFFER], *draft;
+	int is_valid;
 	
 	sprintf(src_name, "%s.as", file_name); /* src_name = <file_name>.as */
 	sprintf(des_name, "%s.am", file_name);
@@ -58,18 +58,89 @@ int pre_assembler(char file_name[], macro_node **head_add, macro_node **tail_add
 	if (!(src = fopen(src_name, "r"))){ /* if the .as file failed to open */
 	
 		errprintf(src_name, NO_LINE_ERROR, "cannot open file - pre assembler");
-		free(draft);
 		return 0;
 		
 	}
 	
+	is_valid = pre_assemble_stream(src, src_name, head_add, tail_add, &draft, origins);
+	
+	if (is_valid){ /* if pre assembler did not failed */
+	
+		if (!(des = fopen(des_name, "w"))){ /* creates .am file */
 	
-	/* inserts lines from .as file to curr_line until EOF */
-	while (fgets(curr_line, MAX_BUFFER, src) != NULL){ 
+			errprintf(des_name, NO_LINE_ERROR, "cannot open file");
+			return 0;
+		
+		}
+		
+		else {  /* writes the draft in the .am file */
+			fprintf(des, "%s", draft);
+			fclose(des);
+		}
+	}
+	
+	free(draft);
+	
+	
+	fclose(src);
+	
+	return is_valid;
+	
+}
+
+
+
+
+/*
+ * Expands the macros of a source stream (the core of the pre-assembler phase).
+ * It is used for .as files and for in memory sources of an assembler session.
+ *
+ * param src - The source stream.
+ * param src_name - The name of the source (for error messages).
+ * param head_add - Pointer to the head of the macro list.
+ * param tail_add - Pointer to the tail of the macro list.
+ * param draft_add - Pointer to store the expanded text (allocated, the caller frees it).
+ * param origins - Pointer to log the .as origin of every expanded line (NULL if not needed).
+ * Returns 1 if the macros were expanded successfully, otherwise returns 0 (the macro list is freed).
+ */
+int pre_assemble_stream(FILE *src, char *src_name, macro_node **head_add, macro_node **tail_add,
+						char **draft_add, map_origin_vector *origins){
+	
+	macro_node *curr_macro;
+	line_node *macro_line;
+	/* MAX_BUFFER = 1024 */
+	char curr_line[MAX_BUFFER] , temp[MAX_BUFFER], include_path[MAX_BUFFER], *line_ptr;
+	const char *text_ptr;
+	int mcro_flag = 0, line_num = 0, draft_size = 0, is_valid = 1, is_macro_valid, is_include;
+	char *draft = (char *)counted_calloc(draft_size + 1, sizeof(char)); /* stores the result */
+	
+	if (!draft){ /* if allocation was failed */
+	
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - pre assembler");
+		exit(1);
+	
+	}
+	
+	
+	/* inserts lines from the source to curr_line until EOF (or until the file has too many errors) */
+	while (!is_diag_limit_reached() && fgets(curr_line, MAX_BUFFER, src) != NULL){ 
 		
 		line_num++; /* test.as file line counter */
+		add_stat_counter(stat_source_bytes, strlen(curr_line));
+		
+		/* if it is an .include statement (it is not written to the .am file) */
+		if (mcro_flag == 0 && (is_include = get_include_path(curr_line, src_name, include_path)) != 0){
 		
-		if ((IS_ENDMCRO)){ /* if current line has endmcro statement */
+			if (is_include == -1 || !check_length(curr_line)){
+			
+				errprintf(src_name, line_num, "invalid .include statement - expected .include \"file\"");
+				is_valid = 0;
+			}
+			else if (!include_macros(include_path, src_name, line_num, head_add, tail_add))
+				is_valid = 0;
+		}
+		
+		else if ((IS_ENDMCRO)){ /* if current line has endmcro statement */
 		 	
 
 		    /* checks the corners of endmcro statement */
@@ -164,14 +235,14 @@ int pre_assembler(char file_name[], macro_node **head_add, macro_node **tail_add
 		
 		/* there is not endmcro in this line, hence, the line needs to be stored in the current macro */
 		else if (mcro_flag == 1 && is_valid)
-		    insert_line(tail_add, curr_line);
+		    insert_line(tail_add, curr_line, line_num);
 		    
 		    
 		/* outside of macro definition */
 		else if (mcro_flag == 0 && is_valid){
 			
 			/* ENLARGE_SIZE = draft_size += sizeof(char) * MAX_LINE(82) */
-			draft = (char *)realloc(draft, ENLARGE_SIZE); 
+			draft = (char *)counted_realloc(draft, ENLARGE_SIZE); 
 
 			if (!draft){
 			
@@ -205,45 +276,51 @@ int pre_assembler(char file_name[], macro_node **head_add, macro_node **tail_add
 		 	}
 				else { /* it is a valid macro line */
 				
+					/* the body of an included macro may be longer than a line */
+					if (curr_macro -> text != NULL){
+					
+						draft_size += strlen(curr_macro -> text);
+						if (!(draft = (char *)counted_realloc(draft, draft_size))){
+						
+							errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - pre assembler");
+							exit(1);
+						}
+					}
+					
 					macro_to_string(draft, curr_macro); /* inserts in darft the macro lines */
+					add_stat_counter(stat_macros_expanded, 1);
+					
+					/* the expanded lines come from the macro call and from the definition lines */
+					for (macro_line = curr_macro -> head_line; origins != NULL && macro_line != NULL; macro_line = macro_line -> next)
+						insert_map_origin(origins, line_num, macro_line -> line_num);
+					
+					/* the lines of an included macro are not in the .as file, so they come from the call */
+					for (text_ptr = curr_macro -> text; origins != NULL && text_ptr != NULL && *text_ptr != '\0'; text_ptr++)
+						if (*text_ptr == '\n')
+							insert_map_origin(origins, line_num, 0);
 					
 				}
 			}
-			else
+			else {
 				strcat(draft, curr_line); /* inserts in draft the current line */
+				if (origins != NULL)
+					insert_map_origin(origins, line_num, 0);
+			}
 			
 		}
 		
 	} /* end of while */
 	
-	if (is_valid){ /* if pre assembler did not failed */
-	
-		if (!(des = fopen(des_name, "w"))){ /* creates .am file */
+	add_stat_counter(stat_source_lines, line_num);
 	
-			errprintf(des_name, NO_LINE_ERROR, "cannot open file");
-			return 0;
-		
-		}
-		
-		else {  /* writes the draft in the .am file */
-			fprintf(des, "%s", draft);
-			fclose(des);
-		}
-	}
-	
-	else { /* found an error */
+	if (!is_valid){ /* found an error */
 		
 		if (*(head_add) != NULL)
 			free_macro_list(head_add); 
 	
 	}
 	
-	
-	
-	free(draft);
-	
-	
-	fclose(src);
+	*draft_add = draft;
 	
 	return is_valid;
 	
@@ -0,0 +1,463 @@
+/*
+ *	File: profile.c
+ *
+ *	This file implements the emulator profiler (--profile option).
+ *	The program is run by the interpreter while the executed instructions of every address are counted.
+ *	A shadow call stack follows jsr/rts - every jsr adds a call to the caller->callee edge, and the
+ *	instructions from a jsr to its rts are added to the inclusive count of the callee (once for recursive
+ *	calls). After the run the counts are mapped to the labels (a label owns the addresses up to the next
+ *	label), to the instruction lines of the .am file and to the lines of the .as file (an expanded line
+ *	is counted in the macro definition line and in the macro call line), and the report is written
+ *	to <file>.prof. The addresses are resolved by binary searches on the sorted arrays of the .map file.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "cpu.h"
+#include "mapfile.h"
+#include "profile.h"
+
+/* macro definitions */
+#define MAX_CALL_DEPTH (CPU_MEMORY_SIZE + 1) /* a jsr needs a stack word, so the depth is bounded */
+#define PERCENT(count, total) ((total) > 0 ? (count) * 100.0 / (total) : 0)
+
+/* exclusive functions prototype */
+int read_profile_map(program_profile *, char *);
+void *grow_profile_array(void *, int, int *, size_t);
+int find_label(program_profile *, int);
+void add_call(program_profile *, int, int);
+void run_profiled(cpu_state *, program_profile *, long);
+void pop_frame(program_profile *, int *, long *, int *, long);
+void write_profile_report(cpu_state *, program_profile *, char *);
+void write_source_lines(FILE *, cpu_state *, program_profile *, char *);
+char *read_source_line(FILE *, int *, int, char *);
+int compare_labels_self(const void *, const void *);
+int compare_edges(const void *, const void *);
+
+
+
+/*
+ *	Loads a .ob file, runs it while profiling and writes the profile report to a .prof file.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param file_name - The name of the .ob file without extension (its .map file is read too).
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ *	returns 1 if the program was run, 0 if the .ob or the .map file could not be read.
+ */
+int profile_program(cpu_state *cpu, char *file_name, long limit){
+
+	program_profile *profile = (program_profile *)counted_calloc(1, sizeof(program_profile));
+	int is_run = 0;
+
+	if (profile == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - profile");
+		exit(1);
+	}
+
+	if (load_ob_image(cpu, file_name) && read_profile_map(profile, file_name)){
+		predecode_cpu(cpu);
+		run_profiled(cpu, profile, limit);
+		write_profile_report(cpu, profile, file_name);
+		is_run = 1;
+	}
+
+	if (profile -> map != NULL)
+		free_map_file(profile -> map);
+	free(profile -> labels);
+	free(profile -> edges);
+	free(profile);
+
+	return is_run;
+
+}
+
+
+
+/*
+ *	Reads the .map file of a program and makes a profile label for every label of the map.
+ *
+ *	param profile - Pointer to the profile.
+ *	param file_name - The name of the program without extension.
+ *	returns 1 if the file was read, 0 otherwise.
+ */
+int read_profile_map(program_profile *profile, char *file_name){
+
+	int i;
+
+	if ((profile -> map = read_map_file(file_name)) == NULL)
+		return 0;
+
+	/* the last label owns the addresses before the first label */
+	profile -> labels_num = profile -> map -> labels_num + 1;
+	profile -> labels = (profile_label *)counted_calloc(profile -> labels_num, sizeof(profile_label));
+
+	if (profile -> labels == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - profile");
+		exit(1);
+	}
+
+	for (i = 0; i < profile -> map -> labels_num; i++){
+		strcpy(profile -> labels[i].name, profile -> map -> labels[i].name);
+		profile -> labels[i].address = profile -> map -> labels[i].address;
+	}
+	strcpy(profile -> labels[i].name, NO_LABEL_NAME);
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Makes room for one more cell in a profile array (the size is doubled when the array is full).
+ *
+ *	param array - The array (NULL if it was not allocated yet).
+ *	param count - Number of used cells.
+ *	param size - Pointer to the number of allocated cells.
+ *	param cell - Size of a cell.
+ *	returns the array.
+ */
+void *grow_profile_array(void *array, int count, int *size, size_t cell){
+
+	if (count < *size)
+		return array;
+
+	*size = *size ? *size * 2 : FIRST_PROFILE_SIZE;
+
+	if ((array = counted_realloc(array, *size * cell)) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - profile");
+		exit(1);
+	}
+
+	return array;
+
+}
+
+
+
+/*
+ *	Finds the label that owns an address (the last label whose address is not greater).
+ *
+ *	param profile - Pointer to the profile.
+ *	param address - The address.
+ *	returns the index of the label (the NO_LABEL_NAME label if the address is before the first label).
+ */
+int find_label(program_profile *profile, int address){
+
+	int res = find_map_label(profile -> map, address);
+
+	return res < 0 ? profile -> labels_num - 1 : res;
+
+}
+
+
+
+/*
+ *	Adds a call to the call graph.
+ *
+ *	param profile - Pointer to the profile.
+ *	param caller - The index of the caller label.
+ *	param callee - The index of the callee label.
+ */
+void add_call(program_profile *profile, int caller, int callee){
+
+	int i;
+
+	profile -> labels[callee].calls++;
+
+	for (i = 0; i < profile -> edges_num; i++){
+		if (profile -> edges[i].caller == caller && profile -> edges[i].callee == callee){
+			profile -> edges[i].calls++;
+			return;
+		}
+	}
+
+	profile -> edges = (profile_edge *)grow_profile_array(profile -> edges, profile -> edges_num,
+										&(profile -> edges_size), sizeof(profile_edge));
+	profile -> edges[profile -> edges_num].caller = caller;
+	profile -> edges[profile -> edges_num].callee = callee;
+	profile -> edges[profile -> edges_num++].calls = 1;
+
+}
+
+
+
+/*
+ *	Runs the cpu from its pc until it stops while counting the executed instructions and the calls.
+ *
+ *	param cpu - Pointer to the cpu.
+ *	param profile - Pointer to the profile.
+ *	param limit - The maximum number of instructions to execute (0 for no limit).
+ */
+void run_profiled(cpu_state *cpu, program_profile *profile, long limit){
+
+	decoded_ins *ins = &(cpu -> code[cpu -> pc]), *next;
+	int frames[MAX_CALL_DEPTH], depth = 0, callee;
+	long starts[MAX_CALL_DEPTH], cnt = 0;
+
+	cpu -> status = cpu_running;
+
+	/* the frame of the start address */
+	frames[depth] = find_label(profile, cpu -> pc);
+	starts[depth++] = 0;
+	profile -> labels[frames[0]].on_stack++;
+
+	while (ins != NULL && (limit <= 0 || cnt < limit)){
+
+		if ((next = ins -> handler(cpu, ins)) == NULL && cpu -> status == cpu_fault)
+			break; /* the faulting instruction was not executed */
+
+		profile -> counts[ins -> address]++;
+		cnt++;
+
+		if (next != NULL && ins -> opcode == ast_ins_jsr - 1){
+			callee = find_label(profile, next -> address);
+			add_call(profile, frames[depth - 1], callee);
+			if (depth < MAX_CALL_DEPTH){
+				frames[depth] = callee;
+				starts[depth++] = cnt;
+				profile -> labels[callee].on_stack++;
+			}
+		}
+		else if (next != NULL && ins -> opcode == ast_ins_rts - 1 && depth > 1)
+			pop_frame(profile, frames, starts, &depth, cnt);
+
+		ins = next;
+	}
+
+	if (ins != NULL && cpu -> status == cpu_running){ /* stopped by the limit */
+		cpu -> status = cpu_limit;
+		cpu -> pc = ins -> address;
+	}
+
+	while (depth > 0)
+		pop_frame(profile, frames, starts, &depth, cnt);
+
+	cpu -> executed += cnt;
+
+}
+
+
+
+/*
+ *	Pops a frame of the shadow call stack and adds its instructions to the inclusive count of its
+ *	label (if it is the outermost frame of the label).
+ *
+ *	param profile - Pointer to the profile.
+ *	param frames - The labels of the frames.
+ *	param starts - The instructions counter when every frame was pushed.
+ *	param depth - Pointer to the number of frames.
+ *	param cnt - The instructions counter.
+ */
+void pop_frame(program_profile *profile, int *frames, long *starts, int *depth, long cnt){
+
+	profile_label *label = &(profile -> labels[frames[--(*depth)]]);
+
+	if (--(label -> on_stack) == 0)
+		label -> inclusive += cnt - starts[*depth];
+
+}
+
+
+
+/*
+ *	Writes the profile report - a flat profile by label, the call graph and the source lines.
+ *
+ *	param cpu - Pointer to the cpu (after the run).
+ *	param profile - Pointer to the profile.
+ *	param file_name - The name of the program without extension.
+ */
+void write_profile_report(cpu_state *cpu, program_profile *profile, char *file_name){
+
+	FILE *des;
+	char prof_name[MAX_BUFFER];
+	profile_label **sorted;
+	long total = cpu -> executed;
+	int i;
+
+	for (i = 0; i < CPU_MEMORY_SIZE; i++)
+		if (profile -> counts[i] > 0)
+			profile -> labels[find_label(profile, i)].self += profile -> counts[i];
+
+	sprintf(prof_name, "%s.prof", file_name);
+
+	if (!(des = fopen(prof_name, "w"))){
+		errprintf(prof_name, NO_LINE_ERROR, "cannot write file");
+		return;
+	}
+
+	if ((sorted = (profile_label **)counted_malloc(profile -> labels_num * sizeof(profile_label *))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - profile");
+		exit(1);
+	}
+
+	/* flat profile */
+	for (i = 0; i < profile -> labels_num; i++)
+		sorted[i] = &(profile -> labels[i]);
+	qsort(sorted, profile -> labels_num, sizeof(profile_label *), compare_labels_self);
+
+	fprintf(des, "flat profile of %s (%ld instructions)\n\n", file_name, total);
+	fprintf(des, "%12s %7s %12s %10s  %s\n", "self", "%", "inclusive", "calls", "label");
+
+	for (i = 0; i < profile -> labels_num && sorted[i] -> self > 0; i++)
+		fprintf(des, "%12ld %6.2f%% %12ld %10ld  %s\n", sorted[i] -> self, PERCENT(sorted[i] -> self, total),
+				sorted[i] -> inclusive, sorted[i] -> calls, sorted[i] -> name);
+
+	free(sorted);
+
+	/* call graph */
+	qsort(profile -> edges, profile -> edges_num, sizeof(profile_edge), compare_edges);
+
+	fprintf(des, "\ncall graph\n\n%10s  %s\n", "calls", "caller -> callee");
+
+	for (i = 0; i < profile -> edges_num; i++)
+		fprintf(des, "%10ld  %s -> %s\n", profile -> edges[i].calls, profile -> labels[profile -> edges[i].caller].name,
+				profile -> labels[profile -> edges[i].callee].name);
+
+	/* the instruction lines with the source text */
+	write_source_lines(des, cpu, profile, file_name);
+
+	fclose(des);
+
+}
+
+
+
+/*
+ *	Writes the instruction lines of the .am file (with their .as origin) and the lines of the .as file
+ *	to the profile report.
+ *
+ *	param des - Pointer to the report.
+ *	param cpu - Pointer to the cpu (after the run).
+ *	param profile - Pointer to the profile.
+ *	param file_name - The name of the program without extension.
+ */
+void write_source_lines(FILE *des, cpu_state *cpu, program_profile *profile, char *file_name){
+
+	FILE *src;
+	char src_name[MAX_BUFFER], line[MAX_BUFFER], *text;
+	map_file *map = profile -> map;
+	map_range *range;
+	map_origin *origin;
+	profile_source_line *as_lines;
+	long total = cpu -> executed, count;
+	int i, j, line_num = 0, as_lines_num = 1;
+
+	for (i = 0; i < map -> origins_num; i++)
+		if (map -> origins[i].line >= as_lines_num)
+			as_lines_num = map -> origins[i].line + 1;
+
+	if ((as_lines = (profile_source_line *)counted_calloc(as_lines_num, sizeof(profile_source_line))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - profile");
+		exit(1);
+	}
+
+	sprintf(src_name, "%s.am", file_name);
+	fprintf(des, "\ninstruction lines of %s\n\n%12s %7s %6s %6s  %s\n", src_name, "count", "%", "line", ".as", "source");
+
+	src = fopen(src_name, "r");
+
+	/* the code ranges are first (the ranges are sorted by address) */
+	for (i = 0; i < map -> ranges_num && map -> ranges[i].address < cpu -> code_end; i++){
+
+		range = &(map -> ranges[i]);
+
+		for (count = 0, j = range -> address; j < range -> address + range -> length && j < CPU_MEMORY_SIZE; j++)
+			count += profile -> counts[j];
+
+		text = read_source_line(src, &line_num, range -> line, line);
+
+		if ((origin = get_map_origin(map, range -> line)) == NULL){
+			fprintf(des, "%12ld %6.2f%% %6d %6s  %s\n", count, PERCENT(count, total), range -> line, "", text);
+			continue;
+		}
+
+		/* an expanded line is counted in the macro definition line and in the macro call line */
+		j = origin -> macro_line ? origin -> macro_line : origin -> line;
+		if (j < as_lines_num){
+			as_lines[j].self += count;
+			as_lines[j].is_code = 1;
+		}
+		if (origin -> macro_line)
+			as_lines[origin -> line].expanded += count;
+
+		fprintf(des, "%12ld %6.2f%% %6d %6d  %s", count, PERCENT(count, total), range -> line, j, text);
+		if (origin -> macro_line)
+			fprintf(des, "\t(macro call at line %d)", origin -> line);
+		fputc('\n', des);
+	}
+
+	if (src != NULL)
+		fclose(src);
+
+	/* the lines of the .as file */
+	sprintf(src_name, "%s.as", file_name);
+	fprintf(des, "\nsource lines of %s\n\n%12s %7s %12s %6s  %s\n", src_name, "count", "%", "expanded", "line", "source");
+
+	src = fopen(src_name, "r");
+	line_num = 0;
+
+	for (i = 1; i < as_lines_num; i++){
+
+		if (!as_lines[i].is_code && as_lines[i].expanded == 0)
+			continue;
+
+		text = read_source_line(src, &line_num, i, line);
+		fprintf(des, "%12ld %6.2f%% %12ld %6d  %s\n", as_lines[i].self, PERCENT(as_lines[i].self, total),
+				as_lines[i].expanded, i, text);
+	}
+
+	if (src != NULL)
+		fclose(src);
+	free(as_lines);
+
+}
+
+
+
+/*
+ *	Reads a source file forward up to a line.
+ *
+ *	param src - Pointer to the source (NULL if it could not be opened).
+ *	param line_num - Pointer to the number of the last read line.
+ *	param target - The line to read.
+ *	param line - Buffer of the line.
+ *	returns the text of the line without the new line ("" if it was not found).
+ */
+char *read_source_line(FILE *src, int *line_num, int target, char *line){
+
+	if (*line_num > target) /* the lines are read forward only */
+		return "";
+
+	while (src != NULL && *line_num < target && fgets(line, MAX_BUFFER, src))
+		(*line_num)++;
+
+	if (src == NULL || *line_num != target)
+		return "";
+
+	line[strcspn(line, "\r\n")] = '\0';
+
+	return line;
+
+}
+
+
+
+/* the sort orders of the report */
+
+int compare_labels_self(const void *a, const void *b){
+
+	long self_a = (*(profile_label * const *)a) -> self, self_b = (*(profile_label * const *)b) -> self;
+
+	return self_a < self_b ? 1 : self_a > self_b ? -1 : 0;
+
+}
+
+int compare_edges(const void *a, const void *b){
+
+	long calls_a = ((const profile_edge *)a) -> calls, calls_b = ((const profile_edge *)b) -> calls;
+
+	return calls_a < calls_b ? 1 : calls_a > calls_b ? -1 : 0;
+
+}
@@ -0,0 +1,49 @@
+/*
+ *	File: profile.h
+ *
+ *	Defines the data structures and function prototypes of the emulator profiler (--profile option).
+ *	The profiler counts the executed instructions of every address and maps them back to the labels
+ *	and to the source lines (of the .am file and through the macro expansions of the .as file) by the
+ *	.map file of the program (assembler --map option), and it builds a call graph of the jsr/rts calls.
+ *	The report is written to a .prof file.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define FIRST_PROFILE_SIZE 64 /* initial size of the profile arrays (doubled when full) */
+#define NO_LABEL_NAME "(no label)" /* the function of the addresses before the first label */
+
+typedef struct {
+	char name[MAX_LABEL_SIZE];
+	int address;
+	long self; /* instructions executed in [address, address of the next label) */
+	long inclusive; /* instructions executed from a jsr to the label until the matching rts */
+	long calls; /* number of jsr to the label */
+	int on_stack; /* number of frames of the label on the call stack (for recursion) */
+} profile_label;
+
+typedef struct {
+	int caller; /* label indexes */
+	int callee;
+	long calls;
+} profile_edge;
+
+typedef struct {
+	long self; /* instructions of the memory words of the line (all the expansions of a macro definition line) */
+	long expanded; /* instructions expanded from a macro call in the line */
+	int is_code; /* 1 if the line has instruction words */
+} profile_source_line;
+
+typedef struct {
+	map_file *map;
+	profile_label *labels; /* the labels of the map (same indexes), the last one is NO_LABEL_NAME */
+	int labels_num;
+	profile_edge *edges;
+	int edges_num;
+	int edges_size;
+	long counts[CPU_MEMORY_SIZE]; /* executed instructions of every address */
+} program_profile;
+
+/* functions prototype */
+int profile_program(cpu_state *, char *, long);
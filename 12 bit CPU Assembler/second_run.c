@@ -5,6 +5,7 @@
  *  In the second run, the assembler processes each line of the input assembly source code,
  *  evaluates instructions and directives, and generates the actual machine code instructions.
  *  It also performs additional checks for entry and extern labels, ensuring they are correctly used.
+ *  In the check mode (--check option) the lines are only checked, without the code and data images.
  *  
  *  author: Gal Levi
  *  version: 5.8.23
@@ -14,10 +15,17 @@
 #include "labels_BST.h"
 #include "ast.h"
 #include "encoder.h"
+#include "diag.h"
 
 /* functions protoype */
 int encoder(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[MAX_MEMORY_ASSUMPTION],
- 			int *, ast *, symbol_table_node *, char *, int);
+ 			int *, ast *, symbol_table_node *, extern_ref_vector *, char *, int);
+int encode_line(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[MAX_MEMORY_ASSUMPTION],
+ 			int *, ast *, symbol_table_node *, extern_ref_vector *, char *, int);
+int second_run_stream(FILE *, char *, mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *,
+					  mem_data_word (*)[MAX_MEMORY_ASSUMPTION], int *, symbol_table_node *, extern_ref_vector *,
+					  line_map_vector *, int *, int);
+int check_encoding(ast *, symbol_table_node *, char *, int);
 
 
 /*
@@ -31,6 +39,8 @@ int encoder(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[M
  *  param data_im - A pointer to a 2D array of mem_data_word representing the data image.
  *  param dc_add - A pointer to the current data counter, which gets updated during the run.
  *  param symbol_table - A pointer to the symbol table containing label information.
+ *  param ext_refs - A pointer to the external references log, filled while encoding.
+ *  param line_map - A pointer to the line map, filled while encoding (NULL if it is not needed).
  *  param file_name - The name of the source assembly file being processed.
  *  param error_lines - An array of integers representing lines with errors from the first run.
  *  param err_ln_size - The size of the error_lines array in bytes.
@@ -42,14 +52,13 @@ int encoder(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[M
  */
 int second_run(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
 				mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int *dc_add,
-				 symbol_table_node *symbol_table, char *file_name, int *error_lines, int err_ln_size){
+				 symbol_table_node *symbol_table, extern_ref_vector *ext_refs, line_map_vector *line_map,
+				  char *file_name, int *error_lines, int err_ln_size){
  			
  			
- 	int line_num = 0, is_valid = 1, is_line_valid = 1, i;
+ 	int is_valid;
 	FILE *src;
-	char src_name[MAX_BUFFER], curr_line[MAX_BUFFER];
-	ast curr_line_ast;
-	symbol_table_node *curr_search_res;
+	char src_name[MAX_BUFFER];
 	
 	sprintf(src_name, "%s.am", file_name);
 	
@@ -60,10 +69,45 @@ int second_run(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
 		
 	}
 	
+	is_valid = second_run_stream(src, src_name, code_im, ic_add, data_im, dc_add, symbol_table, ext_refs, line_map,
+								 error_lines, err_ln_size);
+	
+	fclose(src);
+	return is_valid;
+ 			
+}
+
+
+
+/*
+ *  Performs the second run on an expanded source stream (the core of the second run).
+ *  It is used for .am files and for the in memory sources of the check mode, which passes NULL images.
+ *
+ *  param src - The expanded source stream.
+ *  param src_name - The name of the source (for error messages).
+ *  param code_im - A pointer to the code image (NULL to only check the lines).
+ *  param ic_add - A pointer to the current instruction counter.
+ *  param data_im - A pointer to the data image (NULL to only check the lines).
+ *  param dc_add - A pointer to the current data counter.
+ *  param symbol_table - A pointer to the symbol table.
+ *  param ext_refs - A pointer to the external references log.
+ *  param line_map - A pointer to the line map (NULL if it is not needed).
+ *  param error_lines - An array of the lines with errors from the first run.
+ *  param err_ln_size - The size of the error_lines array in bytes.
+ *  returns 1 if no errors were found, 0 otherwise.
+ */
+int second_run_stream(FILE *src, char *src_name, mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
+					  mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int *dc_add, symbol_table_node *symbol_table,
+					  extern_ref_vector *ext_refs, line_map_vector *line_map, int *error_lines, int err_ln_size){
+
+	int line_num = 0, is_valid = 1, is_line_valid = 1, i, ic_before, dc_before;
+	char curr_line[MAX_BUFFER];
+	ast curr_line_ast;
+	
 	memset(curr_line, '\0', MAX_BUFFER); /* "clears" curr_line junk characters */
 	
-	/* runs on the file */
-	while (fgets(curr_line, MAX_BUFFER, src) != NULL){
+	/* runs on the file (until it has too many errors) */
+	while (!is_diag_limit_reached() && fgets(curr_line, MAX_BUFFER, src) != NULL){
 		
 		line_num++; /* test.am file line counter */
 		
@@ -80,74 +124,114 @@ int second_run(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
 			continue;
 		
 		curr_line_ast = get_ast(curr_line);
+		ic_before = *ic_add;
+		dc_before = *dc_add;
+		
+		/* checks the entry/extern labels of the line or encodes it */
+		is_line_valid = encode_line(code_im, ic_add, data_im, dc_add, &curr_line_ast, symbol_table, ext_refs,
+									src_name, line_num);
+		
+		/* logs the memory words of the line */
+		if (line_map != NULL && is_line_valid){
+			if (*ic_add > ic_before)
+				insert_line_map(line_map, line_num, ic_before, *ic_add - ic_before, 0);
+			if (*dc_add > dc_before)
+				insert_line_map(line_map, line_num, dc_before, *dc_add - dc_before, 1);
+		}
 		
-		/* if the line is empty or a comment, skips it */
-		if (curr_line_ast.ast_union_option == ast_union_empty_line ||
-			curr_line_ast.ast_union_option == ast_union_comment_line)
-			continue;
-			
-		/* if it is entry or extern line */
-		if (curr_line_ast.ast_union_option == ast_union_dir &&
-		 (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry ||
-		  curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_extern)){  
-		  
-			/* if it is entry line */
-			if (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry){
-			
-				/* finding the entry label in the table */
-				curr_search_res = search_label(symbol_table, curr_line_ast.ast_union_ins_dir.ast_dir.dir.label);
-			
-				/* if the label is declared as entry and not defined in the file */
-				if (curr_search_res -> comm == enum_comm_none){
-				
-					errprintf(src_name, line_num, "the label '%s' is declared as entry and is not defined in the file", curr_search_res -> label);
-					is_line_valid = 0;
-			
-				}
-		
-			}
-		
-			/* if it is extern line */
-			else if (curr_line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_extern){
 		
-				/* runs on extern label array */
-				for (i = 0; i < curr_line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels_count; i++){
-				
-					/* finding the entry label in the table */
-					curr_search_res = search_label(symbol_table, curr_line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]);
-					
-					if (curr_search_res -> label_value.value == NO_VALUE)
-						warnprintf(src_name, line_num, "the label '%s' was declared as extern but not used in the file", curr_search_res -> label);
-				
-				
-				}
+		if (is_valid && !is_line_valid) /* if current line is invalid the whole program is invalid */
+			is_valid = 0;
+			
 		
+	}
+ 			
+	return is_valid;	
+ 			
+}
+
+
+/*
+ *  Handles one parsed line in the second run.
+ *  Entry and extern lines are checked against the symbol table, instruction and directive lines
+ *  are encoded into the code and data images.
+ *
+ *  param code_im - A pointer to the code image (NULL to only check the line).
+ *  param ic_add - A pointer to the current instruction counter.
+ *  param data_im - A pointer to the data image (NULL to only check the line).
+ *  param dc_add - A pointer to the current data counter.
+ *  param curr_line_ast - The ast of the line.
+ *  param symbol_table - A pointer to the symbol table.
+ *  param ext_refs - A pointer to the external references log.
+ *  param src_name - The name of the source (for error messages).
+ *  param line_num - The number of the line.
+ *  returns 1 if the line is valid, 0 otherwise.
+ */
+int encode_line(mem_code_word (*code_im)[MAX_MEMORY_ASSUMPTION], int *ic_add,
+				mem_data_word (*data_im)[MAX_MEMORY_ASSUMPTION], int *dc_add, ast *curr_line_ast,
+				 symbol_table_node *symbol_table, extern_ref_vector *ext_refs, char *src_name, int line_num){
+
+	int is_line_valid = 1, i;
+	symbol_table_node *curr_search_res;
+	
+	/* if the line is empty or a comment, skips it */
+	if (curr_line_ast -> ast_union_option == ast_union_empty_line ||
+		curr_line_ast -> ast_union_option == ast_union_comment_line)
+		return 1;
+		
+	/* if it is entry or extern line */
+	if (curr_line_ast -> ast_union_option == ast_union_dir &&
+	 (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry ||
+	  curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_extern)){  
+	  
+		/* if it is entry line */
+		if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_entry){
+		
+			/* finding the entry label in the table */
+			curr_search_res = search_label(symbol_table, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.label);
+		
+			/* if the label is declared as entry and not defined in the file */
+			if (curr_search_res -> comm == enum_comm_none){
+			
+				errprintf(src_name, line_num, "the label '%s' is declared as entry and is not defined in the file", curr_search_res -> label);
+				is_line_valid = 0;
 		
 			}
+	
 		}
-		
-		
-		else { /* if it is an instruction or directive(string and data) line */
+	
+		/* if it is extern line */
+		else if (curr_line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_extern){
+	
+			/* runs on extern label array */
+			for (i = 0; i < curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels_count; i++){
 			
-			/* encodes the instruction/directive into machine code */
-			if (!encoder(code_im, ic_add, data_im, dc_add, &curr_line_ast, symbol_table, src_name, line_num))
-				is_line_valid = 0;
-		
+				/* finding the extern label in the table (an external of the snapshot is in the table only if it was used) */
+				curr_search_res = search_label(symbol_table, curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]);
+				
+				if (curr_search_res == NULL || curr_search_res -> value == NO_VALUE)
+					warnprintf(src_name, line_num, "the label '%s' was declared as extern but not used in the file", curr_line_ast -> ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]);
+			
+			
+			}
+	
+	
 		}
+	}
+	
+	
+	else { /* if it is an instruction or directive(string and data) line */
 		
+		/* checks the instruction/directive like the encoder (check mode) */
+		if (code_im == NULL)
+			is_line_valid = check_encoding(curr_line_ast, symbol_table, src_name, line_num);
 		
-		if (is_valid && !is_line_valid) /* if current line is invalid the whole program is invalid */
-			is_valid = 0;
-			
-		
+		/* encodes the instruction/directive into machine code */
+		else if (!encoder(code_im, ic_add, data_im, dc_add, curr_line_ast, symbol_table, ext_refs, src_name, line_num))
+			is_line_valid = 0;
+	
 	}
- 			
- 			
- 			
 	
- 			
- 			
-	fclose(src);
-	return is_valid;	
- 			
+	return is_line_valid;
+
 }
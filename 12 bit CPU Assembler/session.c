@@ -0,0 +1,1113 @@
+/*
+ *	File: session.c
+ *
+ *	This file implements the assembler session - incremental reassembly of an in memory source.
+ *	Every edit replaces a range of source lines. If the last update had no diagnostics and the edit
+ *	replaces plain lines (lines that expand to themselves) by plain instruction, .data, .string, empty or
+ *	comment lines with the same label definitions that use only defined local labels, the edit is patched:
+ *	the macro expansion and the symbol table are kept, the words after the edit are moved, the addresses
+ *	of the lines and the labels after it are shifted, and only the new lines and the lines that use a
+ *	moved label are encoded again. Such an edit cannot report a diagnostic, so the result is the same as a
+ *	reassembly. Any other edit reassembles the source: the macros are expanded in memory (a cheap text
+ *	pass), every expanded line that has a memoized ast reuses it and only new line texts are parsed (this
+ *	covers both the edited lines and the lines of affected macro expansions), then the label definitions,
+ *	the address assignment and the encoding run on the cached asts.
+ *	The diagnostics are printed by errprintf/warnprintf with the session name.
+ *	The stream mode of the assembler ('-') assembles its standard input as one edit of a new session and
+ *	writes the outputs to its standard output, so it writes no files:
+ *		.ob		the content of the .ob file
+ *		.ent	the content of the .ent file (only if there are entry labels)
+ *		.ext	the content of the .ext file (only if external labels are used)
+ *	a line that starts with a dot starts a section (the outputs have no such lines).
+ *	The session mode of the assembler (--session, for editors) keeps one session for its standard input.
+ *	The input is a sequence of edits - a line ".edit first last count" and then the count new lines - and
+ *	after every edit the outputs (if the source is valid) and a line ".end" are written to the standard
+ *	output, and the diagnostics of the edit to the standard error.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for fmemopen in ansi mode */
+
+#include "session.h"
+#include "diag.h"
+
+/* macro definitions */
+#define SESSION_INIT_SIZE 64 /* initial number of cells in the lines arrays */
+#define MEMO_SWEEP_RATIO 2 /* a patch sweeps the memoized asts when they are this many times the lines */
+#define STREAM_CHUNK_SIZE 8192 /* the source of a stream is read in chunks of this size */
+
+/* functions prototype */
+int pre_assemble_stream(FILE *, char *, macro_node **, macro_node **, char **, map_origin_vector *);
+int define_line_labels(ast *, int, int, symbol_table_node **, macro_node *, int *, int *, char *, int);
+void count_line_words(ast *, int *, int *);
+int encode_line(mem_code_word (*)[MAX_MEMORY_ASSUMPTION], int *, mem_data_word (*)[MAX_MEMORY_ASSUMPTION],
+ 			int *, ast *, symbol_table_node *, extern_ref_vector *, char *, int);
+void print_code_and_data_to_stream(FILE *, mem_code_word *, int, mem_data_word *, int);
+
+/* exclusive functions prototype */
+char *read_stream_text(FILE *);
+char *read_edit_lines(FILE *, int);
+void print_session_outputs(asm_session *, FILE *);
+int find_session_patch(asm_session *, int, int, char **, int, session_patch *);
+int is_plain_source_line(asm_session *, int, int);
+int is_plain_line_text(asm_session *, char *);
+int is_patchable_ast(asm_session *, ast *);
+int is_patchable_operand(asm_session *, enum op_type_e, op_type_u *);
+int is_same_label_definitions(asm_session *, session_patch *);
+int patch_session(asm_session *, session_patch *);
+void shift_session_labels(symbol_table_node *, session_patch *, int);
+int is_label_moved(asm_session *, ast *, session_patch *);
+int reassemble_session(asm_session *);
+int expand_session_lines(asm_session *, char *);
+ast_memo_node *get_memo_ast(asm_session *, char *);
+void sweep_memo_asts(asm_session *);
+unsigned long hash_line(char *);
+void *enlarge_array(void *, int *, int);
+
+
+
+/*
+ *	Creates a new empty session.
+ *
+ *	param name - The source name (used in error messages).
+ *	returns - Pointer to the new session
+ */
+asm_session *create_session(char *name){
+
+	asm_session *session = (asm_session *)counted_calloc(1, sizeof(asm_session));
+
+	if (session == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	strncpy(session -> name, name, MAX_BUFFER - 1);
+	session -> is_valid = 1;
+
+	return session;
+
+}
+
+
+
+/*
+ *	Replaces a range of source lines and reassembles the source.
+ *
+ *	param session - Pointer to the session
+ *	param first - Index of the first replaced line (0 based)
+ *	param last - Index after the last replaced line (first = last inserts lines before first)
+ *	param text - The new lines, separated by new lines (empty string deletes the range)
+ *	returns - 1 if the source is valid after the edit, 0 otherwise (or if the range is invalid)
+ */
+int edit_session(asm_session *session, int first, int last, char *text){
+
+	int new_cnt = 0, i, length, size, is_patched, is_valid;
+	char *line_end;
+	char **new_lines;
+	session_patch patch;
+
+	if (first < 0 || last < first || last > session -> src_cnt){
+		errprintf(session -> name, NO_LINE_ERROR, "invalid edit range %d-%d - session", first, last);
+		return 0;
+	}
+
+	/* counts the new lines (a text without a final new line still ends with a line) */
+	for (i = 0; text[i]; i++)
+		if (text[i] == '\n' || text[i + 1] == '\0')
+			new_cnt++;
+
+	new_lines = (char **)counted_malloc(sizeof(char *) * (new_cnt + 1));
+
+	if (new_lines == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	/* splits the text into lines that end with a new line */
+	for (i = 0; i < new_cnt; i++){
+
+		length = (line_end = strchr(text, '\n')) ? line_end - text : strlen(text);
+
+		if (!(new_lines[i] = (char *)counted_malloc(length + 2))){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        	exit(1);
+		}
+
+		memcpy(new_lines[i], text, length);
+		strcpy(new_lines[i] + length, "\n");
+		text += line_end ? length + 1 : length;
+	}
+
+	/* the edit is checked against the lines it replaces, so before the range is replaced */
+	is_patched = find_session_patch(session, first, last, new_lines, new_cnt, &patch);
+
+	/* replaces the range */
+	for (i = first; i < last; i++)
+		free(session -> src_lines[i]);
+
+	while (session -> src_cnt - (last - first) + new_cnt > session -> src_size){
+		size = session -> src_size;
+		session -> src_lines = (char **)enlarge_array(session -> src_lines, &(session -> src_size), sizeof(char *));
+		session -> src_expanded = (int *)enlarge_array(session -> src_expanded, &size, sizeof(int));
+	}
+
+	/* the arrays are not allocated yet for an empty source or an empty text */
+	if (last < session -> src_cnt){
+		memmove(session -> src_lines + first + new_cnt, session -> src_lines + last,
+				sizeof(char *) * (session -> src_cnt - last));
+		memmove(session -> src_expanded + first + new_cnt, session -> src_expanded + last,
+				sizeof(int) * (session -> src_cnt - last));
+	}
+	if (new_cnt > 0)
+		memcpy(session -> src_lines + first, new_lines, sizeof(char *) * new_cnt);
+	for (i = first; i < first + new_cnt; i++)
+		session -> src_expanded[i] = 1; /* a patched line expands to itself (a reassembly counts them again) */
+	session -> src_cnt += new_cnt - (last - first);
+
+	free(new_lines);
+
+	if (!is_patched)
+		return reassemble_session(session);
+
+	is_valid = patch_session(session, &patch);
+	free(patch.memos);
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Frees the memory used by a session.
+ *
+ *	param session - Pointer to the session
+ */
+void free_session(asm_session *session){
+
+	int i;
+	ast_memo_node *curr, *next;
+
+	for (i = 0; i < session -> src_cnt; i++)
+		free(session -> src_lines[i]);
+	free(session -> src_lines);
+	free(session -> src_expanded);
+
+	for (i = 0; i < AST_TABLE_SIZE; i++){
+		for (curr = session -> memo[i]; curr != NULL; curr = next){
+			next = curr -> next;
+			free(curr -> line);
+			free(curr);
+		}
+	}
+
+	free(session -> lines);
+	free_macro_list(&(session -> head_macro));
+	free_symbol_table(&(session -> label_root));
+	free_extern_refs(&(session -> ext_refs));
+	free(session);
+
+}
+
+
+
+/*
+ *	Assembles a source stream in memory and writes its outputs as sections of a result stream.
+ *
+ *	param src - The source stream
+ *	param des - The result stream
+ *	param name - The source name (used in error messages)
+ *	returns - 1 if the source is valid (the outputs were written), 0 otherwise
+ */
+int assemble_stream(FILE *src, FILE *des, char *name){
+
+	asm_session *session = create_session(name);
+	char *text = read_stream_text(src);
+	int is_valid;
+
+	if ((is_valid = edit_session(session, 0, 0, text)))
+		print_session_outputs(session, des);
+
+	fflush(des);
+	free(text);
+	free_session(session);
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Keeps a session for a stream of edits and writes the outputs of every edit to a result stream.
+ *
+ *	param src - The edits stream (".edit first last count" lines, each one followed by count new lines)
+ *	param des - The result stream
+ *	param name - The source name (used in error messages)
+ *	returns - 1 if the source is valid after the last edit, 0 otherwise
+ */
+int serve_session(FILE *src, FILE *des, char *name){
+
+	asm_session *session = create_session(name);
+	char command[MAX_BUFFER], *text;
+	int first, last, count, is_valid = 1;
+
+	while (fgets(command, MAX_BUFFER, src) != NULL){
+
+		if (sscanf(command, ".edit %d %d %d", &first, &last, &count) != 3 || count < 0){
+			command[strcspn(command, "\n")] = '\0';
+			errprintf(name, NO_LINE_ERROR, "invalid session command '%s' (expected .edit first last count)", command);
+			is_valid = 0;
+		}
+		else {
+			text = read_edit_lines(src, count);
+			if ((is_valid = edit_session(session, first, last, text)))
+				print_session_outputs(session, des);
+			free(text);
+		}
+
+		/* the answer of every edit is written at once (the editor waits for it) */
+		fprintf(des, ".end\n");
+		fflush(des);
+		flush_diags();
+	}
+
+	free_session(session);
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Reads the new lines of an edit into a string.
+ *
+ *	param src - The edits stream
+ *	param count - Number of lines to read (fewer at the end of the stream)
+ *	returns - The lines (allocated, the caller frees it)
+ */
+char *read_edit_lines(FILE *src, int count){
+
+	char *text = NULL;
+	long length = 0, size = 0;
+
+	do {
+		if (length + MAX_BUFFER > size){
+
+			size = size ? size * 2 : MAX_BUFFER;
+
+			if (!(text = (char *)counted_realloc(text, size))){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+				exit(1);
+			}
+		}
+
+		text[length] = '\0';
+
+		/* a line longer than the buffer is read in parts, and only its end counts */
+		if (count > 0 && fgets(text + length, MAX_BUFFER, src) != NULL){
+			length += strlen(text + length);
+			if (text[length - 1] == '\n')
+				count--;
+		}
+		else
+			count = 0;
+
+	} while (count > 0);
+
+	return text;
+
+}
+
+
+
+/*
+ *	Reads a whole stream into a string.
+ *
+ *	param src - The stream
+ *	returns - The text of the stream (allocated, the caller frees it)
+ */
+char *read_stream_text(FILE *src){
+
+	char *text = NULL;
+	long length = 0, size = 0, cnt;
+
+	do {
+		if (length + STREAM_CHUNK_SIZE + 1 > size){
+
+			size = size ? size * 2 : STREAM_CHUNK_SIZE + 1;
+
+			if (!(text = (char *)counted_realloc(text, size))){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+				exit(1);
+			}
+		}
+
+		length += (cnt = fread(text + length, sizeof(char), STREAM_CHUNK_SIZE, src));
+
+	} while (cnt > 0);
+
+	text[length] = '\0';
+
+	return text;
+
+}
+
+
+
+/*
+ *	Writes the outputs of a valid session as the sections of a result stream.
+ *
+ *	param session - Pointer to the session
+ *	param des - The result stream
+ */
+void print_session_outputs(asm_session *session, FILE *des){
+
+	extern_ref_vector plain_refs = {NULL, 0, 0};
+	symbol_table_node *plain_root;
+
+	/* the labels are written in the order of the table without the snapshot (NULL if there is none) */
+	plain_root = build_plain_symbol_table(session -> label_root, &(session -> ext_refs), &plain_refs);
+
+	fprintf(des, ".ob\n");
+	print_code_and_data_to_stream(des, session -> code_im, session -> ic, session -> data_im, session -> dc);
+
+	if (is_there_entry(session -> label_root)){
+		fprintf(des, ".ent\n");
+		print_entry_labels_to_stream(des, plain_root ? plain_root : session -> label_root);
+	}
+
+	if (session -> ext_refs.count > 0){
+		fprintf(des, ".ext\n");
+		print_extern_labels_to_stream(des, plain_root ? plain_root : session -> label_root,
+									  plain_root ? &plain_refs : &(session -> ext_refs));
+	}
+
+	free_symbol_table(&plain_root);
+	free_extern_refs(&plain_refs);
+
+}
+
+
+
+/*
+ *	Checks if an edit can be patched into the last update, and gets the asts of its new lines.
+ *	It is called before the range is replaced, so the source lines are still the lines of the last update.
+ *
+ *	param session - Pointer to the session
+ *	param first - Index of the first replaced source line
+ *	param last - Index after the last replaced source line
+ *	param new_lines - The new lines (each one ends with a new line)
+ *	param new_cnt - Number of new lines
+ *	param patch - Pointer to the patch to fill (its memos are allocated only if the edit can be patched)
+ *	returns - 1 if the edit can be patched, 0 if the source needs a reassembly
+ */
+int find_session_patch(asm_session *session, int first, int last, char **new_lines, int new_cnt, session_patch *patch){
+
+	int i, ic_words, dc_words;
+	session_line *lines = session -> lines;
+
+	/* an update that reported a diagnostic reports it again, so only a reassembly can follow it */
+	if (!session -> is_quiet)
+		return 0;
+
+	for (i = 0, patch -> line = 0; i < first; i++)
+		patch -> line += session -> src_expanded[i];
+
+	/* the line after an insertion (or the last line) is plain, so the new lines are not in a macro definition */
+	if (first == last && !(first < session -> src_cnt ? is_plain_source_line(session, first, patch -> line) :
+						   is_plain_source_line(session, first - 1, patch -> line - 1)))
+		return 0;
+
+	patch -> old_cnt = last - first;
+	patch -> new_cnt = new_cnt;
+	patch -> ic = patch -> line < session -> lines_cnt ? lines[patch -> line].ic : session -> ic;
+	patch -> dc = patch -> line < session -> lines_cnt ? lines[patch -> line].dc : session -> dc;
+	patch -> old_ic = patch -> old_dc = patch -> new_ic = patch -> new_dc = 0;
+
+	for (i = 0; i < patch -> old_cnt; i++){
+
+		if (!is_plain_source_line(session, first + i, patch -> line + i) ||
+			!is_patchable_ast(session, &(lines[patch -> line + i].memo -> line_ast)))
+			return 0;
+
+		patch -> old_ic += lines[patch -> line + i].memo -> ic_words;
+		patch -> old_dc += lines[patch -> line + i].memo -> dc_words;
+	}
+
+	if (!(patch -> memos = (ast_memo_node **)counted_malloc(sizeof(ast_memo_node *) * (new_cnt + 1)))){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	session -> parsed_cnt = 0;
+
+	for (i = 0; i < new_cnt; i++){
+
+		if (!is_plain_line_text(session, new_lines[i])){
+			free(patch -> memos);
+			return 0;
+		}
+
+		patch -> memos[i] = get_memo_ast(session, new_lines[i]);
+
+		if (!is_patchable_ast(session, &(patch -> memos[i] -> line_ast))){
+			free(patch -> memos);
+			return 0;
+		}
+
+		patch -> new_ic += patch -> memos[i] -> ic_words;
+		patch -> new_dc += patch -> memos[i] -> dc_words;
+	}
+
+	ic_words = session -> ic + patch -> new_ic - patch -> old_ic;
+	dc_words = session -> dc + patch -> new_dc - patch -> old_dc;
+
+	/* a memory overflow is a diagnostic */
+	if (ic_words + dc_words > MAX_MEMORY_ASSUMPTION || !is_same_label_definitions(session, patch)){
+		free(patch -> memos);
+		return 0;
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks if a source line of the last update is a plain line - a line that expanded to itself.
+ *
+ *	param session - Pointer to the session
+ *	param src - Index of the source line
+ *	param line - Index of its expanded line
+ *	returns - 1 if the line is plain, 0 otherwise
+ */
+int is_plain_source_line(asm_session *session, int src, int line){
+
+	return src >= 0 && src < session -> src_cnt && session -> src_expanded[src] == 1 &&
+		   line >= 0 && line < session -> lines_cnt && strcmp(session -> lines[line].memo -> line, session -> src_lines[src]) == 0;
+
+}
+
+
+
+/*
+ *	Checks if the pre assembler copies a new line as is - the line is not too long, it is not a macro
+ *	statement or an .include statement and it has no macro name.
+ *
+ *	param session - Pointer to the session
+ *	param line - The line text
+ *	returns - 1 if the line expands to itself, 0 otherwise
+ */
+int is_plain_line_text(asm_session *session, char *line){
+
+	return strlen(line) < MAX_LINE && strstr(line, "mcro") == NULL && strstr(line, ".include") == NULL &&
+		   is_macro(&(session -> head_macro), line) == NULL;
+
+}
+
+
+
+/*
+ *	Checks if the ast of a replaced or a new line can be patched - it is an instruction, a .data or a
+ *	.string directive, an empty line or a comment line that encodes without a diagnostic and without an
+ *	external label.
+ *
+ *	param session - Pointer to the session
+ *	param line_ast - The ast of the line
+ *	returns - 1 if the line can be patched, 0 otherwise
+ */
+int is_patchable_ast(asm_session *session, ast *line_ast){
+
+	int i;
+
+	switch (line_ast -> ast_union_option){
+
+		case ast_union_empty_line:
+		case ast_union_comment_line:
+			return 1;
+
+		case ast_union_dir:
+			return line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_string ||
+				   (line_ast -> ast_union_ins_dir.ast_dir.ast_union_dir_option == ast_union_dir_data &&
+					line_ast -> ast_union_ins_dir.ast_dir.dir.data_num_array.range_error == NO_RANGE_ERROR);
+
+		case ast_union_ins:
+
+			/* 2 parameters instructions case (mov, cmp, add, sub, lea) */
+			if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_mov && line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
+				for (i = 0; i < 2; i++)
+					if (!is_patchable_operand(session, line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote[i],
+											  &(line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu[i])))
+						return 0;
+			}
+
+			/* one parameter instructions case */
+			else if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_not && line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr)
+				return is_patchable_operand(session, line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote,
+											&(line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu));
+
+			return 1;
+
+		default: /* an error, or a directive of the first run (.entry, .extern, .incbin) */
+			return 0;
+	}
+
+}
+
+
+
+/*
+ *	Checks if an operand encodes without a diagnostic and without an external label.
+ *
+ *	param session - Pointer to the session
+ *	param ote - The addressing method of the operand
+ *	param otu - Pointer to the operand
+ *	returns - 1 if the operand is a register, an immediate value in range or a defined local label, 0 otherwise
+ */
+int is_patchable_operand(asm_session *session, enum op_type_e ote, op_type_u *otu){
+
+	symbol_table_node *label;
+
+	if (ote == ast_op_type_label)
+		return (label = search_label(session -> label_root, otu -> label)) != NULL && label -> comm != enum_comm_none;
+
+	if (ote == ast_op_type_imm)
+		return otu -> imm >= MIN_IMM_NUM && otu -> imm <= MAX_IMM_NUM;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks if the new lines define the same labels as the replaced lines (the same names in the same
+ *	order, and each one on an instruction or on a directive like before), so the symbol table keeps its
+ *	labels and only their values change.
+ *
+ *	param session - Pointer to the session
+ *	param patch - Pointer to the patch
+ *	returns - 1 if the label definitions are the same, 0 otherwise
+ */
+int is_same_label_definitions(asm_session *session, session_patch *patch){
+
+	int i = 0, j = 0;
+	ast *old_ast, *new_ast;
+
+	while (1){
+
+		while (i < patch -> old_cnt && !session -> lines[patch -> line + i].memo -> line_ast.label_def_flag)
+			i++;
+		while (j < patch -> new_cnt && !patch -> memos[j] -> line_ast.label_def_flag)
+			j++;
+
+		if (i == patch -> old_cnt || j == patch -> new_cnt)
+			return i == patch -> old_cnt && j == patch -> new_cnt;
+
+		old_ast = &(session -> lines[patch -> line + i].memo -> line_ast);
+		new_ast = &(patch -> memos[j] -> line_ast);
+
+		if (strcmp(old_ast -> label, new_ast -> label) != 0 ||
+			(old_ast -> ast_union_option == ast_union_ins) != (new_ast -> ast_union_option == ast_union_ins))
+			return 0;
+
+		i++;
+		j++;
+	}
+
+}
+
+
+
+/*
+ *	Patches an edit into the last update: moves the words after the edit, shifts the addresses of the
+ *	lines, the labels and the external references after it, and encodes the new lines and the lines that
+ *	use a moved label. The source lines are already replaced.
+ *
+ *	param session - Pointer to the session
+ *	param patch - Pointer to the patch (found by find_session_patch)
+ *	returns - 1 if the source is valid (a patched source stays valid)
+ */
+int patch_session(asm_session *session, session_patch *patch){
+
+	int i, ic, dc, is_valid = 1;
+	int delta_ic = patch -> new_ic - patch -> old_ic, delta_dc = patch -> new_dc - patch -> old_dc;
+	int tail = patch -> line + patch -> old_cnt; /* the first line after the edit */
+	extern_ref_vector scratch_refs = {NULL, 0, 0}; /* the lines that are encoded again log their externals again */
+	symbol_table_node *label;
+	ast *line_ast;
+
+	/* moves the words after the edit */
+	memmove(session -> code_im + patch -> ic + patch -> new_ic, session -> code_im + patch -> ic + patch -> old_ic,
+			sizeof(mem_code_word) * (session -> ic - patch -> ic - patch -> old_ic));
+	memmove(session -> data_im + patch -> dc + patch -> new_dc, session -> data_im + patch -> dc + patch -> old_dc,
+			sizeof(mem_data_word) * (session -> dc - patch -> dc - patch -> old_dc));
+
+	/* the encoder sets the fields of zero words (and the words after a shorter image are cleared) */
+	memset(session -> code_im + patch -> ic, 0, sizeof(mem_code_word) * patch -> new_ic);
+	memset(session -> data_im + patch -> dc, 0, sizeof(mem_data_word) * patch -> new_dc);
+	if (delta_ic < 0)
+		memset(session -> code_im + session -> ic + delta_ic, 0, sizeof(mem_code_word) * -delta_ic);
+	if (delta_dc < 0)
+		memset(session -> data_im + session -> dc + delta_dc, 0, sizeof(mem_data_word) * -delta_dc);
+
+	/* the replaced lines use no externals, so every external reference after the edit only moves */
+	for (i = 0; i < session -> ext_refs.count; i++)
+		if (session -> ext_refs.refs[i].address >= patch -> ic + patch -> old_ic)
+			session -> ext_refs.refs[i].address += delta_ic;
+
+	shift_session_labels(session -> label_root, patch, session -> ic);
+	session -> ic += delta_ic;
+	session -> dc += delta_dc;
+
+	/* replaces the expanded lines and shifts the offsets of the lines after them */
+	while (session -> lines_cnt + patch -> new_cnt - patch -> old_cnt > session -> lines_size)
+		session -> lines = (session_line *)enlarge_array(session -> lines, &(session -> lines_size), sizeof(session_line));
+
+	memmove(session -> lines + patch -> line + patch -> new_cnt, session -> lines + tail,
+			sizeof(session_line) * (session -> lines_cnt - tail));
+	session -> lines_cnt += patch -> new_cnt - patch -> old_cnt;
+
+	for (i = patch -> line + patch -> new_cnt; i < session -> lines_cnt; i++){
+		session -> lines[i].ic += delta_ic;
+		session -> lines[i].dc += delta_dc;
+	}
+
+	for (i = 0, ic = patch -> ic, dc = patch -> dc; i < patch -> new_cnt; i++){
+
+		session -> lines[patch -> line + i].memo = patch -> memos[i];
+		session -> lines[patch -> line + i].ic = ic;
+		session -> lines[patch -> line + i].dc = dc;
+		ic += patch -> memos[i] -> ic_words;
+		dc += patch -> memos[i] -> dc_words;
+
+		/* the labels of the new lines (the same labels as the replaced lines) get their new addresses */
+		if (patch -> memos[i] -> line_ast.label_def_flag){
+			label = search_label(session -> label_root, patch -> memos[i] -> line_ast.label);
+			label -> value = label -> comm == enum_ins ? session -> lines[patch -> line + i].ic :
+							 session -> lines[patch -> line + i].dc + session -> ic;
+		}
+	}
+
+	/* encodes the new lines and the lines that use a moved label */
+	for (i = 0; i < session -> lines_cnt; i++){
+
+		line_ast = &(session -> lines[i].memo -> line_ast);
+
+		if (i < patch -> line || i >= patch -> line + patch -> new_cnt){
+
+			if (!is_label_moved(session, line_ast, patch))
+				continue;
+
+			memset(session -> code_im + session -> lines[i].ic, 0, sizeof(mem_code_word) * session -> lines[i].memo -> ic_words);
+		}
+
+		ic = session -> lines[i].ic;
+		dc = session -> lines[i].dc;
+
+		if (!encode_line(&(session -> code_im), &ic, &(session -> data_im), &dc, line_ast, session -> label_root,
+						 &scratch_refs, session -> name, i + 1))
+			is_valid = 0;
+	}
+
+	free_extern_refs(&scratch_refs);
+
+	/* the asts of the replaced line texts are kept until a reassembly, or until they are too many */
+	if (session -> memo_cnt > MEMO_SWEEP_RATIO * session -> lines_cnt + SESSION_INIT_SIZE){
+
+		(session -> generation)++;
+		for (i = 0; i < session -> lines_cnt; i++)
+			session -> lines[i].memo -> generation = session -> generation;
+		sweep_memo_asts(session);
+	}
+
+	/* the checks of find_session_patch leave the encoder nothing to report */
+	session -> is_quiet = is_valid;
+
+	return session -> is_valid = is_valid;
+
+}
+
+
+
+/*
+ *	Shifts the values of the labels after a patched edit (the labels of the edited lines are set by
+ *	patch_session): a code label after the edit moves by the change of the code words, and a data label
+ *	moves by the change of the code words (the data is after the code) and, after the edit, also by the
+ *	change of the data words. The first use of an external label after the edit moves like the code.
+ *
+ *	param root - The root of the symbol table
+ *	param patch - Pointer to the patch
+ *	param old_ic - The number of code words before the edit
+ */
+void shift_session_labels(symbol_table_node *root, session_patch *patch, int old_ic){
+
+	if (root == NULL)
+		return;
+
+	if (root -> comm == enum_ins){
+		if (root -> value >= patch -> ic + patch -> old_ic)
+			root -> value += patch -> new_ic - patch -> old_ic;
+	}
+	else if (root -> comm == enum_dir){
+		if (root -> value - old_ic >= patch -> dc + patch -> old_dc)
+			root -> value += patch -> new_dc - patch -> old_dc;
+		root -> value += patch -> new_ic - patch -> old_ic;
+	}
+	else if (root -> value != NO_VALUE && root -> value >= patch -> ic + patch -> old_ic)
+		root -> value += patch -> new_ic - patch -> old_ic;
+
+	shift_session_labels(root -> left, patch, old_ic);
+	shift_session_labels(root -> right, patch, old_ic);
+
+}
+
+
+
+/*
+ *	Checks if an instruction of a patched source uses a label that the patch moved. A label of the edited
+ *	lines counts as moved.
+ *
+ *	param session - Pointer to the session (after the patch)
+ *	param line_ast - The ast of the line
+ *	param patch - Pointer to the patch
+ *	returns - 1 if the line needs to be encoded again, 0 otherwise
+ */
+int is_label_moved(asm_session *session, ast *line_ast, session_patch *patch){
+
+	int i, cnt, offset;
+	op_type_u *otu;
+	enum op_type_e *ote;
+	symbol_table_node *label;
+
+	if (line_ast -> ast_union_option != ast_union_ins)
+		return 0;
+
+	/* 2 parameters instructions case (mov, cmp, add, sub, lea) */
+	if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_mov && line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_lea){
+		ote = line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.ote;
+		otu = line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_two_op.otu;
+		cnt = 2;
+	}
+	else if (line_ast -> ast_union_ins_dir.ast_ins.ins >= ast_ins_not && line_ast -> ast_union_ins_dir.ast_ins.ins <= ast_ins_jsr){
+		ote = &(line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.ote);
+		otu = &(line_ast -> ast_union_ins_dir.ast_ins.ast_ins_kind.ast_ins_one_op.otu);
+		cnt = 1;
+	}
+	else
+		return 0;
+
+	for (i = 0; i < cnt; i++){
+
+		if (ote[i] != ast_op_type_label || !(label = search_label(session -> label_root, otu[i].label)))
+			continue;
+
+		if (label -> comm == enum_ins && label -> value >= patch -> ic &&
+			(label -> value < patch -> ic + patch -> new_ic || patch -> new_ic != patch -> old_ic))
+			return 1;
+
+		if (label -> comm == enum_dir){
+			offset = label -> value - session -> ic;
+			if (patch -> new_ic != patch -> old_ic || (offset >= patch -> dc &&
+				(offset < patch -> dc + patch -> new_dc || patch -> new_dc != patch -> old_dc)))
+				return 1;
+		}
+	}
+
+	return 0;
+
+}
+
+
+
+/*
+ *	Reassembles the session source (pre assembler, first run and second run on the cached asts).
+ *
+ *	param session - Pointer to the session
+ *	returns - 1 if the source is valid, 0 otherwise
+ */
+int reassemble_session(asm_session *session){
+
+	int i, is_line_valid, is_valid = 1;
+	long diags_cnt = get_diags_count();
+	char *line_errors; /* flags of the lines the first run found invalid */
+	ast_memo_node *curr;
+
+	/* resets the tables of the previous update */
+	session -> is_quiet = 0;
+	free_macro_list(&(session -> head_macro));
+	free_symbol_table(&(session -> label_root));
+	free_extern_refs(&(session -> ext_refs));
+	memset(session -> code_im, 0, sizeof(session -> code_im)); /* the encoder sets the fields of zero words */
+	memset(session -> data_im, 0, sizeof(session -> data_im));
+	session -> ic = 0;
+	session -> dc = 0;
+
+	/* pre assembler and parsing */
+	if (!expand_session_lines(session, session -> name))
+		return session -> is_valid = 0;
+
+	if (!(line_errors = (char *)counted_calloc(session -> lines_cnt + 1, sizeof(char)))){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	/* first run on the cached asts */
+	reset_snapshot_externs();
+	for (i = 0; i < session -> lines_cnt; i++){
+
+		curr = session -> lines[i].memo;
+		session -> lines[i].ic = session -> ic; /* the offsets of the line (for the patches of the next edits) */
+		session -> lines[i].dc = session -> dc;
+		is_line_valid = define_line_labels(&(curr -> line_ast), curr -> ic_words, curr -> dc_words,
+											&(session -> label_root), session -> head_macro,
+											&(session -> ic), &(session -> dc), session -> name, i + 1);
+
+		if (!is_line_valid){
+			line_errors[i] = 1;
+			is_valid = 0;
+		}
+	}
+
+	resolve_snapshot_externs(session -> label_root);
+
+	if (session -> ic + session -> dc > MAX_MEMORY_ASSUMPTION){
+
+		errprintf(session -> name, NO_LINE_ERROR, "memory overflow - the maximum memory you can use is %d memory words but you exceeded it and reached %d.", MAX_MEMORY_ASSUMPTION, session -> ic + session -> dc);
+		free(line_errors);
+		return session -> is_valid = 0;
+	}
+
+	if (is_valid) /* adding ic for all directive labels */
+		increase_labels_value_by_comm(session -> label_root, session -> ic, enum_dir);
+
+	/* second run on the cached asts */
+	session -> ic = 0;
+	session -> dc = 0;
+
+	for (i = 0; i < session -> lines_cnt; i++){
+
+		if (line_errors[i]) /* if already found an error in the current line */
+			continue;
+
+		if (!encode_line(&(session -> code_im), &(session -> ic), &(session -> data_im), &(session -> dc),
+						 &(session -> lines[i].memo -> line_ast), session -> label_root, &(session -> ext_refs),
+						 session -> name, i + 1))
+			is_valid = 0;
+	}
+
+	free(line_errors);
+
+	session -> is_quiet = is_valid && get_diags_count() == diags_cnt;
+
+	return session -> is_valid = is_valid;
+
+}
+
+
+
+/*
+ *	Expands the macros of the session source and gets the ast of every expanded line.
+ *
+ *	param session - Pointer to the session
+ *	param src_name - The source name (for error messages)
+ *	returns - 1 if the pre assembler found no errors, 0 otherwise
+ */
+int expand_session_lines(asm_session *session, char *src_name){
+
+	FILE *stream;
+	char *text, *draft, curr_line[MAX_BUFFER];
+	int i, length = 0, is_valid;
+	map_origin_vector origins = {NULL, 0, 0}; /* the source line of every expanded line */
+
+	/* joins the source lines into one text */
+	for (i = 0; i < session -> src_cnt; i++)
+		length += strlen(session -> src_lines[i]);
+
+	if (!(text = (char *)counted_malloc(length + 1))){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	for (i = 0, length = 0; i < session -> src_cnt; i++){
+		strcpy(text + length, session -> src_lines[i]);
+		length += strlen(session -> src_lines[i]);
+	}
+
+	/* pre assembler in memory (fmemopen does not accept an empty buffer) */
+	if (length == 0 || !(stream = fmemopen(text, length, "r"))){
+
+		session -> lines_cnt = 0;
+		free(text);
+		return length == 0;
+	}
+
+	is_valid = pre_assemble_stream(stream, src_name, &(session -> head_macro), &(session -> tail_macro), &draft, &origins);
+	fclose(stream);
+	free(text);
+
+	if (!is_valid){
+		free(draft);
+		free_map_origins(&origins);
+		return 0;
+	}
+
+	delete_macro_lines(&(session -> head_macro)); /* now we need only the macro names */
+
+	/* counts the expanded lines of every source line (a patch finds its lines by them) */
+	memset(session -> src_expanded, 0, sizeof(int) * session -> src_cnt);
+	for (i = 0; i < origins.count; i++)
+		if (origins.origins[i].line >= 1 && origins.origins[i].line <= session -> src_cnt)
+			session -> src_expanded[origins.origins[i].line - 1]++;
+	free_map_origins(&origins);
+
+	/* gets the asts of the expanded lines (parses only new line texts) */
+	(session -> generation)++;
+	session -> lines_cnt = 0;
+	session -> parsed_cnt = 0;
+
+	if (*draft != '\0' && (stream = fmemopen(draft, strlen(draft), "r"))){
+
+		while (fgets(curr_line, MAX_BUFFER, stream) != NULL){
+
+			if (session -> lines_cnt == session -> lines_size)
+				session -> lines = (session_line *)enlarge_array(session -> lines, &(session -> lines_size),
+																  sizeof(session_line));
+
+			session -> lines[(session -> lines_cnt)++].memo = get_memo_ast(session, curr_line);
+		}
+
+		fclose(stream);
+	}
+
+	free(draft);
+	sweep_memo_asts(session); /* forgets the asts of line texts that are not in the source anymore */
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Gets the memoized ast of a line text (parses the line if its text is new).
+ *
+ *	param session - Pointer to the session
+ *	param line - The line text
+ *	returns - Pointer to the memoized ast node of the line
+ */
+ast_memo_node *get_memo_ast(asm_session *session, char *line){
+
+	unsigned long hash = hash_line(line);
+	ast_memo_node *curr = session -> memo[hash % AST_TABLE_SIZE];
+	char line_cpy[MAX_BUFFER];
+
+	while (curr != NULL){
+
+		if (curr -> hash == hash && strcmp(curr -> line, line) == 0){ /* the line was already parsed */
+			curr -> generation = session -> generation;
+			return curr;
+		}
+
+		curr = curr -> next;
+	}
+
+	/* new line text - parses it */
+	if (!(curr = (ast_memo_node *)counted_malloc(sizeof(ast_memo_node))) || !(curr -> line = (char *)counted_malloc(strlen(line) + 1))){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	strcpy(curr -> line, line);
+	strcpy(line_cpy, line); /* get_ast changes the line */
+	curr -> line_ast = get_ast(line_cpy);
+	count_line_words(&(curr -> line_ast), &(curr -> ic_words), &(curr -> dc_words));
+	curr -> hash = hash;
+	curr -> generation = session -> generation;
+	curr -> next = session -> memo[hash % AST_TABLE_SIZE];
+	session -> memo[hash % AST_TABLE_SIZE] = curr;
+	(session -> parsed_cnt)++;
+	(session -> memo_cnt)++;
+
+	return curr;
+
+}
+
+
+
+/*
+ *	Frees the memoized asts that were not used by the last update.
+ *
+ *	param session - Pointer to the session
+ */
+void sweep_memo_asts(asm_session *session){
+
+	int i;
+	ast_memo_node **curr_add, *temp;
+
+	for (i = 0; i < AST_TABLE_SIZE; i++){
+
+		curr_add = &(session -> memo[i]);
+
+		while (*curr_add != NULL){
+
+			if ((*curr_add) -> generation != session -> generation){ /* stale ast */
+				temp = *curr_add;
+				*curr_add = temp -> next;
+				free(temp -> line);
+				free(temp);
+				(session -> memo_cnt)--;
+			}
+			else
+				curr_add = &((*curr_add) -> next);
+		}
+	}
+
+}
+
+
+
+/*
+ *	Computes the hash of a line text (djb2).
+ *
+ *	param line - The line text
+ *	returns - The hash of the line
+ */
+unsigned long hash_line(char *line){
+
+	unsigned long hash = 5381;
+
+	while (*line)
+		hash = hash * 33 + (unsigned char)*line++;
+
+	return hash;
+
+}
+
+
+
+/*
+ *	Doubles the size of a dynamic array.
+ *
+ *	param arr - The array (NULL for a new array)
+ *	param size_add - Pointer to the number of cells in the array (updated)
+ *	param cell_size - The size of a cell in bytes
+ *	returns - Pointer to the enlarged array
+ */
+void *enlarge_array(void *arr, int *size_add, int cell_size){
+
+	*size_add = *size_add ? *size_add * 2 : SESSION_INIT_SIZE;
+
+	if (!(arr = counted_realloc(arr, (long)*size_add * cell_size))){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "Memory allocation failed - session");
+        exit(1);
+	}
+
+	return arr;
+
+}
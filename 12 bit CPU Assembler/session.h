@@ -0,0 +1,83 @@
+/*
+ *	File: session.h
+ *
+ *	Defines the data structures and function prototypes of an assembler session.
+ *	A session keeps an in memory source with its macro table, symbol table, the asts of its lines and the
+ *	addresses of its lines, and updates them after every edit without touching the file system. Since the
+ *	ast of a line depends only on the line text, the asts are memoized by text, so an edit parses only new
+ *	line texts. An edit of plain lines (no macro, no declaration and the same label definitions) of a source
+ *	that had no diagnostics is patched: the addresses after the edit are shifted and only the edited lines
+ *	and the lines that use a moved label are encoded again. Any other edit reassembles the whole source.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "macro_list.h"
+#include "labels_BST.h"
+#include "ast.h"
+#include "encoder.h"
+#include "snapshot.h"
+
+#define AST_TABLE_SIZE 4096 /* number of buckets in the memoized asts table */
+
+typedef struct ast_memo_node { /* memoized ast of a line text */
+	char *line; /* the line text (the key) */
+	unsigned long hash;
+	ast line_ast;
+	int ic_words; /* number of code words of the line */
+	int dc_words; /* number of data words of the line */
+	int generation; /* the last update that used the ast */
+	struct ast_memo_node *next;
+} ast_memo_node;
+
+typedef struct { /* an expanded line of the last update */
+	ast_memo_node *memo;
+	int ic; /* offset of the first code word of the line */
+	int dc; /* offset of the first data word of the line */
+} session_line;
+
+typedef struct { /* an edit of plain lines that is patched into the last update */
+	int line; /* index of the first replaced expanded line */
+	int old_cnt; /* number of replaced lines */
+	int new_cnt; /* number of new lines */
+	ast_memo_node **memos; /* the asts of the new lines */
+	int ic; /* offsets of the first replaced line */
+	int dc;
+	int old_ic; /* number of words of the replaced lines */
+	int old_dc;
+	int new_ic; /* number of words of the new lines */
+	int new_dc;
+} session_patch;
+
+typedef struct {
+	char name[MAX_BUFFER]; /* the source name (for error messages) */
+	char **src_lines; /* the source (.as) lines, each line ends with a new line */
+	int *src_expanded; /* number of expanded lines of every source line (0 for a macro definition line) */
+	int src_cnt;
+	int src_size; /* number of allocated cells */
+	macro_node *head_macro; /* the macro table of the last update */
+	macro_node *tail_macro;
+	ast_memo_node *memo[AST_TABLE_SIZE]; /* memoized asts by line text */
+	int memo_cnt; /* number of memoized asts */
+	session_line *lines; /* the expanded (.am) lines of the last update */
+	int lines_cnt;
+	int lines_size; /* number of allocated cells */
+	int generation; /* number of updates */
+	int parsed_cnt; /* number of lines parsed by the last update */
+	symbol_table_node *label_root;
+	extern_ref_vector ext_refs;
+	mem_code_word code_im[MAX_MEMORY_ASSUMPTION];
+	mem_data_word data_im[MAX_MEMORY_ASSUMPTION];
+	int ic;
+	int dc;
+	int is_valid; /* result of the last update */
+	int is_quiet; /* 1 if the last update was valid and reported no diagnostics (the next edit may be patched) */
+} asm_session;
+
+/* functions prototype */
+asm_session *create_session(char *);
+int edit_session(asm_session *, int, int, char *);
+void free_session(asm_session *);
+int assemble_stream(FILE *, FILE *, char *);
+int serve_session(FILE *, FILE *, char *);
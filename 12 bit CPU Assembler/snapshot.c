@@ -0,0 +1,800 @@
+/*
+ *	File: snapshot.c
+ *
+ *	This file implements the symbols snapshots (see snapshot.h). Exporting a snapshot expands the source
+ *	in memory, collects the names of its .extern declarations and builds a perfect hash of them (hash and
+ *	displace - the names of every bucket get a seed that puts them in free slots, so a lookup reads one
+ *	slot). Importing a snapshot maps it into memory for all the files after it, and the only state of a
+ *	file is the mark of the names that it declared as external.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for mmap, getpid and fmemopen in ansi mode */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "macro_list.h"
+#include "labels_BST.h"
+#include "ast.h"
+#include "snapshot.h"
+
+/* macro definitions */
+#define SEED_MIX 2654435761UL /* spreads the seeds over the offset basis */
+#define BUCKET_KEYS 4 /* average number of names in a bucket */
+#define MAX_SEED 65536 /* a bucket that finds no seed up to it enlarges the table */
+#define MAX_SEED_SLOTS 64 /* maximum number of names in a bucket */
+#define FIRST_NAMES_SIZE 64 /* initial size of the names array of an exported file */
+#define SYM_NAME_SIZE (MAX_BUFFER + MAX_LABEL_SIZE) /* the path with the extension and a process id */
+
+typedef struct { /* the imported snapshot */
+	char *base; /* the mapped file */
+	long size;
+	sym_header *header;
+	unsigned int *disp;
+	sym_slot *table;
+	char *strings;
+	int *externs; /* for every slot whose name the current file declared as external - its label sequence
+				     number + 1 (0 if it is not declared) */
+} sym_snapshot;
+
+typedef struct { /* a label of the table that the file has without the snapshot */
+	symbol_table_node *node; /* the label in the symbol table, NULL for an unused external of the snapshot */
+	char *name;
+	int seq; /* the order of its insertion without the snapshot */
+} plain_label;
+
+typedef struct { /* a bucket of names while the perfect hash is built */
+	unsigned int first; /* the index of its first name in the names array (grouped by bucket) */
+	unsigned int count;
+} sym_bucket;
+
+static sym_snapshot snapshot = {NULL, 0, NULL, NULL, NULL, NULL, NULL};
+static unsigned int build_buckets_num; /* the buckets number of the image that is built (for the comparator) */
+
+/* functions prototype */
+int pre_assemble_stream(FILE *, char *, macro_node **, macro_node **, char **, map_origin_vector *);
+
+/* exclusive functions prototype */
+int collect_extern_names(FILE *, char *, char ***, unsigned int *);
+char *build_symbols_image(char **, unsigned int *, unsigned long *);
+int place_symbols(char **, unsigned int, unsigned int, unsigned int, unsigned int *, sym_slot *);
+int write_symbols_snapshot(char *, char *, unsigned long);
+int is_sym_valid(char *, long);
+int compare_symbol_names(const void *, const void *);
+int compare_symbol_buckets(const void *, const void *);
+int compare_bucket_sizes(const void *, const void *);
+int collect_plain_labels(symbol_table_node *, plain_label *, int);
+int compare_plain_labels(const void *, const void *);
+unsigned int hash_symbol_name(const char *, unsigned int);
+
+
+
+/*
+ *	Exports the external labels of a source to a snapshot (<file>.sym). The source is expanded in memory
+ *	and only its .extern declarations are parsed, nothing is assembled.
+ *
+ *	param file_name - The name of the source file without extension.
+ *	returns 1 if the snapshot was written, 0 otherwise.
+ */
+int export_symbols_snapshot(char *file_name){
+
+	FILE *src;
+	char src_name[MAX_BUFFER], am_name[MAX_BUFFER], sym_name[MAX_BUFFER], *draft, **names = NULL, *image;
+	unsigned int names_num = 0;
+	unsigned long size;
+	int is_valid;
+	macro_node *head_macro = NULL, *tail_macro = NULL;
+
+	sprintf(src_name, "%s.as", file_name);
+	sprintf(am_name, "%s.am", file_name); /* the errors refer to the expanded lines like in a build */
+	sprintf(sym_name, "%s%s", file_name, SYM_EXT);
+
+	if (!(src = fopen(src_name, "r"))){
+
+		errprintf(src_name, NO_LINE_ERROR, "cannot open file - pre assembler");
+		return 0;
+	}
+
+	is_valid = pre_assemble_stream(src, src_name, &head_macro, &tail_macro, &draft, NULL);
+	fclose(src);
+
+	if (head_macro != NULL)
+		free_macro_list(&head_macro);
+
+	if (!is_valid){
+		free(draft);
+		return 0;
+	}
+
+	/* fmemopen does not accept an empty buffer - an empty source has no names */
+	if (*draft != '\0'){
+
+		if (!(src = fmemopen(draft, strlen(draft), "r"))){
+			errprintf(am_name, NO_LINE_ERROR, "cannot open the expanded source - export symbols");
+			free(draft);
+			return 0;
+		}
+
+		is_valid = collect_extern_names(src, am_name, &names, &names_num);
+		fclose(src);
+	}
+
+	free(draft);
+
+	if (is_valid){
+
+		image = build_symbols_image(names, &names_num, &size);
+
+		if (!(is_valid = write_symbols_snapshot(sym_name, image, size)))
+			errprintf(sym_name, NO_LINE_ERROR, "cannot write the symbols snapshot");
+
+		free(image);
+	}
+
+	while (names_num > 0)
+		free(names[--names_num]);
+	free(names);
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Imports a snapshot for the files that come after it (a snapshot that was imported before is closed).
+ *
+ *	param path - The .sym file.
+ *	returns 1 if the snapshot was imported, 0 otherwise (the files are assembled without a snapshot).
+ */
+int import_symbols_snapshot(char *path){
+
+	struct stat st;
+	void *base;
+	int fd;
+
+	close_symbols_snapshot();
+
+	if ((fd = open(path, O_RDONLY)) < 0){
+		errprintf(path, NO_LINE_ERROR, "cannot open file - import symbols");
+		return 0;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < (long)sizeof(sym_header) ||
+		(base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+		errprintf(path, NO_LINE_ERROR, "the file is not a symbols snapshot - import symbols");
+		close(fd);
+		return 0;
+	}
+
+	close(fd); /* the mapping stays valid */
+
+	if (!is_sym_valid((char *)base, st.st_size)){
+		errprintf(path, NO_LINE_ERROR, "the file is not a symbols snapshot - import symbols");
+		munmap(base, st.st_size);
+		return 0;
+	}
+
+	snapshot.base = (char *)base;
+	snapshot.size = st.st_size;
+	snapshot.header = (sym_header *)snapshot.base;
+	snapshot.disp = (unsigned int *)(snapshot.base + snapshot.header -> disp_offset);
+	snapshot.table = (sym_slot *)(snapshot.base + snapshot.header -> table_offset);
+	snapshot.strings = snapshot.base + snapshot.header -> strings_offset;
+
+	if ((snapshot.externs = (int *)counted_calloc(snapshot.header -> table_size, sizeof(int))) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+		exit(1);
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Unmaps the imported snapshot (if there is one).
+ */
+void close_symbols_snapshot(void){
+
+	if (snapshot.base == NULL)
+		return;
+
+	munmap(snapshot.base, snapshot.size);
+	free(snapshot.externs);
+	snapshot.base = NULL;
+	snapshot.externs = NULL;
+
+}
+
+
+
+/*
+ *	Finds a name in the imported snapshot.
+ *
+ *	param label - The name.
+ *	returns the slot of the name, NO_SLOT if it is not in the snapshot (or there is no snapshot).
+ */
+int find_snapshot_label(char *label){
+
+	unsigned int hash, slot;
+
+	if (snapshot.base == NULL)
+		return NO_SLOT;
+
+	hash = hash_symbol_name(label, 0);
+	slot = hash_symbol_name(label, snapshot.disp[hash % snapshot.header -> buckets_num]) %
+		   snapshot.header -> table_size;
+
+	if (snapshot.table[slot].name != 0 && snapshot.table[slot].hash == hash &&
+		strcmp(snapshot.strings + snapshot.table[slot].name, label) == 0)
+		return (int)slot;
+
+	return NO_SLOT;
+
+}
+
+
+
+/*
+ *	Declares a label as external in the current file if it is in the snapshot (instead of inserting it
+ *	to the symbol table).
+ *
+ *	param label - The label of the .extern declaration.
+ *	returns 1 if the label is in the snapshot, 0 if it should be inserted to the symbol table.
+ */
+int declare_snapshot_extern(char *label){
+
+	int slot = find_snapshot_label(label);
+
+	if (slot == NO_SLOT)
+		return 0;
+
+	if (!snapshot.externs[slot]) /* the first declaration inserts the label without the snapshot */
+		snapshot.externs[slot] = next_label_seq() + 1;
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks if the current file declared a label of the snapshot as external.
+ *
+ *	param label - The label.
+ *	returns 1 if the label is a declared external of the snapshot, 0 otherwise.
+ */
+int is_snapshot_extern(char *label){
+
+	int slot = find_snapshot_label(label);
+
+	return slot != NO_SLOT && snapshot.externs[slot] != 0;
+
+}
+
+
+
+/*
+ *	Clears the external declarations of the previous file (called before the first run of a file).
+ */
+void reset_snapshot_externs(void){
+
+	if (snapshot.base != NULL)
+		memset(snapshot.externs, 0, sizeof(int) * snapshot.header -> table_size);
+
+}
+
+
+
+/*
+ *	Makes the used labels that the file declared as externals of the snapshot external labels of the
+ *	symbol table (called at the end of the first run). They were inserted by their first use, so their
+ *	value is the first use address, and the encoder logs their references like any external label.
+ *
+ *	param root - Pointer to the root of the symbol table or its sub-tree.
+ */
+void resolve_snapshot_externs(symbol_table_node *root){
+
+	if (root == NULL || snapshot.base == NULL)
+		return;
+
+	if (root -> type == enum_type_none && is_snapshot_extern(root -> label))
+		update_label_type(root, enum_extl);
+
+	resolve_snapshot_externs(root -> left);
+	resolve_snapshot_externs(root -> right);
+
+}
+
+
+
+/*
+ *	Rebuilds the symbol table that the current file has without the snapshot, so the outputs are written
+ *	in the same order (the .ent and .ext files follow the post order of the table). The labels are inserted
+ *	in the order of their creation, and a declared external of the snapshot in the order of its declaration
+ *	(the .extern line inserts it without the snapshot), so the new table has the same shape.
+ *
+ *	param root - Pointer to the root of the symbol table.
+ *	param ext_refs - Pointer to the external references log.
+ *	param plain_refs - Pointer to an empty log to store the references to the labels of the new table.
+ *	returns the new table, NULL if there is no snapshot (the outputs are written from the table itself).
+ */
+symbol_table_node *build_plain_symbol_table(symbol_table_node *root, extern_ref_vector *ext_refs,
+											extern_ref_vector *plain_refs){
+
+	symbol_table_node *plain_root = NULL;
+	plain_label *labels;
+	unsigned int slot;
+	int i, cnt, unused_cnt = 0;
+
+	if (snapshot.base == NULL)
+		return NULL;
+
+	for (slot = 0; slot < snapshot.header -> table_size; slot++)
+		if (snapshot.externs[slot] && search_label(root, snapshot.strings + snapshot.table[slot].name) == NULL)
+			unused_cnt++;
+
+	labels = (plain_label *)counted_malloc(sizeof(plain_label) * (collect_plain_labels(root, NULL, 0) + unused_cnt + 1));
+
+	if (labels == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+		exit(1);
+	}
+
+	cnt = collect_plain_labels(root, labels, 0);
+
+	/* the declared externals of the snapshot that are not used */
+	for (slot = 0; slot < snapshot.header -> table_size; slot++){
+		if (snapshot.externs[slot] && search_label(root, snapshot.strings + snapshot.table[slot].name) == NULL){
+			labels[cnt].node = NULL;
+			labels[cnt].name = snapshot.strings + snapshot.table[slot].name;
+			labels[cnt++].seq = snapshot.externs[slot] - 1;
+		}
+	}
+
+	qsort(labels, cnt, sizeof(plain_label), compare_plain_labels);
+
+	for (i = 0; i < cnt; i++){
+		if (labels[i].node != NULL)
+			plain_root = insert_label(plain_root, labels[i].name, labels[i].node -> value, labels[i].node -> type,
+									  labels[i].node -> comm);
+		else
+			plain_root = insert_label(plain_root, labels[i].name, NO_VALUE, enum_extl, enum_comm_none);
+	}
+
+	for (i = 0; i < ext_refs -> count; i++)
+		insert_extern_ref(plain_refs, search_label(plain_root, ext_refs -> refs[i].label -> label),
+						  ext_refs -> refs[i].address);
+
+	free(labels);
+	return plain_root;
+
+}
+
+
+
+/*
+ *	Collects the labels of the symbol table with the order of their insertion without the snapshot
+ *	(a used external of the snapshot was inserted by its .extern declaration).
+ *
+ *	param root - Pointer to the root of the symbol table or its sub-tree.
+ *	param labels - The array to fill (NULL to count the labels only).
+ *	param cnt - The number of labels that are already collected.
+ *	returns the number of labels that are collected.
+ */
+int collect_plain_labels(symbol_table_node *root, plain_label *labels, int cnt){
+
+	int slot;
+
+	if (root == NULL)
+		return cnt;
+
+	if (labels != NULL){
+		labels[cnt].node = root;
+		labels[cnt].name = root -> label;
+		labels[cnt].seq = root -> seq;
+
+		if ((slot = find_snapshot_label(root -> label)) != NO_SLOT && snapshot.externs[slot] &&
+			snapshot.externs[slot] - 1 < root -> seq)
+			labels[cnt].seq = snapshot.externs[slot] - 1;
+	}
+
+	cnt = collect_plain_labels(root -> left, labels, cnt + 1);
+	return collect_plain_labels(root -> right, labels, cnt);
+
+}
+
+
+
+/*
+ *	Compares two labels by the order of their insertion (qsort comparator).
+ *
+ *	param a - Pointer to the first label.
+ *	param b - Pointer to the second label.
+ *	returns negative, zero or positive number according to the order of the labels.
+ */
+int compare_plain_labels(const void *a, const void *b){
+
+	return ((const plain_label *)a) -> seq - ((const plain_label *)b) -> seq;
+
+}
+
+
+
+/*
+ *	Collects the names of the .extern declarations of an expanded source.
+ *
+ *	param src - The expanded source.
+ *	param src_name - The name of the expanded source (for error messages).
+ *	param names_add - Pointer to the names array (allocated names, it is enlarged if needed).
+ *	param names_num - Pointer to the number of names.
+ *	returns 1 if every declaration is valid, 0 otherwise.
+ */
+int collect_extern_names(FILE *src, char *src_name, char ***names_add, unsigned int *names_num){
+
+	char line[MAX_BUFFER];
+	unsigned int size = 0;
+	int line_num = 0, is_valid = 1, i;
+	ast line_ast;
+
+	while (fgets(line, MAX_BUFFER, src) != NULL){
+
+		line_num++;
+
+		/* only the lines that may be an extern declaration are parsed */
+		if (strstr(line, ".extern") == NULL)
+			continue;
+
+		line_ast = get_ast(line);
+
+		if (line_ast.ast_union_option == ast_union_error){
+			errprintf(src_name, line_num, "%s", line_ast.ast_error);
+			is_valid = 0;
+			continue;
+		}
+
+		if (line_ast.ast_union_option != ast_union_dir ||
+			line_ast.ast_union_ins_dir.ast_dir.ast_union_dir_option != ast_union_dir_extern)
+			continue;
+
+		for (i = 0; i < line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels_count; i++){
+
+			if (*names_num == size){
+				size = size ? size * 2 : FIRST_NAMES_SIZE;
+				if ((*names_add = (char **)counted_realloc(*names_add, sizeof(char *) * size)) == NULL){
+					errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+					exit(1);
+				}
+			}
+
+			if (((*names_add)[*names_num] = (char *)counted_malloc(MAX_LABEL_SIZE)) == NULL){
+				errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+				exit(1);
+			}
+
+			strcpy((*names_add)[(*names_num)++], line_ast.ast_union_ins_dir.ast_dir.dir.extern_labels_array.labels[i]);
+		}
+	}
+
+	return is_valid;
+
+}
+
+
+
+/*
+ *	Builds the image of a snapshot from its names.
+ *
+ *	param names - The names (they are grouped by bucket and the repeated ones are freed).
+ *	param names_num_add - Pointer to the number of names (the number of different names is stored).
+ *	param size_add - Pointer to store the size of the image.
+ *	returns the image (allocated).
+ */
+char *build_symbols_image(char **names, unsigned int *names_num_add, unsigned long *size_add){
+
+	sym_header *header;
+	char *image;
+	unsigned int i, j, names_num = *names_num_add, buckets_num, table_size, strings_size = 1, *disp;
+	sym_slot *table;
+
+	/* a name that is declared twice is stored once */
+	if (names_num > 1)
+		qsort(names, names_num, sizeof(char *), compare_symbol_names);
+	for (i = 0, j = 0; i < names_num; i++){
+		if (j > 0 && strcmp(names[j - 1], names[i]) == 0)
+			free(names[i]);
+		else
+			names[j++] = names[i];
+	}
+	*names_num_add = names_num = j;
+
+	for (i = 0; i < names_num; i++)
+		strings_size += strlen(names[i]) + 1;
+
+	buckets_num = names_num / BUCKET_KEYS + 1;
+	table_size = names_num + names_num / BUCKET_KEYS + 1; /* at most 80 percent of the slots are used */
+
+	/* groups the names by bucket */
+	build_buckets_num = buckets_num;
+	if (names_num > 1)
+		qsort(names, names_num, sizeof(char *), compare_symbol_buckets);
+
+	disp = (unsigned int *)counted_malloc(sizeof(unsigned int) * buckets_num);
+	table = (sym_slot *)counted_malloc(sizeof(sym_slot) * table_size);
+
+	if (!disp || !table){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+		exit(1);
+	}
+
+	/* a bucket without a seed enlarges the table (rare with 80 percent of the slots) */
+	while (!place_symbols(names, names_num, buckets_num, table_size, disp, table)){
+
+		table_size *= 2;
+		if ((table = (sym_slot *)counted_realloc(table, sizeof(sym_slot) * table_size)) == NULL){
+			errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+			exit(1);
+		}
+	}
+
+	*size_add = sizeof(sym_header) + sizeof(unsigned int) * buckets_num + sizeof(sym_slot) * table_size + strings_size;
+
+	if ((image = (char *)counted_calloc(*size_add, 1)) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+		exit(1);
+	}
+
+	header = (sym_header *)image;
+	memcpy(header -> magic, SYM_MAGIC, sizeof(SYM_MAGIC));
+	header -> byte_order = SYM_BYTE_ORDER;
+	header -> version = SYM_VERSION;
+	header -> symbols_num = names_num;
+	header -> buckets_num = buckets_num;
+	header -> table_size = table_size;
+	header -> disp_offset = sizeof(sym_header);
+	header -> table_offset = header -> disp_offset + sizeof(unsigned int) * buckets_num;
+	header -> strings_offset = header -> table_offset + sizeof(sym_slot) * table_size;
+	header -> strings_size = strings_size;
+
+	memcpy(image + header -> disp_offset, disp, sizeof(unsigned int) * buckets_num);
+
+	/* the names are stored by their slots (offset 0 is the empty name) */
+	for (i = 0, j = 1; i < table_size; i++){
+
+		if (table[i].name == 0)
+			continue;
+
+		strcpy(image + header -> strings_offset + j, names[table[i].name - 1]);
+		table[i].name = j;
+		j += strlen(image + header -> strings_offset + j) + 1;
+	}
+
+	memcpy(image + header -> table_offset, table, sizeof(sym_slot) * table_size);
+
+	free(disp);
+	free(table);
+
+	return image;
+
+}
+
+
+
+/*
+ *	Places the names in the slots of the table - the buckets are placed from the largest, and every
+ *	bucket gets the first seed that puts all of its names in free slots.
+ *
+ *	param names - The names, grouped by bucket.
+ *	param names_num - Number of names.
+ *	param buckets_num - Number of buckets.
+ *	param table_size - Number of slots.
+ *	param disp - Array to store the seed of every bucket.
+ *	param table - The slots (the name of a used slot is the index of the name + 1).
+ *	returns 1 if every bucket got a seed, 0 otherwise.
+ */
+int place_symbols(char **names, unsigned int names_num, unsigned int buckets_num, unsigned int table_size,
+				  unsigned int *disp, sym_slot *table){
+
+	sym_bucket *buckets;
+	unsigned int i, j, k, cnt = 0, seed, slots[MAX_SEED_SLOTS];
+	int is_placed = 1;
+
+	if ((buckets = (sym_bucket *)counted_malloc(sizeof(sym_bucket) * buckets_num)) == NULL){
+		errprintf(NO_FILE_ERROR, NO_LINE_ERROR, "memory allocation failed - symbols snapshot");
+		exit(1);
+	}
+
+	for (i = 0; i < names_num; i = j){
+
+		k = hash_symbol_name(names[i], 0) % buckets_num;
+		for (j = i + 1; j < names_num && hash_symbol_name(names[j], 0) % buckets_num == k; j++)
+			;
+
+		buckets[cnt].first = i;
+		buckets[cnt++].count = j - i;
+	}
+
+	qsort(buckets, cnt, sizeof(sym_bucket), compare_bucket_sizes);
+
+	memset(disp, 0, sizeof(unsigned int) * buckets_num);
+	memset(table, 0, sizeof(sym_slot) * table_size);
+
+	for (i = 0; is_placed && i < cnt; i++){
+
+		/* a bucket that is too large for the slots buffer fails like a bucket without a seed */
+		for (seed = 1, is_placed = 0; !is_placed && buckets[i].count <= MAX_SEED_SLOTS && seed < MAX_SEED; seed++){
+
+			for (j = 0, is_placed = 1; is_placed && j < buckets[i].count; j++){
+
+				slots[j] = hash_symbol_name(names[buckets[i].first + j], seed) % table_size;
+				is_placed = table[slots[j]].name == 0;
+
+				for (k = 0; is_placed && k < j; k++)
+					is_placed = slots[k] != slots[j];
+			}
+		}
+
+		if (!is_placed)
+			break;
+
+		disp[hash_symbol_name(names[buckets[i].first], 0) % buckets_num] = seed - 1;
+
+		for (j = 0; j < buckets[i].count; j++){
+			table[slots[j]].hash = hash_symbol_name(names[buckets[i].first + j], 0);
+			table[slots[j]].name = buckets[i].first + j + 1;
+		}
+	}
+
+	free(buckets);
+
+	return is_placed;
+
+}
+
+
+
+/*
+ *	Writes the image of a snapshot to its file. The image is written to a temporary file which is then
+ *	renamed, so another invocation never maps a partly written file.
+ *
+ *	param sym_name - The name of the .sym file.
+ *	param image - The image.
+ *	param size - The size of the image.
+ *	returns 1 if the file was written, 0 otherwise.
+ */
+int write_symbols_snapshot(char *sym_name, char *image, unsigned long size){
+
+	FILE *des;
+	char temp_name[SYM_NAME_SIZE];
+	int is_written;
+
+	sprintf(temp_name, "%s.%ld", sym_name, (long)getpid());
+
+	if (!(des = fopen(temp_name, "wb")))
+		return 0;
+
+	is_written = fwrite(image, 1, size, des) == size;
+	is_written = fclose(des) == 0 && is_written;
+
+	if (!is_written || rename(temp_name, sym_name) != 0){
+		remove(temp_name);
+		return 0;
+	}
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks that a mapped file is a snapshot and that its sections are in the file.
+ *
+ *	param base - The mapped file.
+ *	param size - The size of the file.
+ *	returns 1 if the file is valid, 0 otherwise.
+ */
+int is_sym_valid(char *base, long size){
+
+	sym_header *header = (sym_header *)base;
+	sym_slot *table;
+	unsigned int i;
+
+	if (memcmp(header -> magic, SYM_MAGIC, sizeof(SYM_MAGIC)) != 0 || header -> byte_order != SYM_BYTE_ORDER ||
+		header -> version != SYM_VERSION || header -> buckets_num == 0 || header -> table_size == 0 ||
+		header -> symbols_num > header -> table_size || header -> disp_offset != sizeof(sym_header) ||
+		header -> buckets_num > (unsigned long)(size - header -> disp_offset) / sizeof(unsigned int) ||
+		header -> table_offset != header -> disp_offset + header -> buckets_num * sizeof(unsigned int) ||
+		header -> table_size > (unsigned long)(size - header -> table_offset) / sizeof(sym_slot) ||
+		header -> strings_offset != header -> table_offset + header -> table_size * sizeof(sym_slot) ||
+		header -> strings_size == 0 || header -> strings_size > (unsigned long)(size - header -> strings_offset) ||
+		base[header -> strings_offset + header -> strings_size - 1] != '\0')
+		return 0;
+
+	/* every name starts in the string table, which ends with a null, and is a label */
+	table = (sym_slot *)(base + header -> table_offset);
+	for (i = 0; i < header -> table_size; i++)
+		if (table[i].name >= header -> strings_size ||
+			strlen(base + header -> strings_offset + table[i].name) >= MAX_LABEL_SIZE)
+			return 0;
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Compares two names (qsort comparator).
+ *
+ *	param a - Pointer to the first name.
+ *	param b - Pointer to the second name.
+ *	returns negative, zero or positive number according to the order of the names.
+ */
+int compare_symbol_names(const void *a, const void *b){
+
+	return strcmp(*(char * const *)a, *(char * const *)b);
+
+}
+
+
+
+/*
+ *	Compares two names by their buckets and then by their text (qsort comparator).
+ *
+ *	param a - Pointer to the first name.
+ *	param b - Pointer to the second name.
+ *	returns negative, zero or positive number according to the order of the names.
+ */
+int compare_symbol_buckets(const void *a, const void *b){
+
+	unsigned int bucket_a = hash_symbol_name(*(char * const *)a, 0) % build_buckets_num,
+				 bucket_b = hash_symbol_name(*(char * const *)b, 0) % build_buckets_num;
+
+	if (bucket_a != bucket_b)
+		return bucket_a < bucket_b ? -1 : 1;
+
+	return compare_symbol_names(a, b);
+
+}
+
+
+
+/*
+ *	Compares two buckets by their sizes - the larger first (qsort comparator).
+ *
+ *	param a - Pointer to the first bucket.
+ *	param b - Pointer to the second bucket.
+ *	returns negative, zero or positive number according to the order of the buckets.
+ */
+int compare_bucket_sizes(const void *a, const void *b){
+
+	const sym_bucket *bucket_a = (const sym_bucket *)a, *bucket_b = (const sym_bucket *)b;
+
+	if (bucket_a -> count != bucket_b -> count)
+		return bucket_a -> count > bucket_b -> count ? -1 : 1;
+
+	return bucket_a -> first < bucket_b -> first ? -1 : bucket_a -> first > bucket_b -> first;
+
+}
+
+
+
+/*
+ *	Computes the 32 bit FNV-1a hash of a name with a seed (seed 0 is the plain FNV-1a hash).
+ *
+ *	param name - The name.
+ *	param seed - The seed.
+ *	returns the hash.
+ */
+unsigned int hash_symbol_name(const char *name, unsigned int seed){
+
+	return (unsigned int)hash_string((FNV_OFFSET ^ (seed * SEED_MIX)) & HASH_MASK, name);
+
+}
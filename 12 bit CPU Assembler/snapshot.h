@@ -0,0 +1,55 @@
+/*
+ *	File: snapshot.h
+ *
+ *	Defines the symbols snapshot format (.sym) and the function prototypes of the snapshot layer.
+ *	A snapshot holds the names of a common set of external labels (the .extern declarations of the file
+ *	it was exported from, --export-symbols option):
+ *		header (sym_header)
+ *		displacements - the seed of every bucket of the perfect hash
+ *		slots - a sym_slot for every cell (a name is in the cell that the seed of its bucket gives)
+ *		string table - the null terminated names
+ *	The snapshot that is imported (--import-symbols option) is mapped into memory, it is not changed and
+ *	it lies under the symbol table of every file: an .extern declaration of a name in the snapshot only
+ *	marks its slot and does not insert a label to the symbol table, so the table holds only the labels
+ *	of the file. The errors and the outputs are the same as without the snapshot (the .ent and .ext files
+ *	are written from the table that the file has without it, see build_plain_symbol_table).
+ *	labels_BST.h must be included before.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define SYM_MAGIC "SYM" /* the first bytes of a .sym file (with a null) */
+#define SYM_VERSION 1
+#define SYM_BYTE_ORDER 0x01020304 /* reads differently on a machine of another byte order */
+#define SYM_EXT ".sym"
+#define NO_SLOT -1 /* the name is not in the snapshot */
+
+typedef struct {
+	char magic[4];
+	unsigned int byte_order;
+	unsigned int version;
+	unsigned int symbols_num;
+	unsigned int buckets_num;
+	unsigned int table_size; /* number of slots */
+	unsigned int disp_offset; /* the offsets are in bytes from the start of the file */
+	unsigned int table_offset;
+	unsigned int strings_offset;
+	unsigned int strings_size;
+} sym_header;
+
+typedef struct {
+	unsigned int hash; /* the hash of the name (seed 0) */
+	unsigned int name; /* offset of the name in the string table, 0 for an empty slot */
+} sym_slot;
+
+/* functions prototype */
+int export_symbols_snapshot(char *);
+int import_symbols_snapshot(char *);
+void close_symbols_snapshot(void);
+int find_snapshot_label(char *);
+int declare_snapshot_extern(char *);
+int is_snapshot_extern(char *);
+void reset_snapshot_externs(void);
+void resolve_snapshot_externs(symbol_table_node *);
+symbol_table_node *build_plain_symbol_table(symbol_table_node *, extern_ref_vector *, extern_ref_vector *);
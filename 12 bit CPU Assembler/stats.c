@@ -0,0 +1,290 @@
+/*
+ *	File: stats.c
+ *
+ *	This file implements the assembly statistics (--stats option).
+ *	The phases of the current file are timed by the trace clock (and traced if --trace is on), the modules
+ *	add their counters while they run and the allocations are counted by the counted allocation functions.
+ *	The statistics are printed after every file to stdout as text, or as one JSON object per line.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "stats.h"
+#include "trace.h"
+
+/* macro definitions */
+#define US_IN_MS 1000.0 /* microseconds in a millisecond */
+#define MS_IN_SEC 1000.0 /* milliseconds in a second */
+#define BYTES_IN_MB 1000000.0 /* bytes in a MB */
+
+/* names of the phases, counters and output files (in the order of their enums) */
+const char *PHASE_NAMES[] = {"pre_assembler", "first_run", "second_run", "export"};
+const char *COUNTER_NAMES[] = {"source_lines", "lines", "macros_expanded", "source_bytes", "symbols",
+							   "symbol_max_depth", "symbol_depth_sum"};
+const char *STAT_OUTPUTS_EXT[] = {".am", ".ob", ".ent", ".ext"};
+
+static asm_stats curr_stats; /* statistics of the current file */
+static asm_stats total_stats; /* sums of the statistics of all the files (for the summary) */
+static long files_cnt = 0, total_allocs = 0, total_alloc_bytes = 0;
+
+/* exclusive functions prototype */
+long get_output_size(char *, int);
+void add_to_summary(long, long);
+double get_rate(double, double);
+
+
+
+/*
+ *	Resets the statistics for a new file.
+ */
+void reset_stats(void){
+
+	memset(&curr_stats, 0, sizeof(asm_stats));
+	get_alloc_counters(&(curr_stats.alloc_cnt_start), &(curr_stats.alloc_bytes_start));
+
+}
+
+
+
+/*
+ *	Starts timing a phase.
+ *
+ *	param phase - The phase.
+ */
+void start_phase(enum asm_phase phase){
+
+	curr_stats.phase_start[phase] = trace_clock() / US_IN_MS;
+
+}
+
+
+
+/*
+ *	Ends timing a phase (the time is added to the phase time and the phase is traced).
+ *
+ *	param phase - The phase.
+ */
+void end_phase(enum asm_phase phase){
+
+	double end = trace_clock() / US_IN_MS;
+
+	curr_stats.phase_ms[phase] += end - curr_stats.phase_start[phase];
+	trace_span(PHASE_NAMES[phase], "phase", curr_stats.phase_start[phase] * US_IN_MS, end * US_IN_MS,
+			   TRACE_MAIN_TID);
+
+}
+
+
+
+/*
+ *	Adds a value to a counter of the current file.
+ *
+ *	param counter - The counter.
+ *	param value - The value to add.
+ */
+void add_stat_counter(enum stat_counter counter, long value){
+
+	curr_stats.counters[counter] += value;
+
+}
+
+
+
+/*
+ *	Sets the result of the current file.
+ *
+ *	param is_cached - 1 if the outputs were restored from the cache, 0 otherwise.
+ *	param outputs - Flags of the written output files (bit i is set if STAT_OUTPUTS_EXT[i] was written).
+ */
+void set_stats_result(int is_cached, int outputs){
+
+	curr_stats.is_cached = is_cached;
+	curr_stats.outputs = outputs;
+
+}
+
+
+
+/*
+ *	Prints the statistics of the current file to stdout and adds them to the summary.
+ *
+ *	param file_name - The name of the file without extension.
+ *	param format - stats_text for a readable report, stats_json for one JSON object in one line,
+ *				   stats_summary to only add them to the summary.
+ */
+void print_stats(char *file_name, enum stats_format format){
+
+	int i;
+	long alloc_cnt, alloc_bytes, symbols = curr_stats.counters[stat_symbols];
+	double total_ms = 0, avg_depth = symbols ? (double)curr_stats.counters[stat_symbol_depth_sum] / symbols : 0;
+
+	get_alloc_counters(&alloc_cnt, &alloc_bytes);
+	alloc_cnt -= curr_stats.alloc_cnt_start;
+	alloc_bytes -= curr_stats.alloc_bytes_start;
+
+	for (i = 0; i < PHASES_NUM; i++)
+		total_ms += curr_stats.phase_ms[i];
+
+	add_to_summary(alloc_cnt, alloc_bytes);
+
+	if (format == stats_summary)
+		return;
+
+	if (format == stats_json){
+
+		printf("{\"file\":");
+		print_json_string(stdout, file_name);
+		printf(",\"cached\":%d,\"valid\":%d,\"time_ms\":{", curr_stats.is_cached,
+				(curr_stats.outputs & OB_OUTPUT) != 0);
+		for (i = 0; i < PHASES_NUM; i++)
+			printf("\"%s\":%.3f,", PHASE_NAMES[i], curr_stats.phase_ms[i]);
+		printf("\"total\":%.3f}", total_ms);
+		for (i = 0; i < stat_counters_num; i++)
+			if (i != stat_symbol_depth_sum)
+				printf(",\"%s\":%ld", COUNTER_NAMES[i], curr_stats.counters[i]);
+		printf(",\"symbol_avg_depth\":%.2f,\"allocations\":%ld,\"requested_bytes\":%ld,\"output_bytes\":{",
+				avg_depth, alloc_cnt, alloc_bytes);
+		for (i = 0; i < STAT_OUTPUTS_NUM; i++)
+			printf("%s\"%s\":%ld", i ? "," : "", STAT_OUTPUTS_EXT[i] + 1, get_output_size(file_name, i));
+		printf("}}\n");
+		return;
+	}
+
+	printf("stats '%s'%s:\n", file_name, curr_stats.is_cached ? " (restored from cache)" : "");
+	for (i = 0; i < PHASES_NUM; i++)
+		printf("  %-16s %10.3f ms\n", PHASE_NAMES[i], curr_stats.phase_ms[i]);
+	printf("  %-16s %10.3f ms\n", "total", total_ms);
+	printf("  lines: %ld source (%ld bytes), %ld expanded, %ld macro expansions\n",
+			curr_stats.counters[stat_source_lines], curr_stats.counters[stat_source_bytes],
+			curr_stats.counters[stat_lines], curr_stats.counters[stat_macros_expanded]);
+	printf("  symbols: %ld, max depth %ld, average depth %.2f\n", symbols,
+			curr_stats.counters[stat_symbol_max_depth], avg_depth);
+	printf("  allocations: %ld (%ld bytes requested)\n", alloc_cnt, alloc_bytes);
+	printf("  output bytes:");
+	for (i = 0; i < STAT_OUTPUTS_NUM; i++)
+		printf(" %s %ld", STAT_OUTPUTS_EXT[i], get_output_size(file_name, i));
+	printf("\n");
+
+}
+
+
+
+/*
+ *	Prints the summary of all the files to stdout - the total time and the throughput of every phase.
+ *
+ *	param format - stats_json for one JSON object in one line, otherwise a readable report.
+ */
+void print_stats_summary(enum stats_format format){
+
+	int i;
+	long lines = total_stats.counters[stat_source_lines], bytes = total_stats.counters[stat_source_bytes];
+	double total_ms = 0;
+
+	for (i = 0; i < PHASES_NUM; i++)
+		total_ms += total_stats.phase_ms[i];
+
+	if (format == stats_json){
+
+		printf("{\"summary\":{\"files\":%ld,\"source_lines\":%ld,\"source_bytes\":%ld,\"phases\":{",
+				files_cnt, lines, bytes);
+		for (i = 0; i < PHASES_NUM; i++)
+			printf("\"%s\":{\"time_ms\":%.3f,\"lines_per_sec\":%.0f,\"mb_per_sec\":%.3f},", PHASE_NAMES[i],
+					total_stats.phase_ms[i], get_rate(lines, total_stats.phase_ms[i]),
+					get_rate(bytes / BYTES_IN_MB, total_stats.phase_ms[i]));
+		printf("\"total\":{\"time_ms\":%.3f,\"lines_per_sec\":%.0f,\"mb_per_sec\":%.3f}},", total_ms,
+				get_rate(lines, total_ms), get_rate(bytes / BYTES_IN_MB, total_ms));
+		printf("\"macros_expanded\":%ld,\"symbols\":%ld,\"allocations\":%ld,\"requested_bytes\":%ld}}\n",
+				total_stats.counters[stat_macros_expanded], total_stats.counters[stat_symbols], total_allocs,
+				total_alloc_bytes);
+		return;
+	}
+
+	printf("summary: %ld files, %ld source lines (%ld bytes)\n", files_cnt, lines, bytes);
+	printf("  %-16s %12s %14s %10s\n", "phase", "time (ms)", "lines/sec", "MB/sec");
+	for (i = 0; i < PHASES_NUM; i++)
+		printf("  %-16s %12.3f %14.0f %10.3f\n", PHASE_NAMES[i], total_stats.phase_ms[i],
+				get_rate(lines, total_stats.phase_ms[i]), get_rate(bytes / BYTES_IN_MB, total_stats.phase_ms[i]));
+	printf("  %-16s %12.3f %14.0f %10.3f\n", "total", total_ms, get_rate(lines, total_ms),
+			get_rate(bytes / BYTES_IN_MB, total_ms));
+	printf("  %ld macro expansions, %ld symbols, %ld allocations (%ld bytes requested)\n",
+			total_stats.counters[stat_macros_expanded], total_stats.counters[stat_symbols], total_allocs,
+			total_alloc_bytes);
+
+}
+
+
+
+/*
+ *	Adds the statistics of the current file to the summary.
+ *
+ *	param alloc_cnt - The number of allocations of the current file.
+ *	param alloc_bytes - The number of bytes the current file requested.
+ */
+void add_to_summary(long alloc_cnt, long alloc_bytes){
+
+	int i;
+
+	for (i = 0; i < PHASES_NUM; i++)
+		total_stats.phase_ms[i] += curr_stats.phase_ms[i];
+
+	for (i = 0; i < stat_counters_num; i++){
+		if (i == stat_symbol_max_depth){
+			if (curr_stats.counters[i] > total_stats.counters[i])
+				total_stats.counters[i] = curr_stats.counters[i];
+		}
+		else
+			total_stats.counters[i] += curr_stats.counters[i];
+	}
+
+	files_cnt++;
+	total_allocs += alloc_cnt;
+	total_alloc_bytes += alloc_bytes;
+
+}
+
+
+
+/*
+ *	Computes a rate per second.
+ *
+ *	param amount - The amount of work.
+ *	param ms - The time of the work in milliseconds.
+ *	returns the amount per second, or 0 if the time is 0.
+ */
+double get_rate(double amount, double ms){
+
+	return ms > 0 ? amount * MS_IN_SEC / ms : 0;
+
+}
+
+
+
+/*
+ *	Gets the size of an output file.
+ *
+ *	param file_name - The name of the file without extension.
+ *	param idx - The index of the output file in STAT_OUTPUTS_EXT.
+ *	returns the size of the file in bytes, or 0 if the file was not written.
+ */
+long get_output_size(char *file_name, int idx){
+
+	FILE *output;
+	char output_name[MAX_BUFFER];
+	long size;
+
+	if (!(curr_stats.outputs & (1 << idx))) /* skips files that were not written (they may be old files) */
+		return 0;
+
+	sprintf(output_name, "%s%s", file_name, STAT_OUTPUTS_EXT[idx]);
+
+	if (!(output = fopen(output_name, "rb")))
+		return 0;
+
+	fseek(output, 0, SEEK_END);
+	size = ftell(output);
+	fclose(output);
+
+	return size;
+
+}
@@ -0,0 +1,47 @@
+/*
+ *	File: stats.h
+ *
+ *	Defines the data structures and function prototypes of the assembly statistics (--stats option).
+ *	The statistics of a file are the wall time of every phase, the counters of the work that was done
+ *	(lines, macro expansions, symbols, allocations) and the sizes of the output files.
+ *	The summary of all the files adds the throughput (lines/sec and MB/sec) of every phase.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+#define PHASES_NUM 4 /* number of timed phases */
+#define STAT_OUTPUTS_NUM 4 /* number of output files (.am, .ob, .ent, .ext) */
+#define AM_OUTPUT 1 /* flag of the .am file */
+#define OB_OUTPUT 2 /* flag of the .ob file */
+#define ENT_OUTPUT 4 /* flag of the .ent file */
+#define EXT_OUTPUT 8 /* flag of the .ext file */
+
+enum asm_phase {phase_pre_assembler, phase_first_run, phase_second_run, phase_export};
+
+enum stat_counter {stat_source_lines, stat_lines, stat_macros_expanded, stat_source_bytes, stat_symbols,
+				   stat_symbol_max_depth, stat_symbol_depth_sum, stat_counters_num};
+
+/* stats_summary prints only the summary of all the files (used by the benchmark) */
+enum stats_format {stats_none, stats_text, stats_json, stats_summary};
+
+typedef struct { /* statistics of one file */
+	double phase_ms[PHASES_NUM]; /* wall time of every phase in milliseconds */
+	double phase_start[PHASES_NUM]; /* start time of every running phase in milliseconds */
+	long counters[stat_counters_num];
+	long alloc_cnt_start; /* the allocation counters when the file started */
+	long alloc_bytes_start;
+	int is_cached; /* 1 if the outputs were restored from the cache */
+	int outputs; /* flags of the written output files */
+} asm_stats;
+
+/* functions prototype */
+void reset_stats(void);
+void start_phase(enum asm_phase);
+void end_phase(enum asm_phase);
+void add_stat_counter(enum stat_counter, long);
+void set_stats_result(int, int);
+void print_stats(char *, enum stats_format);
+void print_stats_summary(enum stats_format);
@@ -0,0 +1,140 @@
+/*
+ *	File: trace.c
+ *
+ *	This file implements the event tracing (--trace option).
+ *	Every span is written as a complete ("X") Chrome trace event as soon as it ends, so the spans of
+ *	the parsing threads are serialized by a mutex. The timestamps are microseconds of a monotonic clock.
+ *	When the trace ends, the thread names are written as metadata events and the JSON array is closed.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for clock_gettime and pthreads in ansi mode */
+
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+
+/* macro definitions */
+#define NS_IN_US 1000.0 /* nanoseconds in a microsecond */
+#define TRACE_PID 1 /* process id of all the events */
+
+static FILE *trace_des = NULL; /* the trace file (NULL if tracing is off) */
+static int events_cnt = 0; /* number of written events (the first event has no comma before it) */
+static int max_tid = TRACE_MAIN_TID; /* the maximum thread id that was used */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/*
+ *	Starts tracing to a file.
+ *
+ *	param trace_name - The name of the trace file.
+ *	returns 1 if the trace file was opened, 0 otherwise.
+ */
+int start_trace(char *trace_name){
+
+	if (trace_des != NULL) /* only one trace per run */
+		end_trace();
+
+	if (!(trace_des = fopen(trace_name, "w"))){
+		errprintf(trace_name, NO_LINE_ERROR, "cannot open trace file");
+		return 0;
+	}
+
+	events_cnt = 0;
+	max_tid = TRACE_MAIN_TID;
+	fprintf(trace_des, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	return 1;
+
+}
+
+
+
+/*
+ *	Checks if tracing is on.
+ *
+ *	returns 1 if tracing is on, 0 otherwise.
+ */
+int is_tracing(void){
+
+	return trace_des != NULL;
+
+}
+
+
+
+/*
+ *	Gets the current time of the trace clock.
+ *
+ *	returns the time in microseconds.
+ */
+double trace_clock(void){
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * US_IN_SEC + now.tv_nsec / NS_IN_US;
+
+}
+
+
+
+/*
+ *	Writes a span to the trace (does nothing if tracing is off).
+ *
+ *	param name - The name of the span.
+ *	param cat - The category of the span (file, phase, io or worker).
+ *	param start - The start time of the span (trace clock).
+ *	param end - The end time of the span (trace clock).
+ *	param tid - The thread id of the span.
+ */
+void trace_span(const char *name, const char *cat, double start, double end, int tid){
+
+	if (trace_des == NULL)
+		return;
+
+	pthread_mutex_lock(&trace_lock);
+
+	fprintf(trace_des, "%s{\"name\":", events_cnt++ ? ",\n" : "");
+	print_json_string(trace_des, name);
+	fprintf(trace_des, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+			cat, start, end - start, TRACE_PID, tid);
+
+	if (tid > max_tid)
+		max_tid = tid;
+
+	pthread_mutex_unlock(&trace_lock);
+
+}
+
+
+
+/*
+ *	Ends the trace - writes the thread names and closes the trace file.
+ */
+void end_trace(void){
+
+	int i;
+
+	if (trace_des == NULL)
+		return;
+
+	for (i = TRACE_MAIN_TID; i <= max_tid; i++){
+
+		fprintf(trace_des, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+				events_cnt++ ? ",\n" : "", TRACE_PID, i);
+		if (i == TRACE_MAIN_TID)
+			fprintf(trace_des, "\"main\"}}");
+		else
+			fprintf(trace_des, "\"parse worker %d\"}}", i);
+	}
+
+	fprintf(trace_des, "\n]}\n");
+	fclose(trace_des);
+	trace_des = NULL;
+
+}
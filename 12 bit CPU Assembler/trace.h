@@ -0,0 +1,21 @@
+/*
+ *	File: trace.h
+ *
+ *	Defines the function prototypes of the event tracing (--trace option).
+ *	The trace is a Chrome trace event file (loadable by Perfetto and chrome://tracing) with a span for
+ *	every file, every phase of a file and every chunk that a parsing worker thread parsed.
+ *
+ *	author: Gal Levi
+ *	version: 5.8.23
+ */
+
+#include "funcs_and_macs.h"
+
+#define TRACE_MAIN_TID 0 /* thread id of the main thread in the trace (workers are 1, 2, ...) */
+
+/* functions prototype */
+int start_trace(char *);
+int is_tracing(void);
+double trace_clock(void);
+void trace_span(const char *, const char *, double, double, int);
+void end_trace(void);